@@ -0,0 +1,438 @@
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <jsapi.h>
+
+#include <js/Conversions.h>
+#include <js/Promise.h>
+
+#include "asyncio.h"
+
+// AsyncIO gives scripts I/O functions that return a Promise instead of
+// blocking the thread, so that a script can have many reads in flight at once
+// and keep running while they complete:
+//
+//   readFile(path) - resolves with the contents of the file as a string.
+//   readSocket(address, port, data) - connects to a numeric IPv4 or IPv6
+//     address, sends 'data' if given, and resolves with everything received
+//     until the peer closes the connection.
+//
+// Both reject with an Error if the operation fails, or if what was read is not
+// valid UTF-8.
+//
+// Completions are delivered by an epoll loop that plugs into EventLoop as its
+// Source. When the event loop has nothing else to do, it blocks in
+// epoll_wait() until an operation completes or the next timer is due. The
+// promises are kept in a HandleTable until they are settled.
+//
+// Sockets are non-blocking and registered directly with epoll. Regular files,
+// however, are always "ready" as far as epoll is concerned, and a read from a
+// file that is not in the page cache blocks anyway. So files are read on a
+// small pool of worker threads, which signal the epoll loop through an
+// eventfd when a read is done. (io_uring would let the kernel do those reads
+// asynchronously without the threads, but needs a newer kernel and liburing,
+// which this project does not depend on.) The worker threads never touch the
+// JSContext; promises are resolved only on the context's thread.
+//
+// This file uses Linux-specific APIs.
+
+static constexpr int MaxEvents = 64;
+
+// The natives are plain functions and need to find the AsyncIO, as in
+// 'eventloop.cpp'.
+static thread_local boilerplate::AsyncIO* currentIO = nullptr;
+
+boilerplate::AsyncIO::AsyncIO(size_t numThreads)
+    : m_cx(nullptr),
+      m_loop(nullptr),
+      m_epoll(-1),
+      m_wakeup(-1),
+      m_inFlight(0),
+      m_numThreads(numThreads),
+      m_stopping(false) {}
+
+boilerplate::AsyncIO::~AsyncIO(void) {
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_stopping = true;
+  }
+  m_work.notify_all();
+  for (std::thread& thread : m_threads) thread.join();
+
+  // Promises that are still pending are never settled.
+  for (auto& conn : m_connections) close(conn->fd);
+  m_connections.clear();
+  if (m_wakeup >= 0) close(m_wakeup);
+  if (m_epoll >= 0) close(m_epoll);
+
+  if (m_loop) m_loop->setSource(nullptr);
+  m_promises.reset();
+  if (currentIO == this) currentIO = nullptr;
+}
+
+bool boilerplate::AsyncIO::init(JSContext* cx, EventLoop* loop) {
+  m_epoll = epoll_create1(EPOLL_CLOEXEC);
+  m_wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (m_epoll < 0 || m_wakeup < 0) {
+    std::cerr << "AsyncIO: " << strerror(errno) << '\n';
+    return false;
+  }
+
+  epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.ptr = nullptr;  // the eventfd; connections have their own ptr
+  if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeup, &event) < 0) {
+    std::cerr << "AsyncIO: " << strerror(errno) << '\n';
+    return false;
+  }
+
+  m_cx = cx;
+  m_loop = loop;
+  m_promises.reset(new HandleTable(cx));
+  for (size_t ix = 0; ix < m_numThreads; ix++)
+    m_threads.emplace_back(&AsyncIO::workerMain, this);
+
+  loop->setSource(this);
+  currentIO = this;
+  return true;
+}
+
+bool boilerplate::AsyncIO::defineFunctions(JSContext* cx,
+                                           JS::HandleObject global) {
+  static const JSFunctionSpec functions[] = {
+      JS_FN("readFile", &AsyncIO::ReadFile, 1, 0),
+      JS_FN("readSocket", &AsyncIO::ReadSocket, 3, 0), JS_FS_END};
+  return JS_DefineFunctions(cx, global, functions);
+}
+
+// Returns 0 or an errno value.
+static int ReadWholeFile(const std::string& path, std::string* data) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return errno;
+
+  struct stat info;
+  if (fstat(fd, &info) == 0 && info.st_size > 0) data->reserve(info.st_size);
+
+  char buffer[65536];
+  int error = 0;
+  for (;;) {
+    ssize_t count = read(fd, buffer, sizeof(buffer));
+    if (count == 0) break;
+    if (count < 0) {
+      if (errno == EINTR) continue;
+      error = errno;
+      break;
+    }
+    data->append(buffer, count);
+  }
+
+  close(fd);
+  return error;
+}
+
+void boilerplate::AsyncIO::workerMain(void) {
+  for (;;) {
+    std::unique_ptr<FileRead> request;
+    {
+      std::unique_lock<std::mutex> lock(m_lock);
+      m_work.wait(lock, [this] { return m_stopping || !m_queued.empty(); });
+      if (m_stopping) return;
+      request = std::move(m_queued.front());
+      m_queued.pop_front();
+    }
+
+    request->error = ReadWholeFile(request->path, &request->data);
+
+    {
+      std::lock_guard<std::mutex> lock(m_lock);
+      m_completed.push_back(std::move(request));
+    }
+    uint64_t one = 1;
+    if (write(m_wakeup, &one, sizeof(one)) < 0) {
+      // Only fails if the counter would overflow, in which case the epoll
+      // loop is going to wake up anyway.
+    }
+  }
+}
+
+void boilerplate::AsyncIO::wait(JSContext* cx, int timeoutMs) {
+  epoll_event events[MaxEvents];
+  int count = epoll_wait(m_epoll, events, MaxEvents, timeoutMs);
+  if (count < 0) {
+    if (errno != EINTR) std::cerr << "epoll_wait: " << strerror(errno) << '\n';
+    return;
+  }
+
+  // Settling a promise only enqueues its reaction jobs, so no JS runs here and
+  // m_connections can't change under us, other than by closeConnection().
+  for (int ix = 0; ix < count; ix++) {
+    if (!events[ix].data.ptr) {
+      uint64_t signalled;
+      if (read(m_wakeup, &signalled, sizeof(signalled)) < 0) {
+        // EAGAIN: another wakeup already took care of it.
+      }
+      completeFileReads(cx);
+      continue;
+    }
+    handleConnection(cx, static_cast<Connection*>(events[ix].data.ptr),
+                     events[ix].events);
+  }
+}
+
+void boilerplate::AsyncIO::completeFileReads(JSContext* cx) {
+  std::vector<std::unique_ptr<FileRead>> completed;
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    std::swap(completed, m_completed);
+  }
+  for (auto& request : completed) {
+    settle(cx, request->promise, ("readFile: " + request->path).c_str(),
+           request->data, request->error);
+  }
+}
+
+void boilerplate::AsyncIO::settle(JSContext* cx, HandleTable::Handle handle,
+                                  const char* what, const std::string& data,
+                                  int error) {
+  JS::RootedObject promise(cx, &m_promises->get(handle).toObject());
+  m_promises->remove(handle);
+  m_inFlight--;
+
+  JSAutoRealm ar(cx, promise);
+
+  bool ok = false;
+  if (error == 0) {
+    JS::RootedString str(cx, JS_NewStringCopyUTF8N(
+                                 cx, JS::UTF8Chars(data.data(), data.size())));
+    JS::RootedValue value(cx);
+    if (str) {
+      value.setString(str);
+      ok = JS::ResolvePromise(cx, promise, value);
+    }
+  } else {
+    JS_ReportErrorUTF8(cx, "%s: %s", what, strerror(error));
+  }
+  if (ok) return;
+
+  // Turn the pending exception into the rejection reason.
+  JS::RootedValue exception(cx);
+  if (!JS_GetPendingException(cx, &exception)) return;
+  JS_ClearPendingException(cx);
+  if (!JS::RejectPromise(cx, promise, exception)) JS_ClearPendingException(cx);
+}
+
+void boilerplate::AsyncIO::handleConnection(JSContext* cx, Connection* conn,
+                                            uint32_t events) {
+  // Settles the promise, with an error if 'error' is not 0.
+  auto finish = [&](int error) {
+    settle(cx, conn->promise, "readSocket", conn->in, error);
+    closeConnection(conn);
+  };
+
+  if (!conn->connected) {
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0)
+      error = errno;
+    if (error != 0) return finish(error);
+    conn->connected = true;
+  }
+
+  while (!conn->reading) {
+    if (conn->written == conn->out.size()) {
+      epoll_event event = {};
+      event.events = EPOLLIN;
+      event.data.ptr = conn;
+      if (epoll_ctl(m_epoll, EPOLL_CTL_MOD, conn->fd, &event) < 0)
+        return finish(errno);
+      conn->reading = true;
+      // The response may already be there, but we'll hear about it with the
+      // next epoll_wait(), so stop here.
+      return;
+    }
+
+    ssize_t count = send(conn->fd, conn->out.data() + conn->written,
+                         conn->out.size() - conn->written, MSG_NOSIGNAL);
+    if (count < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+      if (errno == EINTR) continue;
+      return finish(errno);
+    }
+    conn->written += count;
+  }
+
+  for (;;) {
+    char buffer[16384];
+    ssize_t count = recv(conn->fd, buffer, sizeof(buffer), 0);
+    if (count > 0) {
+      conn->in.append(buffer, count);
+      continue;
+    }
+    if (count == 0) return finish(0);  // the peer closed the connection
+    if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+    if (errno == EINTR) continue;
+    return finish(errno);
+  }
+}
+
+void boilerplate::AsyncIO::closeConnection(Connection* conn) {
+  close(conn->fd);  // also removes it from the epoll set
+  for (size_t ix = 0; ix < m_connections.size(); ix++) {
+    if (m_connections[ix].get() == conn) {
+      std::swap(m_connections[ix], m_connections.back());
+      m_connections.pop_back();
+      return;
+    }
+  }
+}
+
+bool boilerplate::AsyncIO::ReadFile(JSContext* cx, unsigned argc,
+                                    JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  if (!args.requireAtLeast(cx, "readFile", 1)) return false;
+
+  AsyncIO* io = currentIO;
+  if (!io) {
+    JS_ReportErrorASCII(cx, "readFile: no AsyncIO is running on this thread");
+    return false;
+  }
+
+  JS::RootedString pathStr(cx, JS::ToString(cx, args[0]));
+  if (!pathStr) return false;
+  JS::UniqueChars path = JS_EncodeStringToUTF8(cx, pathStr);
+  if (!path) return false;
+
+  JS::RootedObject promise(cx, JS::NewPromiseObject(cx, nullptr));
+  if (!promise) return false;
+
+  std::unique_ptr<FileRead> request(new FileRead());
+  request->path = path.get();
+  request->promise = io->m_promises->add(JS::ObjectValue(*promise));
+  request->error = 0;
+  if (request->promise == HandleTable::InvalidHandle) {
+    JS_ReportOutOfMemory(cx);
+    return false;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(io->m_lock);
+    io->m_queued.push_back(std::move(request));
+  }
+  io->m_work.notify_one();
+  io->m_inFlight++;
+
+  args.rval().setObject(*promise);
+  return true;
+}
+
+bool boilerplate::AsyncIO::ReadSocket(JSContext* cx, unsigned argc,
+                                      JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  if (!args.requireAtLeast(cx, "readSocket", 2)) return false;
+
+  AsyncIO* io = currentIO;
+  if (!io) {
+    JS_ReportErrorASCII(cx,
+                        "readSocket: no AsyncIO is running on this thread");
+    return false;
+  }
+
+  JS::RootedString addressStr(cx, JS::ToString(cx, args[0]));
+  if (!addressStr) return false;
+  JS::UniqueChars address = JS_EncodeStringToUTF8(cx, addressStr);
+  if (!address) return false;
+
+  uint32_t port;
+  if (!JS::ToUint32(cx, args[1], &port)) return false;
+  if (port == 0 || port > 65535) {
+    JS_ReportErrorASCII(cx, "readSocket: invalid port");
+    return false;
+  }
+
+  JS::UniqueChars out;
+  if (!args.get(2).isUndefined()) {
+    JS::RootedString outStr(cx, JS::ToString(cx, args[2]));
+    if (!outStr || !(out = JS_EncodeStringToUTF8(cx, outStr))) return false;
+  }
+
+  // Only numeric addresses, since looking up a host name would block.
+  sockaddr_storage storage = {};
+  socklen_t length;
+  auto* addr4 = reinterpret_cast<sockaddr_in*>(&storage);
+  auto* addr6 = reinterpret_cast<sockaddr_in6*>(&storage);
+  if (inet_pton(AF_INET, address.get(), &addr4->sin_addr) == 1) {
+    addr4->sin_family = AF_INET;
+    addr4->sin_port = htons(port);
+    length = sizeof(*addr4);
+  } else if (inet_pton(AF_INET6, address.get(), &addr6->sin6_addr) == 1) {
+    addr6->sin6_family = AF_INET6;
+    addr6->sin6_port = htons(port);
+    length = sizeof(*addr6);
+  } else {
+    JS_ReportErrorUTF8(cx, "readSocket: not a numeric address: %s",
+                       address.get());
+    return false;
+  }
+
+  JS::RootedObject promise(cx, JS::NewPromiseObject(cx, nullptr));
+  if (!promise) return false;
+
+  int fd = socket(storage.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                  0);
+  if (fd < 0) {
+    JS_ReportErrorUTF8(cx, "readSocket: %s", strerror(errno));
+    return false;
+  }
+  if (connect(fd, reinterpret_cast<sockaddr*>(&storage), length) < 0 &&
+      errno != EINPROGRESS) {
+    JS_ReportErrorUTF8(cx, "readSocket: %s: %s", address.get(),
+                       strerror(errno));
+    close(fd);
+    return false;
+  }
+
+  std::unique_ptr<Connection> conn(new Connection());
+  conn->fd = fd;
+  conn->connected = false;
+  conn->reading = false;
+  if (out) conn->out = out.get();
+  conn->written = 0;
+  conn->promise = io->m_promises->add(JS::ObjectValue(*promise));
+  if (conn->promise == HandleTable::InvalidHandle) {
+    close(fd);
+    JS_ReportOutOfMemory(cx);
+    return false;
+  }
+
+  // Writable means connected, or failed to connect.
+  epoll_event event = {};
+  event.events = EPOLLOUT;
+  event.data.ptr = conn.get();
+  if (epoll_ctl(io->m_epoll, EPOLL_CTL_ADD, fd, &event) < 0) {
+    io->m_promises->remove(conn->promise);
+    close(fd);
+    JS_ReportErrorUTF8(cx, "readSocket: %s", strerror(errno));
+    return false;
+  }
+
+  io->m_connections.push_back(std::move(conn));
+  io->m_inFlight++;
+
+  args.rval().setObject(*promise);
+  return true;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <jsapi.h>
+
+#include "eventloop.h"
+#include "handletable.h"
+
+// See 'asyncio.cpp' for documentation.
+
+namespace boilerplate {
+
+class AsyncIO : public EventLoop::Source {
+ public:
+  explicit AsyncIO(size_t numThreads = 4);
+  ~AsyncIO(void) override;
+
+  AsyncIO(const AsyncIO&) = delete;
+  AsyncIO& operator=(const AsyncIO&) = delete;
+
+  bool init(JSContext* cx, EventLoop* loop);
+
+  // Defines readFile() and readSocket() on the global.
+  bool defineFunctions(JSContext* cx, JS::HandleObject global);
+
+  // EventLoop::Source implementation.
+  bool pending(void) const override { return m_inFlight > 0; }
+  void wait(JSContext* cx, int timeoutMs) override;
+
+ private:
+  struct FileRead {
+    std::string path;
+    HandleTable::Handle promise;
+    std::string data;
+    int error;  // errno, or 0
+  };
+
+  struct Connection {
+    int fd;
+    bool connected;
+    bool reading;  // done sending, waiting for the response
+    std::string out;
+    size_t written;
+    std::string in;
+    HandleTable::Handle promise;
+  };
+
+  void workerMain(void);
+  void completeFileReads(JSContext* cx);
+  void handleConnection(JSContext* cx, Connection* conn, uint32_t events);
+  void closeConnection(Connection* conn);
+  void settle(JSContext* cx, HandleTable::Handle promise, const char* what,
+              const std::string& data, int error);
+
+  static bool ReadFile(JSContext* cx, unsigned argc, JS::Value* vp);
+  static bool ReadSocket(JSContext* cx, unsigned argc, JS::Value* vp);
+
+  JSContext* m_cx;
+  EventLoop* m_loop;
+  int m_epoll;
+  int m_wakeup;  // eventfd that the workers signal
+  size_t m_inFlight;
+  std::unique_ptr<HandleTable> m_promises;
+  std::vector<std::unique_ptr<Connection>> m_connections;
+
+  size_t m_numThreads;
+  std::vector<std::thread> m_threads;
+  std::mutex m_lock;
+  std::condition_variable m_work;
+  bool m_stopping;
+  std::deque<std::unique_ptr<FileRead>> m_queued;
+  std::vector<std::unique_ptr<FileRead>> m_completed;
+};
+
+}  // namespace boilerplate
@@ -0,0 +1,241 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <jsapi.h>
+
+#include <js/CompilationAndEvaluation.h>
+#include <js/Initialization.h>
+#include <js/Promise.h>
+#include <js/SourceText.h>
+
+#include "asyncio.h"
+#include "boilerplate.h"
+#include "eventloop.h"
+
+// This example shows how to give scripts non-blocking I/O with natives that
+// return a Promise, using boilerplate::AsyncIO on top of
+// boilerplate::EventLoop. See 'asyncio.cpp' for how it works.
+//
+// It writes a number of temporary files, and starts a server thread on a
+// local port that answers each connection after a delay, like a slow remote
+// service would. Then it reads the files and queries the server, once waiting
+// for each read before starting the next, and once with all of them in flight
+// at the same time, and prints how long each took.
+//
+// The number of files and of connections can be given as the first argument,
+// and the server's delay in milliseconds as the second.
+
+static unsigned numRequests = 50;
+static unsigned serverDelayMs = 20;
+static constexpr size_t fileSize = 256 * 1024;
+
+using Clock = std::chrono::steady_clock;
+using Milliseconds = std::chrono::duration<double, std::milli>;
+
+// Each benchmark is an async function taking the list of file paths and the
+// server's port.
+static const struct {
+  const char* name;
+  const char* code;
+} benchmarks[] = {
+    {"files, one at a time",
+     "async (files, port) => { let total = 0; for (const f of files) total "
+     "+= (await readFile(f)).length; return total; }"},
+    {"files, all at once",
+     "async (files, port) => (await Promise.all(files.map(readFile)))"
+     ".reduce((total, s) => total + s.length, 0)"},
+    {"sockets, one at a time",
+     "async (files, port) => { let total = 0; for (const f of files) total "
+     "+= (await readSocket('127.0.0.1', port, f + '\\n')).length; "
+     "return total; }"},
+    {"sockets, all at once",
+     "async (files, port) => (await Promise.all(files.map(f => "
+     "readSocket('127.0.0.1', port, f + '\\n'))))"
+     ".reduce((total, s) => total + s.length, 0)"},
+};
+
+// A server that reads one line from each connection and echoes it back after
+// serverDelayMs. Each connection is handled on its own thread, so that the
+// delays overlap if the client makes many connections at once.
+class SlowServer {
+  int m_fd;
+  uint16_t m_port;
+  std::thread m_acceptThread;
+  std::vector<std::thread> m_handlers;
+
+  static void Handle(int fd) {
+    std::string line;
+    char c;
+    while (line.size() < 4096 && recv(fd, &c, 1, 0) == 1 && c != '\n')
+      line += c;
+    std::this_thread::sleep_for(std::chrono::milliseconds(serverDelayMs));
+    line += '\n';
+    (void)send(fd, line.data(), line.size(), MSG_NOSIGNAL);
+    close(fd);
+  }
+
+  void acceptLoop(void) {
+    for (;;) {
+      int fd = accept(m_fd, nullptr, nullptr);
+      if (fd < 0) return;  // shut down
+      m_handlers.emplace_back(&SlowServer::Handle, fd);
+    }
+  }
+
+ public:
+  SlowServer(void) : m_fd(-1), m_port(0) {}
+
+  ~SlowServer(void) {
+    if (m_fd < 0) return;
+    shutdown(m_fd, SHUT_RDWR);  // makes accept() fail
+    m_acceptThread.join();
+    for (std::thread& handler : m_handlers) handler.join();
+    close(m_fd);
+  }
+
+  bool start(void) {
+    m_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;  // any free port
+    socklen_t length = sizeof(addr);
+    if (m_fd < 0 ||
+        bind(m_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        listen(m_fd, SOMAXCONN) < 0 ||
+        getsockname(m_fd, reinterpret_cast<sockaddr*>(&addr), &length) < 0) {
+      perror("server");
+      // The destructor only cleans up a server that started.
+      if (m_fd >= 0) close(m_fd);
+      m_fd = -1;
+      return false;
+    }
+    m_port = ntohs(addr.sin_port);
+    m_acceptThread = std::thread(&SlowServer::acceptLoop, this);
+    return true;
+  }
+
+  uint16_t port(void) const { return m_port; }
+};
+
+class TempFiles {
+  std::vector<std::string> m_paths;
+
+ public:
+  ~TempFiles(void) {
+    for (const std::string& path : m_paths) unlink(path.c_str());
+  }
+
+  bool create(unsigned count, size_t size) {
+    std::string contents(size, 'x');
+    for (unsigned ix = 0; ix < count; ix++) {
+      char path[] = "/tmp/asyncread-XXXXXX";
+      int fd = mkstemp(path);
+      if (fd < 0) {
+        perror("mkstemp");
+        return false;
+      }
+      m_paths.push_back(path);
+      bool ok = write(fd, contents.data(), size) == ssize_t(size);
+      close(fd);
+      if (!ok) {
+        perror("write");
+        return false;
+      }
+    }
+    return true;
+  }
+
+  const std::vector<std::string>& paths(void) const { return m_paths; }
+};
+
+static bool RunBenchmark(JSContext* cx, boilerplate::EventLoop* loop,
+                         const char* name, const char* code,
+                         JS::HandleValue files, uint16_t port) {
+  JS::CompileOptions options(cx);
+  options.setFileAndLine(name, 1);
+  JS::SourceText<mozilla::Utf8Unit> source;
+  JS::RootedValue fn(cx);
+  if (!source.init(cx, code, strlen(code), JS::SourceOwnership::Borrowed) ||
+      !JS::Evaluate(cx, options, source, &fn))
+    return false;
+
+  JS::RootedValueArray<2> args(cx);
+  args[0].set(files);
+  args[1].setInt32(port);
+  JS::RootedValue rval(cx);
+
+  Clock::time_point start = Clock::now();
+  if (!JS_CallFunctionValue(cx, nullptr, fn, args, &rval)) return false;
+  loop->run(cx);
+  Milliseconds elapsed = Clock::now() - start;
+
+  JS::RootedObject promise(cx, &rval.toObject());
+  if (JS::GetPromiseState(promise) != JS::PromiseState::Fulfilled) {
+    std::cerr << name << ": failed\n";
+    return false;
+  }
+  std::cout << name << "\t" << elapsed.count() << " ms\t"
+            << JS::GetPromiseResult(promise).toNumber() << " characters\n";
+  return true;
+}
+
+static bool AsyncReadExample(JSContext* cx) {
+  TempFiles tempFiles;
+  SlowServer server;
+  if (!tempFiles.create(numRequests, fileSize) || !server.start()) return false;
+
+  boilerplate::EventLoop loop;
+  boilerplate::AsyncIO io;
+  if (!loop.init(cx) || !io.init(cx, &loop)) return false;
+
+  // Self-hosting must be initialized after setting up the job queue.
+  if (!JS::InitSelfHostedCode(cx)) return false;
+
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) return false;
+
+  JSAutoRealm ar(cx, global);
+
+  if (!loop.defineFunctions(cx, global) || !io.defineFunctions(cx, global))
+    return false;
+
+  JS::RootedObject array(cx, JS_NewArrayObject(cx, 0));
+  if (!array) return false;
+  JS::RootedString path(cx);
+  for (size_t ix = 0; ix < tempFiles.paths().size(); ix++) {
+    path = JS_NewStringCopyZ(cx, tempFiles.paths()[ix].c_str());
+    if (!path || !JS_SetElement(cx, array, ix, path)) return false;
+  }
+  JS::RootedValue files(cx, JS::ObjectValue(*array));
+
+  std::cout << numRequests << " files of " << fileSize / 1024
+            << " KB, and connections with a " << serverDelayMs
+            << " ms delay\n";
+  for (const auto& benchmark : benchmarks) {
+    if (!RunBenchmark(cx, &loop, benchmark.name, benchmark.code, files,
+                      server.port()))
+      return false;
+  }
+  return true;
+}
+
+int main(int argc, const char* argv[]) {
+  if (argc > 1) numRequests = strtoul(argv[1], nullptr, 10);
+  if (argc > 2) serverDelayMs = strtoul(argv[2], nullptr, 10);
+
+  if (!boilerplate::RunExample(AsyncReadExample,
+                               /* initSelfHosting = */ false))
+    return 1;
+  return 0;
+}
@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <jsapi.h>
+
+#include "bench.h"
+
+// A small harness for microbenchmarks of the embedding API, so that the cost
+// of the common operations can be compared across SpiderMonkey versions.
+//
+// Each benchmark is a body that performs the operation a given number of
+// times. The runner first finds how many iterations make one repetition take
+// at least options.minRepetitionTime, so that the clock's resolution doesn't
+// matter, doubling the count until it does. Then it runs a few warmup
+// repetitions, which give the JITs and the GC a chance to settle, and then
+// the measured repetitions. The time per iteration of each repetition is one
+// sample; the report gives the minimum, median, maximum, and mean of the
+// samples. With the default 30 repetitions, a 99th percentile would just be
+// the maximum under another name, so none is reported.
+//
+// The JSON report has one object per benchmark, with times in nanoseconds,
+// and the SpiderMonkey version, so that the reports from two versions can be
+// compared by a script.
+
+using Clock = std::chrono::steady_clock;
+
+static bool ParseUnsigned(const char* arg, const char* text, unsigned* value) {
+  char* end;
+  unsigned long parsed = strtoul(text, &end, 10);
+  if (*text == '\0' || *end != '\0') {
+    std::cerr << "invalid value for " << arg << '\n';
+    return false;
+  }
+  *value = unsigned(parsed);
+  return true;
+}
+
+bool boilerplate::BenchOptions::parseArgs(int argc, const char* argv[]) {
+  for (int ix = 1; ix < argc; ix++) {
+    const char* arg = argv[ix];
+    unsigned value;
+    if (strcmp(arg, "--json") == 0) {
+      json = true;
+    } else if (strncmp(arg, "--bench-filter=", 15) == 0) {
+      filter = arg + 15;
+    } else if (strncmp(arg, "--bench-warmup=", 15) == 0) {
+      if (!ParseUnsigned(arg, arg + 15, &warmup)) return false;
+    } else if (strncmp(arg, "--bench-repetitions=", 20) == 0) {
+      if (!ParseUnsigned(arg, arg + 20, &repetitions)) return false;
+      repetitions = std::max(repetitions, 1u);
+    } else if (strncmp(arg, "--bench-min-us=", 15) == 0) {
+      if (!ParseUnsigned(arg, arg + 15, &value)) return false;
+      minRepetitionTime = std::chrono::microseconds(value);
+    }
+  }
+  return true;
+}
+
+static double Percentile(const std::vector<double>& sorted, double fraction) {
+  size_t index = size_t(std::ceil(fraction * sorted.size()));
+  return sorted[std::min(sorted.size(), std::max<size_t>(index, 1)) - 1];
+}
+
+bool boilerplate::BenchRunner::run(const std::string& name,
+                                   const Body& body) {
+  if (!m_options.filter.empty() &&
+      name.find(m_options.filter) == std::string::npos)
+    return true;
+
+  auto timeRepetition = [&body](size_t iterations, Clock::duration* elapsed) {
+    Clock::time_point start = Clock::now();
+    if (!body(iterations)) return false;
+    *elapsed = Clock::now() - start;
+    return true;
+  };
+
+  size_t iterations = 1;
+  Clock::duration elapsed;
+  for (;;) {
+    if (!timeRepetition(iterations, &elapsed)) return false;
+    if (elapsed >= m_options.minRepetitionTime) break;
+    iterations *= 2;
+  }
+
+  for (unsigned ix = 0; ix < m_options.warmup; ix++) {
+    if (!timeRepetition(iterations, &elapsed)) return false;
+  }
+
+  std::vector<double> samples;
+  samples.reserve(m_options.repetitions);
+  for (unsigned ix = 0; ix < m_options.repetitions; ix++) {
+    if (!timeRepetition(iterations, &elapsed)) return false;
+    std::chrono::duration<double, std::nano> ns = elapsed;
+    samples.push_back(ns.count() / iterations);
+  }
+  std::sort(samples.begin(), samples.end());
+
+  double sum = 0;
+  for (double sample : samples) sum += sample;
+
+  m_results.push_back({name, iterations, samples.front(),
+                       Percentile(samples, 0.5), samples.back(),
+                       sum / samples.size()});
+  if (!m_options.json)
+    std::cerr << name << ": p50 " << m_results.back().p50Ns << " ns\n";
+  return true;
+}
+
+// Benchmark names are plain ASCII, so they need no escaping, except for
+// quotes and backslashes just in case.
+static void WriteJSONString(std::ostream& out, const std::string& str) {
+  out << '"';
+  for (char c : str) {
+    if (c == '"' || c == '\\') out << '\\';
+    out << c;
+  }
+  out << '"';
+}
+
+void boilerplate::BenchRunner::report(std::ostream& out) const {
+  if (m_options.json) {
+    out << "{\"engine\":";
+    WriteJSONString(out, JS_GetImplementationVersion());
+    out << ",\"repetitions\":" << m_options.repetitions
+        << ",\"benchmarks\":[";
+    for (size_t ix = 0; ix < m_results.size(); ix++) {
+      const BenchResult& result = m_results[ix];
+      out << (ix ? "," : "") << "{\"name\":";
+      WriteJSONString(out, result.name);
+      out << ",\"iterations\":" << result.iterations
+          << ",\"minNs\":" << result.minNs << ",\"p50Ns\":" << result.p50Ns
+          << ",\"maxNs\":" << result.maxNs << ",\"meanNs\":" << result.meanNs
+          << '}';
+    }
+    out << "]}\n";
+    return;
+  }
+
+  out << JS_GetImplementationVersion() << ", " << m_options.repetitions
+      << " repetitions, ns per iteration\n"
+      << std::left << std::setw(40) << "benchmark" << std::right
+      << std::setw(12) << "min" << std::setw(12) << "p50" << std::setw(12)
+      << "max" << '\n';
+  for (const BenchResult& result : m_results) {
+    out << std::left << std::setw(40) << result.name << std::right
+        << std::fixed << std::setprecision(1) << std::setw(12) << result.minNs
+        << std::setw(12) << result.p50Ns << std::setw(12) << result.maxNs
+        << '\n';
+  }
+  out.unsetf(std::ios::fixed);
+}
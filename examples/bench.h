@@ -0,0 +1,58 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// See 'bench.cpp' for documentation.
+
+namespace boilerplate {
+
+struct BenchOptions {
+  unsigned warmup = 3;        // repetitions that are run but not counted
+  unsigned repetitions = 30;  // repetitions that are counted
+  // Each repetition runs the body enough times to take at least this long.
+  std::chrono::microseconds minRepetitionTime{2000};
+  std::string filter;  // only run benchmarks whose name contains this
+  bool json = false;
+
+  // Reads --bench-warmup=N, --bench-repetitions=N, --bench-min-us=N,
+  // --bench-filter=TEXT, and --json. Other arguments are ignored.
+  bool parseArgs(int argc, const char* argv[]);
+};
+
+struct BenchResult {
+  std::string name;
+  size_t iterations;  // per repetition
+  // Time per iteration, over the repetitions.
+  double minNs;
+  double p50Ns;
+  double maxNs;
+  double meanNs;
+};
+
+class BenchRunner {
+ public:
+  // Runs the benchmarked operation 'iterations' times. Returns false on
+  // failure, with an exception pending if it was a JS error.
+  using Body = std::function<bool(size_t iterations)>;
+
+  explicit BenchRunner(const BenchOptions& options) : m_options(options) {}
+
+  // Returns false if the body failed. Skipped benchmarks succeed.
+  bool run(const std::string& name, const Body& body);
+
+  const std::vector<BenchResult>& results(void) const { return m_results; }
+
+  // Writes one line per result, or a JSON object if options.json is set.
+  void report(std::ostream& out) const;
+
+ private:
+  BenchOptions m_options;
+  std::vector<BenchResult> m_results;
+};
+
+}  // namespace boilerplate
@@ -0,0 +1,211 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <jsapi.h>
+
+#include <js/CompilationAndEvaluation.h>
+#include <js/SourceText.h>
+
+#include "bindings.h"
+#include "boilerplate.h"
+
+// This example compares hand-written JSNatives with ones generated by the
+// templates in 'bindings.h', for a few kinds of functions: one with no
+// arguments, one with number arguments, one with a string argument, and a
+// method of a C++ object stored in the `this` object's private pointer.
+// For each pair, JS calls the function in a loop and we print the time per
+// call.
+//
+// The number of calls can be given as the first argument.
+
+static unsigned numCalls = 10000000;
+
+using Clock = std::chrono::steady_clock;
+using Nanoseconds = std::chrono::duration<double, std::nano>;
+
+///// The C++ functions ////////////////////////////////////////////////////////
+
+static int32_t ReturnInteger(void) { return 23; }
+
+static double Add(double a, double b) { return a + b; }
+
+static uint32_t Length(const std::string& str) { return str.size(); }
+
+class Counter {
+  int32_t m_count;
+
+ public:
+  Counter(void) : m_count(0) {}
+
+  int32_t increment(int32_t by) { return m_count += by; }
+
+  static void finalize(JSFreeOp* fop, JSObject* obj) {
+    delete static_cast<Counter*>(JS_GetPrivate(obj));
+  }
+
+  static constexpr JSClassOps classOps = {
+      nullptr,  // addProperty
+      nullptr,  // deleteProperty
+      nullptr,  // enumerate
+      nullptr,  // newEnumerate
+      nullptr,  // resolve
+      nullptr,  // mayResolve
+      &Counter::finalize,
+      nullptr,  // call
+      nullptr,  // hasInstance
+      nullptr,  // construct
+      nullptr,  // trace
+  };
+
+  // boilerplate::bindings::NativeThis uses this to check the class of `this`
+  // before getting the private pointer.
+  static constexpr JSClass klass = {
+      "Counter",
+      JSCLASS_HAS_PRIVATE | JSCLASS_FOREGROUND_FINALIZE,
+      &Counter::classOps,
+  };
+};
+constexpr JSClassOps Counter::classOps;
+constexpr JSClass Counter::klass;
+
+///// Hand-written JSNatives for the same functions ////////////////////////////
+
+static bool ReturnIntegerNative(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  args.rval().setInt32(ReturnInteger());
+  return true;
+}
+
+static bool AddNative(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  double a, b;
+  if (!JS::ToNumber(cx, args.get(0), &a) || !JS::ToNumber(cx, args.get(1), &b))
+    return false;
+  args.rval().setDouble(Add(a, b));
+  return true;
+}
+
+static bool LengthNative(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  JS::RootedString str(cx, JS::ToString(cx, args.get(0)));
+  if (!str) return false;
+  JS::UniqueChars chars = JS_EncodeStringToUTF8(cx, str);
+  if (!chars) return false;
+  args.rval().setNumber(Length(chars.get()));
+  return true;
+}
+
+static bool IncrementNative(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  JS::RootedObject thisObj(cx);
+  if (!args.computeThis(cx, &thisObj)) return false;
+  auto* counter = static_cast<Counter*>(
+      JS_GetInstancePrivate(cx, thisObj, &Counter::klass, &args));
+  if (!counter) return false;
+
+  int32_t by;
+  if (!JS::ToInt32(cx, args.get(0), &by)) return false;
+  args.rval().setInt32(counter->increment(by));
+  return true;
+}
+
+static bool CounterConstructor(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  if (!args.isConstructing()) {
+    JS_ReportErrorASCII(cx, "You must call this constructor with 'new'");
+    return false;
+  }
+  JS::RootedObject thisObj(
+      cx, JS_NewObjectForConstructor(cx, &Counter::klass, args));
+  if (!thisObj) return false;
+  JS_SetPrivate(thisObj, new Counter());
+  args.rval().setObject(*thisObj);
+  return true;
+}
+
+///// Setting up the two versions of each function /////////////////////////////
+
+static JSFunctionSpec globalFunctions[] = {
+    JS_FN("returnIntegerHandWritten", ReturnIntegerNative, 0, 0),
+    BOILERPLATE_FN("returnIntegerGenerated", ReturnInteger, 0),
+    JS_FN("addHandWritten", AddNative, 2, 0),
+    BOILERPLATE_FN("addGenerated", Add, 0),
+    JS_FN("lengthHandWritten", LengthNative, 1, 0),
+    BOILERPLATE_FN("lengthGenerated", Length, 0),
+    JS_FS_END};
+
+static JSFunctionSpec counterMethods[] = {
+    JS_FN("incrementHandWritten", IncrementNative, 1, 0),
+    BOILERPLATE_FN("incrementGenerated", Counter::increment, 0), JS_FS_END};
+
+static const struct {
+  const char* name;
+  const char* call;  // %s is replaced by HandWritten or Generated
+} benchmarks[] = {
+    {"no arguments", "returnInteger%s()"},
+    {"two numbers", "add%s(i, 0.5)"},
+    {"string", "length%s('hello')"},
+    {"method", "counter.increment%s(1)"},
+};
+
+static bool TimeCalls(JSContext* cx, const char* call, const char* which,
+                      Nanoseconds* perCall) {
+  char callCode[64];
+  snprintf(callCode, sizeof(callCode), call, which);
+  std::string code = "(function (n) { const counter = new Counter(); ";
+  code += "let x; for (let i = 0; i < n; i++) x = ";
+  code += callCode;
+  code += "; return x; })";
+
+  JS::CompileOptions options(cx);
+  options.setFileAndLine("bindings", 1);
+  JS::SourceText<mozilla::Utf8Unit> source;
+  JS::RootedValue fn(cx);
+  if (!source.init(cx, code.c_str(), code.size(),
+                   JS::SourceOwnership::Borrowed) ||
+      !JS::Evaluate(cx, options, source, &fn))
+    return false;
+
+  JS::RootedValueArray<1> args(cx);
+  args[0].setNumber(numCalls);
+  JS::RootedValue rval(cx);
+
+  Clock::time_point start = Clock::now();
+  if (!JS_CallFunctionValue(cx, nullptr, fn, args, &rval)) return false;
+  *perCall = Nanoseconds(Clock::now() - start) / numCalls;
+  return true;
+}
+
+static bool BindingsExample(JSContext* cx) {
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) return false;
+
+  JSAutoRealm ar(cx, global);
+
+  if (!JS_DefineFunctions(cx, global, globalFunctions) ||
+      !JS_InitClass(cx, global, nullptr, &Counter::klass, CounterConstructor,
+                    0, nullptr, counterMethods, nullptr, nullptr))
+    return false;
+
+  std::cout << numCalls << " calls\n"
+            << "function\thand-written\tgenerated\n";
+  for (const auto& benchmark : benchmarks) {
+    Nanoseconds handWritten, generated;
+    if (!TimeCalls(cx, benchmark.call, "HandWritten", &handWritten) ||
+        !TimeCalls(cx, benchmark.call, "Generated", &generated))
+      return false;
+    std::cout << benchmark.name << "\t" << handWritten.count() << " ns\t"
+              << generated.count() << " ns\n";
+  }
+  return true;
+}
+
+int main(int argc, const char* argv[]) {
+  if (argc > 1) numCalls = strtoul(argv[1], nullptr, 10);
+
+  if (!boilerplate::RunExample(BindingsExample)) return 1;
+  return 0;
+}
@@ -0,0 +1,465 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <jsapi.h>
+
+#include <js/CallArgs.h>
+#include <js/Conversions.h>
+
+/* Generating JSNatives from ordinary C++ functions.
+ *
+ * A JSNative that wraps a C++ function always does the same things: get the
+ * CallArgs, maybe compute `this`, convert each argument, call the function,
+ * and convert the return value. This header does that at compile time, so
+ * that you can write
+ *
+ *     static double Add(double a, double b) { return a + b; }
+ *
+ *     static JSFunctionSpec functions[] = {
+ *         BOILERPLATE_FN("add", Add, JSPROP_ENUMERATE),
+ *         JS_FS_END};
+ *
+ * instead of a JSNative that calls JS::ToNumber() on each argument.
+ * BOILERPLATE_NATIVE(Add) gives just the JSNative, for example to use with
+ * JS_PSG() or JS_DefineFunction().
+ *
+ * The parameters of the function can be:
+ *   - int32_t, uint32_t, double, bool: converted as in JS, but without a
+ *     function call if the value already has that type;
+ *   - std::string (or const std::string&): converted to a UTF-8 string;
+ *   - JS::HandleValue: passed as-is, without any conversion;
+ *   - JSContext*: doesn't use up a JS argument. If the function takes one, it
+ *     may also fail by setting a pending exception, for example with
+ *     JS_ReportErrorASCII();
+ *   - JS::HandleObject: doesn't use up a JS argument. It receives the `this`
+ *     object. Only natives whose function takes one call computeThis().
+ * Missing JS arguments are treated as undefined.
+ *
+ * The return type can be void, int32_t, uint32_t, double, bool, std::string,
+ * const char*, JSString*, JSObject*, or JS::Value.
+ *
+ * Member functions work too, in which case the C++ object comes from the
+ * `this` object's private pointer, by default (see NativeThis below.)
+ *
+ * Everything is resolved at compile time, so a generated native is as fast as
+ * a hand-written one. The 'bindings.cpp' example measures this. */
+
+namespace boilerplate {
+namespace bindings {
+
+// Argument conversions. Storage is what the converted value is kept in until
+// the function is called.
+
+template <typename T>
+struct ArgConverter;  // Not defined: the parameter type is not supported
+
+template <>
+struct ArgConverter<int32_t> {
+  using Storage = int32_t;
+  static bool convert(JSContext* cx, JS::HandleValue v, Storage* out) {
+    if (v.isInt32()) {
+      *out = v.toInt32();
+      return true;
+    }
+    return JS::ToInt32(cx, v, out);
+  }
+  static int32_t unwrap(Storage& s) { return s; }
+};
+
+template <>
+struct ArgConverter<uint32_t> {
+  using Storage = uint32_t;
+  static bool convert(JSContext* cx, JS::HandleValue v, Storage* out) {
+    if (v.isInt32() && v.toInt32() >= 0) {
+      *out = v.toInt32();
+      return true;
+    }
+    return JS::ToUint32(cx, v, out);
+  }
+  static uint32_t unwrap(Storage& s) { return s; }
+};
+
+template <>
+struct ArgConverter<double> {
+  using Storage = double;
+  static bool convert(JSContext* cx, JS::HandleValue v, Storage* out) {
+    if (v.isNumber()) {
+      *out = v.toNumber();
+      return true;
+    }
+    return JS::ToNumber(cx, v, out);
+  }
+  static double unwrap(Storage& s) { return s; }
+};
+
+template <>
+struct ArgConverter<bool> {
+  using Storage = bool;
+  static bool convert(JSContext* cx, JS::HandleValue v, Storage* out) {
+    *out = JS::ToBoolean(v);
+    return true;
+  }
+  static bool unwrap(Storage& s) { return s; }
+};
+
+template <>
+struct ArgConverter<std::string> {
+  using Storage = std::string;
+  static bool convert(JSContext* cx, JS::HandleValue v, Storage* out) {
+    JS::RootedString str(cx, JS::ToString(cx, v));
+    if (!str) return false;
+    JS::UniqueChars chars = JS_EncodeStringToUTF8(cx, str);
+    if (!chars) return false;
+    out->assign(chars.get());
+    return true;
+  }
+  static std::string& unwrap(Storage& s) { return s; }
+};
+
+template <>
+struct ArgConverter<JS::HandleValue> {
+  // Points into the CallArgs, which are rooted.
+  using Storage = const JS::Value*;
+  static bool convert(JSContext* cx, JS::HandleValue v, Storage* out) {
+    *out = v.address();
+    return true;
+  }
+  static JS::HandleValue unwrap(Storage& s) {
+    return JS::HandleValue::fromMarkedLocation(s);
+  }
+};
+
+// Return value conversions.
+
+template <typename T>
+struct ResultConverter;  // Not defined: the return type is not supported
+
+template <>
+struct ResultConverter<int32_t> {
+  static bool set(JSContext*, int32_t r, JS::MutableHandleValue rval) {
+    rval.setInt32(r);
+    return true;
+  }
+};
+
+template <>
+struct ResultConverter<uint32_t> {
+  static bool set(JSContext*, uint32_t r, JS::MutableHandleValue rval) {
+    rval.setNumber(r);
+    return true;
+  }
+};
+
+template <>
+struct ResultConverter<double> {
+  static bool set(JSContext*, double r, JS::MutableHandleValue rval) {
+    rval.setDouble(r);
+    return true;
+  }
+};
+
+template <>
+struct ResultConverter<bool> {
+  static bool set(JSContext*, bool r, JS::MutableHandleValue rval) {
+    rval.setBoolean(r);
+    return true;
+  }
+};
+
+template <>
+struct ResultConverter<std::string> {
+  static bool set(JSContext* cx, const std::string& r,
+                  JS::MutableHandleValue rval) {
+    JSString* str =
+        JS_NewStringCopyUTF8N(cx, JS::UTF8Chars(r.data(), r.size()));
+    if (!str) return false;
+    rval.setString(str);
+    return true;
+  }
+};
+
+template <>
+struct ResultConverter<const char*> {
+  static bool set(JSContext* cx, const char* r, JS::MutableHandleValue rval) {
+    JSString* str = JS_NewStringCopyZ(cx, r);
+    if (!str) return false;
+    rval.setString(str);
+    return true;
+  }
+};
+
+// The functions returning GC things must not GC between creating the thing
+// and returning it, since nothing roots it in the meantime.
+
+template <>
+struct ResultConverter<JSString*> {
+  static bool set(JSContext*, JSString* r, JS::MutableHandleValue rval) {
+    if (!r) return false;
+    rval.setString(r);
+    return true;
+  }
+};
+
+template <>
+struct ResultConverter<JSObject*> {
+  static bool set(JSContext*, JSObject* r, JS::MutableHandleValue rval) {
+    if (!r) return false;
+    rval.setObject(*r);
+    return true;
+  }
+};
+
+template <>
+struct ResultConverter<JS::Value> {
+  static bool set(JSContext*, const JS::Value& r,
+                  JS::MutableHandleValue rval) {
+    rval.set(r);
+    return true;
+  }
+};
+
+// Where the C++ object for a member function comes from. The default is the
+// private pointer of `this`, if `this` is of class C::klass. Specialize this to
+// get the object some other way.
+template <typename C>
+struct NativeThis {
+  static C* get(JSContext* cx, JS::HandleObject obj) {
+    C* self =
+        static_cast<C*>(JS_GetInstancePrivate(cx, obj, &C::klass, nullptr));
+    if (!self) {
+      JS_ReportErrorASCII(cx, "method called on incompatible %s",
+                          JS_GetClass(obj)->name);
+    }
+    return self;
+  }
+};
+
+// Below here is the machinery that puts the above together. You shouldn't need
+// to use it directly.
+
+namespace detail {
+
+enum ParamKind { ArgParam, ContextParam, ThisParam };
+
+template <typename P>
+struct KindOf : std::integral_constant<ParamKind, ArgParam> {};
+template <>
+struct KindOf<JSContext*> : std::integral_constant<ParamKind, ContextParam> {};
+template <>
+struct KindOf<JS::HandleObject>
+    : std::integral_constant<ParamKind, ThisParam> {};
+
+template <typename P>
+using Kind = KindOf<typename std::decay<P>::type>;
+
+template <ParamKind K, typename... P>
+struct Count;
+template <ParamKind K>
+struct Count<K> : std::integral_constant<size_t, 0> {};
+template <ParamKind K, typename First, typename... Rest>
+struct Count<K, First, Rest...>
+    : std::integral_constant<size_t, (Kind<First>::value == K) +
+                                         Count<K, Rest...>::value> {};
+
+// The index of the JS argument for the I'th parameter of the C++ function is
+// the number of parameters before it that also take a JS argument.
+template <typename... P>
+constexpr size_t ArgIndex(size_t i) {
+  const bool takesArg[] = {(Kind<P>::value == ArgParam)..., false};
+  size_t index = 0;
+  for (size_t j = 0; j < i; j++) index += takesArg[j];
+  return index;
+}
+
+struct CallState {
+  JSContext* cx;
+  const JS::CallArgs& args;
+  JS::HandleObject thisObj;
+};
+
+struct NoStorage {};
+
+template <typename P, size_t I, ParamKind K = Kind<P>::value>
+struct Param {
+  using Converter = ArgConverter<typename std::decay<P>::type>;
+  using Storage = typename Converter::Storage;
+  static bool convert(const CallState& state, Storage* out) {
+    return Converter::convert(state.cx, state.args.get(I), out);
+  }
+  static decltype(auto) unwrap(const CallState&, Storage& s) {
+    return Converter::unwrap(s);
+  }
+};
+
+template <typename P, size_t I>
+struct Param<P, I, ContextParam> {
+  using Storage = NoStorage;
+  static bool convert(const CallState&, Storage*) { return true; }
+  static JSContext* unwrap(const CallState& state, Storage&) {
+    return state.cx;
+  }
+};
+
+template <typename P, size_t I>
+struct Param<P, I, ThisParam> {
+  using Storage = NoStorage;
+  static bool convert(const CallState&, Storage*) { return true; }
+  static JS::HandleObject unwrap(const CallState& state, Storage&) {
+    return state.thisObj;
+  }
+};
+
+template <typename R, bool CheckException>
+struct Returner {
+  template <typename F>
+  static bool call(const CallState& state, F&& f) {
+    auto&& result = f();
+    if (CheckException && JS_IsExceptionPending(state.cx)) return false;
+    return ResultConverter<typename std::decay<R>::type>::set(
+        state.cx, result, state.args.rval());
+  }
+};
+
+template <bool CheckException>
+struct Returner<void, CheckException> {
+  template <typename F>
+  static bool call(const CallState& state, F&& f) {
+    f();
+    if (CheckException && JS_IsExceptionPending(state.cx)) return false;
+    state.args.rval().setUndefined();
+    return true;
+  }
+};
+
+template <typename R, typename... P>
+struct Signature {
+  static constexpr bool CheckException = Count<ContextParam, P...>::value > 0;
+  static constexpr bool NeedsThis = Count<ThisParam, P...>::value > 0;
+  static constexpr unsigned NumArgs = Count<ArgParam, P...>::value;
+
+  // Converts all the arguments, stopping at the first one that fails, and then
+  // calls fn with them.
+  template <typename F, size_t... Is>
+  static bool invoke(const CallState& state, F&& fn,
+                     std::index_sequence<Is...>) {
+    std::tuple<typename Param<P, ArgIndex<P...>(Is)>::Storage...>
+        storage;
+    bool ok = true;
+    (void)std::initializer_list<int>{
+        (ok = ok && Param<P, ArgIndex<P...>(Is)>::convert(
+                        state, &std::get<Is>(storage)),
+         0)...};
+    if (!ok) return false;
+
+    return Returner<R, CheckException>::call(state, [&]() -> R {
+      return fn(Param<P, ArgIndex<P...>(Is)>::unwrap(
+          state, std::get<Is>(storage))...);
+    });
+  }
+
+  template <typename F>
+  static bool invoke(const CallState& state, F&& fn) {
+    return invoke(state, std::forward<F>(fn),
+                  std::index_sequence_for<P...>());
+  }
+};
+
+// Calls body(thisObj), computing `this` only if Needed.
+template <bool Needed>
+struct WithThis {
+  template <typename F>
+  static bool call(JSContext* cx, const JS::CallArgs& args, F&& body) {
+    JS::RootedObject thisObj(cx);
+    if (!args.computeThis(cx, &thisObj)) return false;
+    return body(thisObj);
+  }
+};
+
+template <>
+struct WithThis<false> {
+  template <typename F>
+  static bool call(JSContext* cx, const JS::CallArgs& args, F&& body) {
+    return body(nullptr);
+  }
+};
+
+}  // namespace detail
+
+template <typename F, F f>
+struct Native;
+
+template <typename R, typename... P, R (*f)(P...)>
+struct Native<R (*)(P...), f> {
+  using Sig = detail::Signature<R, P...>;
+  static constexpr unsigned nargs = Sig::NumArgs;
+
+  static bool call(JSContext* cx, unsigned argc, JS::Value* vp) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    return detail::WithThis<Sig::NeedsThis>::call(
+        cx, args, [&](JS::HandleObject thisObj) {
+          return Sig::invoke(detail::CallState{cx, args, thisObj},
+                             [](P... params) -> R {
+                               return f(std::forward<P>(params)...);
+                             });
+        });
+  }
+};
+
+template <typename C, typename R, typename... P>
+struct MemberNative {
+  using Sig = detail::Signature<R, P...>;
+  static constexpr unsigned nargs = Sig::NumArgs;
+
+  template <typename Call>
+  static bool call(JSContext* cx, unsigned argc, JS::Value* vp, Call&& call) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    JS::RootedObject thisObj(cx);
+    if (!args.computeThis(cx, &thisObj)) return false;
+
+    C* self = NativeThis<C>::get(cx, thisObj);
+    if (!self) return false;
+
+    return Sig::invoke(detail::CallState{cx, args, thisObj},
+                       [self, &call](P... params) -> R {
+                         return call(self, std::forward<P>(params)...);
+                       });
+  }
+};
+
+template <typename C, typename R, typename... P, R (C::*f)(P...)>
+struct Native<R (C::*)(P...), f> : MemberNative<C, R, P...> {
+  static bool call(JSContext* cx, unsigned argc, JS::Value* vp) {
+    return MemberNative<C, R, P...>::call(
+        cx, argc, vp, [](C* self, P... params) -> R {
+          return (self->*f)(std::forward<P>(params)...);
+        });
+  }
+};
+
+template <typename C, typename R, typename... P, R (C::*f)(P...) const>
+struct Native<R (C::*)(P...) const, f> : MemberNative<C, R, P...> {
+  static bool call(JSContext* cx, unsigned argc, JS::Value* vp) {
+    return MemberNative<C, R, P...>::call(
+        cx, argc, vp, [](C* self, P... params) -> R {
+          return (self->*f)(std::forward<P>(params)...);
+        });
+  }
+};
+
+}  // namespace bindings
+}  // namespace boilerplate
+
+#define BOILERPLATE_NATIVE(fn) \
+  (&::boilerplate::bindings::Native<decltype(&fn), &fn>::call)
+
+#define BOILERPLATE_FN(name, fn, flags)                               \
+  JS_FN(name, BOILERPLATE_NATIVE(fn),                                 \
+        (::boilerplate::bindings::Native<decltype(&fn), &fn>::nargs), \
+        flags)
@@ -1,8 +1,21 @@
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
 #include <jsapi.h>
 
 #include <js/Initialization.h>
 
 #include "boilerplate.h"
+#include "opcodecounts.h"
+#ifdef BOILERPLATE_HAVE_PROFILER
+#  include "profiler.h"
+#endif
 
 // This file contains boilerplate code used by a number of examples. Ideally
 // this should eventually become part of SpiderMonkey itself.
@@ -19,26 +32,316 @@ JSObject* boilerplate::CreateGlobal(JSContext* cx) {
                             JS::FireOnNewGlobalHook, options);
 }
 
+// RuntimeConfig collects the settings for the GC and the heap that an embedder
+// may want to tune for a particular workload. Each field that is set is passed
+// on to the corresponding JS_SetGCParameter() key; fields that are left unset
+// keep SpiderMonkey's defaults. See js/GCAPI.h for what each key means.
+//
+// Every setting can also be overridden from the environment or the command
+// line. For example, 'sliceBudgetMs' is read from the BOILERPLATE_GC_SLICE_MS
+// environment variable and from a '--gc-slice-ms=N' argument.
+//
+// It also holds the settings for profiling an example, which are read from
+// BOILERPLATE_PROFILE=FILE and BOILERPLATE_PROFILE_JIT=1, or from
+// '--profile=FILE' and '--profile-jit' arguments, and for counting its
+// opcodes, from BOILERPLATE_OPCODE_COUNTS=FILE or '--opcode-counts=FILE'.
+struct ConfigKey {
+  const char* name;
+  mozilla::Maybe<uint32_t> boilerplate::RuntimeConfig::*field;
+  JSGCParamKey key;
+  // JS_SetGCParameter() asserts that the engine accepts the value, so values
+  // outside of these bounds are rejected when they are read instead.
+  uint32_t min;
+  uint32_t max;
+};
+
+// The engine's nursery is made of 1 MB chunks, and can't be smaller than one.
+static constexpr uint32_t MinNurseryBytes = 1024 * 1024;
+// Heap growth factors are percentages, and the heap has to grow.
+static constexpr uint32_t MinHeapGrowth = 100;
+static constexpr uint32_t MaxHeapGrowth = 10000;
+
+static const ConfigKey configKeys[] = {
+    {"max-heap-bytes", &boilerplate::RuntimeConfig::maxHeapBytes,
+     JSGC_MAX_BYTES, 0, UINT32_MAX},
+    {"nursery-bytes", &boilerplate::RuntimeConfig::maxNurseryBytes,
+     JSGC_MAX_NURSERY_BYTES, MinNurseryBytes, UINT32_MAX},
+    {"incremental", &boilerplate::RuntimeConfig::incremental, JSGC_MODE, 0, 1},
+    {"slice-ms", &boilerplate::RuntimeConfig::sliceBudgetMs,
+     JSGC_SLICE_TIME_BUDGET, 0, UINT32_MAX},
+    {"high-frequency-time-limit-ms",
+     &boilerplate::RuntimeConfig::highFrequencyTimeLimitMs,
+     JSGC_HIGH_FREQUENCY_TIME_LIMIT, 0, UINT32_MAX},
+    {"high-frequency-low-limit-mb",
+     &boilerplate::RuntimeConfig::highFrequencyLowLimitMB,
+     JSGC_HIGH_FREQUENCY_LOW_LIMIT, 0, UINT32_MAX},
+    {"high-frequency-high-limit-mb",
+     &boilerplate::RuntimeConfig::highFrequencyHighLimitMB,
+     JSGC_HIGH_FREQUENCY_HIGH_LIMIT, 1, UINT32_MAX},
+    {"high-frequency-heap-growth-max",
+     &boilerplate::RuntimeConfig::highFrequencyHeapGrowthMax,
+     JSGC_HIGH_FREQUENCY_HEAP_GROWTH_MAX, MinHeapGrowth, MaxHeapGrowth},
+    {"high-frequency-heap-growth-min",
+     &boilerplate::RuntimeConfig::highFrequencyHeapGrowthMin,
+     JSGC_HIGH_FREQUENCY_HEAP_GROWTH_MIN, MinHeapGrowth, MaxHeapGrowth},
+    {"low-frequency-heap-growth",
+     &boilerplate::RuntimeConfig::lowFrequencyHeapGrowth,
+     JSGC_LOW_FREQUENCY_HEAP_GROWTH, MinHeapGrowth, MaxHeapGrowth},
+    {"allocation-threshold-mb",
+     &boilerplate::RuntimeConfig::allocationThresholdMB,
+     JSGC_ALLOCATION_THRESHOLD, 1, UINT32_MAX},
+};
+
+static bool ParseConfigValue(const char* name, const char* text,
+                             const ConfigKey& option, uint32_t* value) {
+  char* end;
+  unsigned long parsed = strtoul(text, &end, 10);
+  if (*text == '\0' || *text == '-' || *end != '\0' || parsed > UINT32_MAX) {
+    std::cerr << "invalid value for " << name << ": " << text << '\n';
+    return false;
+  }
+  if (parsed < option.min || parsed > option.max) {
+    std::cerr << "value for " << name << " must be between " << option.min
+              << " and " << option.max << ": " << text << '\n';
+    return false;
+  }
+  *value = uint32_t(parsed);
+  return true;
+}
+
+// Some settings are only valid together with others: the engine rejects a
+// high-frequency low limit that isn't below the high limit, and a minimum
+// growth factor above the maximum. Settings that aren't given keep the
+// engine's defaults, which are used for the comparison.
+bool boilerplate::RuntimeConfig::validate(void) const {
+  if (highFrequencyLowLimitMB.valueOr(100) >=
+      highFrequencyHighLimitMB.valueOr(500)) {
+    std::cerr << "high-frequency-low-limit-mb must be below "
+                 "high-frequency-high-limit-mb\n";
+    return false;
+  }
+  if (highFrequencyHeapGrowthMin.valueOr(150) >
+      highFrequencyHeapGrowthMax.valueOr(300)) {
+    std::cerr << "high-frequency-heap-growth-min must not be above "
+                 "high-frequency-heap-growth-max\n";
+    return false;
+  }
+  for (const ConfigKey& option : configKeys) {
+    const mozilla::Maybe<uint32_t>& value = this->*option.field;
+    if (value.isSome() && (*value < option.min || *value > option.max)) {
+      std::cerr << "value for " << option.name << " must be between "
+                << option.min << " and " << option.max << ": " << *value
+                << '\n';
+      return false;
+    }
+  }
+  return true;
+}
+
+// Override settings from BOILERPLATE_GC_* environment variables.
+bool boilerplate::RuntimeConfig::readEnvironment(void) {
+  for (const ConfigKey& option : configKeys) {
+    std::string var = "BOILERPLATE_GC_";
+    for (const char* c = option.name; *c; c++)
+      var += *c == '-' ? '_' : char(toupper(*c));
+
+    const char* text = getenv(var.c_str());
+    if (!text) continue;
+
+    uint32_t value;
+    if (!ParseConfigValue(var.c_str(), text, option, &value)) return false;
+    (this->*option.field) = mozilla::Some(value);
+  }
+
+  if (const char* output = getenv("BOILERPLATE_PROFILE"))
+    profileOutput = output;
+  if (const char* jit = getenv("BOILERPLATE_PROFILE_JIT"))
+    profileJit = strcmp(jit, "0") != 0;
+  if (const char* output = getenv("BOILERPLATE_OPCODE_COUNTS"))
+    opcodeCountsOutput = output;
+  return true;
+}
+
+// Override settings from --gc-*=N arguments. Other arguments are ignored, so
+// that examples can have their own arguments as well.
+bool boilerplate::RuntimeConfig::parseArgs(int argc, const char* argv[]) {
+  for (int ix = 1; ix < argc; ix++) {
+    const char* arg = argv[ix];
+    if (strncmp(arg, "--profile=", 10) == 0) {
+      profileOutput = arg + 10;
+      continue;
+    }
+    if (strcmp(arg, "--profile-jit") == 0) {
+      profileJit = true;
+      continue;
+    }
+    if (strncmp(arg, "--opcode-counts=", 16) == 0) {
+      opcodeCountsOutput = arg + 16;
+      continue;
+    }
+    if (strncmp(arg, "--gc-", 5) != 0) continue;
+
+    const char* equals = strchr(arg, '=');
+    if (!equals) {
+      std::cerr << "missing value for " << arg << '\n';
+      return false;
+    }
+    std::string name(arg + 5, equals - (arg + 5));
+
+    const ConfigKey* option = nullptr;
+    for (const ConfigKey& candidate : configKeys) {
+      if (name == candidate.name) option = &candidate;
+    }
+    if (!option) {
+      std::cerr << "unknown GC option " << arg << '\n';
+      return false;
+    }
+
+    uint32_t value;
+    if (!ParseConfigValue(arg, equals + 1, *option, &value)) return false;
+    (this->*option->field) = mozilla::Some(value);
+  }
+  return validate();
+}
+
+void boilerplate::RuntimeConfig::apply(JSContext* cx) const {
+  for (const ConfigKey& option : configKeys) {
+    const mozilla::Maybe<uint32_t>& value = this->*option.field;
+    if (value.isNothing()) continue;
+
+    if (option.key == JSGC_MODE) {
+      JS_SetGCParameter(cx, JSGC_MODE,
+                        *value ? JSGC_MODE_INCREMENTAL : JSGC_MODE_GLOBAL);
+      continue;
+    }
+    JS_SetGCParameter(cx, option.key, *value);
+  }
+}
+
+// Create a JSContext with the given heap and GC settings. By default the
+// self-hosting environment is initialized, as it is needed to run any
+// JavaScript. Returns null on failure.
+JSContext* boilerplate::CreateContext(const RuntimeConfig& config,
+                                      bool initSelfHosting) {
+  if (!config.validate()) return nullptr;
+
+  JSContext* cx =
+      JS_NewContext(config.maxHeapBytes.valueOr(JS::DefaultHeapMaxBytes));
+  if (!cx) {
+    return nullptr;
+  }
+
+  config.apply(cx);
+
+  if (initSelfHosting && !JS::InitSelfHostedCode(cx)) {
+    JS_DestroyContext(cx);
+    return nullptr;
+  }
+
+  return cx;
+}
+
+#ifdef BOILERPLATE_HAVE_PROFILER
+// Run the example under a Profiler, and write its samples as folded stacks to
+// the configured file, and the number of samples per line to the same file
+// with '.lines' appended. See 'profiler.cpp'.
+static bool RunProfiled(JSContext* cx, bool (*task)(JSContext*),
+                        const boilerplate::RuntimeConfig& config) {
+  boilerplate::Profiler profiler(std::chrono::microseconds(1000),
+                                 config.profileJit);
+  if (!profiler.start(cx)) {
+    std::cerr << "could not start the profiler\n";
+    return false;
+  }
+  bool ok = task(cx);
+  profiler.stop();
+
+  std::string linesOutput = config.profileOutput + ".lines";
+  std::ofstream folded(config.profileOutput);
+  std::ofstream lines(linesOutput);
+  profiler.writeFolded(folded);
+  profiler.writeLines(lines);
+  if (!folded || !lines) {
+    std::cerr << "could not write the profile to " << config.profileOutput
+              << '\n';
+    return false;
+  }
+
+  std::cerr << "profile: " << profiler.samples() << " samples ("
+            << profiler.idleSamples() << " not in JS), written to "
+            << config.profileOutput << " and " << linesOutput << '\n';
+  return ok;
+}
+#else
+// The profiler needs SIGPROF and pthread_kill(), which this C library
+// doesn't have.
+static bool RunProfiled(JSContext*, bool (*)(JSContext*),
+                        const boilerplate::RuntimeConfig&) {
+  std::cerr << "profiling is unsupported on this platform\n";
+  return false;
+}
+#endif  // BOILERPLATE_HAVE_PROFILER
+
+// Run the example, under a Profiler if one is configured, while counting the
+// opcodes that it executes, and write the counts to the configured file. See
+// 'opcodecounts.cpp'.
+static bool RunCountingOpcodes(JSContext* cx, bool (*task)(JSContext*),
+                               const boilerplate::RuntimeConfig& config) {
+  boilerplate::OpcodeCounter counter;
+  counter.start(cx);
+  bool ok = config.profileOutput.empty() ? task(cx)
+                                         : RunProfiled(cx, task, config);
+  {
+    // If the example failed with an exception, keep it pending through this.
+    JS::AutoSaveExceptionState savedException(cx);
+    if (!counter.stop(cx)) {
+      std::cerr << "could not collect the opcode counts\n";
+      return false;
+    }
+  }
+
+  std::ofstream out(config.opcodeCountsOutput);
+  out << "count\tpercent\topcode\n";
+  counter.write(out);
+  if (!out) {
+    std::cerr << "could not write the opcode counts to "
+              << config.opcodeCountsOutput << '\n';
+    return false;
+  }
+
+  std::cerr << "opcode counts: " << counter.total() << " executed in "
+            << counter.scripts() << " scripts, written to "
+            << config.opcodeCountsOutput << '\n';
+  return ok;
+}
+
 // Initialize the JS environment, create a JSContext and run the example
 // function in that context. By default the self-hosting environment is
 // initialized as it is needed to run any JavaScript). If the 'initSelfHosting'
 // argument is false, we will not initialize self-hosting and instead leave
 // that to the caller.
 bool boilerplate::RunExample(bool (*task)(JSContext*), bool initSelfHosting) {
+  return RunExample(task, RuntimeConfig(), initSelfHosting);
+}
+
+// The same, but with heap and GC settings from 'config'.
+bool boilerplate::RunExample(bool (*task)(JSContext*),
+                             const RuntimeConfig& config,
+                             bool initSelfHosting) {
   if (!JS_Init()) {
     return false;
   }
 
-  JSContext* cx = JS_NewContext(JS::DefaultHeapMaxBytes);
+  JSContext* cx = CreateContext(config, initSelfHosting);
   if (!cx) {
     return false;
   }
 
-  if (initSelfHosting && !JS::InitSelfHostedCode(cx)) {
-    return false;
-  }
-
-  if (!task(cx)) {
+  if (!config.opcodeCountsOutput.empty()) {
+    if (!RunCountingOpcodes(cx, task, config)) return false;
+  } else if (!config.profileOutput.empty()) {
+    if (!RunProfiled(cx, task, config)) return false;
+  } else if (!task(cx)) {
     return false;
   }
 
@@ -47,3 +350,134 @@ bool boilerplate::RunExample(bool (*task)(JSContext*), bool initSelfHosting) {
 
   return true;
 }
+
+// A ContextPool keeps a number of JSContexts alive so that tasks don't have to
+// pay for creating a context and initializing self-hosting every time. A
+// JSContext may only be used on the thread that created it, so each context in
+// the pool lives on its own worker thread, and tasks are handed to whichever
+// worker becomes free first. JS_Init() must have been called before init(),
+// and the pool must be destroyed before calling JS_ShutDown().
+boilerplate::ContextPool::ContextPool(size_t size, bool initSelfHosting,
+                                      const RuntimeConfig& config)
+    : m_size(size),
+      m_config(config),
+      m_initSelfHosting(initSelfHosting),
+      m_stopping(false),
+      m_started(0),
+      m_failed(0) {}
+
+boilerplate::ContextPool::~ContextPool(void) {
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_stopping = true;
+  }
+  m_wakeup.notify_all();
+
+  for (std::thread& thread : m_threads) thread.join();
+}
+
+// Optionally, give each worker a chance to set up per-thread state, such as
+// a global object, once its context is ready; and to tear it down again before
+// the context is destroyed. Must be called before init().
+void boilerplate::ContextPool::setWorkerHooks(Task setup, Cleanup cleanup) {
+  m_setup = std::move(setup);
+  m_cleanup = std::move(cleanup);
+}
+
+// Start the worker threads and wait until each one has a warm context. Returns
+// false if any of the contexts could not be created.
+bool boilerplate::ContextPool::init(void) {
+  for (size_t ix = 0; ix < m_size; ix++)
+    m_threads.emplace_back(&ContextPool::workerMain, this);
+
+  std::unique_lock<std::mutex> guard(m_lock);
+  m_ready.wait(guard, [this] { return m_started + m_failed == m_size; });
+  return m_failed == 0;
+}
+
+// The number of workers whose context is ready to run tasks. Less than size()
+// if init() failed, and zero before init().
+size_t boilerplate::ContextPool::liveWorkers(void) {
+  std::lock_guard<std::mutex> guard(m_lock);
+  return m_started;
+}
+
+// Queue a task to run on the next free context. The future resolves to the
+// task's return value, or to false right away, without running the task, if
+// there are no live workers to run it.
+std::future<bool> boilerplate::ContextPool::post(Task task) {
+  Job job;
+  job.task = std::move(task);
+  std::future<bool> result = job.result.get_future();
+
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (m_started == 0) {
+      job.result.set_value(false);
+      return result;
+    }
+    m_jobs.push_back(std::move(job));
+  }
+  m_wakeup.notify_one();
+
+  return result;
+}
+
+void boilerplate::ContextPool::workerMain(void) {
+  JSContext* cx = CreateContext(m_config, m_initSelfHosting);
+  if (cx && m_setup && !m_setup(cx)) {
+    JS_DestroyContext(cx);
+    cx = nullptr;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (cx)
+      m_started++;
+    else
+      m_failed++;
+  }
+  m_ready.notify_one();
+  if (!cx) return;
+
+  while (true) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> guard(m_lock);
+      m_wakeup.wait(guard, [this] { return m_stopping || !m_jobs.empty(); });
+      if (m_jobs.empty()) break;  // only stop once the queue is drained
+      job = std::move(m_jobs.front());
+      m_jobs.pop_front();
+    }
+
+    bool ok = job.task(cx);
+
+    // Don't let one task's leftovers leak into the next one that gets this
+    // context.
+    if (JS_IsExceptionPending(cx)) JS_ClearPendingException(cx);
+    JS_MaybeGC(cx);
+
+    job.result.set_value(ok);
+  }
+
+  if (m_cleanup) m_cleanup(cx);
+  JS_DestroyContext(cx);
+}
+
+// Like RunExample(), but instead of a single context, the task gets a pool of
+// 'poolSize' warm contexts that it can hand work to.
+bool boilerplate::RunExampleWithPool(bool (*task)(ContextPool&),
+                                     size_t poolSize, bool initSelfHosting) {
+  if (!JS_Init()) {
+    return false;
+  }
+
+  bool ok;
+  {
+    ContextPool pool(poolSize, initSelfHosting);
+    ok = pool.init() && task(pool);
+  }
+
+  JS_ShutDown();
+  return ok;
+}
@@ -1,13 +1,111 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include <jsapi.h>
 
+#include <mozilla/Maybe.h>
+
 // See 'boilerplate.cpp' for documentation.
 
 namespace boilerplate {
 
 extern const JSClassOps DefaultGlobalClassOps;
 
+struct RuntimeConfig {
+  mozilla::Maybe<uint32_t> maxHeapBytes;
+  mozilla::Maybe<uint32_t> maxNurseryBytes;
+  mozilla::Maybe<uint32_t> incremental;  // 0 or 1
+  mozilla::Maybe<uint32_t> sliceBudgetMs;
+  mozilla::Maybe<uint32_t> highFrequencyTimeLimitMs;
+  mozilla::Maybe<uint32_t> highFrequencyLowLimitMB;
+  mozilla::Maybe<uint32_t> highFrequencyHighLimitMB;
+  mozilla::Maybe<uint32_t> highFrequencyHeapGrowthMax;  // percent
+  mozilla::Maybe<uint32_t> highFrequencyHeapGrowthMin;  // percent
+  mozilla::Maybe<uint32_t> lowFrequencyHeapGrowth;      // percent
+  mozilla::Maybe<uint32_t> allocationThresholdMB;
+
+  // If set, RunExample() runs the example under a boilerplate::Profiler and
+  // writes the folded stacks to this file.
+  std::string profileOutput;
+  bool profileJit = false;
+
+  // If set, RunExample() counts the bytecode opcodes that the example
+  // executes with a boilerplate::OpcodeCounter, and writes them to this file.
+  std::string opcodeCountsOutput;
+
+  bool readEnvironment(void);
+  bool parseArgs(int argc, const char* argv[]);
+  // Checks the settings that depend on each other; the others are checked as
+  // they are read. Writes a message and returns false if they are invalid.
+  bool validate(void) const;
+  void apply(JSContext* cx) const;
+};
+
 JSObject* CreateGlobal(JSContext* cx);
 
+JSContext* CreateContext(const RuntimeConfig& config,
+                         bool initSelfHosting = true);
+
 bool RunExample(bool (*task)(JSContext*), bool initSelfHosting = true);
+bool RunExample(bool (*task)(JSContext*), const RuntimeConfig& config,
+                bool initSelfHosting = true);
+
+class ContextPool {
+ public:
+  using Task = std::function<bool(JSContext*)>;
+  using Cleanup = std::function<void(JSContext*)>;
+
+  explicit ContextPool(size_t size, bool initSelfHosting = true,
+                       const RuntimeConfig& config = RuntimeConfig());
+  ~ContextPool(void);
+
+  ContextPool(const ContextPool&) = delete;
+  ContextPool& operator=(const ContextPool&) = delete;
+
+  void setWorkerHooks(Task setup, Cleanup cleanup);
+  bool init(void);
+  std::future<bool> post(Task task);
+  bool run(Task task) { return post(std::move(task)).get(); }
+
+  size_t size(void) const { return m_size; }
+  size_t liveWorkers(void);
+
+ private:
+  struct Job {
+    Task task;
+    std::promise<bool> result;
+  };
+
+  void workerMain(void);
+
+  size_t m_size;
+  RuntimeConfig m_config;
+  bool m_initSelfHosting;
+  bool m_stopping;
+  size_t m_started;
+  size_t m_failed;
+
+  Task m_setup;
+  Cleanup m_cleanup;
+
+  std::mutex m_lock;
+  std::condition_variable m_wakeup;
+  std::condition_variable m_ready;
+  std::deque<Job> m_jobs;
+  std::vector<std::thread> m_threads;
+};
+
+bool RunExampleWithPool(bool (*task)(ContextPool&), size_t poolSize,
+                        bool initSelfHosting = true);
 
 }  // namespace boilerplate
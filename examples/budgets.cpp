@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <vector>
+
+#include <js/Initialization.h>
+
+#include "executor.h"
+
+// This example shows how to keep runaway scripts from monopolizing the worker
+// threads of a boilerplate::ScriptExecutor, by giving each script a CPU time
+// limit that a boilerplate::Watchdog enforces. See 'watchdog.cpp' for how that
+// works.
+//
+// It submits a batch of short, well-behaved jobs, once on their own as a
+// baseline, and once with a few infinite loops mixed in. Every job gets the
+// same CPU time limit. It prints how long the well-behaved jobs took to come
+// back in each case, and the CPU time that the scripts used.
+//
+// The CPU time limit in milliseconds can be given as the first argument.
+
+static const char* goodJob = R"js(
+  function fib(n) { return n < 2 ? n : fib(n - 1) + fib(n - 2); }
+  fib(20);
+)js";
+
+static const char* badJob = "while (true) {}";
+
+static constexpr unsigned numJobs = 400;
+static constexpr unsigned badJobEvery = 50;  // one in 50 jobs is a runaway
+static constexpr size_t numThreads = 4;
+static unsigned cpuLimitMs = 50;
+
+using Clock = std::chrono::steady_clock;
+using Milliseconds = std::chrono::duration<double, std::milli>;
+
+static double Percentile(std::vector<double>& values, double fraction) {
+  if (values.empty()) return 0.0;
+  std::sort(values.begin(), values.end());
+  size_t index = std::min(values.size() - 1, size_t(fraction * values.size()));
+  return values[index];
+}
+
+static bool RunBatch(bool withRunaways) {
+  boilerplate::ScriptExecutor executor(numThreads);
+  if (!executor.init()) return false;
+
+  boilerplate::ScriptLimits limits;
+  limits.cpuTime = std::chrono::milliseconds(cpuLimitMs);
+
+  struct Submitted {
+    bool bad;
+    Clock::time_point submitted;
+    std::future<boilerplate::ScriptResult> result;
+  };
+  std::vector<Submitted> jobs;
+  jobs.reserve(numJobs);
+
+  for (unsigned ix = 0; ix < numJobs; ix++) {
+    bool bad = withRunaways && ix % badJobEvery == badJobEvery / 2;
+    jobs.push_back(
+        {bad, Clock::now(),
+         executor.submit(bad ? badJob : goodJob, bad ? "runaway" : "good",
+                         limits)});
+  }
+
+  std::vector<double> latencies;
+  Milliseconds worstRunaway(0);
+  bool ok = true;
+  for (Submitted& job : jobs) {
+    boilerplate::ScriptResult result = job.result.get();
+    if (job.bad) {
+      if (!result.terminated) {
+        std::cerr << "runaway job was not terminated\n";
+        ok = false;
+      }
+      worstRunaway = std::max<Milliseconds>(worstRunaway, result.cpuTime);
+      continue;
+    }
+    if (!result.ok) {
+      std::cerr << "job failed: " << result.value << '\n';
+      ok = false;
+    }
+    // Results are collected in order, so this includes time spent waiting
+    // behind earlier jobs, which is what a client would see.
+    latencies.push_back(Milliseconds(Clock::now() - job.submitted).count());
+  }
+
+  boilerplate::Watchdog::Counters counters = executor.counters();
+  std::cout << (withRunaways ? "with runaways" : "without runaways")
+            << "\tp50 " << Percentile(latencies, 0.5) << " ms\tp99 "
+            << Percentile(latencies, 0.99) << " ms\tterminated "
+            << counters.terminated << " of " << counters.scripts
+            << "\ttotal CPU "
+            << Milliseconds(counters.cpuTime).count() << " ms";
+  if (withRunaways)
+    std::cout << "\tworst runaway CPU " << worstRunaway.count() << " ms";
+  std::cout << '\n';
+  return ok;
+}
+
+int main(int argc, const char* argv[]) {
+  if (argc > 1) cpuLimitMs = strtoul(argv[1], nullptr, 10);
+
+  if (!JS_Init()) return 1;
+
+  std::cout << numJobs << " jobs on " << numThreads << " threads, "
+            << cpuLimitMs << " ms CPU limit\n";
+  bool ok = RunBatch(false) && RunBatch(true);
+
+  JS_ShutDown();
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,214 @@
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <jsapi.h>
+
+#include <js/CompilationAndEvaluation.h>
+#include <js/Conversions.h>
+#include <js/SourceText.h>
+
+#include "bench.h"
+#include "boilerplate.h"
+#include "bulkarrays.h"
+
+// This example shows how to pass many numbers between C++ and JS at once with
+// the helpers in 'bulkarrays.h', and compares them with the element by
+// element loop that the cookbook's approach would lead to.
+//
+// It first checks that the numbers survive a round trip through each kind of
+// array, and then benchmarks each direction with a million elements. Pass
+// --json or the other arguments described in 'bench.cpp' to control the
+// benchmarks.
+//
+// The zero-copy NewFloat64Array() benchmark has to copy the C++ vector on
+// every iteration, because the vector is handed over to the typed array, so
+// what it measures is mostly that copy; the typed array itself costs the same
+// no matter how many elements it has.
+
+static const size_t Length = 1000000;
+
+static boilerplate::BenchOptions options;
+
+static JSObject* NewArrayByElement(JSContext* cx,
+                                   const std::vector<double>& data) {
+  JS::RootedObject array(cx, JS_NewArrayObject(cx, 0));
+  if (!array) return nullptr;
+  for (size_t ix = 0; ix < data.size(); ix++) {
+    if (!JS_SetElement(cx, array, uint32_t(ix), data[ix])) return nullptr;
+  }
+  return array;
+}
+
+static bool ToVectorByElement(JSContext* cx, JS::HandleObject array,
+                              std::vector<double>* out) {
+  uint32_t length;
+  if (!JS_GetArrayLength(cx, array, &length)) return false;
+  out->resize(length);
+  JS::RootedValue v(cx);
+  for (uint32_t ix = 0; ix < length; ix++) {
+    if (!JS_GetElement(cx, array, ix, &v) ||
+        !JS::ToNumber(cx, v, &(*out)[ix]))
+      return false;
+  }
+  return true;
+}
+
+template <typename T>
+static bool CheckSame(const std::vector<T>& expected,
+                      const std::vector<T>& actual, const char* what) {
+  if (expected == actual) return true;
+  std::cerr << what << ": numbers changed in the round trip\n";
+  return false;
+}
+
+static bool CheckRoundTrips(JSContext* cx, const std::vector<double>& doubles,
+                            const std::vector<int32_t>& ints) {
+  JS::RootedObject array(cx, boilerplate::NewArray(cx, doubles));
+  std::vector<double> doublesOut;
+  if (!array || !boilerplate::ToVector(cx, array, &doublesOut) ||
+      !CheckSame(doubles, doublesOut, "Array of doubles"))
+    return false;
+
+  array = boilerplate::NewArray(cx, ints);
+  std::vector<int32_t> intsOut;
+  if (!array || !boilerplate::ToVector(cx, array, &intsOut) ||
+      !CheckSame(ints, intsOut, "Array of int32s"))
+    return false;
+
+  array = boilerplate::NewFloat64Array(cx, std::vector<double>(doubles));
+  if (!array || !boilerplate::ToVector(cx, array, &doublesOut) ||
+      !CheckSame(doubles, doublesOut, "Float64Array"))
+    return false;
+
+  array = boilerplate::NewInt32Array(cx, std::vector<int32_t>(ints));
+  if (!array || !boilerplate::ToVector(cx, array, &intsOut) ||
+      !CheckSame(ints, intsOut, "Int32Array"))
+    return false;
+
+  // Holes and values that aren't numbers are converted the same way as the
+  // typed array constructors convert them.
+  static const char* sparse = "[1, , '3', {}]";
+  JS::CompileOptions opts(cx);
+  JS::SourceText<mozilla::Utf8Unit> source;
+  JS::RootedValue rval(cx);
+  if (!source.init(cx, sparse, strlen(sparse),
+                   JS::SourceOwnership::Borrowed) ||
+      !JS::Evaluate(cx, opts, source, &rval))
+    return false;
+  array = &rval.toObject();
+  if (!boilerplate::ToVector(cx, array, &doublesOut)) return false;
+  if (doublesOut.size() != 4 || doublesOut[0] != 1 ||
+      !std::isnan(doublesOut[1]) || doublesOut[2] != 3 ||
+      !std::isnan(doublesOut[3])) {
+    std::cerr << "sparse Array converted wrongly\n";
+    return false;
+  }
+  return true;
+}
+
+static bool RunToJSBenchmarks(JSContext* cx, boilerplate::BenchRunner& runner,
+                              const std::vector<double>& doubles,
+                              const std::vector<int32_t>& ints) {
+  JS::RootedObject array(cx);
+  return runner.run("to JS/JS_SetElement loop",
+                    [&](size_t iterations) {
+                      for (size_t ix = 0; ix < iterations; ix++) {
+                        array = NewArrayByElement(cx, doubles);
+                        if (!array) return false;
+                      }
+                      return true;
+                    }) &&
+         runner.run("to JS/NewArray, doubles",
+                    [&](size_t iterations) {
+                      for (size_t ix = 0; ix < iterations; ix++) {
+                        array = boilerplate::NewArray(cx, doubles);
+                        if (!array) return false;
+                      }
+                      return true;
+                    }) &&
+         runner.run("to JS/NewArray, int32s",
+                    [&](size_t iterations) {
+                      for (size_t ix = 0; ix < iterations; ix++) {
+                        array = boilerplate::NewArray(cx, ints);
+                        if (!array) return false;
+                      }
+                      return true;
+                    }) &&
+         runner.run("to JS/NewFloat64Array, with copy of vector",
+                    [&](size_t iterations) {
+                      for (size_t ix = 0; ix < iterations; ix++) {
+                        array = boilerplate::NewFloat64Array(
+                            cx, std::vector<double>(doubles));
+                        if (!array) return false;
+                      }
+                      return true;
+                    });
+}
+
+static bool RunFromJSBenchmarks(JSContext* cx,
+                                boilerplate::BenchRunner& runner,
+                                const std::vector<double>& doubles) {
+  JS::RootedObject array(cx, boilerplate::NewArray(cx, doubles));
+  JS::RootedObject typedArray(
+      cx, boilerplate::NewFloat64Array(cx, std::vector<double>(doubles)));
+  if (!array || !typedArray) return false;
+
+  std::vector<double> out;
+  return runner.run("from JS/JS_GetElement loop",
+                    [&](size_t iterations) {
+                      for (size_t ix = 0; ix < iterations; ix++) {
+                        if (!ToVectorByElement(cx, array, &out)) return false;
+                      }
+                      return true;
+                    }) &&
+         runner.run("from JS/ToVector, Array",
+                    [&](size_t iterations) {
+                      for (size_t ix = 0; ix < iterations; ix++) {
+                        if (!boilerplate::ToVector(cx, array, &out))
+                          return false;
+                      }
+                      return true;
+                    }) &&
+         runner.run("from JS/ToVector, Float64Array",
+                    [&](size_t iterations) {
+                      for (size_t ix = 0; ix < iterations; ix++) {
+                        if (!boilerplate::ToVector(cx, typedArray, &out))
+                          return false;
+                      }
+                      return true;
+                    });
+}
+
+static bool BulkExample(JSContext* cx) {
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) return false;
+  JSAutoRealm ar(cx, global);
+
+  std::vector<double> doubles(Length);
+  std::vector<int32_t> ints(Length);
+  for (size_t ix = 0; ix < Length; ix++) {
+    doubles[ix] = ix * 0.5;
+    ints[ix] = int32_t(ix) - int32_t(Length / 2);
+  }
+
+  if (!CheckRoundTrips(cx, doubles, ints)) return false;
+
+  boilerplate::BenchRunner runner(options);
+  if (!RunToJSBenchmarks(cx, runner, doubles, ints) ||
+      !RunFromJSBenchmarks(cx, runner, doubles)) {
+    std::cerr << "benchmark failed\n";
+    return false;
+  }
+  runner.report(std::cout);
+  return true;
+}
+
+int main(int argc, const char* argv[]) {
+  if (!options.parseArgs(argc, argv)) return 1;
+
+  if (!boilerplate::RunExample(BulkExample)) return 1;
+  return 0;
+}
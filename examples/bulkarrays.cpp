@@ -0,0 +1,138 @@
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <jsapi.h>
+#include <jsfriendapi.h>
+
+#include "bulkarrays.h"
+
+// Helpers for moving many numbers between JS and C++ at once.
+//
+// Filling an Array element by element with JS_SetElement() goes through the
+// generic property machinery for each element, and may reallocate the
+// array's storage many times as it grows. JS_NewArrayObject() with a list of
+// values instead allocates a dense array of the right size and copies all
+// the values into it at once. Reading an Array element by element with
+// JS_GetElement() is just as slow, so ToVector() lets the engine convert the
+// whole array into a typed array, which it does with a fast path for dense
+// arrays, and then copies the typed array's data with one memcpy.
+//
+// When a script only needs the numbers and not a real Array, a typed array
+// is better still: NewFloat64Array() and NewInt32Array() hand the memory of
+// the vector over to an ArrayBuffer, so nothing is copied at all. The engine
+// calls FreeVector() when the ArrayBuffer is finalized.
+
+template <typename T>
+static void FreeVector(void* contents, void* userData) {
+  delete static_cast<std::vector<T>*>(userData);
+}
+
+template <typename T>
+static JSObject* NewArrayImpl(JSContext* cx, const T* data, size_t length) {
+  JS::AutoValueVector values(cx);
+  if (!values.reserve(length)) {
+    JS_ReportOutOfMemory(cx);
+    return nullptr;
+  }
+  for (size_t ix = 0; ix < length; ix++)
+    values.infallibleAppend(JS::NumberValue(data[ix]));
+  return JS_NewArrayObject(cx, values);
+}
+
+JSObject* boilerplate::NewArray(JSContext* cx, const double* data,
+                                size_t length) {
+  return NewArrayImpl(cx, data, length);
+}
+
+JSObject* boilerplate::NewArray(JSContext* cx, const int32_t* data,
+                                size_t length) {
+  return NewArrayImpl(cx, data, length);
+}
+
+template <typename T>
+static JSObject* NewTypedArrayImpl(
+    JSContext* cx, std::vector<T>&& data,
+    JSObject* (*newEmpty)(JSContext*, uint32_t),
+    JSObject* (*newWithBuffer)(JSContext*, JS::HandleObject, uint32_t,
+                               int32_t)) {
+  // An external ArrayBuffer needs non-null contents.
+  if (data.empty()) return newEmpty(cx, 0);
+
+  // ArrayBuffers are limited to INT32_MAX bytes in this version.
+  if (data.size() > size_t(std::numeric_limits<int32_t>::max()) / sizeof(T)) {
+    JS_ReportErrorASCII(cx, "too many elements for a typed array");
+    return nullptr;
+  }
+
+  auto* owned = new std::vector<T>(std::move(data));
+  JS::RootedObject buffer(
+      cx, JS_NewExternalArrayBuffer(cx, owned->size() * sizeof(T),
+                                    owned->data(), FreeVector<T>, owned));
+  if (!buffer) {
+    delete owned;  // not freed by the engine on failure
+    return nullptr;
+  }
+  return newWithBuffer(cx, buffer, 0, -1);
+}
+
+JSObject* boilerplate::NewFloat64Array(JSContext* cx,
+                                       std::vector<double>&& data) {
+  return NewTypedArrayImpl(cx, std::move(data), JS_NewFloat64Array,
+                           JS_NewFloat64ArrayWithBuffer);
+}
+
+JSObject* boilerplate::NewInt32Array(JSContext* cx,
+                                     std::vector<int32_t>&& data) {
+  return NewTypedArrayImpl(cx, std::move(data), JS_NewInt32Array,
+                           JS_NewInt32ArrayWithBuffer);
+}
+
+// Returns false if obj is not a typed array of the right type, even through
+// a cross-compartment wrapper. A detached typed array has no elements.
+template <typename T>
+static bool CopyTypedArray(
+    JSObject* obj, JSObject* (*unwrap)(JSObject*),
+    T* (*getData)(JSObject*, bool*, const JS::AutoRequireNoGC&),
+    std::vector<T>* out) {
+  JSObject* unwrapped = unwrap(obj);
+  if (!unwrapped) return false;
+
+  JS::AutoCheckCannotGC nogc;
+  bool isShared;
+  const T* data = getData(unwrapped, &isShared, nogc);
+  // If the memory is shared, another thread may be writing to it while it is
+  // copied. That is a data race in the script, not here, so it is copied
+  // anyway.
+  out->assign(data, data + JS_GetTypedArrayLength(unwrapped));
+  return true;
+}
+
+template <typename T>
+static bool ToVectorImpl(
+    JSContext* cx, JS::HandleObject obj, JSObject* (*unwrap)(JSObject*),
+    T* (*getData)(JSObject*, bool*, const JS::AutoRequireNoGC&),
+    JSObject* (*fromArray)(JSContext*, JS::HandleObject),
+    std::vector<T>* out) {
+  if (CopyTypedArray(obj, unwrap, getData, out)) return true;
+
+  // Anything else is converted the same way as the typed array constructor,
+  // which may run script for getters, proxies, and valueOf() methods.
+  JS::RootedObject converted(cx, fromArray(cx, obj));
+  if (!converted) return false;
+  CopyTypedArray(converted, unwrap, getData, out);
+  return true;
+}
+
+bool boilerplate::ToVector(JSContext* cx, JS::HandleObject obj,
+                           std::vector<double>* out) {
+  return ToVectorImpl(cx, obj, js::UnwrapFloat64Array, JS_GetFloat64ArrayData,
+                      JS_NewFloat64ArrayFromArray, out);
+}
+
+bool boilerplate::ToVector(JSContext* cx, JS::HandleObject obj,
+                           std::vector<int32_t>* out) {
+  return ToVectorImpl(cx, obj, js::UnwrapInt32Array, JS_GetInt32ArrayData,
+                      JS_NewInt32ArrayFromArray, out);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <jsapi.h>
+
+// See 'bulkarrays.cpp' for documentation.
+
+namespace boilerplate {
+
+// Dense JS Arrays, copied from C++ in one go.
+JSObject* NewArray(JSContext* cx, const double* data, size_t length);
+JSObject* NewArray(JSContext* cx, const int32_t* data, size_t length);
+
+inline JSObject* NewArray(JSContext* cx, const std::vector<double>& data) {
+  return NewArray(cx, data.data(), data.size());
+}
+inline JSObject* NewArray(JSContext* cx, const std::vector<int32_t>& data) {
+  return NewArray(cx, data.data(), data.size());
+}
+
+// Typed arrays that take over the vector's memory, without copying it. The
+// vector is left empty, and its memory is freed when the typed array's
+// ArrayBuffer is garbage collected.
+JSObject* NewFloat64Array(JSContext* cx, std::vector<double>&& data);
+JSObject* NewInt32Array(JSContext* cx, std::vector<int32_t>&& data);
+
+// Copies the elements of an Array, a typed array, or any other array-like or
+// iterable object into 'out', converting them as a Float64Array or an
+// Int32Array would.
+bool ToVector(JSContext* cx, JS::HandleObject obj, std::vector<double>* out);
+bool ToVector(JSContext* cx, JS::HandleObject obj, std::vector<int32_t>* out);
+
+}  // namespace boilerplate
@@ -0,0 +1,96 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include <jsapi.h>
+#include <js/CompilationAndEvaluation.h>
+#include <js/SourceText.h>
+
+#include "boilerplate.h"
+#include "scriptcache.h"
+
+// This example shows how to use boilerplate::ScriptCache to run the same
+// scripts many times without compiling them again every time. It compares
+// evaluating a handful of scripts with JS::Evaluate() against evaluating them
+// through the cache, and prints the cache's counters at the end.
+
+static const char* scripts[] = {
+    R"js(
+      const words = 'the quick brown fox jumps over the lazy dog'.split(' ');
+      words.map(w => w[0].toUpperCase() + w.slice(1)).join(' ');
+    )js",
+    R"js(
+      let total = 0;
+      for (const n of [1, 2, 3, 4, 5, 6, 7, 8, 9, 10]) total += n * n;
+      total;
+    )js",
+    R"js(
+      JSON.stringify({ name: 'cache', hits: 1, nested: { a: [1, 2, 3] } });
+    )js",
+};
+
+static constexpr unsigned numRounds = 10000;
+
+using Clock = std::chrono::steady_clock;
+
+static bool EvaluateUncached(JSContext* cx, const char* code) {
+  JS::CompileOptions options(cx);
+  options.setFileAndLine("noname", 1);
+
+  JS::SourceText<mozilla::Utf8Unit> source;
+  if (!source.init(cx, code, strlen(code), JS::SourceOwnership::Borrowed)) {
+    return false;
+  }
+
+  JS::RootedValue rval(cx);
+  return JS::Evaluate(cx, options, source, &rval);
+}
+
+static bool EvaluateCached(JSContext* cx, boilerplate::ScriptCache& cache,
+                           const char* code) {
+  JS::CompileOptions options(cx);
+  options.setFileAndLine("noname", 1);
+
+  JS::RootedValue rval(cx);
+  return cache.evaluate(cx, options, code, strlen(code), &rval);
+}
+
+static bool CachedExample(JSContext* cx) {
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) return false;
+
+  JSAutoRealm ar(cx, global);
+
+  boilerplate::ScriptCache cache(cx, global);
+
+  Clock::time_point start = Clock::now();
+  for (unsigned round = 0; round < numRounds; round++) {
+    for (const char* code : scripts) {
+      if (!EvaluateUncached(cx, code)) return false;
+    }
+  }
+  std::chrono::duration<double, std::micro> uncached = Clock::now() - start;
+
+  start = Clock::now();
+  for (unsigned round = 0; round < numRounds; round++) {
+    for (const char* code : scripts) {
+      if (!EvaluateCached(cx, cache, code)) return false;
+    }
+  }
+  std::chrono::duration<double, std::micro> cached = Clock::now() - start;
+
+  unsigned runs = numRounds * (sizeof(scripts) / sizeof(scripts[0]));
+  const boilerplate::ScriptCache::Stats& stats = cache.stats();
+  std::cout << "JS::Evaluate (us/run): " << uncached.count() / runs << '\n'
+            << "ScriptCache (us/run):  " << cached.count() / runs << '\n'
+            << "hits: " << stats.hits << ", misses: " << stats.misses
+            << ", evictions: " << stats.evictions
+            << ", entries: " << stats.entries << ", bytes: " << stats.bytes
+            << '\n';
+  return true;
+}
+
+int main(int argc, const char* argv[]) {
+  if (!boilerplate::RunExample(CachedExample)) return 1;
+  return 0;
+}
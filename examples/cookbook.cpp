@@ -1,5 +1,6 @@
 #include <cassert>
 #include <iostream>
+#include <string>
 
 #include <jsapi.h>
 
@@ -11,6 +12,8 @@
 #include <js/SourceText.h>
 
 #include "boilerplate.h"
+#include "errorreporter.h"
+#include "stringhash.h"
 
 // This example program shows the SpiderMonkey JSAPI equivalent for a handful
 // of common JavaScript idioms.
@@ -283,6 +286,9 @@ static bool CallLocalFunctionVariable(JSContext* cx, JS::HandleValue f) {
  *
  * Warning: This only works for integers that fit in 32 bits.
  * Otherwise, use setNumber or setDouble (see the next example).
+ *
+ * For natives like this one, which only wrap a C++ function, you can also
+ * have the templates in 'bindings.h' generate the JSNative for you.
  */
 static bool ReturnInteger(JSContext* cx, unsigned argc, JS::Value* vp) {
   JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
@@ -667,8 +673,15 @@ static bool DefineReadOnlyProperty(JSContext* cx, JS::HandleObject obj) {
  */
 static bool GetMD5Func(JSContext* cx, unsigned argc, JS::Value* vp) {
   JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
-  // Implement your MD5 hashing here...
-  JSString* hashstr = JS_NewStringCopyZ(cx, "d41d8cd98f00b204e9800998ecf8427e");
+  // 'this' is the string itself, or a String object if the getter was called
+  // on one. See 'stringhash.cpp' for how the string is hashed in place.
+  JS::RootedString str(cx, JS::ToString(cx, args.thisv()));
+  if (!str) return false;
+  std::string digest;
+  if (!boilerplate::HashString(cx, str, boilerplate::HashAlgorithm::Md5,
+                               &digest))
+    return false;
+  JSString* hashstr = JS_NewStringCopyN(cx, digest.data(), digest.size());
   if (!hashstr) return false;
   args.rval().setString(hashstr);
   return true;
@@ -737,6 +750,9 @@ static JSClass myClass = {"MyClass", JSCLASS_HAS_RESERVED_SLOTS(2), nullptr};
 
 enum MyClassSlots { SlotA, SlotB };
 
+// A getter like this one is a plain JSNative, so the JIT can't inline it or
+// hoist it out of a loop. See 'jitinfo.cpp' for how to give natives JSJitInfo
+// so that it can.
 static bool MyClassPropGetter(JSContext* cx, unsigned argc, JS::Value* vp) {
   JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
   args.rval().setInt32(42);
@@ -839,8 +855,6 @@ static bool DefineMyClass(JSContext* cx, JS::HandleObject global) {
 
 /* Simulating `for` and `for...of`.
  * Actually outputting errors.
- * Create global variable __dirname to retrieve the current JavaScript file
- * name, like in NodeJS
  * Custom error reporter
  */
 
@@ -887,21 +901,8 @@ class AutoReportException {
   explicit AutoReportException(JSContext* cx) : m_cx(cx) {}
 
   ~AutoReportException(void) {
-    if (!JS_IsExceptionPending(m_cx)) return;
-
-    JS::RootedValue v_exn(m_cx);
-    mozilla::Unused << JS_GetPendingException(m_cx, &v_exn);
-    JS_ClearPendingException(m_cx);
-
-    JS::RootedString message(m_cx, JS::ToString(m_cx, v_exn));
-    if (!message) {
-      std::cerr << "(could not convert thrown exception to string)\n";
-    } else {
-      JS::UniqueChars message_utf8(JS_EncodeStringToUTF8(m_cx, message));
-      std::cerr << message_utf8.get() << '\n';
-    }
-
-    JS_ClearPendingException(m_cx);
+    // Does nothing if no exception is pending.
+    boilerplate::DefaultErrorReporter().reportPendingException(m_cx);
   }
 };
 
@@ -989,6 +990,10 @@ static bool RunCookbook(JSContext* cx) {
 }
 
 int main(int argc, const char* argv[]) {
-  if (!boilerplate::RunExample(RunCookbook)) return 1;
+  // Pass --profile=FILE to see where the time goes; see 'profiler.cpp'.
+  boilerplate::RuntimeConfig config;
+  if (!config.readEnvironment() || !config.parseArgs(argc, argv)) return 1;
+
+  if (!boilerplate::RunExample(RunCookbook, config)) return 1;
   return 0;
 }
@@ -0,0 +1,217 @@
+#include <climits>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#  define HAVE_PCLMUL_CRC32 1
+#  include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__linux__) && \
+    (defined(__GNUC__) || defined(__clang__))
+#  define HAVE_ARM_CRC32 1
+// The two compilers spell the target attribute for the CRC extension
+// differently; GCC wants "+crc" and clang "crc".
+#  ifdef __clang__
+#    define ARM_CRC32_TARGET __attribute__((target("crc")))
+#  else
+#    define ARM_CRC32_TARGET __attribute__((target("+crc")))
+#  endif
+#  include <arm_acle.h>
+#  include <asm/hwcap.h>
+#  include <sys/auxv.h>
+#endif
+
+#include "crc32.h"
+
+namespace zlib {
+#include <zlib.h>
+}
+
+// This file computes the same CRC-32 checksum as zlib's crc32(), using
+// hardware instructions if the CPU has them, for the Crc class in resolve.cpp.
+// It accepts buffers of any size, unlike zlib's crc32() which takes the length
+// as an unsigned int.
+//
+// - On x86-64 CPUs with carry-less multiplication (PCLMULQDQ) we fold the
+//   buffer 64 bytes at a time, following Intel's paper "Fast CRC Computation
+//   for Generic Polynomials Using PCLMULQDQ Instruction" (the same algorithm
+//   that the Linux kernel and Chromium's zlib use).
+// - On ARMv8 CPUs with the optional CRC32 instructions we use those; they
+//   implement exactly the polynomial that zlib uses.
+// - Otherwise, and for the leftover bytes at the end of the buffer, we call
+//   zlib's crc32() in chunks that fit in an unsigned int.
+
+static uint32_t Crc32Zlib(uint32_t crc, const uint8_t* data, size_t length) {
+  while (length > 0) {
+    unsigned chunk = length > UINT_MAX ? UINT_MAX : unsigned(length);
+    crc = uint32_t(zlib::crc32(crc, data, chunk));
+    data += chunk;
+    length -= chunk;
+  }
+  return crc;
+}
+
+#ifdef HAVE_PCLMUL_CRC32
+
+// Buffers shorter than this don't gain anything from the folding loop.
+static constexpr size_t PclmulMinimumLength = 64;
+
+// The constants from the paper, for the bit-reflected CRC-32 polynomial.
+alignas(16) static const uint64_t k1k2[] = {0x0154442bd4, 0x01c6e41596};
+alignas(16) static const uint64_t k3k4[] = {0x01751997d0, 0x00ccaa009e};
+alignas(16) static const uint64_t k5k0[] = {0x0163cd6124, 0x0000000000};
+alignas(16) static const uint64_t poly[] = {0x01db710641, 0x01f7011641};
+
+// 'length' must be at least 64 and a multiple of 16. 'crc' is the internal,
+// non-inverted CRC value.
+__attribute__((target("pclmul,sse4.1"))) static uint32_t Crc32Pclmul(
+    uint32_t crc, const uint8_t* data, size_t length) {
+  __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+  x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x00));
+  x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x10));
+  x3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x20));
+  x4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x30));
+  x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(int(crc)));
+  x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(k1k2));
+  data += 64;
+  length -= 64;
+
+  // Fold 64 bytes at a time into four 128-bit accumulators.
+  while (length >= 64) {
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+    x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+    x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+    x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+    y5 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x00));
+    y6 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x10));
+    y7 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x20));
+    y8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x30));
+
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+    x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+    x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+    x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+
+    data += 64;
+    length -= 64;
+  }
+
+  // Fold the four accumulators into one.
+  x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(k3k4));
+  x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+  x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+  x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+  // Fold the remaining 16-byte blocks.
+  while (length >= 16) {
+    x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    data += 16;
+    length -= 16;
+  }
+
+  // Fold 128 bits down to 64.
+  x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+  x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+  x1 = _mm_srli_si128(x1, 8);
+  x1 = _mm_xor_si128(x1, x2);
+
+  x0 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(k5k0));
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_and_si128(x1, x3);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  // Barrett reduction to 32 bits.
+  x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(poly));
+  x2 = _mm_and_si128(x1, x3);
+  x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+  x2 = _mm_and_si128(x2, x3);
+  x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  return uint32_t(_mm_extract_epi32(x1, 1));
+}
+
+static bool HasHardwareCrc32(void) {
+  static const bool supported =
+      __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+  return supported;
+}
+
+static uint32_t Crc32Hardware(uint32_t crc, const uint8_t* data,
+                              size_t length) {
+  if (length >= PclmulMinimumLength) {
+    size_t blocks = length & ~size_t(15);
+    crc = ~Crc32Pclmul(~crc, data, blocks);
+    data += blocks;
+    length -= blocks;
+  }
+  return Crc32Zlib(crc, data, length);
+}
+
+#elif defined(HAVE_ARM_CRC32)
+
+static bool HasHardwareCrc32(void) {
+  static const bool supported = getauxval(AT_HWCAP) & HWCAP_CRC32;
+  return supported;
+}
+
+ARM_CRC32_TARGET static uint32_t Crc32Hardware(
+    uint32_t crc, const uint8_t* data, size_t length) {
+  crc = ~crc;
+  while (length > 0 && (uintptr_t(data) & 7) != 0) {
+    crc = __crc32b(crc, *data++);
+    length--;
+  }
+  for (; length >= 8; data += 8, length -= 8) {
+    uint64_t word;
+    __builtin_memcpy(&word, data, sizeof(word));
+    crc = __crc32d(crc, word);
+  }
+  for (; length > 0; length--) crc = __crc32b(crc, *data++);
+  return ~crc;
+}
+
+#else
+
+static bool HasHardwareCrc32(void) { return false; }
+
+static uint32_t Crc32Hardware(uint32_t crc, const uint8_t* data,
+                              size_t length) {
+  return Crc32Zlib(crc, data, length);
+}
+
+#endif
+
+// Update a running CRC-32, like zlib's crc32(crc, data, length).
+uint32_t Crc32Update(uint32_t crc, const uint8_t* data, size_t length) {
+  if (HasHardwareCrc32()) return Crc32Hardware(crc, data, length);
+  return Crc32Zlib(crc, data, length);
+}
+
+// A description of the code path Crc32Update() takes on this CPU.
+const char* Crc32Implementation(void) {
+  if (!HasHardwareCrc32()) return "zlib";
+#ifdef HAVE_PCLMUL_CRC32
+  return "PCLMULQDQ";
+#else
+  return "ARMv8 CRC32";
+#endif
+}
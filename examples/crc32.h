@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// See 'crc32.cpp' for documentation.
+
+uint32_t Crc32Update(uint32_t crc, const uint8_t* data, size_t length);
+
+const char* Crc32Implementation(void);
@@ -0,0 +1,151 @@
+#include <cassert>
+
+#include <jsapi.h>
+#include <jsfriendapi.h>
+
+#include "domclass.h"
+
+// Natives with JSJitInfo, the way browsers define DOM bindings.
+//
+// A plain JSNative is opaque to the JIT: every call goes through the generic
+// native call path, and the JIT has to assume that the native may do anything.
+// A native that has a JSJitInfo attached tells IonMonkey what kind of
+// operation it is (getter, setter, or method), what type it returns, whether
+// it can fail, and what it can have side effects on. For objects whose class
+// is a DOM class, Ion then calls the JSJitInfo's op directly with the C++
+// object, and, if the info allows it, eliminates or hoists calls out of loops
+// like any other pure operation.
+//
+// - isInfallible: the op never throws, so Ion needn't check for an exception.
+// - returnType: if not JSVAL_TYPE_UNKNOWN, Ion relies on the op always
+//   returning that type.
+// - aliasSet: AliasNone for ops that read no mutable state at all,
+//   AliasDOMSets for ops that read only state that DOM setters and methods
+//   can change, and AliasEverything for anything else.
+// - isMovable: Ion may hoist the op out of a loop, or merge two calls into one.
+//   Only for infallible ops with an alias set other than AliasEverything.
+// Getting any of these wrong means the JIT will produce wrong results, so be
+// conservative.
+//
+// For Ion to recognize a DOM object, its class must be flagged with
+// JSCLASS_IS_DOMJSCLASS, keep its C++ object as a private value in reserved
+// slot DOMObjectSlot, and the DOM callbacks installed by SetDOMCallbacks()
+// must say that the class matches the protoID in the JSJitInfo. The
+// prototype must not itself be of the DOM class, because Ion would then treat
+// it as an instance, so don't use JS_InitClass() for DOM classes. See the
+// 'jitinfo.cpp' example for how to set up the constructor and prototype
+// instead.
+
+static bool InstanceClassMatchesProto(const js::Class* instanceClass,
+                                      uint32_t protoID, uint32_t depth) {
+  // JSCLASS_IS_DOMJSCLASS guarantees that the class is a DOMClass. This
+  // example has no inheritance between DOM classes, so depth is always 0.
+  auto* clasp = reinterpret_cast<const boilerplate::DOMClass*>(
+      js::Jsvalify(instanceClass));
+  return depth == 0 && clasp->protoID == protoID;
+}
+
+static const js::DOMCallbacks domCallbacks = {&InstanceClassMatchesProto};
+
+void boilerplate::SetDOMCallbacks(JSContext* cx) {
+  js::SetDOMCallbacks(cx, &domCallbacks);
+}
+
+static JSJitInfo OpInfo(JSJitInfo::OpType type,
+                        const boilerplate::DOMClass* clasp,
+                        JSValueType returnType, bool isInfallible,
+                        bool isMovable, JSJitInfo::AliasSet aliasSet) {
+  assert(!isMovable ||
+         (isInfallible && aliasSet != JSJitInfo::AliasEverything));
+
+  JSJitInfo info = {};
+  info.protoID = clasp->protoID;
+  info.depth = 0;
+  info.type_ = type;
+  info.aliasSet_ = aliasSet;
+  info.returnType_ = returnType;
+  info.isInfallible = isInfallible;
+  info.isMovable = isMovable;
+  // Eliminatable means that Ion may drop a call whose result is unused. It's
+  // only safe for ops that have no side effects, such as movable ones.
+  info.isEliminatable = isMovable;
+  info.isAlwaysInSlot = false;
+  info.isLazilyCachedInSlot = false;
+  info.isTypedMethod = false;
+  info.slotIndex = 0;
+  return info;
+}
+
+JSJitInfo boilerplate::GetterInfo(JSJitGetterOp getter, const DOMClass* clasp,
+                                  JSValueType returnType, bool isInfallible,
+                                  bool isMovable,
+                                  JSJitInfo::AliasSet aliasSet) {
+  JSJitInfo info = OpInfo(JSJitInfo::Getter, clasp, returnType, isInfallible,
+                          isMovable, aliasSet);
+  info.getter = getter;
+  return info;
+}
+
+// Setters always have side effects, and return undefined.
+JSJitInfo boilerplate::SetterInfo(JSJitSetterOp setter, const DOMClass* clasp) {
+  JSJitInfo info = OpInfo(JSJitInfo::Setter, clasp, JSVAL_TYPE_UNDEFINED,
+                          false, false, JSJitInfo::AliasEverything);
+  info.setter = setter;
+  return info;
+}
+
+JSJitInfo boilerplate::MethodInfo(JSJitMethodOp method, const DOMClass* clasp,
+                                  JSValueType returnType, bool isInfallible,
+                                  bool isMovable,
+                                  JSJitInfo::AliasSet aliasSet) {
+  JSJitInfo info = OpInfo(JSJitInfo::Method, clasp, returnType, isInfallible,
+                          isMovable, aliasSet);
+  info.method = method;
+  return info;
+}
+
+// JSPropertySpec can't carry a JSJitInfo in the public API, so we create the
+// accessor functions from JSFunctionSpecs, which can (JS_FNINFO), and define
+// the property with those. Either getter or setter may be null.
+static bool NewAccessorFunction(JSContext* cx, JS::HandleId id,
+                                JSNative native, const JSJitInfo* info,
+                                JS::MutableHandleObject fun) {
+  if (!native) return true;
+  const JSFunctionSpec spec = JS_FNINFO(nullptr, native, info, 0, 0);
+  JSFunction* function = JS::NewFunctionFromSpec(cx, &spec, id);
+  if (!function) return false;
+  fun.set(JS_GetFunctionObject(function));
+  return true;
+}
+
+bool boilerplate::DefineDOMAccessor(JSContext* cx, JS::HandleObject proto,
+                                    const char* name, JSNative getter,
+                                    const JSJitInfo* getterInfo,
+                                    JSNative setter,
+                                    const JSJitInfo* setterInfo,
+                                    unsigned attrs) {
+  JS::RootedString atom(cx, JS_AtomizeAndPinString(cx, name));
+  if (!atom) return false;
+  JS::RootedId id(cx, INTERNED_STRING_TO_JSID(cx, atom));
+
+  JS::RootedObject getterObj(cx), setterObj(cx);
+  if (!NewAccessorFunction(cx, id, getter, getterInfo, &getterObj) ||
+      !NewAccessorFunction(cx, id, setter, setterInfo, &setterObj))
+    return false;
+
+  return JS_DefinePropertyById(cx, proto, id, getterObj, setterObj, attrs);
+}
+
+// Unlike Ion, the generic natives get called with any `this`, so they must
+// check it.
+bool boilerplate::CheckDOMThis(JSContext* cx, const JS::CallArgs& args,
+                               const DOMClass* clasp,
+                               JS::MutableHandleObject thisObj) {
+  if (!args.computeThis(cx, thisObj)) return false;
+  if (JS_GetClass(thisObj) != &clasp->base) {
+    JS_ReportErrorASCII(cx, "called on an object that is not a %s",
+                        clasp->base.name);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+
+#include <jsapi.h>
+#include <jsfriendapi.h>
+
+// See 'domclass.cpp' for documentation.
+
+namespace boilerplate {
+
+// A JSClass whose instances the JIT can treat like DOM objects. It must have
+// JSCLASS_IS_DOMJSCLASS in its flags and at least one reserved slot, and
+// protoID must be unique among the DOMClasses of the program.
+struct DOMClass {
+  JSClass base;
+  uint16_t protoID;
+};
+
+// The JIT loads the C++ object from this reserved slot, as a private value.
+constexpr uint32_t DOMObjectSlot = 0;
+
+void SetDOMCallbacks(JSContext* cx);
+
+inline void SetDOMObject(JSObject* obj, void* native) {
+  JS_SetReservedSlot(obj, DOMObjectSlot, JS::PrivateValue(native));
+}
+
+template <typename T>
+T* GetDOMObject(JSObject* obj) {
+  return static_cast<T*>(JS_GetReservedSlot(obj, DOMObjectSlot).toPrivate());
+}
+
+JSJitInfo GetterInfo(JSJitGetterOp getter, const DOMClass* clasp,
+                     JSValueType returnType, bool isInfallible, bool isMovable,
+                     JSJitInfo::AliasSet aliasSet);
+JSJitInfo SetterInfo(JSJitSetterOp setter, const DOMClass* clasp);
+JSJitInfo MethodInfo(JSJitMethodOp method, const DOMClass* clasp,
+                     JSValueType returnType, bool isInfallible, bool isMovable,
+                     JSJitInfo::AliasSet aliasSet);
+
+bool DefineDOMAccessor(JSContext* cx, JS::HandleObject proto, const char* name,
+                       JSNative getter, const JSJitInfo* getterInfo,
+                       JSNative setter, const JSJitInfo* setterInfo,
+                       unsigned attrs);
+
+bool CheckDOMThis(JSContext* cx, const JS::CallArgs& args,
+                  const DOMClass* clasp, JS::MutableHandleObject thisObj);
+
+// The JSNatives that the interpreter and the baseline JIT call. Ion calls the
+// JSJitInfo ops directly, skipping these.
+
+template <const DOMClass* Class, JSJitGetterOp Op>
+bool GenericGetter(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  JS::RootedObject thisObj(cx);
+  if (!CheckDOMThis(cx, args, Class, &thisObj)) return false;
+  return Op(cx, thisObj, GetDOMObject<void>(thisObj),
+            JSJitGetterCallArgs(args));
+}
+
+template <const DOMClass* Class, JSJitSetterOp Op>
+bool GenericSetter(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  if (!args.requireAtLeast(cx, "setter", 1)) return false;
+  JS::RootedObject thisObj(cx);
+  if (!CheckDOMThis(cx, args, Class, &thisObj)) return false;
+  if (!Op(cx, thisObj, GetDOMObject<void>(thisObj),
+          JSJitSetterCallArgs(args)))
+    return false;
+  args.rval().setUndefined();
+  return true;
+}
+
+template <const DOMClass* Class, JSJitMethodOp Op>
+bool GenericMethod(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  JS::RootedObject thisObj(cx);
+  if (!CheckDOMThis(cx, args, Class, &thisObj)) return false;
+  return Op(cx, thisObj, GetDOMObject<void>(thisObj),
+            JSJitMethodCallArgs(args));
+}
+
+}  // namespace boilerplate
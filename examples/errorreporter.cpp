@@ -0,0 +1,466 @@
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#include <jsapi.h>
+
+#include <js/Conversions.h>
+
+#include "errorreporter.h"
+#include "hash.h"
+#include "textbuffer.h"
+
+// One way of reporting JS errors for all of the examples, which stays cheap
+// when scripts throw many exceptions.
+//
+// Turning an exception into text takes several allocations, and writing it
+// to a terminal or a pipe takes a system call that may block. Under a high
+// rate of exceptions, usually the same few thrown over and over, that is
+// where the time goes. ErrorReporter therefore:
+//
+// - First computes a key for the error from its location and message (an
+//   xxHash64 of them; see 'hash.cpp'), which costs no allocation for Error
+//   objects. An error with the same key as one reported within the last
+//   dedupWindow is only counted; when it next occurs after the window,
+//   the count is written first as "(repeated N times: <first line>)". The
+//   counts still outstanding are written when the reporter is destroyed.
+// - Writes at most maxReportsPerSecond reports per second in total, and
+//   writes how many were left out once the second is over.
+// - Only formats the errors that pass both checks, into a thread-local
+//   TextBuffer that is reused from one report to the next.
+// - Hands the text to a LogWriter, whose thread does the writing. The
+//   LogWriter collects records into one buffer while the thread writes the
+//   other, so records written in a burst go out with one fwrite(). If the
+//   writer can't keep up and MaxPendingBytes are waiting, further records are
+//   dropped, and counted in the log, rather than blocking the JS thread.
+//
+// The format follows SpiderMonkey's own js::PrintError(), as the REPL used to
+// do: "file:line:column message", the source line with a caret under the
+// error, any notes, and then the stack of Error objects.
+//
+// An ErrorReporter can be shared by threads with a context each. Since
+// writing is asynchronous, call flush() before writing anything else that
+// must come after the errors, such as the REPL's prompt.
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr size_t MaxSeen = 4096;  // keys remembered for dedup
+
+///// LogWriter ///////////////////////////////////////////////////////////////
+
+constexpr size_t boilerplate::LogWriter::MaxPendingBytes;
+
+boilerplate::LogWriter::LogWriter(FILE* out)
+    : m_out(out),
+      m_queued(0),
+      m_completed(0),
+      m_pendingRecords(0),
+      m_dropped(0),
+      m_shuttingDown(false),
+      m_thread(&LogWriter::writerLoop, this) {}
+
+boilerplate::LogWriter::~LogWriter(void) {
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_shuttingDown = true;
+  }
+  m_pendingChanged.notify_one();
+  m_thread.join();
+}
+
+void boilerplate::LogWriter::write(const char* data, size_t length) {
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (m_pending.size() + length > MaxPendingBytes) {
+      m_dropped++;
+      return;
+    }
+    m_pending.append(data, length);
+    m_pendingRecords++;
+    m_queued++;
+  }
+  m_pendingChanged.notify_one();
+}
+
+void boilerplate::LogWriter::flush(void) {
+  std::unique_lock<std::mutex> guard(m_lock);
+  uint64_t target = m_queued;
+  m_written.wait(guard, [this, target] { return m_completed >= target; });
+}
+
+size_t boilerplate::LogWriter::dropped(void) const {
+  std::lock_guard<std::mutex> guard(m_lock);
+  return m_dropped;
+}
+
+void boilerplate::LogWriter::writerLoop(void) {
+  size_t droppedReported = 0;
+  std::unique_lock<std::mutex> guard(m_lock);
+  for (;;) {
+    m_pendingChanged.wait(
+        guard, [this] { return m_shuttingDown || !m_pending.empty(); });
+    // Only stop once everything has been written.
+    if (m_pending.empty()) return;
+
+    m_writing.swap(m_pending);
+    size_t records = m_pendingRecords;
+    m_pendingRecords = 0;
+    size_t dropped = m_dropped;
+    guard.unlock();
+
+    fwrite(m_writing.data(), 1, m_writing.size(), m_out);
+    if (dropped > droppedReported) {
+      fprintf(m_out, "(%zu log records dropped, the log is too slow)\n",
+              dropped - droppedReported);
+      droppedReported = dropped;
+    }
+    fflush(m_out);
+    m_writing.clear();
+
+    guard.lock();
+    m_completed += records;
+    m_written.notify_all();
+  }
+}
+
+///// Formatting //////////////////////////////////////////////////////////////
+
+enum class ErrorKind { Error, Warning, StrictWarning, Note };
+
+static void AppendNumber(boilerplate::TextBuffer* out, unsigned number) {
+  char digits[16];
+  int length = snprintf(digits, sizeof(digits), "%u", number);
+  out->append(digits, size_t(length));
+}
+
+template <typename T>
+static void AppendPrefix(T* report, ErrorKind kind,
+                         boilerplate::TextBuffer* prefix) {
+  if (report->filename) {
+    prefix->append(report->filename);
+    prefix->append(':');
+  }
+  if (report->lineno) {
+    AppendNumber(prefix, report->lineno);
+    prefix->append(':');
+    AppendNumber(prefix, report->column);
+    prefix->append(' ');
+  }
+  switch (kind) {
+    case ErrorKind::Error:
+      break;
+    case ErrorKind::Warning:
+      prefix->append("warning: ");
+      break;
+    case ErrorKind::StrictWarning:
+      prefix->append("strict warning: ");
+      break;
+    case ErrorKind::Note:
+      prefix->append("note: ");
+      break;
+  }
+}
+
+static void AppendErrorLine(const boilerplate::TextBuffer& prefix,
+                            JSErrorReport* report,
+                            boilerplate::TextBuffer* out) {
+  const char16_t* linebuf = report->linebuf();
+  if (!linebuf) return;
+
+  size_t n = report->linebufLength();
+  out->append(":\n");
+  out->append(prefix.data(), prefix.size());
+  out->appendTwoByte(linebuf, n);
+
+  // linebuf usually ends with a newline. If not, add one here.
+  if (n == 0 || linebuf[n - 1] != '\n') out->append('\n');
+
+  out->append(prefix.data(), prefix.size());
+  n = report->tokenOffset();
+  size_t ndots = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (linebuf[i] == '\t') {
+      ndots += 8 - (ndots & 7);
+      continue;
+    }
+    ndots++;
+  }
+  for (size_t i = 0; i < ndots; i++) out->append('.');
+  out->append('^');
+}
+
+// Notes have no source line.
+static void AppendErrorLine(const boilerplate::TextBuffer&, JSErrorNotes::Note*,
+                            boilerplate::TextBuffer*) {}
+
+// Appends one report or note, with the prefix at the start of every line.
+template <typename T>
+static void AppendSingleError(T* report, ErrorKind kind,
+                              boilerplate::TextBuffer* out) {
+  static thread_local boilerplate::TextBuffer prefix;
+  prefix.clear();
+  AppendPrefix(report, kind, &prefix);
+
+  const char* message = report->message().c_str();
+  if (!message) message = "(no message)";
+
+  // Embedded newlines get the prefix too.
+  const char* newline;
+  while ((newline = strchr(message, '\n')) != nullptr) {
+    newline++;
+    out->append(prefix.data(), prefix.size());
+    out->append(message, newline - message);
+    message = newline;
+  }
+  out->append(prefix.data(), prefix.size());
+  out->append(message);
+
+  AppendErrorLine(prefix, report, out);
+  out->append('\n');
+}
+
+static void AppendReport(JSErrorReport* report, boilerplate::TextBuffer* out) {
+  ErrorKind kind = ErrorKind::Error;
+  if (JSREPORT_IS_WARNING(report->flags)) {
+    kind = JSREPORT_IS_STRICT(report->flags) ? ErrorKind::StrictWarning
+                                             : ErrorKind::Warning;
+  }
+  AppendSingleError(report, kind, out);
+
+  if (report->notes) {
+    for (auto&& note : *report->notes)
+      AppendSingleError(note.get(), ErrorKind::Note, out);
+  }
+}
+
+// For exceptions that aren't Error objects, as the REPL prints its results.
+static void AppendValue(JSContext* cx, JS::HandleValue value,
+                        boilerplate::TextBuffer* out) {
+  JS::RootedString str(cx, JS::ToString(cx, value));
+  if (!str) {
+    JS_ClearPendingException(cx);
+    str = JS_ValueToSource(cx, value);
+  }
+  if (!str || !out->appendString(cx, str)) {
+    JS_ClearPendingException(cx);
+    out->append(value.isObject() ? "[unknown object]"
+                                 : "[unknown non-object]");
+  }
+}
+
+static void AppendStack(JSContext* cx, JS::HandleValue exception,
+                        boilerplate::TextBuffer* out) {
+  if (!exception.isObject()) return;
+  JS::RootedObject exceptionObject(cx, &exception.toObject());
+  JS::RootedObject stack(cx, JS::ExceptionStackOrNull(exceptionObject));
+  if (!stack) return;
+
+  JS::RootedString str(cx);
+  if (!JS::BuildStackString(cx, nullptr, stack, &str, 2) || !str ||
+      !out->appendString(cx, str)) {
+    JS_ClearPendingException(cx);
+    return;
+  }
+  // The stack string ends with a newline already.
+}
+
+static uint64_t ReportKey(JSErrorReport* report) {
+  boilerplate::XxHash64 hash;
+  if (report->filename) hash.update(report->filename, strlen(report->filename));
+  uint32_t position[] = {report->lineno, report->column, report->flags};
+  hash.update(position, sizeof(position));
+  const char* message = report->message().c_str();
+  if (message) hash.update(message, strlen(message));
+  return hash.finish();
+}
+
+static uint64_t TextKey(const boilerplate::TextBuffer& text) {
+  boilerplate::XxHash64 hash;
+  hash.update(text.data(), text.size());
+  return hash.finish();
+}
+
+// The first line of a formatted report.
+static void FirstLine(const boilerplate::TextBuffer& text,
+                      boilerplate::TextBuffer* line) {
+  line->clear();
+  if (text.empty()) return;
+  const char* end = static_cast<const char*>(
+      memchr(text.data(), '\n', text.size()));
+  line->append(text.data(), end ? size_t(end - text.data()) : text.size());
+}
+
+///// ErrorReporter ///////////////////////////////////////////////////////////
+
+boilerplate::ErrorReporter::ErrorReporter(FILE* out)
+    : ErrorReporter(Options(), out) {}
+
+boilerplate::ErrorReporter::ErrorReporter(const Options& options, FILE* out)
+    : m_options(options),
+      m_writer(out),
+      m_reportsInRateWindow(0),
+      m_limitedInRateWindow(0) {}
+
+boilerplate::ErrorReporter::~ErrorReporter(void) {
+  flush();
+  // m_writer's destructor stops its thread.
+}
+
+void boilerplate::ErrorReporter::writeRepeats(Seen* seen) {
+  if (!seen->repeats) return;
+  m_notice.clear();
+  m_notice.append("(repeated ");
+  AppendNumber(&m_notice, unsigned(seen->repeats));
+  m_notice.append(seen->repeats == 1 ? " time: " : " times: ");
+  m_notice.append(seen->summary.data(), seen->summary.size());
+  m_notice.append(")\n");
+  m_writer.write(m_notice);
+  seen->repeats = 0;
+}
+
+void boilerplate::ErrorReporter::writeLimited(void) {
+  if (!m_limitedInRateWindow) return;
+  m_notice.clear();
+  m_notice.append("(");
+  AppendNumber(&m_notice, unsigned(m_limitedInRateWindow));
+  m_notice.append(" more errors not reported, over the rate limit)\n");
+  m_writer.write(m_notice);
+  m_limitedInRateWindow = 0;
+}
+
+bool boilerplate::ErrorReporter::admit(uint64_t key,
+                                       const TextBuffer& summary) {
+  Clock::time_point now = Clock::now();
+
+  auto found = m_seen.find(key);
+  if (found != m_seen.end()) {
+    Seen& seen = found->second;
+    if (now - seen.windowStart < m_options.dedupWindow) {
+      seen.repeats++;
+      m_stats.duplicates++;
+      return false;
+    }
+    writeRepeats(&seen);
+  }
+
+  if (now - m_rateWindowStart >= std::chrono::seconds(1)) {
+    writeLimited();
+    m_rateWindowStart = now;
+    m_reportsInRateWindow = 0;
+  }
+  if (m_reportsInRateWindow >= m_options.maxReportsPerSecond) {
+    m_limitedInRateWindow++;
+    m_stats.limited++;
+    return false;
+  }
+  m_reportsInRateWindow++;
+  m_stats.reported++;
+
+  if (found == m_seen.end()) {
+    // Forget everything once there are too many different errors, rather
+    // than looking for the oldest.
+    if (m_seen.size() >= MaxSeen) {
+      for (auto& entry : m_seen) writeRepeats(&entry.second);
+      m_seen.clear();
+    }
+    found = m_seen.emplace(key, Seen()).first;
+    found->second.summary.assign(summary.data(), summary.size());
+  }
+  found->second.windowStart = now;
+  found->second.repeats = 0;
+  return true;
+}
+
+void boilerplate::ErrorReporter::reportException(JSContext* cx,
+                                                 JS::HandleValue exception,
+                                                 const char* label) {
+  static thread_local TextBuffer record;
+  static thread_local TextBuffer summary;
+  record.clear();
+
+  JSErrorReport* errorReport = nullptr;
+  if (exception.isObject()) {
+    JS::RootedObject exceptionObject(cx, &exception.toObject());
+    errorReport = JS_ErrorFromException(cx, exceptionObject);
+  }
+
+  // An Error object's key and first line don't need its text formatted;
+  // any other value is converted to text, which is the key.
+  uint64_t key;
+  if (errorReport) {
+    key = ReportKey(errorReport);
+    if (label) {
+      XxHash64 hash(key);
+      hash.update(label, strlen(label));
+      key = hash.finish();
+    }
+    summary.clear();
+    if (label) summary.append(label);
+    AppendPrefix(errorReport, ErrorKind::Error, &summary);
+    const char* message = errorReport->message().c_str();
+    summary.append(message ? message : "(no message)");
+  } else {
+    record.append(label ? label : "error: ");
+    AppendValue(cx, exception, &record);
+    record.append('\n');
+    key = TextKey(record);
+    FirstLine(record, &summary);
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (!admit(key, summary)) return;
+  }
+
+  if (errorReport) {
+    if (label) record.append(label);
+    AppendReport(errorReport, &record);
+    if (m_options.stacks) AppendStack(cx, exception, &record);
+  }
+  m_writer.write(record);
+}
+
+bool boilerplate::ErrorReporter::reportPendingException(JSContext* cx) {
+  JS::RootedValue exception(cx);
+  if (!JS_GetPendingException(cx, &exception)) return false;
+  JS_ClearPendingException(cx);
+  reportException(cx, exception);
+  return true;
+}
+
+void boilerplate::ErrorReporter::report(JSContext*, JSErrorReport* report) {
+  static thread_local TextBuffer record;
+  static thread_local TextBuffer summary;
+  record.clear();
+  AppendReport(report, &record);
+  FirstLine(record, &summary);
+
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (!admit(ReportKey(report), summary)) return;
+  }
+  m_writer.write(record);
+}
+
+void boilerplate::ErrorReporter::flush(void) {
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    for (auto& entry : m_seen) writeRepeats(&entry.second);
+    writeLimited();
+  }
+  m_writer.flush();
+}
+
+boilerplate::ErrorReporter::Stats boilerplate::ErrorReporter::stats(
+    void) const {
+  std::lock_guard<std::mutex> guard(m_lock);
+  return m_stats;
+}
+
+boilerplate::ErrorReporter& boilerplate::DefaultErrorReporter(void) {
+  static ErrorReporter reporter;
+  return reporter;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include <jsapi.h>
+
+#include "textbuffer.h"
+
+// See 'errorreporter.cpp' for documentation.
+
+namespace boilerplate {
+
+// Writes log records to a FILE on a thread of its own, so that the threads
+// producing them never wait for the write.
+class LogWriter {
+ public:
+  // Records that arrive while this many bytes are waiting are dropped.
+  static constexpr size_t MaxPendingBytes = 1 << 20;
+
+  explicit LogWriter(FILE* out);
+  ~LogWriter(void);  // writes everything still pending
+
+  LogWriter(const LogWriter&) = delete;
+  LogWriter& operator=(const LogWriter&) = delete;
+
+  // Copies the record; it should end with a newline.
+  void write(const char* data, size_t length);
+  void write(const TextBuffer& record) { write(record.data(), record.size()); }
+
+  // Waits until everything written so far is out.
+  void flush(void);
+
+  size_t dropped(void) const;
+
+ private:
+  void writerLoop(void);
+
+  FILE* m_out;
+  mutable std::mutex m_lock;
+  std::condition_variable m_pendingChanged;
+  std::condition_variable m_written;
+  TextBuffer m_pending;   // filled by write()
+  TextBuffer m_writing;   // being written by the thread
+  uint64_t m_queued;      // records queued so far
+  uint64_t m_completed;   // records written so far
+  size_t m_pendingRecords;
+  size_t m_dropped;
+  bool m_shuttingDown;
+  std::thread m_thread;
+};
+
+class ErrorReporter {
+ public:
+  struct Options {
+    // Reports of the same error (same message from the same place) within
+    // this time of its first report are only counted, and the count is
+    // reported once the window is over.
+    std::chrono::milliseconds dedupWindow{1000};
+    // At most this many reports are written per second, over all errors.
+    unsigned maxReportsPerSecond = 100;
+    // Whether to include the stack of Error objects.
+    bool stacks = true;
+  };
+
+  struct Stats {
+    size_t reported = 0;    // written to the log
+    size_t duplicates = 0;  // counted but not written, as repeats
+    size_t limited = 0;     // not written because of maxReportsPerSecond
+  };
+
+  explicit ErrorReporter(FILE* out = stderr);
+  ErrorReporter(const Options& options, FILE* out = stderr);
+  ~ErrorReporter(void);
+
+  ErrorReporter(const ErrorReporter&) = delete;
+  ErrorReporter& operator=(const ErrorReporter&) = delete;
+
+  // Reports and clears the pending exception. Returns false if there was
+  // none, as for an uncatchable error.
+  bool reportPendingException(JSContext* cx);
+  // 'label', if given, starts the report instead of "error: ", for example
+  // "Unhandled promise rejection: ". Reports with different labels are never
+  // counted as repeats of each other.
+  void reportException(JSContext* cx, JS::HandleValue exception,
+                       const char* label = nullptr);
+
+  // For warnings and other reports without an exception, for example from
+  // JS::SetWarningReporter().
+  void report(JSContext* cx, JSErrorReport* report);
+
+  // Writes the counts of errors that were suppressed as duplicates, and waits
+  // until the log writer has written everything.
+  void flush(void);
+
+  Stats stats(void) const;
+
+ private:
+  struct Seen {
+    std::chrono::steady_clock::time_point windowStart;
+    size_t repeats;  // since windowStart, not yet reported
+    std::string summary;  // the first line of the error, for the count
+  };
+
+  // Decides whether to write an error with this key and first line. Called
+  // with m_lock held, like the two below.
+  bool admit(uint64_t key, const TextBuffer& summary);
+  void writeRepeats(Seen* seen);
+  void writeLimited(void);
+
+  Options m_options;
+  LogWriter m_writer;
+
+  mutable std::mutex m_lock;  // for everything below
+  std::unordered_map<uint64_t, Seen> m_seen;
+  std::chrono::steady_clock::time_point m_rateWindowStart;
+  unsigned m_reportsInRateWindow;
+  size_t m_limitedInRateWindow;
+  TextBuffer m_notice;  // for the counts of repeats and limited reports
+  Stats m_stats;
+};
+
+// A process-wide reporter writing to stderr, for examples that don't need a
+// reporter of their own.
+ErrorReporter& DefaultErrorReporter(void);
+
+}  // namespace boilerplate
@@ -0,0 +1,162 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <jsapi.h>
+
+#include <js/CompilationAndEvaluation.h>
+#include <js/Conversions.h>
+#include <js/SourceText.h>
+
+#include "boilerplate.h"
+#include "errorreporter.h"
+
+// This example shows how to report the errors of scripts that throw a lot of
+// them with boilerplate::ErrorReporter, which the other examples use too. See
+// 'errorreporter.cpp' for how it keeps that cheap.
+//
+// A script throws and catches a few kinds of errors from a few places, many
+// times, and passes each one to a native function that logs it. It is run
+// twice, and the time of each run is printed:
+//
+// - naive: the function converts the exception to a string and writes it
+//   with std::endl, which is what the examples used to do, and flushes once
+//   per error.
+// - reporter: the function passes the exception to an ErrorReporter. It
+//   writes the first report of each error, with the source position and
+//   stack, counts the repeats, and does the writing on its own thread.
+//
+// Both write to the file given as an argument, or to /dev/null by default so
+// that the terminal's speed doesn't count. Pass /dev/stderr to see the
+// reports.
+
+static const char* workload = R"js(
+function parse(text) {
+  return JSON.parse(text);
+}
+function lookup(table, key) {
+  if (!(key in table))
+    throw new RangeError('no entry for ' + key);
+  return table[key];
+}
+function main(iterations) {
+  let table = {a: 1, b: 2};
+  for (let i = 0; i < iterations; i++) {
+    try {
+      switch (i % 4) {
+        case 0: parse('{bad json'); break;
+        case 1: lookup(table, 'key' + (i % 8)); break;
+        case 2: null.property; break;
+        case 3: throw 'plain string ' + (i % 3);
+      }
+    } catch (e) {
+      logError(e);
+    }
+  }
+}
+)js";
+
+static constexpr unsigned iterations = 200000;
+
+using Clock = std::chrono::steady_clock;
+using Milliseconds = std::chrono::duration<double, std::milli>;
+
+static const char* logPath = "/dev/null";
+static std::ofstream* naiveLog = nullptr;
+static boilerplate::ErrorReporter* reporter = nullptr;
+
+static bool NaiveLogError(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  JS::RootedString message(cx, JS::ToString(cx, args.get(0)));
+  if (!message) return false;
+  JS::UniqueChars chars = JS_EncodeStringToUTF8(cx, message);
+  if (!chars) return false;
+  *naiveLog << "Exception thrown: " << chars.get() << std::endl;
+  args.rval().setUndefined();
+  return true;
+}
+
+static bool ReporterLogError(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  reporter->reportException(cx, args.get(0));
+  args.rval().setUndefined();
+  return true;
+}
+
+static bool RunWorkload(JSContext* cx, JSNative logError,
+                        Milliseconds* elapsed) {
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) return false;
+  JSAutoRealm ar(cx, global);
+
+  if (!JS_DefineFunction(cx, global, "logError", logError, 1, 0)) return false;
+
+  JS::CompileOptions options(cx);
+  options.setFileAndLine("workload.js", 1);
+  JS::SourceText<mozilla::Utf8Unit> source;
+  JS::RootedValue rval(cx);
+  if (!source.init(cx, workload, strlen(workload),
+                   JS::SourceOwnership::Borrowed) ||
+      !JS::Evaluate(cx, options, source, &rval))
+    return false;
+
+  JS::AutoValueArray<1> args(cx);
+  args[0].setInt32(iterations);
+  Clock::time_point start = Clock::now();
+  if (!JS_CallFunctionName(cx, global, "main", args, &rval)) return false;
+  *elapsed = Clock::now() - start;
+  return true;
+}
+
+static bool ErrorsExample(JSContext* cx) {
+  Milliseconds naiveTime, reporterTime;
+
+  std::ofstream naive(logPath, std::ios::app);
+  if (!naive) {
+    std::cerr << "could not open " << logPath << '\n';
+    return false;
+  }
+  naiveLog = &naive;
+  if (!RunWorkload(cx, NaiveLogError, &naiveTime)) return false;
+  naive.close();
+
+  FILE* out = fopen(logPath, "a");
+  if (!out) {
+    std::cerr << "could not open " << logPath << '\n';
+    return false;
+  }
+  boilerplate::ErrorReporter::Stats stats;
+  {
+    boilerplate::ErrorReporter errors(out);
+    reporter = &errors;
+    bool ok = RunWorkload(cx, ReporterLogError, &reporterTime);
+    reporter = nullptr;
+    if (!ok) {
+      fclose(out);
+      return false;
+    }
+    stats = errors.stats();
+    // Writing the rest is part of the cost.
+    Clock::time_point start = Clock::now();
+    errors.flush();
+    reporterTime += Clock::now() - start;
+  }
+  fclose(out);
+
+  std::cout << iterations << " errors\n"
+            << "naive:    " << naiveTime.count() << " ms\n"
+            << "reporter: " << reporterTime.count() << " ms, "
+            << stats.reported << " reported, " << stats.duplicates
+            << " counted as repeats, " << stats.limited
+            << " over the rate limit\n";
+  return true;
+}
+
+int main(int argc, const char* argv[]) {
+  if (argc > 1) logPath = argv[1];
+
+  if (!boilerplate::RunExample(ErrorsExample)) return 1;
+  return 0;
+}
@@ -0,0 +1,431 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
+#include <utility>
+
+#include <jsapi.h>
+
+#include <js/Conversions.h>
+#include <js/GCVector.h>
+#include <js/Promise.h>
+#include <js/TracingAPI.h>
+#include <js/UniquePtr.h>
+
+#include "errorreporter.h"
+#include "eventloop.h"
+
+// An EventLoop is the embedding's own job queue for Promise jobs, with timers
+// and unhandled rejection reporting, replacing js::UseInternalJobQueues().
+//
+// Promise jobs (microtasks) go in a ring buffer that grows by doubling, so
+// enqueueing and running a job never allocates once the buffer is big enough.
+// The jobs are function objects, which are traced from one extra roots tracer
+// instead of rooting each of them separately.
+//
+// The microtask queue is drained in batches. Every MicrotaskBatchSize jobs we
+// check whether setMicrotaskBudget()'s time budget is used up, and if so, let
+// due timers run before continuing. That is a deliberate departure from the
+// HTML event loop, where a microtask checkpoint always runs until the queue is
+// empty, to keep a flood of microtasks from starving timers. With no budget
+// (the default) the checkpoint does run until the queue is empty.
+//
+// Other work that the loop should wait for, such as I/O, is represented by a
+// Source. When there is nothing else to do, the loop blocks in the source's
+// wait() until the next timer is due. See 'asyncio.cpp' for a source.
+//
+// Timers are kept in a binary min-heap ordered by deadline, and their callbacks
+// in a HandleTable. clearTimeout() only removes the callback; the stale heap
+// entry is skipped when it reaches the top. Each timer callback is followed by
+// a microtask checkpoint.
+//
+// Rejected promises without a handler are collected by the rejection tracker
+// callback, and reported at the end of each microtask checkpoint if they still
+// have no handler by then.
+//
+// The EventLoop must outlive any use of its JSContext that may run JS, and is
+// only for use on the context's thread.
+
+static constexpr size_t MicrotaskBatchSize = 64;
+
+// The natives are plain functions and so need to find the event loop somehow.
+// Since a JSContext is only used on one thread, a thread-local will do.
+static thread_local boilerplate::EventLoop* currentLoop = nullptr;
+
+static void ReportException(JSContext* cx) {
+  // Returning false without an exception is an uncatchable error, such as the
+  // REPL's quit(). Nothing to report.
+  boilerplate::DefaultErrorReporter().reportPendingException(cx);
+}
+
+boilerplate::EventLoop::Ring::Ring(void)
+    : m_capacity(0), m_head(0), m_size(0) {}
+
+bool boilerplate::EventLoop::Ring::push(JSObject* job) {
+  if (m_size == m_capacity) {
+    size_t newCapacity = m_capacity ? m_capacity * 2 : 256;
+    std::unique_ptr<JS::Heap<JSObject*>[]> jobs(
+        new (std::nothrow) JS::Heap<JSObject*>[newCapacity]);
+    if (!jobs) return false;
+    for (size_t ix = 0; ix < m_size; ix++)
+      jobs[ix] = m_jobs[(m_head + ix) & (m_capacity - 1)];
+    m_jobs = std::move(jobs);
+    m_capacity = newCapacity;
+    m_head = 0;
+  }
+
+  m_jobs[(m_head + m_size) & (m_capacity - 1)] = job;
+  m_size++;
+  return true;
+}
+
+JSObject* boilerplate::EventLoop::Ring::pop(void) {
+  JSObject* job = m_jobs[m_head];
+  m_jobs[m_head] = nullptr;
+  m_head = (m_head + 1) & (m_capacity - 1);
+  m_size--;
+  return job;
+}
+
+void boilerplate::EventLoop::Ring::trace(JSTracer* trc) {
+  for (size_t ix = 0; ix < m_size; ix++) {
+    JS::TraceEdge(trc, &m_jobs[(m_head + ix) & (m_capacity - 1)],
+                  "microtask");
+  }
+}
+
+// The debugger sets the job queue aside while it runs its own code, so that
+// Promise jobs from the debugger don't run in the middle of the debuggee's
+// jobs. We swap in an empty ring, and swap the old one back when the debugger
+// is done. The saved ring is still traced in the meantime.
+class boilerplate::EventLoop::SavedQueue
+    : public JS::JobQueue::SavedJobQueue {
+  EventLoop* m_loop;
+  Ring m_saved;
+  bool m_draining;
+
+ public:
+  explicit SavedQueue(EventLoop* loop)
+      : m_loop(loop), m_draining(loop->m_draining) {
+    std::swap(m_saved, loop->m_microtasks);
+    loop->m_draining = false;
+    loop->m_savedQueues.push_back(&m_saved);
+  }
+
+  ~SavedQueue(void) override {
+    m_loop->m_savedQueues.pop_back();
+    std::swap(m_saved, m_loop->m_microtasks);
+    m_loop->m_draining = m_draining;
+  }
+};
+
+boilerplate::EventLoop::EventLoop(void)
+    : m_cx(nullptr),
+      m_draining(false),
+      m_stopped(false),
+      m_microtaskBudget(0),
+      m_source(nullptr),
+      m_lastTimerId(0),
+      m_timerSequence(0) {}
+
+boilerplate::EventLoop::~EventLoop(void) {
+  if (!m_cx) return;
+
+  // Promise jobs can't be enqueued after this, so don't create promises after
+  // the EventLoop is gone.
+  JS::SetJobQueue(m_cx, nullptr);
+  JS::SetPromiseRejectionTrackerCallback(m_cx, nullptr, nullptr);
+  JS_RemoveExtraGCRootsTracer(m_cx, &EventLoop::Trace, this);
+  m_unhandledRejections.reset();
+  m_callbacks.reset();
+  if (currentLoop == this) currentLoop = nullptr;
+}
+
+bool boilerplate::EventLoop::init(JSContext* cx) {
+  m_cx = cx;
+  m_callbacks.reset(new HandleTable(cx));
+  m_unhandledRejections.reset(
+      new JS::PersistentRooted<
+          JS::GCVector<JSObject*, 0, js::SystemAllocPolicy>>(cx));
+
+  if (!JS_AddExtraGCRootsTracer(cx, &EventLoop::Trace, this)) return false;
+
+  JS::SetJobQueue(cx, this);
+  JS::SetPromiseRejectionTrackerCallback(cx, &EventLoop::TrackRejection, this);
+  currentLoop = this;
+  return true;
+}
+
+void boilerplate::EventLoop::Trace(JSTracer* trc, void* data) {
+  auto* loop = static_cast<EventLoop*>(data);
+  loop->m_microtasks.trace(trc);
+  for (Ring* saved : loop->m_savedQueues) saved->trace(trc);
+}
+
+JSObject* boilerplate::EventLoop::getIncumbentGlobal(JSContext* cx) {
+  return JS::CurrentGlobalOrNull(cx);
+}
+
+bool boilerplate::EventLoop::enqueuePromiseJob(
+    JSContext* cx, JS::HandleObject promise, JS::HandleObject job,
+    JS::HandleObject allocationSite, JS::HandleObject incumbentGlobal) {
+  if (!m_microtasks.push(job)) {
+    JS_ReportOutOfMemory(cx);
+    return false;
+  }
+  return true;
+}
+
+// Called by SpiderMonkey, for example from the debugger, to run all jobs.
+void boilerplate::EventLoop::runJobs(JSContext* cx) {
+  drainMicrotasks(cx, Clock::time_point::max());
+}
+
+js::UniquePtr<JS::JobQueue::SavedJobQueue>
+boilerplate::EventLoop::saveJobQueue(JSContext* cx) {
+  auto saved = js::MakeUnique<SavedQueue>(this);
+  if (!saved) {
+    JS_ReportOutOfMemory(cx);
+    return nullptr;
+  }
+  return saved;
+}
+
+boilerplate::EventLoop::Drain boilerplate::EventLoop::drainMicrotasks(
+    JSContext* cx, Clock::time_point deadline) {
+  // A job may end up calling runJobs() again. The outer call will run the
+  // rest of the jobs.
+  if (m_draining) return Drain::Empty;
+  m_draining = true;
+
+  Drain result = Drain::Empty;
+  JS::RootedObject job(cx);
+  JS::RootedValue rval(cx);
+  for (size_t ran = 0; m_microtasks.size() > 0; ran++) {
+    if (m_stopped) {
+      result = Drain::Stopped;
+      break;
+    }
+    if (ran > 0 && ran % MicrotaskBatchSize == 0 &&
+        deadline != Clock::time_point::max() && Clock::now() >= deadline) {
+      result = Drain::OutOfTime;
+      break;
+    }
+
+    job = m_microtasks.pop();
+    JSAutoRealm ar(cx, job);
+    if (!JS::Call(cx, JS::UndefinedHandleValue, job,
+                  JS::HandleValueArray::empty(), &rval))
+      ReportException(cx);
+  }
+
+  m_draining = false;
+  return result;
+}
+
+// Returns true if the microtask queue was emptied.
+bool boilerplate::EventLoop::microtaskCheckpoint(JSContext* cx) {
+  Clock::time_point deadline = Clock::time_point::max();
+  if (m_microtaskBudget.count() > 0)
+    deadline = Clock::now() + m_microtaskBudget;
+
+  if (drainMicrotasks(cx, deadline) != Drain::Empty) return false;
+  reportUnhandledRejections(cx);
+  return true;
+}
+
+bool boilerplate::EventLoop::runDueTimers(JSContext* cx) {
+  Clock::time_point now = Clock::now();
+  JS::RootedValue callback(cx);
+  JS::RootedValue rval(cx);
+  while (!m_stopped && !m_timers.empty() && m_timers.front().deadline <= now) {
+    std::pop_heap(m_timers.begin(), m_timers.end());
+    uint32_t id = m_timers.back().id;
+    m_timers.pop_back();
+
+    auto entry = m_timerCallbacks.find(id);
+    if (entry == m_timerCallbacks.end()) continue;  // cleared
+    callback = m_callbacks->get(entry->second);
+    m_callbacks->remove(entry->second);
+    m_timerCallbacks.erase(entry);
+
+    {
+      JSAutoRealm ar(cx, &callback.toObject());
+      if (!JS::Call(cx, JS::UndefinedHandleValue, callback,
+                    JS::HandleValueArray::empty(), &rval))
+        ReportException(cx);
+    }
+
+    microtaskCheckpoint(cx);
+  }
+  return true;
+}
+
+bool boilerplate::EventLoop::runOnce(JSContext* cx) {
+  microtaskCheckpoint(cx);
+  if (!m_stopped && m_source && m_source->pending()) {
+    m_source->wait(cx, 0);
+    microtaskCheckpoint(cx);
+  }
+  runDueTimers(cx);
+  return !m_stopped &&
+         (m_microtasks.size() > 0 || !m_timerCallbacks.empty() ||
+          (m_source && m_source->pending()));
+}
+
+// Returns -1 if there are no timers.
+int boilerplate::EventLoop::msUntilNextTimer(void) {
+  // Drop timers that were cleared, so we don't wait for them.
+  while (!m_timers.empty() &&
+         m_timerCallbacks.count(m_timers.front().id) == 0) {
+    std::pop_heap(m_timers.begin(), m_timers.end());
+    m_timers.pop_back();
+  }
+  if (m_timers.empty()) return -1;
+
+  auto remaining = m_timers.front().deadline - Clock::now();
+  if (remaining <= Clock::duration::zero()) return 0;
+  // Round up, so that we don't wake up just before the deadline.
+  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+      remaining + std::chrono::milliseconds(1) - Clock::duration(1));
+  return int(std::min<decltype(ms.count())>(ms.count(), INT32_MAX));
+}
+
+void boilerplate::EventLoop::run(JSContext* cx) {
+  m_stopped = false;
+  while (runOnce(cx)) {
+    if (m_microtasks.size() > 0) continue;
+
+    int timeout = msUntilNextTimer();
+    if (m_source && m_source->pending()) {
+      // The source wakes us up when an operation completes, or when the next
+      // timer is due.
+      m_source->wait(cx, timeout);
+    } else if (timeout > 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(timeout));
+    }
+  }
+}
+
+void boilerplate::EventLoop::TrackRejection(
+    JSContext* cx, JS::HandleObject promise,
+    JS::PromiseRejectionHandlingState state, void* data) {
+  auto* loop = static_cast<EventLoop*>(data);
+  auto& rejections = loop->m_unhandledRejections->get();
+
+  if (state == JS::PromiseRejectionHandlingState::Unhandled) {
+    // If this fails, we're out of memory and just won't report the rejection.
+    (void)rejections.append(promise);
+    return;
+  }
+
+  for (size_t ix = 0; ix < rejections.length(); ix++) {
+    if (rejections[ix] == promise) {
+      rejections.erase(rejections.begin() + ix);
+      return;
+    }
+  }
+}
+
+void boilerplate::EventLoop::reportUnhandledRejections(JSContext* cx) {
+  // Converting the reasons to strings may run JS, which may reject more
+  // promises, so take them off the list one at a time.
+  auto& rejections = m_unhandledRejections->get();
+  JS::RootedObject promise(cx);
+  JS::RootedValue reason(cx);
+  while (rejections.length() > 0) {
+    promise = rejections[0];
+    rejections.erase(rejections.begin());
+
+    JSAutoRealm ar(cx, promise);
+    reason = JS::GetPromiseResult(promise);
+    boilerplate::DefaultErrorReporter().reportException(
+        cx, reason, "Unhandled promise rejection: ");
+  }
+}
+
+bool boilerplate::EventLoop::defineFunctions(JSContext* cx,
+                                             JS::HandleObject global) {
+  static const JSFunctionSpec functions[] = {
+      JS_FN("setTimeout", &EventLoop::SetTimeout, 2, 0),
+      JS_FN("clearTimeout", &EventLoop::ClearTimeout, 1, 0),
+      JS_FN("queueMicrotask", &EventLoop::QueueMicrotask, 1, 0), JS_FS_END};
+  return JS_DefineFunctions(cx, global, functions);
+}
+
+static bool RequireCallback(JSContext* cx, const JS::CallArgs& args,
+                            const char* name) {
+  if (!args.requireAtLeast(cx, name, 1)) return false;
+  if (!args[0].isObject() || !JS::IsCallable(&args[0].toObject())) {
+    JS_ReportErrorASCII(cx, "%s: callback must be a function", name);
+    return false;
+  }
+  return true;
+}
+
+bool boilerplate::EventLoop::SetTimeout(JSContext* cx, unsigned argc,
+                                        JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  if (!RequireCallback(cx, args, "setTimeout")) return false;
+
+  double delay = 0.0;
+  if (!JS::ToNumber(cx, args.get(1), &delay)) return false;
+  // Like browsers, clamp the delay to the range of a 32-bit int.
+  if (!(delay > 0.0)) delay = 0.0;
+  delay = std::min(delay, double(INT32_MAX));
+
+  EventLoop* loop = currentLoop;
+  HandleTable::Handle handle = loop->m_callbacks->add(args[0]);
+  if (handle == HandleTable::InvalidHandle) {
+    JS_ReportOutOfMemory(cx);
+    return false;
+  }
+
+  uint32_t id = ++loop->m_lastTimerId;
+  loop->m_timerCallbacks.emplace(id, handle);
+
+  Timer timer;
+  timer.deadline =
+      Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                         std::chrono::duration<double, std::milli>(delay));
+  timer.sequence = loop->m_timerSequence++;
+  timer.id = id;
+  loop->m_timers.push_back(timer);
+  std::push_heap(loop->m_timers.begin(), loop->m_timers.end());
+
+  args.rval().setNumber(id);
+  return true;
+}
+
+bool boilerplate::EventLoop::ClearTimeout(JSContext* cx, unsigned argc,
+                                          JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  uint32_t id;
+  if (!JS::ToUint32(cx, args.get(0), &id)) return false;
+
+  EventLoop* loop = currentLoop;
+  auto entry = loop->m_timerCallbacks.find(id);
+  if (entry != loop->m_timerCallbacks.end()) {
+    loop->m_callbacks->remove(entry->second);
+    loop->m_timerCallbacks.erase(entry);
+  }
+
+  args.rval().setUndefined();
+  return true;
+}
+
+bool boilerplate::EventLoop::QueueMicrotask(JSContext* cx, unsigned argc,
+                                            JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  if (!RequireCallback(cx, args, "queueMicrotask")) return false;
+
+  if (!currentLoop->m_microtasks.push(&args[0].toObject())) {
+    JS_ReportOutOfMemory(cx);
+    return false;
+  }
+
+  args.rval().setUndefined();
+  return true;
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <jsapi.h>
+
+#include <js/GCVector.h>
+#include <js/Promise.h>
+#include <js/UniquePtr.h>
+
+#include "handletable.h"
+
+// See 'eventloop.cpp' for documentation.
+
+namespace boilerplate {
+
+class EventLoop : public JS::JobQueue {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  // Something other than timers that the loop waits for, such as I/O.
+  class Source {
+   public:
+    virtual ~Source(void) = default;
+
+    // Whether there are operations in flight that will call back into JS.
+    virtual bool pending(void) const = 0;
+
+    // Waits up to timeoutMs milliseconds (forever if negative, not at all if
+    // zero) for operations to complete, and runs their callbacks.
+    virtual void wait(JSContext* cx, int timeoutMs) = 0;
+  };
+
+  EventLoop(void);
+  ~EventLoop(void) override;
+
+  EventLoop(const EventLoop&) = delete;
+  EventLoop& operator=(const EventLoop&) = delete;
+
+  bool init(JSContext* cx);
+
+  // Defines setTimeout(), clearTimeout(), and queueMicrotask() on the global.
+  bool defineFunctions(JSContext* cx, JS::HandleObject global);
+
+  // Runs until there are no more microtasks, timers, or pending operations of
+  // the source, or until stop().
+  void run(JSContext* cx);
+
+  // Runs the microtasks, the callbacks of completed operations of the source,
+  // and the timers that are due, without waiting. Returns false if there is no
+  // more work.
+  bool runOnce(JSContext* cx);
+
+  void stop(void) { m_stopped = true; }
+
+  // How long to run microtasks before letting timers run; zero, the default,
+  // means until the microtask queue is empty.
+  void setMicrotaskBudget(std::chrono::microseconds budget) {
+    m_microtaskBudget = budget;
+  }
+
+  size_t pendingTimers(void) const { return m_timerCallbacks.size(); }
+
+  // Only one source is supported. Pass nullptr to remove it again.
+  void setSource(Source* source) { m_source = source; }
+
+  // JS::JobQueue implementation.
+  JSObject* getIncumbentGlobal(JSContext* cx) override;
+  bool enqueuePromiseJob(JSContext* cx, JS::HandleObject promise,
+                         JS::HandleObject job, JS::HandleObject allocationSite,
+                         JS::HandleObject incumbentGlobal) override;
+  void runJobs(JSContext* cx) override;
+  bool empty(void) const override { return m_microtasks.size() == 0; }
+
+ private:
+  // A growable ring buffer of microtasks, which are function objects.
+  class Ring {
+    std::unique_ptr<JS::Heap<JSObject*>[]> m_jobs;
+    size_t m_capacity;  // always a power of two
+    size_t m_head;
+    size_t m_size;
+
+   public:
+    Ring(void);
+    bool push(JSObject* job);
+    JSObject* pop(void);
+    size_t size(void) const { return m_size; }
+    void trace(JSTracer* trc);
+  };
+
+  class SavedQueue;
+
+  struct Timer {
+    Clock::time_point deadline;
+    uint64_t sequence;  // timers with the same deadline run in order
+    uint32_t id;
+
+    // std::push_heap() makes a max-heap, so this is reversed to get the
+    // earliest timer on top.
+    bool operator<(const Timer& other) const {
+      if (deadline != other.deadline) return deadline > other.deadline;
+      return sequence > other.sequence;
+    }
+  };
+
+  enum class Drain { Empty, OutOfTime, Stopped };
+
+  js::UniquePtr<JS::JobQueue::SavedJobQueue> saveJobQueue(
+      JSContext* cx) override;
+
+  Drain drainMicrotasks(JSContext* cx, Clock::time_point deadline);
+  bool microtaskCheckpoint(JSContext* cx);
+  bool runDueTimers(JSContext* cx);
+  int msUntilNextTimer(void);
+  void reportUnhandledRejections(JSContext* cx);
+
+  static void Trace(JSTracer* trc, void* data);
+  static void TrackRejection(JSContext* cx, JS::HandleObject promise,
+                             JS::PromiseRejectionHandlingState state,
+                             void* data);
+
+  static bool SetTimeout(JSContext* cx, unsigned argc, JS::Value* vp);
+  static bool ClearTimeout(JSContext* cx, unsigned argc, JS::Value* vp);
+  static bool QueueMicrotask(JSContext* cx, unsigned argc, JS::Value* vp);
+
+  JSContext* m_cx;
+  Ring m_microtasks;
+  std::vector<Ring*> m_savedQueues;
+  bool m_draining;
+  bool m_stopped;
+  std::chrono::microseconds m_microtaskBudget;
+  Source* m_source;
+
+  std::unique_ptr<HandleTable> m_callbacks;
+  std::vector<Timer> m_timers;
+  std::unordered_map<uint32_t, HandleTable::Handle> m_timerCallbacks;
+  uint32_t m_lastTimerId;
+  uint64_t m_timerSequence;
+
+  std::unique_ptr<
+      JS::PersistentRooted<JS::GCVector<JSObject*, 0, js::SystemAllocPolicy>>>
+      m_unhandledRejections;
+};
+
+}  // namespace boilerplate
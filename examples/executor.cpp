@@ -0,0 +1,142 @@
+#include <memory>
+
+#include <jsapi.h>
+
+#include <js/CompilationAndEvaluation.h>
+#include <js/Conversions.h>
+#include <js/SourceText.h>
+
+#include "executor.h"
+
+// A ScriptExecutor runs scripts on a pool of worker threads, each of which has
+// its own JSContext and its own global object. Jobs are pulled from a shared
+// queue by whichever worker is free, so independent scripts can make use of
+// all cores in one process.
+//
+// Since each worker has its own global, scripts submitted to the executor
+// should not rely on state left behind by earlier scripts: consecutive jobs
+// may or may not run in the same global.
+//
+// Each script can be given ScriptLimits, which a Watchdog enforces, so that a
+// runaway script only costs its worker the time it's allowed. The result
+// reports the CPU and wall clock time used by each script.
+
+// Each worker's global. The ContextPool worker hooks create it once the
+// context is ready and reset it before the context goes away.
+static thread_local JS::PersistentRooted<JSObject*>* workerGlobal = nullptr;
+
+static bool CreateWorkerGlobal(JSContext* cx) {
+  if (!boilerplate::Watchdog::Install(cx)) return false;
+
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) return false;
+
+  workerGlobal = new JS::PersistentRooted<JSObject*>(cx, global);
+  return true;
+}
+
+static void DestroyWorkerGlobal(JSContext* cx) {
+  delete workerGlobal;
+  workerGlobal = nullptr;
+}
+
+// Convert a value to a std::string for passing back to the submitting thread.
+// JS values can't leave the worker's context, so the result has to be copied
+// into something the other thread can own.
+static bool StringifyValue(JSContext* cx, JS::HandleValue value,
+                           std::string* out) {
+  JS::RootedString str(cx, JS::ToString(cx, value));
+  if (!str) return false;
+
+  JS::UniqueChars chars(JS_EncodeStringToUTF8(cx, str));
+  if (!chars) return false;
+
+  *out = chars.get();
+  return true;
+}
+
+static void StringifyPendingException(JSContext* cx, std::string* out) {
+  JS::RootedValue exception(cx);
+  if (!JS_GetPendingException(cx, &exception)) {
+    *out = "uncatchable exception";
+    return;
+  }
+  JS_ClearPendingException(cx);
+
+  if (!StringifyValue(cx, exception, out)) {
+    JS_ClearPendingException(cx);
+    *out = "exception could not be converted to string";
+  }
+}
+
+static bool EvaluateJob(JSContext* cx, const std::string& code,
+                        const std::string& filename,
+                        boilerplate::ScriptBudget& budget,
+                        ScriptResult* result) {
+  JSAutoRealm ar(cx, *workerGlobal);
+  result->terminated = false;
+
+  JS::CompileOptions options(cx);
+  options.setFileAndLine(filename.c_str(), 1);
+
+  JS::SourceText<mozilla::Utf8Unit> source;
+  JS::RootedValue rval(cx);
+  if (!source.init(cx, code.c_str(), code.length(),
+                   JS::SourceOwnership::Borrowed) ||
+      !JS::Evaluate(cx, options, source, &rval) ||
+      !StringifyValue(cx, rval, &result->value)) {
+    result->ok = false;
+    if (budget.exceeded()) {
+      result->terminated = true;
+      result->value = "script terminated: over its time limit";
+    } else {
+      StringifyPendingException(cx, &result->value);
+    }
+    return false;
+  }
+
+  result->ok = true;
+  return true;
+}
+
+boilerplate::ScriptExecutor::ScriptExecutor(size_t numThreads)
+    : m_pool(numThreads > 0 ? numThreads : 1) {
+  m_pool.setWorkerHooks(CreateWorkerGlobal, DestroyWorkerGlobal);
+}
+
+bool boilerplate::ScriptExecutor::init(void) {
+  return m_watchdog.start() && m_pool.init();
+}
+
+// Queue a script for evaluation. The returned future becomes ready when some
+// worker has finished evaluating it, or right away with an error if no worker
+// has a context.
+std::future<boilerplate::ScriptResult> boilerplate::ScriptExecutor::submit(
+    std::string code, std::string filename, ScriptLimits limits) {
+  auto result = std::make_shared<std::promise<ScriptResult>>();
+  std::future<ScriptResult> future = result->get_future();
+
+  // The pool would drop the job, and the promise with it.
+  if (m_pool.liveWorkers() == 0) {
+    ScriptResult scriptResult;
+    scriptResult.ok = false;
+    scriptResult.value = "no worker context to run the script on";
+    scriptResult.terminated = false;
+    scriptResult.cpuTime = scriptResult.wallTime = std::chrono::nanoseconds(0);
+    result->set_value(std::move(scriptResult));
+    return future;
+  }
+
+  m_pool.post([this, result, code = std::move(code),
+               filename = std::move(filename), limits](JSContext* cx) {
+    ScriptResult scriptResult;
+    boilerplate::ScriptBudget budget(m_watchdog, cx, limits);
+    bool ok = EvaluateJob(cx, code, filename, budget, &scriptResult);
+    scriptResult.cpuTime = budget.cpuTime();
+    scriptResult.wallTime = budget.wallTime();
+    result->set_value(std::move(scriptResult));
+    return ok;
+  });
+
+  return future;
+}
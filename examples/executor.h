@@ -0,0 +1,43 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <future>
+#include <string>
+#include <thread>
+
+#include "boilerplate.h"
+#include "watchdog.h"
+
+// See 'executor.cpp' for documentation.
+
+namespace boilerplate {
+
+struct ScriptResult {
+  bool ok;
+  std::string value;  // the result as a string, or the error message if !ok
+  bool terminated;    // stopped for going over its ScriptLimits
+  std::chrono::nanoseconds cpuTime;
+  std::chrono::nanoseconds wallTime;
+};
+
+class ScriptExecutor {
+ public:
+  explicit ScriptExecutor(
+      size_t numThreads = std::thread::hardware_concurrency());
+
+  bool init(void);
+  std::future<ScriptResult> submit(std::string code,
+                                   std::string filename = "noname",
+                                   ScriptLimits limits = ScriptLimits());
+
+  Watchdog::Counters counters(void) { return m_watchdog.counters(); }
+
+  size_t size(void) const { return m_pool.size(); }
+
+ private:
+  Watchdog m_watchdog;  // must outlive the pool's workers
+  ContextPool m_pool;
+};
+
+}  // namespace boilerplate
@@ -0,0 +1,238 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <jsapi.h>
+
+#include <js/CompilationAndEvaluation.h>
+#include <js/Conversions.h>
+#include <js/SourceText.h>
+
+#include "boilerplate.h"
+#include "externalstrings.h"
+#include "memoryusage.h"
+
+// This example shows how to pass a large document to a script without copying
+// it into the GC heap, and how to run a large script file without reading it
+// into a buffer, using the helpers in 'externalstrings.cpp'.
+//
+// It generates a document of about 8 MB of UTF-8 text and passes it to a
+// script twice: once copied with JS_NewStringCopyUTF8N(), and once as an
+// external string pointing into a boilerplate::ExternalText. For each, it
+// prints how long that took and how much string memory the global's zone uses
+// afterwards. Then the script reads the document line by line through a
+// native function, line(n), that returns external substrings of the same
+// text, so no line is ever copied either.
+//
+// Finally it writes a large generated script to a temporary file and
+// evaluates it both by reading the file into a std::string and straight from
+// a mapping of the file.
+
+using Clock = std::chrono::steady_clock;
+
+static const size_t DocumentLines = 200000;
+
+static boilerplate::ExternalText* document = nullptr;
+static std::vector<size_t> lineStarts;  // in UTF-16 code units
+
+static std::string MakeDocument(void) {
+  std::ostringstream out;
+  for (size_t ix = 0; ix < DocumentLines; ix++)
+    out << "record " << ix << ",café crème,☃," << ix * 7 % 1000
+        << ",the quick brown fox\n";
+  return out.str();
+}
+
+static bool Line(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  uint32_t index;
+  if (!JS::ToUint32(cx, args.get(0), &index)) return false;
+  if (size_t(index) + 1 >= lineStarts.size()) {
+    args.rval().setNull();
+    return true;
+  }
+  // Leave out the newline.
+  size_t start = lineStarts[index];
+  JSString* str =
+      document->newString(cx, start, lineStarts[index + 1] - start - 1);
+  if (!str) return false;
+  args.rval().setString(str);
+  return true;
+}
+
+static bool SharesDocument(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  args.rval().setBoolean(
+      args.get(0).isString() &&
+      boilerplate::ExternalText::FromString(args[0].toString()) == document);
+  return true;
+}
+
+static JSFunctionSpec functions[] = {
+    JS_FN("line", Line, 1, 0), JS_FN("sharesDocument", SharesDocument, 1, 0),
+    JS_FS_END};
+
+static bool Evaluate(JSContext* cx, const char* code,
+                     JS::MutableHandleValue rval) {
+  JS::CompileOptions options(cx);
+  options.setFileAndLine("external.js", 1);
+  JS::SourceText<mozilla::Utf8Unit> source;
+  return source.init(cx, code, strlen(code), JS::SourceOwnership::Borrowed) &&
+         JS::Evaluate(cx, options, source, rval);
+}
+
+static bool ReportStrings(JSContext* cx, JS::HandleObject global,
+                          const char* what, Clock::duration elapsed) {
+  JS_GC(cx);
+  boilerplate::MemoryUsage usage;
+  if (!boilerplate::GetMemoryUsage(cx, global, &usage)) return false;
+  std::chrono::duration<double, std::milli> ms = elapsed;
+  std::cout << what << ": " << ms.count() << " ms, string memory "
+            << usage.stringBytes / 1024 << " KB\n";
+  return true;
+}
+
+static bool PassDocument(JSContext* cx, JS::HandleObject global,
+                         const std::string& utf8) {
+  static const char* countLines = R"js(
+    (function () {
+      let count = 0;
+      for (let ix = doc.indexOf('\n'); ix >= 0; ix = doc.indexOf('\n', ix + 1))
+        count++;
+      return count;
+    })()
+  )js";
+
+  JS::RootedValue rval(cx);
+  if (!ReportStrings(cx, global, "before", Clock::duration::zero()))
+    return false;
+
+  Clock::time_point start = Clock::now();
+  JS::RootedString str(cx, JS_NewStringCopyUTF8N(
+                               cx, JS::UTF8Chars(utf8.data(), utf8.size())));
+  if (!str || !JS_DefineProperty(cx, global, "doc", str, 0) ||
+      !Evaluate(cx, countLines, &rval) ||
+      !ReportStrings(cx, global, "copied", Clock::now() - start))
+    return false;
+  std::cout << "  " << rval.toNumber() << " lines\n";
+
+  // Drop the copy, so that it doesn't count towards the next measurement.
+  str = nullptr;
+  if (!JS_DeleteProperty(cx, global, "doc")) return false;
+
+  // The conversion to UTF-16 is a copy too, but outside the GC heap, and
+  // only once no matter how many strings and realms end up using the text.
+  start = Clock::now();
+  document = boilerplate::ExternalText::FromUTF8(utf8.data(), utf8.size());
+  str = document->newString(cx);
+  if (!str || !JS_DefineProperty(cx, global, "doc", str, 0) ||
+      !Evaluate(cx, countLines, &rval) ||
+      !ReportStrings(cx, global, "external", Clock::now() - start))
+    return false;
+  std::cout << "  " << rval.toNumber() << " lines\n";
+
+  lineStarts.push_back(0);
+  for (size_t ix = 0; ix < document->length(); ix++) {
+    if (document->chars()[ix] == u'\n') lineStarts.push_back(ix + 1);
+  }
+
+  static const char* readLines = R"js(
+    (function () {
+      let total = 0, shared = 0;
+      for (let n = 0, text; (text = line(n)) !== null; n++) {
+        total += text.split(',')[3] | 0;
+        if (sharesDocument(text)) shared++;
+      }
+      return `sum ${total}, ${shared} lines share the document`;
+    })()
+  )js";
+
+  start = Clock::now();
+  if (!JS_DefineFunctions(cx, global, functions) ||
+      !Evaluate(cx, readLines, &rval) ||
+      !ReportStrings(cx, global, "line by line", Clock::now() - start))
+    return false;
+  str = rval.toString();
+  JS::UniqueChars result = JS_EncodeStringToUTF8(cx, str);
+  if (!result) return false;
+  std::cout << "  " << result.get() << '\n';
+  return true;
+}
+
+static bool RunMappedScript(JSContext* cx) {
+  char path[] = "/tmp/external-XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    perror("mkstemp");
+    return false;
+  }
+  close(fd);
+
+  // A script of about 10 MB, mostly a large table of data.
+  {
+    std::ofstream out(path);
+    out << "var table = [\n";
+    for (size_t ix = 0; ix < 300000; ix++)
+      out << "  {id: " << ix << ", name: 'entry " << ix << "'},\n";
+    out << "];\ntable.length;\n";
+    if (!out) {
+      unlink(path);
+      std::cerr << "could not write " << path << '\n';
+      return false;
+    }
+  }
+
+  JS::CompileOptions options(cx);
+  options.setFileAndLine(path, 1);
+  JS::RootedValue rval(cx);
+
+  Clock::time_point start = Clock::now();
+  std::ifstream in(path, std::ios::binary);
+  std::string code((std::istreambuf_iterator<char>(in)),
+                   std::istreambuf_iterator<char>());
+  JS::SourceText<mozilla::Utf8Unit> source;
+  bool ok = source.init(cx, code.data(), code.size(),
+                        JS::SourceOwnership::Borrowed) &&
+            JS::Evaluate(cx, options, source, &rval);
+  std::chrono::duration<double, std::milli> readTime = Clock::now() - start;
+
+  start = Clock::now();
+  ok = ok && boilerplate::EvaluateMappedFile(cx, options, path, &rval);
+  std::chrono::duration<double, std::milli> mappedTime = Clock::now() - start;
+
+  unlink(path);
+  if (!ok) return false;
+  std::cout << "script of " << code.size() / 1024 << " KB, "
+            << rval.toNumber() << " entries: read " << readTime.count()
+            << " ms, mapped " << mappedTime.count() << " ms\n";
+  return true;
+}
+
+static bool ExternalExample(JSContext* cx) {
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) return false;
+  JSAutoRealm ar(cx, global);
+
+  std::string utf8 = MakeDocument();
+  std::cout << "document of " << utf8.size() / 1024 << " KB of UTF-8\n";
+  if (!PassDocument(cx, global, utf8) || !RunMappedScript(cx)) return false;
+
+  // This reference was the example's own; the text is freed once the GC has
+  // finalized the last string that points into it.
+  document->release();
+  document = nullptr;
+  return true;
+}
+
+int main(int argc, const char* argv[]) {
+  if (!boilerplate::RunExample(ExternalExample)) return 1;
+  return 0;
+}
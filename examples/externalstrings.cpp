@@ -0,0 +1,222 @@
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <jsapi.h>
+
+#include <js/CompilationAndEvaluation.h>
+#include <js/SourceText.h>
+
+#include "externalstrings.h"
+
+// Helpers for handing large native text to scripts without copying it into
+// the GC heap.
+//
+// JS_NewStringCopyZ() and friends copy the characters into memory owned by
+// the GC. For a short string that doesn't matter, but a document of several
+// megabytes then exists twice, once on each side, and copying it takes time.
+// An external string, made with JS_NewExternalString(), instead points at
+// characters that the embedding owns. The engine never writes to them, and
+// calls the JSStringFinalizer given with them when the string is finalized,
+// so the embedding knows when it may free them. They have to be UTF-16 in
+// this version of SpiderMonkey, so text in another encoding is converted once
+// into an ExternalText first; after that, every string made from it costs a
+// GC cell and nothing more, even for substrings.
+//
+// ExternalText is its own finalizer: the JSStringFinalizer passed to the
+// engine is the ExternalText's base class, so the finalizer can find the text
+// again and drop the reference that the string held.
+//
+// For scripts, SourceText can borrow the source instead of copying it, so a
+// file mapped with mmap() can be compiled without ever being read into a
+// buffer. Note that the engine still keeps its own copy of the source of every
+// script, compressed in the background, for Function.prototype.toString() and
+// for compiling lazily parsed functions later. Mapping the file saves the
+// reading buffer, and the time to fill it, not that copy.
+
+boilerplate::ExternalText::ExternalText(std::u16string&& text)
+    : m_refCount(1), m_text(std::move(text)) {
+  finalize = Finalize;
+}
+
+boilerplate::ExternalText* boilerplate::ExternalText::Adopt(
+    std::u16string&& text) {
+  return new ExternalText(std::move(text));
+}
+
+static bool IsContinuation(unsigned char byte) { return (byte & 0xC0) == 0x80; }
+
+// Invalid UTF-8 is replaced with U+FFFD. Uses no JSAPI, so that it can be
+// called on any thread.
+std::u16string boilerplate::UTF8ToUTF16(const char* utf8, size_t length) {
+  std::u16string text;
+  text.reserve(length);  // exact for ASCII, and never too small
+
+  auto* bytes = reinterpret_cast<const unsigned char*>(utf8);
+  size_t ix = 0;
+  while (ix < length) {
+    unsigned char lead = bytes[ix];
+    if (lead < 0x80) {
+      text.push_back(lead);
+      ix++;
+      continue;
+    }
+
+    // The number of continuation bytes, and the smallest code point that
+    // needs this many, to reject overlong forms.
+    size_t extra;
+    uint32_t min;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+      extra = 1, min = 0x80;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+      extra = 2, min = 0x800;
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+      extra = 3, min = 0x10000;
+    } else {
+      text.push_back(0xFFFD);
+      ix++;
+      continue;
+    }
+
+    uint32_t codePoint = lead & (0x3F >> extra);
+    size_t count = 0;
+    while (count < extra && ix + 1 + count < length &&
+           IsContinuation(bytes[ix + 1 + count])) {
+      codePoint = (codePoint << 6) | (bytes[ix + 1 + count] & 0x3F);
+      count++;
+    }
+    if (count < extra || codePoint < min || codePoint > 0x10FFFF ||
+        (codePoint >= 0xD800 && codePoint <= 0xDFFF)) {
+      // Skip the lead byte and the continuation bytes that were read, as one
+      // replacement character.
+      text.push_back(0xFFFD);
+      ix += 1 + count;
+      continue;
+    }
+    ix += 1 + extra;
+
+    if (codePoint < 0x10000) {
+      text.push_back(char16_t(codePoint));
+    } else {
+      codePoint -= 0x10000;
+      text.push_back(char16_t(0xD800 + (codePoint >> 10)));
+      text.push_back(char16_t(0xDC00 + (codePoint & 0x3FF)));
+    }
+  }
+
+  text.shrink_to_fit();
+  return text;
+}
+
+boilerplate::ExternalText* boilerplate::ExternalText::FromUTF8(
+    const char* utf8, size_t length) {
+  return new ExternalText(UTF8ToUTF16(utf8, length));
+}
+
+void boilerplate::ExternalText::release(void) {
+  if (m_refCount.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+}
+
+void boilerplate::ExternalText::Finalize(const JSStringFinalizer* fin,
+                                         char16_t* chars) {
+  // Cast away the const that the engine adds; the text is only freed here,
+  // never written to.
+  auto* text = static_cast<ExternalText*>(const_cast<JSStringFinalizer*>(fin));
+  text->release();
+}
+
+JSString* boilerplate::ExternalText::newString(JSContext* cx) {
+  return newString(cx, 0, m_text.size());
+}
+
+JSString* boilerplate::ExternalText::newString(JSContext* cx, size_t start,
+                                               size_t length) {
+  if (start > m_text.size() || length > m_text.size() - start) {
+    JS_ReportErrorASCII(cx, "substring out of range");
+    return nullptr;
+  }
+  // The engine doesn't accept an empty external string; an empty string
+  // needs no characters anyway.
+  if (length == 0) return JS_GetEmptyString(cx);
+
+  // The string may be finalized as soon as it is created, if the GC runs
+  // before the caller roots it, so the reference must be taken first.
+  addRef();
+  // The engine never writes to the characters of an external string; it only
+  // passes them back to Finalize().
+  auto* chars = const_cast<char16_t*>(m_text.data()) + start;
+  JSString* str = JS_NewExternalString(cx, chars, length, this);
+  if (!str) release();
+  return str;
+}
+
+boilerplate::ExternalText* boilerplate::ExternalText::FromString(
+    JSString* str) {
+  if (!JS_IsExternalString(str)) return nullptr;
+  const JSStringFinalizer* fin = JS_GetExternalStringFinalizer(str);
+  // Other external strings have other finalizers.
+  if (fin->finalize != Finalize) return nullptr;
+  return static_cast<ExternalText*>(const_cast<JSStringFinalizer*>(fin));
+}
+
+bool boilerplate::MappedFile::map(JSContext* cx, const char* path) {
+  unmap();
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    JS_ReportErrorUTF8(cx, "could not open %s", path);
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    JS_ReportErrorUTF8(cx, "could not read %s", path);
+    return false;
+  }
+
+  // An empty file can't be mapped, but needs no memory either.
+  if (st.st_size == 0) {
+    close(fd);
+    m_data = "";
+    return true;
+  }
+
+  void* mapping =
+      mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    JS_ReportErrorUTF8(cx, "could not map %s", path);
+    return false;
+  }
+  m_data = static_cast<const char*>(mapping);
+  m_size = size_t(st.st_size);
+  return true;
+}
+
+void boilerplate::MappedFile::unmap(void) {
+  if (m_size) munmap(const_cast<char*>(m_data), m_size);
+  m_data = nullptr;
+  m_size = 0;
+}
+
+// The mapping only has to outlive the compilation: the compiled script refers
+// to the engine's own copy of the source, not to the mapped file.
+bool boilerplate::EvaluateMappedFile(JSContext* cx,
+                                     const JS::ReadOnlyCompileOptions& options,
+                                     const char* path,
+                                     JS::MutableHandleValue rval) {
+  MappedFile file;
+  if (!file.map(cx, path)) return false;
+
+  JS::SourceText<mozilla::Utf8Unit> source;
+  return source.init(cx, file.data(), file.size(),
+                     JS::SourceOwnership::Borrowed) &&
+         JS::Evaluate(cx, options, source, rval);
+}
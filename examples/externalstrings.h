@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+
+#include <jsapi.h>
+
+// See 'externalstrings.cpp' for documentation.
+
+namespace boilerplate {
+
+std::u16string UTF8ToUTF16(const char* utf8, size_t length);
+
+// An immutable UTF-16 text, kept outside of the GC heap, that any number of
+// JS strings can point into without copying it. It is reference counted: the
+// C++ code that creates it holds one reference, and each JS string made from
+// it holds another until the GC finalizes the string.
+class ExternalText : private JSStringFinalizer {
+ public:
+  // Both return a text with one reference, which the caller must release().
+  static ExternalText* Adopt(std::u16string&& text);
+  // Invalid UTF-8 is replaced with U+FFFD.
+  static ExternalText* FromUTF8(const char* utf8, size_t length);
+
+  void addRef(void) { m_refCount.fetch_add(1, std::memory_order_relaxed); }
+  void release(void);
+
+  const char16_t* chars(void) const { return m_text.data(); }
+  size_t length(void) const { return m_text.size(); }
+
+  // A JS string of the whole text, or of 'length' code units from 'start'.
+  JSString* newString(JSContext* cx);
+  JSString* newString(JSContext* cx, size_t start, size_t length);
+
+  // Returns the text that 'str' points into, or nullptr if it wasn't made by
+  // an ExternalText. No reference is added.
+  static ExternalText* FromString(JSString* str);
+
+ private:
+  explicit ExternalText(std::u16string&& text);
+  static void Finalize(const JSStringFinalizer* fin, char16_t* chars);
+
+  std::atomic<size_t> m_refCount;
+  std::u16string m_text;
+};
+
+// A read-only memory mapping of a whole file.
+class MappedFile {
+ public:
+  MappedFile(void) = default;
+  ~MappedFile(void) { unmap(); }
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // Reports an error on cx if the file can't be opened or mapped.
+  bool map(JSContext* cx, const char* path);
+  void unmap(void);
+
+  const char* data(void) const { return m_data; }
+  size_t size(void) const { return m_size; }
+
+ private:
+  const char* m_data = nullptr;
+  size_t m_size = 0;
+};
+
+// Evaluates the UTF-8 script in the file at 'path' straight from a mapping of
+// the file, instead of reading it into a buffer first.
+bool EvaluateMappedFile(JSContext* cx,
+                        const JS::ReadOnlyCompileOptions& options,
+                        const char* path, JS::MutableHandleValue rval);
+
+}  // namespace boilerplate
@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <sstream>
+
+#include <jsapi.h>
+
+#include "gcstats.h"
+
+// GCStats records how long the garbage collector pauses a context, so that an
+// embedding can see how much of its time goes into GC without attaching a
+// profiler.
+//
+// It registers a GC slice callback, which SpiderMonkey calls at the beginning
+// and end of each slice of work (a non-incremental GC is one slice; an
+// incremental GC is split into many), and a GC callback, which is called at
+// the beginning and end of each GC. For each slice it records the duration,
+// the reason the GC was started, and the size of the GC heap afterwards.
+//
+// Records go into a lock-free ring buffer that keeps the most recent
+// GCStats::Capacity slices. The callbacks run on the context's thread and
+// never block, and the buffer can be read from any thread, for example by a
+// thread that exports metrics.
+//
+// There is only one GC callback per context, so install() replaces any GC
+// callback that was set with JS_SetGCCallback() before. The slice callback
+// that was there before is called after ours.
+
+// The slice callback doesn't get a data pointer, so we keep track of the
+// instance per thread; there's only one JSContext per thread.
+static thread_local boilerplate::GCStats* currentStats = nullptr;
+
+bool boilerplate::GCStats::install(JSContext* cx) {
+  if (currentStats) return false;  // one GCStats per context
+  currentStats = this;
+  m_cx = cx;
+  m_installed = Clock::now();
+  m_previousSliceCallback = JS::SetGCSliceCallback(cx, OnGCSlice);
+  JS_SetGCCallback(cx, OnGC, this);
+  return true;
+}
+
+void boilerplate::GCStats::uninstall(void) {
+  if (currentStats != this) return;
+  JS::SetGCSliceCallback(m_cx, m_previousSliceCallback);
+  JS_SetGCCallback(m_cx, nullptr, nullptr);
+  currentStats = nullptr;
+  m_cx = nullptr;
+}
+
+void boilerplate::GCStats::OnGCSlice(JSContext* cx, JS::GCProgress progress,
+                                     const JS::GCDescription& desc) {
+  GCStats* self = currentStats;
+
+  switch (progress) {
+    case JS::GC_CYCLE_BEGIN:
+      self->m_sliceIsCycleStart = true;
+      break;
+
+    case JS::GC_SLICE_BEGIN:
+      self->m_sliceStart = Clock::now();
+      break;
+
+    case JS::GC_CYCLE_END:
+      // This is reported just before the GC_SLICE_END of the last slice.
+      self->m_sliceIsCycleEnd = true;
+      break;
+
+    case JS::GC_SLICE_END: {
+      Clock::time_point now = Clock::now();
+      std::chrono::duration<double, std::milli> start =
+          self->m_sliceStart - self->m_installed;
+      std::chrono::duration<double, std::milli> duration =
+          now - self->m_sliceStart;
+
+      Slice slice;
+      slice.startMs = start.count();
+      slice.durationMs = duration.count();
+      slice.reason = JS::gcreason::ExplainReason(desc.reason_);
+      slice.heapBytes = JS_GetGCParameter(cx, JSGC_BYTES);
+      slice.cycleStart = self->m_sliceIsCycleStart;
+      slice.cycleEnd = self->m_sliceIsCycleEnd;
+      self->m_slices.push(slice);
+
+      self->m_sliceIsCycleStart = false;
+      self->m_sliceIsCycleEnd = false;
+      break;
+    }
+
+    default:
+      break;
+  }
+
+  if (self->m_previousSliceCallback)
+    self->m_previousSliceCallback(cx, progress, desc);
+}
+
+void boilerplate::GCStats::OnGC(JSContext* cx, JSGCStatus status,
+                                void* data) {
+  auto* self = static_cast<GCStats*>(data);
+  if (status == JSGC_END)
+    self->m_cycles.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Pause time percentiles over the slices that are still in the buffer.
+boilerplate::GCStats::Summary boilerplate::GCStats::summarize(void) const {
+  std::vector<Slice> recent = slices();
+
+  std::vector<double> pauses;
+  pauses.reserve(recent.size());
+  for (const Slice& slice : recent) pauses.push_back(slice.durationMs);
+  std::sort(pauses.begin(), pauses.end());
+
+  auto percentile = [&pauses](unsigned pct) {
+    if (pauses.empty()) return 0.0;
+    return pauses[(pauses.size() - 1) * pct / 100];
+  };
+
+  Summary summary;
+  summary.slices = m_slices.totalPushed();
+  summary.cycles = m_cycles.load(std::memory_order_relaxed);
+  summary.p50Ms = percentile(50);
+  summary.p99Ms = percentile(99);
+  summary.maxMs = pauses.empty() ? 0 : pauses.back();
+  summary.totalMs = 0;
+  for (double pause : pauses) summary.totalMs += pause;
+  return summary;
+}
+
+// The summary and the recorded slices, as a JSON object. Reasons are
+// SpiderMonkey identifiers, so they don't need escaping.
+std::string boilerplate::GCStats::toJSON(void) const {
+  Summary summary = summarize();
+
+  std::ostringstream out;
+  out << "{\"slices\":" << summary.slices << ",\"cycles\":" << summary.cycles
+      << ",\"p50Ms\":" << summary.p50Ms << ",\"p99Ms\":" << summary.p99Ms
+      << ",\"maxMs\":" << summary.maxMs << ",\"totalMs\":" << summary.totalMs
+      << ",\"recent\":[";
+
+  bool first = true;
+  for (const Slice& slice : slices()) {
+    if (!first) out << ',';
+    first = false;
+    out << "{\"startMs\":" << slice.startMs
+        << ",\"durationMs\":" << slice.durationMs << ",\"reason\":\""
+        << slice.reason << "\",\"heapBytes\":" << slice.heapBytes
+        << ",\"cycleStart\":" << (slice.cycleStart ? "true" : "false")
+        << ",\"cycleEnd\":" << (slice.cycleEnd ? "true" : "false") << '}';
+  }
+  out << "]}";
+  return out.str();
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <jsapi.h>
+
+// See 'gcstats.cpp' for documentation.
+
+namespace boilerplate {
+
+// A fixed-size ring buffer with one writer and any number of readers, none of
+// which ever take a lock. Each slot has a sequence number that is odd while
+// the slot is being written, so readers can tell when they've read a slot that
+// was being overwritten at the same time, and skip it.
+//
+// So that a reader racing with the writer is not a data race, values are
+// stored as words of relaxed atomics, which is why T must be trivially
+// copyable.
+template <typename T, size_t N>
+class RingBuffer {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "RingBuffer values are copied word by word");
+
+  static constexpr size_t Words =
+      (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+  struct Slot {
+    std::atomic<uint64_t> sequence{0};
+    std::array<std::atomic<uint64_t>, Words> words;
+  };
+  std::array<Slot, N> m_slots;
+  std::atomic<uint64_t> m_written{0};
+
+ public:
+  // Only ever called from one thread.
+  void push(const T& value) {
+    uint64_t index = m_written.load(std::memory_order_relaxed);
+    Slot& slot = m_slots[index % N];
+    uint64_t words[Words] = {};
+    memcpy(words, &value, sizeof(T));
+
+    uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t ix = 0; ix < Words; ix++)
+      slot.words[ix].store(words[ix], std::memory_order_relaxed);
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+    m_written.store(index + 1, std::memory_order_release);
+  }
+
+  // Copy the most recent (up to N) values, oldest first. May be called from
+  // any thread.
+  std::vector<T> snapshot(void) const {
+    std::vector<T> values;
+    uint64_t end = m_written.load(std::memory_order_acquire);
+    uint64_t begin = end > N ? end - N : 0;
+    values.reserve(end - begin);
+    for (uint64_t index = begin; index < end; index++) {
+      const Slot& slot = m_slots[index % N];
+      uint64_t before = slot.sequence.load(std::memory_order_acquire);
+      if (before & 1) continue;
+      uint64_t words[Words];
+      for (size_t ix = 0; ix < Words; ix++)
+        words[ix] = slot.words[ix].load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.sequence.load(std::memory_order_relaxed) != before) continue;
+      T value;
+      memcpy(&value, words, sizeof(T));
+      values.push_back(value);
+    }
+    return values;
+  }
+
+  uint64_t totalPushed(void) const {
+    return m_written.load(std::memory_order_acquire);
+  }
+};
+
+class GCStats {
+ public:
+  struct Slice {
+    double startMs;  // since GCStats::install()
+    double durationMs;
+    const char* reason;
+    uint32_t heapBytes;  // at the end of the slice
+    bool cycleStart : 1;
+    bool cycleEnd : 1;
+  };
+
+  struct Summary {
+    uint64_t slices;  // including ones that were overwritten
+    uint64_t cycles;
+    double p50Ms;
+    double p99Ms;
+    double maxMs;
+    double totalMs;
+  };
+
+  static constexpr size_t Capacity = 4096;
+
+  GCStats(void) = default;
+  GCStats(const GCStats&) = delete;
+  GCStats& operator=(const GCStats&) = delete;
+  // Uninstalls, if still installed, so the callbacks never outlive it.
+  ~GCStats(void) { uninstall(); }
+
+  bool install(JSContext* cx);
+  void uninstall(void);
+
+  std::vector<Slice> slices(void) const { return m_slices.snapshot(); }
+  Summary summarize(void) const;
+  std::string toJSON(void) const;
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  static void OnGCSlice(JSContext* cx, JS::GCProgress progress,
+                        const JS::GCDescription& desc);
+  static void OnGC(JSContext* cx, JSGCStatus status, void* data);
+
+  JSContext* m_cx = nullptr;
+  Clock::time_point m_installed;
+  Clock::time_point m_sliceStart;
+  bool m_sliceIsCycleStart = false;
+  bool m_sliceIsCycleEnd = false;
+  std::atomic<uint64_t> m_cycles{0};
+  JS::GCSliceCallback m_previousSliceCallback = nullptr;
+  RingBuffer<Slice, Capacity> m_slices;
+};
+
+}  // namespace boilerplate
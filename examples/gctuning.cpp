@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <jsapi.h>
+
+#include <js/CompilationAndEvaluation.h>
+#include <js/Initialization.h>
+#include <js/SourceText.h>
+
+#include "boilerplate.h"
+
+// This example runs an allocation-heavy script under a few different
+// boilerplate::RuntimeConfig settings and reports, for each one, how fast it
+// ran and how long the GC paused it.
+//
+// Besides the presets below, it also runs one "custom" config that is taken
+// from the BOILERPLATE_GC_* environment variables and --gc-*=N arguments, so
+// you can try out settings for your own workload, e.g.:
+//
+//   gctuning --gc-nursery-bytes=33554432 --gc-slice-ms=5
+
+static const char* allocatingProgram = R"js(
+  let retained = [];
+  for (let i = 0; i < 200000; i++) {
+    const obj = { index: i, name: 'item' + i, values: [i, i * 2, i * 3] };
+    if (i % 10 === 0) retained.push(obj);
+    if (retained.length > 5000) retained = [];
+  }
+  retained.length;
+)js";
+
+static constexpr unsigned numRuns = 10;
+
+using Clock = std::chrono::steady_clock;
+using Milliseconds = std::chrono::duration<double, std::milli>;
+
+// Pause times are measured from the start to the end of each GC slice, which
+// is the time the script is stopped for.
+static std::vector<double> slicePauses;
+static Clock::time_point sliceStart;
+
+static void OnGCSlice(JSContext* cx, JS::GCProgress progress,
+                      const JS::GCDescription& desc) {
+  if (progress == JS::GC_SLICE_BEGIN) {
+    sliceStart = Clock::now();
+  } else if (progress == JS::GC_SLICE_END) {
+    Milliseconds pause = Clock::now() - sliceStart;
+    slicePauses.push_back(pause.count());
+  }
+}
+
+static bool RunAllocatingProgram(JSContext* cx) {
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) return false;
+
+  JSAutoRealm ar(cx, global);
+
+  JS::CompileOptions options(cx);
+  options.setFileAndLine("allocate.js", 1);
+
+  for (unsigned run = 0; run < numRuns; run++) {
+    JS::SourceText<mozilla::Utf8Unit> source;
+    if (!source.init(cx, allocatingProgram, strlen(allocatingProgram),
+                     JS::SourceOwnership::Borrowed))
+      return false;
+
+    JS::RootedValue rval(cx);
+    if (!JS::Evaluate(cx, options, source, &rval)) return false;
+  }
+  return true;
+}
+
+static bool MeasureConfig(const char* name,
+                          const boilerplate::RuntimeConfig& config) {
+  JSContext* cx = boilerplate::CreateContext(config);
+  if (!cx) return false;
+
+  slicePauses.clear();
+  JS::SetGCSliceCallback(cx, OnGCSlice);
+
+  Clock::time_point start = Clock::now();
+  bool ok = RunAllocatingProgram(cx);
+  Milliseconds elapsed = Clock::now() - start;
+
+  JS_DestroyContext(cx);
+  if (!ok) return false;
+
+  std::sort(slicePauses.begin(), slicePauses.end());
+  double total = 0;
+  for (double pause : slicePauses) total += pause;
+  double p99 = slicePauses.empty()
+                   ? 0
+                   : slicePauses[(slicePauses.size() - 1) * 99 / 100];
+  double max = slicePauses.empty() ? 0 : slicePauses.back();
+
+  std::cout << name << ":\n"
+            << "  runs/s:      " << numRuns / (elapsed.count() / 1000) << '\n'
+            << "  GC slices:   " << slicePauses.size() << '\n'
+            << "  GC total:    " << total << " ms\n"
+            << "  p99 pause:   " << p99 << " ms\n"
+            << "  max pause:   " << max << " ms\n";
+  return true;
+}
+
+int main(int argc, const char* argv[]) {
+  boilerplate::RuntimeConfig custom;
+  if (!custom.readEnvironment() || !custom.parseArgs(argc, argv)) return 1;
+
+  boilerplate::RuntimeConfig smallNursery;
+  // The smallest nursery there can be: one 1 MB chunk.
+  smallNursery.maxNurseryBytes = mozilla::Some(1024u * 1024);
+
+  boilerplate::RuntimeConfig largeNursery;
+  largeNursery.maxNurseryBytes = mozilla::Some(64u * 1024 * 1024);
+
+  boilerplate::RuntimeConfig nonIncremental;
+  nonIncremental.incremental = mozilla::Some(0u);
+
+  boilerplate::RuntimeConfig shortSlices;
+  shortSlices.incremental = mozilla::Some(1u);
+  shortSlices.sliceBudgetMs = mozilla::Some(2u);
+
+  if (!JS_Init()) return 1;
+
+  bool ok = MeasureConfig("default", boilerplate::RuntimeConfig()) &&
+            MeasureConfig("1 MB nursery", smallNursery) &&
+            MeasureConfig("64 MB nursery", largeNursery) &&
+            MeasureConfig("non-incremental", nonIncremental) &&
+            MeasureConfig("incremental, 2 ms slices", shortSlices) &&
+            MeasureConfig("custom", custom);
+
+  JS_ShutDown();
+  return ok ? 0 : 1;
+}
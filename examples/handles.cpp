@@ -0,0 +1,139 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <jsapi.h>
+
+#include "boilerplate.h"
+#include "gcstats.h"
+#include "handletable.h"
+
+// This example compares two ways of keeping a large number of JS callbacks
+// alive from C++: one PersistentRooted per callback, and a
+// boilerplate::HandleTable. For each, it measures the time to root all the
+// callbacks, the GC pause while they're rooted, and the time to release them
+// again. For the HandleTable, it also measures filling the table a second
+// time, which reuses the free slots.
+//
+// The number of callbacks can be given as the first argument.
+
+static size_t numCallbacks = 200000;
+
+using Clock = std::chrono::steady_clock;
+using Milliseconds = std::chrono::duration<double, std::milli>;
+
+static bool Callback(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  args.rval().setUndefined();
+  return true;
+}
+
+static bool MakeCallback(JSContext* cx, JS::MutableHandleValue callback) {
+  JSFunction* fun = JS_NewFunction(cx, Callback, 0, 0, "callback");
+  if (!fun) return false;
+  callback.setObject(*JS_GetFunctionObject(fun));
+  return true;
+}
+
+static double GCPause(JSContext* cx) {
+  boilerplate::GCStats stats;
+  stats.install(cx);
+  JS_GC(cx);
+  stats.uninstall();
+  return stats.summarize().totalMs;
+}
+
+static void PrintRow(const char* what, Milliseconds add, double gc,
+                     Milliseconds remove) {
+  std::cout << what << "\t" << add.count() << " ms\t" << gc << " ms\t"
+            << remove.count() << " ms\n";
+}
+
+static bool PersistentRootedPerCallback(JSContext* cx) {
+  std::vector<std::unique_ptr<JS::PersistentRooted<JS::Value>>> roots;
+  roots.reserve(numCallbacks);
+
+  JS::RootedValue callback(cx);
+  Clock::time_point start = Clock::now();
+  for (size_t ix = 0; ix < numCallbacks; ix++) {
+    if (!MakeCallback(cx, &callback)) return false;
+    roots.emplace_back(new JS::PersistentRooted<JS::Value>(cx, callback));
+  }
+  Milliseconds add = Clock::now() - start;
+
+  double gc = GCPause(cx);
+
+  start = Clock::now();
+  roots.clear();
+  Milliseconds remove = Clock::now() - start;
+
+  PrintRow("PersistentRooted", add, gc, remove);
+  return true;
+}
+
+static bool FillTable(JSContext* cx, boilerplate::HandleTable& table,
+                      std::vector<boilerplate::HandleTable::Handle>* handles,
+                      Milliseconds* elapsed) {
+  JS::RootedValue callback(cx);
+  Clock::time_point start = Clock::now();
+  for (size_t ix = 0; ix < numCallbacks; ix++) {
+    if (!MakeCallback(cx, &callback)) return false;
+    boilerplate::HandleTable::Handle handle = table.add(callback);
+    if (handle == boilerplate::HandleTable::InvalidHandle) {
+      JS_ReportOutOfMemory(cx);
+      return false;
+    }
+    handles->push_back(handle);
+  }
+  *elapsed = Clock::now() - start;
+  return true;
+}
+
+static void EmptyTable(boilerplate::HandleTable& table,
+                       std::vector<boilerplate::HandleTable::Handle>* handles,
+                       Milliseconds* elapsed) {
+  Clock::time_point start = Clock::now();
+  for (boilerplate::HandleTable::Handle handle : *handles) table.remove(handle);
+  *elapsed = Clock::now() - start;
+  handles->clear();
+}
+
+static bool HandleTableForCallbacks(JSContext* cx) {
+  boilerplate::HandleTable table(cx);
+  std::vector<boilerplate::HandleTable::Handle> handles;
+  handles.reserve(numCallbacks);
+
+  Milliseconds add, remove;
+  if (!FillTable(cx, table, &handles, &add)) return false;
+  double gc = GCPause(cx);
+  EmptyTable(table, &handles, &remove);
+  PrintRow("HandleTable", add, gc, remove);
+
+  // The second time around, all slots come from the free list.
+  if (!FillTable(cx, table, &handles, &add)) return false;
+  gc = GCPause(cx);
+  EmptyTable(table, &handles, &remove);
+  PrintRow("HandleTable (reused)", add, gc, remove);
+
+  return true;
+}
+
+static bool HandlesExample(JSContext* cx) {
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) return false;
+
+  JSAutoRealm ar(cx, global);
+
+  std::cout << numCallbacks << " callbacks\n"
+            << "storage\troot\tGC while rooted\tunroot\n";
+  return PersistentRootedPerCallback(cx) && HandleTableForCallbacks(cx);
+}
+
+int main(int argc, const char* argv[]) {
+  if (argc > 1) numCallbacks = strtoul(argv[1], nullptr, 10);
+
+  if (!boilerplate::RunExample(HandlesExample)) return 1;
+  return 0;
+}
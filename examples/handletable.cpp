@@ -0,0 +1,85 @@
+#include <cassert>
+#include <new>
+
+#include <jsapi.h>
+
+#include <js/TracingAPI.h>
+
+#include "handletable.h"
+
+// A HandleTable keeps many JS values alive from C++ for a fraction of the cost
+// of giving each of them its own PersistentRooted.
+//
+// Every PersistentRooted is linked into the GC's list of roots when it is
+// created and unlinked when it is destroyed. With hundreds of thousands of
+// them, for example one per JS callback that C++ holds on to, creating and
+// destroying those roots becomes a measurable overhead, and the GC walks a
+// long linked list spread all over the heap. Instead, a HandleTable stores
+// the values as JS::Heap<JS::Value> in slabs of a few thousand slots each, and
+// traces all of them from a single JS_AddExtraGCRootsTracer() callback.
+//
+// add() returns a small integer handle, which stays valid until it is passed
+// to remove(). Removed slots go on a free list and are reused by later calls
+// to add(). Slabs are never moved or freed while the table is alive, so
+// adding values never has to move the existing ones (which would mean running
+// GC barriers for each of them).
+//
+// A HandleTable must be destroyed before its JSContext.
+
+boilerplate::HandleTable::HandleTable(JSContext* cx)
+    : m_cx(cx), m_used(0), m_live(0), m_freeList(InvalidHandle) {
+  JS_AddExtraGCRootsTracer(cx, &HandleTable::Trace, this);
+}
+
+boilerplate::HandleTable::~HandleTable(void) {
+  JS_RemoveExtraGCRootsTracer(m_cx, &HandleTable::Trace, this);
+}
+
+// Returns InvalidHandle if out of memory.
+boilerplate::HandleTable::Handle boilerplate::HandleTable::add(
+    const JS::Value& value) {
+  Handle handle = m_freeList;
+  if (handle != InvalidHandle) {
+    m_freeList = slot(handle).nextFree;
+  } else {
+    if (m_used == capacity()) {
+      std::unique_ptr<Slot[]> slab(new (std::nothrow) Slot[SlabSize]);
+      if (!slab) return InvalidHandle;
+      m_slabs.push_back(std::move(slab));
+    }
+    handle = Handle(++m_used);
+  }
+
+  Slot& s = slot(handle);
+  s.value = value;
+  s.nextFree = InvalidHandle;
+  m_live++;
+  return handle;
+}
+
+void boilerplate::HandleTable::remove(Handle handle) {
+  assert(handle != InvalidHandle && handle <= m_used);
+
+  // Free slots hold undefined, so that whatever they pointed to can be
+  // collected, and so that tracing them is harmless.
+  Slot& s = slot(handle);
+  s.value = JS::UndefinedValue();
+  s.nextFree = m_freeList;
+  m_freeList = handle;
+  m_live--;
+}
+
+void boilerplate::HandleTable::Trace(JSTracer* trc, void* data) {
+  auto* self = static_cast<HandleTable*>(data);
+
+  size_t remaining = self->m_used;
+  for (const std::unique_ptr<Slot[]>& slab : self->m_slabs) {
+    size_t count = remaining < SlabSize ? remaining : SlabSize;
+    for (size_t ix = 0; ix < count; ix++) {
+      JS::Heap<JS::Value>& value = slab[ix].value;
+      if (value.unbarrieredGet().isGCThing())
+        JS::TraceEdge(trc, &value, "HandleTable slot");
+    }
+    remaining -= count;
+  }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <jsapi.h>
+
+// See 'handletable.cpp' for documentation.
+
+namespace boilerplate {
+
+class HandleTable {
+ public:
+  using Handle = uint32_t;
+  static constexpr Handle InvalidHandle = 0;
+
+  explicit HandleTable(JSContext* cx);
+  ~HandleTable(void);
+
+  HandleTable(const HandleTable&) = delete;
+  HandleTable& operator=(const HandleTable&) = delete;
+
+  Handle add(const JS::Value& value);
+  void remove(Handle handle);
+
+  JS::Value get(Handle handle) const { return slot(handle).value; }
+  void set(Handle handle, const JS::Value& value) {
+    slot(handle).value = value;
+  }
+
+  size_t size(void) const { return m_live; }
+  size_t capacity(void) const { return m_slabs.size() * SlabSize; }
+
+ private:
+  static constexpr size_t SlabSize = 4096;
+
+  struct Slot {
+    JS::Heap<JS::Value> value;
+    Handle nextFree = InvalidHandle;
+  };
+
+  static void Trace(JSTracer* trc, void* data);
+
+  Slot& slot(Handle handle) const {
+    size_t index = handle - 1;
+    return m_slabs[index / SlabSize][index % SlabSize];
+  }
+
+  JSContext* m_cx;
+  std::vector<std::unique_ptr<Slot[]>> m_slabs;
+  size_t m_used;  // number of slots handed out at least once
+  size_t m_live;
+  Handle m_freeList;
+};
+
+}  // namespace boilerplate
@@ -0,0 +1,337 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "hash.h"
+
+// Plain C++ implementations of a few common hash functions, for hashing the
+// contents of JS strings and buffers from native code; see 'stringhash.cpp'.
+// They use no JSAPI, so they can run on any thread.
+//
+// - MD5 (RFC 1321) and SHA-256 (FIPS 180-4) are what other systems usually
+//   store as content hashes. MD5 is broken as a cryptographic hash and is
+//   only here to match existing checksums.
+// - xxHash64 is not cryptographic either, but is several times faster than
+//   both, and is the one to use for caches and change detection.
+//
+// Each of them can be fed the input in pieces with update(), of any size, and
+// gives the same result as hashing all of the input at once. finish() must
+// only be called once.
+
+static inline uint32_t RotateLeft32(uint32_t x, unsigned n) {
+  return (x << n) | (x >> (32 - n));
+}
+
+static inline uint32_t RotateRight32(uint32_t x, unsigned n) {
+  return (x >> n) | (x << (32 - n));
+}
+
+static inline uint64_t RotateLeft64(uint64_t x, unsigned n) {
+  return (x << n) | (x >> (64 - n));
+}
+
+static inline uint32_t ReadLE32(const uint8_t* p) {
+  return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 |
+         uint32_t(p[3]) << 24;
+}
+
+static inline uint64_t ReadLE64(const uint8_t* p) {
+  return uint64_t(ReadLE32(p)) | uint64_t(ReadLE32(p + 4)) << 32;
+}
+
+static inline uint32_t ReadBE32(const uint8_t* p) {
+  return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 |
+         uint32_t(p[3]);
+}
+
+static inline void WriteBE32(uint8_t* p, uint32_t x) {
+  p[0] = uint8_t(x >> 24);
+  p[1] = uint8_t(x >> 16);
+  p[2] = uint8_t(x >> 8);
+  p[3] = uint8_t(x);
+}
+
+// MD5 and SHA-256 share the same structure: 64-byte blocks, and a final
+// block padded with 0x80, zeros, and the message length in bits. Feeds
+// 'data' to 'block' one block at a time, keeping a partial block in
+// 'buffer'. 'total' is the number of bytes seen before this call.
+template <typename Block>
+static void UpdateBlocks(uint8_t buffer[64], uint64_t* total,
+                         const uint8_t* data, size_t length, Block block) {
+  size_t buffered = size_t(*total % 64);
+  *total += length;
+
+  if (buffered) {
+    size_t count = 64 - buffered < length ? 64 - buffered : length;
+    memcpy(buffer + buffered, data, count);
+    data += count;
+    length -= count;
+    if (buffered + count < 64) return;
+    block(buffer);
+  }
+  for (; length >= 64; data += 64, length -= 64) block(data);
+  memcpy(buffer, data, length);
+}
+
+///// MD5 /////////////////////////////////////////////////////////////////////
+
+static const uint32_t Md5K[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a,
+    0xa8304613, 0xfd469501, 0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+    0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821, 0xf61e2562, 0xc040b340,
+    0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8,
+    0x676f02d9, 0x8d2a4c8a, 0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+    0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70, 0x289b7ec6, 0xeaa127fa,
+    0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92,
+    0xffeff47d, 0x85845dd1, 0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+    0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+};
+
+static const unsigned Md5Shifts[16] = {7, 12, 17, 22, 5, 9,  14, 20,
+                                       4, 11, 16, 23, 6, 10, 15, 21};
+
+boilerplate::Md5::Md5(void)
+    : m_state{0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476}, m_length(0) {}
+
+void boilerplate::Md5::block(const uint8_t* data) {
+  uint32_t m[16];
+  for (unsigned ix = 0; ix < 16; ix++) m[ix] = ReadLE32(data + 4 * ix);
+
+  uint32_t a = m_state[0], b = m_state[1], c = m_state[2], d = m_state[3];
+  for (unsigned ix = 0; ix < 64; ix++) {
+    uint32_t f;
+    unsigned g;
+    switch (ix / 16) {
+      case 0:
+        f = (b & c) | (~b & d);
+        g = ix;
+        break;
+      case 1:
+        f = (d & b) | (~d & c);
+        g = (5 * ix + 1) % 16;
+        break;
+      case 2:
+        f = b ^ c ^ d;
+        g = (3 * ix + 5) % 16;
+        break;
+      default:
+        f = c ^ (b | ~d);
+        g = (7 * ix) % 16;
+        break;
+    }
+    uint32_t next = d;
+    d = c;
+    c = b;
+    b += RotateLeft32(a + f + Md5K[ix] + m[g], Md5Shifts[ix / 16 * 4 + ix % 4]);
+    a = next;
+  }
+  m_state[0] += a;
+  m_state[1] += b;
+  m_state[2] += c;
+  m_state[3] += d;
+}
+
+void boilerplate::Md5::update(const void* data, size_t length) {
+  UpdateBlocks(m_buffer, &m_length, static_cast<const uint8_t*>(data), length,
+               [this](const uint8_t* block) { this->block(block); });
+}
+
+void boilerplate::Md5::finish(uint8_t digest[DigestLength]) {
+  uint64_t bits = m_length * 8;
+  uint8_t padding[72] = {0x80};
+  size_t padLength = 64 - size_t((m_length + 8) % 64);
+  for (unsigned ix = 0; ix < 8; ix++)
+    padding[padLength + ix] = uint8_t(bits >> (8 * ix));
+  update(padding, padLength + 8);
+
+  for (unsigned ix = 0; ix < 4; ix++) {
+    for (unsigned byte = 0; byte < 4; byte++)
+      digest[4 * ix + byte] = uint8_t(m_state[ix] >> (8 * byte));
+  }
+}
+
+///// SHA-256 /////////////////////////////////////////////////////////////////
+
+static const uint32_t Sha256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+boilerplate::Sha256::Sha256(void)
+    : m_state{0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f,
+              0x9b05688c, 0x1f83d9ab, 0x5be0cd19},
+      m_length(0) {}
+
+void boilerplate::Sha256::block(const uint8_t* data) {
+  uint32_t w[64];
+  for (unsigned ix = 0; ix < 16; ix++) w[ix] = ReadBE32(data + 4 * ix);
+  for (unsigned ix = 16; ix < 64; ix++) {
+    uint32_t s0 = RotateRight32(w[ix - 15], 7) ^
+                  RotateRight32(w[ix - 15], 18) ^ (w[ix - 15] >> 3);
+    uint32_t s1 = RotateRight32(w[ix - 2], 17) ^
+                  RotateRight32(w[ix - 2], 19) ^ (w[ix - 2] >> 10);
+    w[ix] = w[ix - 16] + s0 + w[ix - 7] + s1;
+  }
+
+  uint32_t a = m_state[0], b = m_state[1], c = m_state[2], d = m_state[3];
+  uint32_t e = m_state[4], f = m_state[5], g = m_state[6], h = m_state[7];
+  for (unsigned ix = 0; ix < 64; ix++) {
+    uint32_t s1 = RotateRight32(e, 6) ^ RotateRight32(e, 11) ^
+                  RotateRight32(e, 25);
+    uint32_t choice = (e & f) ^ (~e & g);
+    uint32_t t1 = h + s1 + choice + Sha256K[ix] + w[ix];
+    uint32_t s0 = RotateRight32(a, 2) ^ RotateRight32(a, 13) ^
+                  RotateRight32(a, 22);
+    uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+    uint32_t t2 = s0 + majority;
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+  m_state[0] += a;
+  m_state[1] += b;
+  m_state[2] += c;
+  m_state[3] += d;
+  m_state[4] += e;
+  m_state[5] += f;
+  m_state[6] += g;
+  m_state[7] += h;
+}
+
+void boilerplate::Sha256::update(const void* data, size_t length) {
+  UpdateBlocks(m_buffer, &m_length, static_cast<const uint8_t*>(data), length,
+               [this](const uint8_t* block) { this->block(block); });
+}
+
+void boilerplate::Sha256::finish(uint8_t digest[DigestLength]) {
+  uint64_t bits = m_length * 8;
+  uint8_t padding[72] = {0x80};
+  size_t padLength = 64 - size_t((m_length + 8) % 64);
+  for (unsigned ix = 0; ix < 8; ix++)
+    padding[padLength + ix] = uint8_t(bits >> (56 - 8 * ix));
+  update(padding, padLength + 8);
+
+  for (unsigned ix = 0; ix < 8; ix++) WriteBE32(digest + 4 * ix, m_state[ix]);
+}
+
+///// xxHash64 ////////////////////////////////////////////////////////////////
+
+// From the xxHash specification,
+// https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+static constexpr uint64_t Prime1 = 0x9E3779B185EBCA87ull;
+static constexpr uint64_t Prime2 = 0xC2B2AE3D27D4EB4Full;
+static constexpr uint64_t Prime3 = 0x165667B19E3779F9ull;
+static constexpr uint64_t Prime4 = 0x85EBCA77C2B2AE63ull;
+static constexpr uint64_t Prime5 = 0x27D4EB2F165667C5ull;
+
+static inline uint64_t XxRound(uint64_t accumulator, uint64_t lane) {
+  accumulator += lane * Prime2;
+  return RotateLeft64(accumulator, 31) * Prime1;
+}
+
+static inline uint64_t XxMerge(uint64_t hash, uint64_t accumulator) {
+  hash ^= XxRound(0, accumulator);
+  return hash * Prime1 + Prime4;
+}
+
+boilerplate::XxHash64::XxHash64(uint64_t seed)
+    : m_seed(seed),
+      m_accumulators{seed + Prime1 + Prime2, seed + Prime2, seed,
+                     seed - Prime1},
+      m_length(0) {}
+
+void boilerplate::XxHash64::update(const void* data, size_t length) {
+  auto* bytes = static_cast<const uint8_t*>(data);
+  size_t buffered = size_t(m_length % 32);
+  m_length += length;
+
+  auto stripe = [this](const uint8_t* p) {
+    for (unsigned ix = 0; ix < 4; ix++)
+      m_accumulators[ix] = XxRound(m_accumulators[ix], ReadLE64(p + 8 * ix));
+  };
+
+  if (buffered) {
+    size_t count = 32 - buffered < length ? 32 - buffered : length;
+    memcpy(m_buffer + buffered, bytes, count);
+    bytes += count;
+    length -= count;
+    if (buffered + count < 32) return;
+    stripe(m_buffer);
+  }
+  for (; length >= 32; bytes += 32, length -= 32) stripe(bytes);
+  memcpy(m_buffer, bytes, length);
+}
+
+uint64_t boilerplate::XxHash64::finish(void) const {
+  uint64_t hash;
+  if (m_length >= 32) {
+    const uint64_t* acc = m_accumulators;
+    hash = RotateLeft64(acc[0], 1) + RotateLeft64(acc[1], 7) +
+           RotateLeft64(acc[2], 12) + RotateLeft64(acc[3], 18);
+    for (unsigned ix = 0; ix < 4; ix++) hash = XxMerge(hash, acc[ix]);
+  } else {
+    hash = m_seed + Prime5;
+  }
+  hash += m_length;
+
+  const uint8_t* p = m_buffer;
+  size_t remaining = size_t(m_length % 32);
+  for (; remaining >= 8; p += 8, remaining -= 8) {
+    hash ^= XxRound(0, ReadLE64(p));
+    hash = RotateLeft64(hash, 27) * Prime1 + Prime4;
+  }
+  if (remaining >= 4) {
+    hash ^= uint64_t(ReadLE32(p)) * Prime1;
+    hash = RotateLeft64(hash, 23) * Prime2 + Prime3;
+    p += 4;
+    remaining -= 4;
+  }
+  for (; remaining > 0; p++, remaining--) {
+    hash ^= *p * Prime5;
+    hash = RotateLeft64(hash, 11) * Prime1;
+  }
+
+  hash ^= hash >> 33;
+  hash *= Prime2;
+  hash ^= hash >> 29;
+  hash *= Prime3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+void boilerplate::XxHash64::finish(uint8_t digest[DigestLength]) const {
+  uint64_t hash = finish();
+  for (unsigned ix = 0; ix < 8; ix++)
+    digest[ix] = uint8_t(hash >> (56 - 8 * ix));
+}
+
+std::string boilerplate::HexDigest(const uint8_t* digest, size_t length) {
+  static const char hexDigits[] = "0123456789abcdef";
+  std::string hex(2 * length, '\0');
+  for (size_t ix = 0; ix < length; ix++) {
+    hex[2 * ix] = hexDigits[digest[ix] >> 4];
+    hex[2 * ix + 1] = hexDigits[digest[ix] & 0xF];
+  }
+  return hex;
+}
+
+constexpr size_t boilerplate::Md5::DigestLength;
+constexpr size_t boilerplate::Sha256::DigestLength;
+constexpr size_t boilerplate::XxHash64::DigestLength;
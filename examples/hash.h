@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// See 'hash.cpp' for documentation.
+
+namespace boilerplate {
+
+class Md5 {
+ public:
+  static constexpr size_t DigestLength = 16;
+
+  Md5(void);
+  void update(const void* data, size_t length);
+  void finish(uint8_t digest[DigestLength]);
+
+ private:
+  void block(const uint8_t* data);
+
+  uint32_t m_state[4];
+  uint64_t m_length;
+  uint8_t m_buffer[64];
+};
+
+class Sha256 {
+ public:
+  static constexpr size_t DigestLength = 32;
+
+  Sha256(void);
+  void update(const void* data, size_t length);
+  void finish(uint8_t digest[DigestLength]);
+
+ private:
+  void block(const uint8_t* data);
+
+  uint32_t m_state[8];
+  uint64_t m_length;
+  uint8_t m_buffer[64];
+};
+
+class XxHash64 {
+ public:
+  static constexpr size_t DigestLength = 8;
+
+  explicit XxHash64(uint64_t seed = 0);
+  void update(const void* data, size_t length);
+  uint64_t finish(void) const;
+  // The hash in big-endian order, as xxhsum prints it.
+  void finish(uint8_t digest[DigestLength]) const;
+
+ private:
+  uint64_t m_seed;
+  uint64_t m_accumulators[4];
+  uint64_t m_length;
+  uint8_t m_buffer[32];
+};
+
+// Lowercase hexadecimal, as md5sum and sha256sum print digests.
+std::string HexDigest(const uint8_t* digest, size_t length);
+
+}  // namespace boilerplate
@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <jsapi.h>
+
+#include <js/CompilationAndEvaluation.h>
+#include <js/SourceText.h>
+
+#include "boilerplate.h"
+#include "hash.h"
+#include "stringhash.h"
+
+// This example checks and measures the hashing extension in 'stringhash.cpp'
+// and the hash functions in 'hash.cpp'.
+//
+// It first checks the hash functions against published test vectors, and
+// checks that hashing a JS string in place gives the same digest as hashing
+// its UTF-8 encoding. Then it prints the throughput, in MB of UTF-8 per
+// second:
+//
+// - of each hash function over a plain C++ buffer, for reference;
+// - of hashing JS strings of various kinds in place, compared with encoding
+//   them with JS_EncodeStringToUTF8() and hashing the copy;
+// - of hashing a rope the first time (which flattens it), again, and again
+//   with a StringHashCache.
+//
+// Finally it runs a script that uses the streaming Hash class.
+//
+// The size of the strings, in millions of characters, can be given as an
+// argument.
+
+static unsigned megachars = 16;
+static constexpr unsigned iterations = 5;
+
+using Clock = std::chrono::steady_clock;
+using Seconds = std::chrono::duration<double>;
+
+static const struct {
+  const char* name;
+  boilerplate::HashAlgorithm algorithm;
+} algorithms[] = {
+    {"md5", boilerplate::HashAlgorithm::Md5},
+    {"sha256", boilerplate::HashAlgorithm::Sha256},
+    {"xxh64", boilerplate::HashAlgorithm::XxHash64},
+};
+
+static const struct {
+  const char* input;
+  const char* md5;
+  const char* sha256;
+  const char* xxh64;
+} testVectors[] = {
+    {"", "d41d8cd98f00b204e9800998ecf8427e",
+     "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855",
+     "ef46db3751d8e999"},
+    {"abc", "900150983cd24fb0d6963f7d28e17f72",
+     "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",
+     "44bc2cf5ad770999"},
+    {"The quick brown fox jumps over the lazy dog",
+     "9e107d9d372bb6826bd81d3542a419d6",
+     "d7a8fbb307d7809469ca9abcb0082e4f8d5651e46d3cdb762d02d0bf37c9e592",
+     "0b242d361fda71bc"},
+};
+
+static const struct {
+  const char* name;
+  const char* code;  // 'n' is the number of characters
+} strings[] = {
+    {"ASCII", "'x'.repeat(n)"},
+    {"Latin-1", "'caf\\u00e9 '.repeat(n / 5)"},
+    {"two-byte, mostly ASCII", "'\\u20ac' + 'x'.repeat(n - 1)"},
+    {"two-byte, CJK", "'\\u65e5\\u672c\\u8a9e'.repeat(n / 3)"},
+    {"two-byte, emoji", "'\\ud83d\\ude00 '.repeat(n / 3)"},
+};
+
+static const char* streamingScript = R"js(
+  const text = 'Grüße, 世界! '.repeat(100000);
+  const h = new Hash('sha256');
+  for (let ix = 0; ix < text.length; ix += 4096)
+    h.update(text.slice(ix, ix + 4096));
+  const bytes = new Uint8Array([1, 2, 3]);
+  `${h.digest() === hash(text) ? 'same' : 'different'} digest in pieces, ` +
+  `bytes: ${new Hash('md5').update(bytes).update(bytes.buffer).digest()}`;
+)js";
+
+static bool Evaluate(JSContext* cx, const char* code,
+                     JS::MutableHandleValue rval) {
+  JS::CompileOptions options(cx);
+  options.setFileAndLine("hashing", 1);
+  JS::SourceText<mozilla::Utf8Unit> source;
+  return source.init(cx, code, strlen(code), JS::SourceOwnership::Borrowed) &&
+         JS::Evaluate(cx, options, source, rval);
+}
+
+// Runs 'hash' a number of times and returns the best time, in seconds.
+template <typename F>
+static bool Measure(F hash, double* best) {
+  *best = 1e9;
+  for (unsigned ix = 0; ix < iterations; ix++) {
+    Clock::time_point start = Clock::now();
+    if (!hash()) return false;
+    Seconds elapsed = Clock::now() - start;
+    *best = std::min(*best, elapsed.count());
+  }
+  return true;
+}
+
+static std::string HashBytes(boilerplate::HashAlgorithm algorithm,
+                             const char* data, size_t length) {
+  boilerplate::StringHasher hasher(algorithm);
+  hasher.update(data, length);
+  return hasher.hexDigest();
+}
+
+static bool HashEncoded(JSContext* cx, JS::HandleString str,
+                        boilerplate::HashAlgorithm algorithm,
+                        std::string* digest, size_t* utf8Length = nullptr) {
+  JS::UniqueChars utf8 = JS_EncodeStringToUTF8(cx, str);
+  if (!utf8) return false;
+  size_t length = strlen(utf8.get());
+  *digest = HashBytes(algorithm, utf8.get(), length);
+  if (utf8Length) *utf8Length = length;
+  return true;
+}
+
+static bool CheckTestVectors(void) {
+  for (const auto& vector : testVectors) {
+    size_t length = strlen(vector.input);
+    const char* expected[] = {vector.md5, vector.sha256, vector.xxh64};
+    for (size_t ix = 0; ix < 3; ix++) {
+      std::string digest =
+          HashBytes(algorithms[ix].algorithm, vector.input, length);
+      // Byte by byte must give the same result.
+      boilerplate::StringHasher pieces(algorithms[ix].algorithm);
+      for (size_t pos = 0; pos < length; pos++)
+        pieces.update(vector.input + pos, 1);
+      if (digest != expected[ix] || pieces.hexDigest() != expected[ix]) {
+        std::cerr << algorithms[ix].name << "('" << vector.input
+                  << "') is " << digest << ", expected " << expected[ix]
+                  << '\n';
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static bool HashingExample(JSContext* cx) {
+  if (!CheckTestVectors()) return false;
+  std::cout << "test vectors OK\n\n";
+
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) return false;
+  JSAutoRealm ar(cx, global);
+  if (!boilerplate::DefineHashFunctions(cx, global)) return false;
+
+  size_t n = megachars * 1000000;
+  std::string setup = "var n = " + std::to_string(n) + ";";
+  JS::RootedValue value(cx);
+  if (!Evaluate(cx, setup.c_str(), &value)) return false;
+
+  std::cout << "C++ buffer of " << megachars << " MB, MB/s\n";
+  std::vector<char> buffer(n, 'x');
+  for (const auto& algorithm : algorithms) {
+    double best;
+    if (!Measure(
+            [&]() {
+              HashBytes(algorithm.algorithm, buffer.data(), buffer.size());
+              return true;
+            },
+            &best))
+      return false;
+    std::cout << algorithm.name << '\t' << n / best / 1e6 << '\n';
+  }
+
+  std::cout << "\nstring\talgorithm\tencode\tin place (MB/s)\n";
+  JS::RootedString str(cx);
+  for (const auto& string : strings) {
+    if (!Evaluate(cx, string.code, &value)) return false;
+    str = value.toString();
+    for (const auto& algorithm : algorithms) {
+      std::string encoded, inPlace;
+      size_t utf8Length;
+      double encode, direct;
+      if (!Measure(
+              [&]() {
+                return HashEncoded(cx, str, algorithm.algorithm, &encoded,
+                                   &utf8Length);
+              },
+              &encode) ||
+          !Measure(
+              [&]() {
+                boilerplate::StringHasher hasher(algorithm.algorithm);
+                if (!hasher.update(cx, str)) return false;
+                inPlace = hasher.hexDigest();
+                return true;
+              },
+              &direct))
+        return false;
+      if (encoded != inPlace) {
+        std::cerr << string.name << ": digests differ\n";
+        return false;
+      }
+      std::cout << string.name << '\t' << algorithm.name << '\t'
+                << utf8Length / encode / 1e6 << '\t'
+                << utf8Length / direct / 1e6 << '\n';
+    }
+  }
+
+  // A rope of many pieces, as built up by a loop of concatenations. Timed
+  // once each, since the first hash changes the string.
+  if (!Evaluate(cx,
+                "let s = ''; for (let i = 0; i < n / 64; i++) "
+                "s += 'x'.repeat(63) + i % 10; s",
+                &value))
+    return false;
+  str = value.toString();
+  std::string digest;
+  auto timeOnce = [&](const char* what) {
+    Clock::time_point start = Clock::now();
+    if (!boilerplate::HashString(cx, str, boilerplate::HashAlgorithm::XxHash64,
+                                 &digest))
+      return false;
+    Seconds elapsed = Clock::now() - start;
+    std::cout << what << '\t' << elapsed.count() * 1e3 << " ms\n";
+    return true;
+  };
+  std::cout << "\nrope, xxh64\n";
+  if (!timeOnce("first (flattens)") || !timeOnce("second")) return false;
+  {
+    boilerplate::StringHashCache cache(cx);
+    if (!timeOnce("cache miss") || !timeOnce("cache hit")) return false;
+    JS_GC(cx);  // the string is still alive, and may have moved
+    if (!timeOnce("after GC")) return false;
+    std::cout << cache.hits() << " hits, " << cache.misses() << " misses\n";
+  }
+
+  if (!Evaluate(cx, streamingScript, &value)) return false;
+  str = value.toString();
+  JS::UniqueChars result = JS_EncodeStringToUTF8(cx, str);
+  if (!result) return false;
+  std::cout << '\n' << result.get() << '\n';
+  return true;
+}
+
+int main(int argc, const char* argv[]) {
+  if (argc > 1) megachars = std::max(atoi(argv[1]), 1);
+
+  if (!boilerplate::RunExample(HashingExample)) return 1;
+  return 0;
+}
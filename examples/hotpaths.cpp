@@ -0,0 +1,453 @@
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <jsapi.h>
+#include <jsfriendapi.h>
+
+#include <js/CompilationAndEvaluation.h>
+#include <js/GCAPI.h>
+#include <js/Initialization.h>
+#include <js/SourceText.h>
+
+#include "bench.h"
+#include "boilerplate.h"
+#include "crc32.h"
+#include "handletable.h"
+#include "lazyproperties.h"
+#include "scriptcache.h"
+
+// This is the benchmark suite for the embedding's hot paths, built as the
+// 'bench' target and run by 'meson test --benchmark'. Run it before and after
+// upgrading SpiderMonkey, with --json, and compare the reports to catch
+// regressions. See 'bench.cpp' for how the numbers are measured, and for the
+// arguments that control it.
+//
+// It covers the operations that the other examples show:
+//
+// - creating a context and a global (startup.cpp, boilerplate.cpp)
+// - evaluating source each time, versus running a cached script (cached.cpp)
+// - calling a native function from JS, and a JS function from C++
+//   (cookbook.cpp's ReturnInteger)
+// - getting and setting properties from C++ (cookbook.cpp's GetProperty and
+//   SetProperty)
+// - creating and using objects of a class with lazily resolved properties
+//   (resolve.cpp's Crc)
+// - rooting GC things in the various ways (tracing.cpp, handles.cpp)
+// - allocating objects, and full and incremental GCs
+
+static bool Evaluate(JSContext* cx, const char* code,
+                     JS::MutableHandleValue rval) {
+  JS::CompileOptions options(cx);
+  options.setFileAndLine("bench", 1);
+  JS::SourceText<mozilla::Utf8Unit> source;
+  return source.init(cx, code, strlen(code), JS::SourceOwnership::Borrowed) &&
+         JS::Evaluate(cx, options, source, rval);
+}
+
+// Calls the global function 'name' with the number of iterations.
+static bool CallLoop(JSContext* cx, const char* name, size_t iterations) {
+  JS::RootedObject global(cx, JS::CurrentGlobalOrNull(cx));
+  JS::RootedValueArray<1> args(cx);
+  args[0].setNumber(double(iterations));
+  JS::RootedValue rval(cx);
+  return JS_CallFunctionName(cx, global, name, args, &rval);
+}
+
+////////////////////////////////////////////////////////////
+
+static bool ReturnInteger(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  args.rval().setInt32(23);
+  return true;
+}
+
+// A class of the same shape as resolve.cpp's Crc: its methods and properties
+// are resolved lazily on the prototype by boilerplate::LazyProperties, and
+// each instance keeps its checksum in a reserved slot.
+class Crc {
+  static constexpr uint32_t LazyIdsSlot = 0;
+  static constexpr uint32_t ChecksumSlot = 1;
+
+  static bool constructor(JSContext* cx, unsigned argc, JS::Value* vp) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    JS::RootedObject obj(cx,
+                         JS_NewObjectForConstructor(cx, &Crc::klass, args));
+    if (!obj) return false;
+    JS_SetReservedSlot(obj, ChecksumSlot, JS::PrivateUint32Value(0));
+    args.rval().setObject(*obj);
+    return true;
+  }
+
+  static JSObject* instance(JSContext* cx, const JS::CallArgs& args) {
+    JSObject* obj =
+        args.thisv().isObject() ? &args.thisv().toObject() : nullptr;
+    if (!obj || JS_GetClass(obj) != &Crc::klass ||
+        JS_GetReservedSlot(obj, ChecksumSlot).isUndefined()) {
+      JS_ReportErrorASCII(cx, "not a Crc");
+      return nullptr;
+    }
+    return obj;
+  }
+
+  static bool update(JSContext* cx, unsigned argc, JS::Value* vp) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    JS::RootedObject obj(cx, instance(cx, args));
+    if (!obj) return false;
+
+    bool ok = false;
+    if (args.get(0).isObject()) {
+      JS::AutoCheckCannotGC nogc;
+      JSObject* view = js::UnwrapArrayBufferView(&args[0].toObject());
+      if (view) {
+        bool isShared;
+        auto* data = static_cast<uint8_t*>(
+            JS_GetArrayBufferViewData(view, &isShared, nogc));
+        uint32_t crc =
+            JS_GetReservedSlot(obj, ChecksumSlot).toPrivateUint32();
+        crc = Crc32Update(crc, data, JS_GetArrayBufferViewByteLength(view));
+        JS_SetReservedSlot(obj, ChecksumSlot, JS::PrivateUint32Value(crc));
+        ok = true;
+      }
+    }
+    if (!ok) {
+      JS_ReportErrorASCII(cx, "update() takes a typed array or DataView");
+      return false;
+    }
+    args.rval().setUndefined();
+    return true;
+  }
+
+  static bool getChecksum(JSContext* cx, unsigned argc, JS::Value* vp) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    JSObject* obj = instance(cx, args);
+    if (!obj) return false;
+    args.rval().setNumber(
+        JS_GetReservedSlot(obj, ChecksumSlot).toPrivateUint32());
+    return true;
+  }
+
+  static const JSFunctionSpec methods[];
+  static const JSPropertySpec properties[];
+  static const boilerplate::LazyProperties lazy;
+
+  static bool newEnumerate(JSContext* cx, JS::HandleObject obj,
+                           JS::MutableHandleIdVector properties,
+                           bool enumerableOnly) {
+    return lazy.newEnumerate(cx, obj, properties, enumerableOnly);
+  }
+  static bool resolve(JSContext* cx, JS::HandleObject obj, JS::HandleId id,
+                      bool* resolved) {
+    return lazy.resolve(cx, obj, id, resolved);
+  }
+  static bool mayResolve(const JSAtomState& names, jsid id,
+                         JSObject* maybeObj) {
+    return lazy.mayResolve(id);
+  }
+
+  static constexpr JSClassOps classOps = {
+      nullptr,  // addProperty
+      nullptr,  // deleteProperty
+      nullptr,  // enumerate
+      &Crc::newEnumerate,
+      &Crc::resolve,
+      &Crc::mayResolve,
+  };
+  static constexpr JSClass klass = {"Crc", JSCLASS_HAS_RESERVED_SLOTS(2),
+                                    &Crc::classOps};
+
+ public:
+  static bool DefinePrototype(JSContext* cx, JS::HandleObject global) {
+    JS::RootedObject proto(
+        cx, JS_InitClass(cx, global, nullptr, &Crc::klass, &Crc::constructor,
+                         0, nullptr, nullptr, nullptr, nullptr));
+    return proto && lazy.attach(cx, proto);
+  }
+};
+constexpr JSClassOps Crc::classOps;
+constexpr JSClass Crc::klass;
+constexpr uint32_t Crc::LazyIdsSlot;
+constexpr uint32_t Crc::ChecksumSlot;
+
+const JSFunctionSpec Crc::methods[] = {
+    JS_FN("update", &Crc::update, 1, JSPROP_ENUMERATE), JS_FS_END};
+const JSPropertySpec Crc::properties[] = {
+    JS_PSG("checksum", &Crc::getChecksum, JSPROP_ENUMERATE), JS_PS_END};
+const boilerplate::LazyProperties Crc::lazy(Crc::methods, Crc::properties,
+                                            Crc::LazyIdsSlot);
+
+static const JSFunctionSpec benchFunctions[] = {
+    JS_FN("returnInteger", ReturnInteger, 0, 0), JS_FS_END};
+
+// The JS side of the benchmarks. Each function takes the number of
+// iterations.
+static const char* benchScript = R"js(
+  function callNative(n) {
+    for (let i = 0; i < n; i++) returnInteger();
+  }
+  function emptyFunction() {}
+  function useCrc(n) {
+    const data = new Uint8Array(64);
+    for (let i = 0; i < n; i++) {
+      const crc = new Crc();
+      crc.update(data);
+      crc.checksum;
+    }
+  }
+  function allocate(n) {
+    let keep;
+    for (let i = 0; i < n; i++) keep = {i, next: keep && keep.next};
+  }
+  var heap = [];
+  for (let i = 0; i < 100000; i++) heap.push({i, name: 'object ' + i});
+)js";
+
+// In a block, so that running it again doesn't redeclare 'a' globally.
+static const char* smallScript = "{ let a = [1, 2, 3]; a.map(x => x * 2)[2]; }";
+
+////////////////////////////////////////////////////////////
+
+static bool RunStartupBenchmarks(JSContext* cx,
+                                 boilerplate::BenchRunner& runner) {
+  // Only one context may exist per thread, so new contexts are created on
+  // another one. Each repetition includes starting one thread.
+  return runner.run(
+             "startup/context (new thread)",
+             [](size_t iterations) {
+               bool ok = true;
+               std::thread thread([iterations, &ok]() {
+                 for (size_t ix = 0; ix < iterations && ok; ix++) {
+                   JSContext* cx =
+                       boilerplate::CreateContext(boilerplate::RuntimeConfig());
+                   if (!cx) {
+                     ok = false;
+                     break;
+                   }
+                   JS_DestroyContext(cx);
+                 }
+               });
+               thread.join();
+               return ok;
+             }) &&
+         runner.run("startup/CreateGlobal", [cx](size_t iterations) {
+           JS::RootedObject global(cx);
+           for (size_t ix = 0; ix < iterations; ix++) {
+             global = boilerplate::CreateGlobal(cx);
+             if (!global) return false;
+           }
+           return true;
+         });
+}
+
+static bool RunEvaluateBenchmarks(JSContext* cx,
+                                  boilerplate::BenchRunner& runner) {
+  JS::RootedObject global(cx, JS::CurrentGlobalOrNull(cx));
+  auto cache = std::make_shared<boilerplate::ScriptCache>(cx, global);
+  size_t length = strlen(smallScript);
+
+  return runner.run("evaluate/JS::Evaluate",
+                    [cx](size_t iterations) {
+                      JS::RootedValue rval(cx);
+                      for (size_t ix = 0; ix < iterations; ix++) {
+                        if (!Evaluate(cx, smallScript, &rval)) return false;
+                      }
+                      return true;
+                    }) &&
+         runner.run("evaluate/ScriptCache", [cx, cache, length](size_t n) {
+           JS::CompileOptions options(cx);
+           options.setFileAndLine("bench-cached", 1);
+           JS::RootedScript script(cx);
+           if (!cache->getOrCompile(cx, options, smallScript, length, &script))
+             return false;
+           JS::RootedValue rval(cx);
+           for (size_t ix = 0; ix < n; ix++) {
+             if (!cache->evaluate(cx, options, smallScript, length, &rval))
+               return false;
+           }
+           return true;
+         });
+}
+
+static bool RunCallBenchmarks(JSContext* cx, boilerplate::BenchRunner& runner) {
+  return runner.run("call/native from JS",
+                    [cx](size_t n) { return CallLoop(cx, "callNative", n); }) &&
+         runner.run("call/JS from C++", [cx](size_t iterations) {
+           JS::RootedObject global(cx, JS::CurrentGlobalOrNull(cx));
+           JS::RootedValue rval(cx);
+           for (size_t ix = 0; ix < iterations; ix++) {
+             if (!JS_CallFunctionName(cx, global, "emptyFunction",
+                                      JS::HandleValueArray::empty(), &rval))
+               return false;
+           }
+           return true;
+         });
+}
+
+static bool RunPropertyBenchmarks(JSContext* cx,
+                                  boilerplate::BenchRunner& runner) {
+  auto obj = std::make_shared<JS::PersistentRootedObject>(
+      cx, JS_NewPlainObject(cx));
+  if (!*obj) return false;
+
+  return runner.run("property/JS_SetProperty",
+                    [cx, obj](size_t iterations) {
+                      JS::RootedObject target(cx, *obj);
+                      JS::RootedValue value(cx);
+                      for (size_t ix = 0; ix < iterations; ix++) {
+                        value.setInt32(int32_t(ix));
+                        if (!JS_SetProperty(cx, target, "myprop", value))
+                          return false;
+                      }
+                      return true;
+                    }) &&
+         runner.run("property/JS_GetProperty", [cx, obj](size_t iterations) {
+           JS::RootedObject target(cx, *obj);
+           JS::RootedValue value(cx);
+           for (size_t ix = 0; ix < iterations; ix++) {
+             if (!JS_GetProperty(cx, target, "myprop", &value)) return false;
+           }
+           return true;
+         });
+}
+
+static bool RunResolveBenchmarks(JSContext* cx,
+                                 boilerplate::BenchRunner& runner) {
+  return runner.run("resolve/Crc new+update+checksum",
+                    [cx](size_t n) { return CallLoop(cx, "useCrc", n); }) &&
+         runner.run("resolve/first lookup in a new global",
+                    [cx](size_t iterations) {
+                      JS::RootedObject global(cx);
+                      JS::RootedValue rval(cx);
+                      for (size_t ix = 0; ix < iterations; ix++) {
+                        global = boilerplate::CreateGlobal(cx);
+                        if (!global) return false;
+                        JSAutoRealm ar(cx, global);
+                        if (!Crc::DefinePrototype(cx, global) ||
+                            !Evaluate(cx, "Crc.prototype.update", &rval))
+                          return false;
+                      }
+                      return true;
+                    });
+}
+
+// A C++ structure holding GC things, traced from an extra roots tracer, as in
+// tracing.cpp.
+struct TracedValues {
+  std::vector<JS::Heap<JS::Value>> values;
+
+  static void Trace(JSTracer* trc, void* data) {
+    for (auto& value : static_cast<TracedValues*>(data)->values)
+      JS::TraceEdge(trc, &value, "bench value");
+  }
+};
+
+static bool RunRootingBenchmarks(JSContext* cx,
+                                 boilerplate::BenchRunner& runner) {
+  JS::RootedObject obj(cx, JS_NewPlainObject(cx));
+  if (!obj) return false;
+  JS::HandleObject target = obj;  // stays valid even if the GC moves obj
+
+  auto table = std::make_shared<boilerplate::HandleTable>(cx);
+  auto traced = std::make_shared<TracedValues>();
+  JS_AddExtraGCRootsTracer(cx, &TracedValues::Trace, traced.get());
+
+  bool ok =
+      runner.run("rooting/Rooted",
+                 [cx, target](size_t iterations) {
+                   for (size_t ix = 0; ix < iterations; ix++)
+                     JS::RootedObject rooted(cx, target.get());
+                   return true;
+                 }) &&
+      runner.run("rooting/PersistentRooted",
+                 [cx, target](size_t iterations) {
+                   for (size_t ix = 0; ix < iterations; ix++)
+                     JS::PersistentRootedObject rooted(cx, target.get());
+                   return true;
+                 }) &&
+      runner.run("rooting/HandleTable add+remove",
+                 [table, target](size_t iterations) {
+                   for (size_t ix = 0; ix < iterations; ix++) {
+                     auto handle = table->add(JS::ObjectValue(*target.get()));
+                     if (handle == boilerplate::HandleTable::InvalidHandle)
+                       return false;
+                     table->remove(handle);
+                   }
+                   return true;
+                 }) &&
+      runner.run("rooting/Heap in a traced vector",
+                 [traced, target](size_t iterations) {
+                   traced->values.clear();
+                   JS::Value value = JS::ObjectValue(*target.get());
+                   for (size_t ix = 0; ix < iterations; ix++)
+                     traced->values.emplace_back(value);
+                   return true;
+                 });
+
+  traced->values.clear();
+  JS_RemoveExtraGCRootsTracer(cx, &TracedValues::Trace, traced.get());
+  return ok;
+}
+
+static bool RunGCBenchmarks(JSContext* cx, boilerplate::BenchRunner& runner) {
+  return runner.run("gc/allocate objects",
+                    [cx](size_t n) { return CallLoop(cx, "allocate", n); }) &&
+         runner.run("gc/incremental GC, 5 ms slices",
+                    [cx](size_t iterations) {
+                      for (size_t ix = 0; ix < iterations; ix++) {
+                        JS::PrepareForFullGC(cx);
+                        JS::StartIncrementalGC(cx, GC_NORMAL,
+                                               JS::GCReason::API, 5);
+                        while (JS::IsIncrementalGCInProgress(cx)) {
+                          JS::PrepareForIncrementalGC(cx);
+                          JS::IncrementalGCSlice(cx, JS::GCReason::API, 5);
+                        }
+                      }
+                      return true;
+                    }) &&
+         runner.run("gc/full GC, 100k live objects", [cx](size_t iterations) {
+           for (size_t ix = 0; ix < iterations; ix++) JS_GC(cx);
+           return true;
+         });
+}
+
+static boilerplate::BenchOptions options;
+
+static bool BenchExample(JSContext* cx) {
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) return false;
+  JSAutoRealm ar(cx, global);
+
+  JS::RootedValue rval(cx);
+  if (!JS_DefineFunctions(cx, global, benchFunctions) ||
+      !Crc::DefinePrototype(cx, global) || !Evaluate(cx, benchScript, &rval))
+    return false;
+
+  boilerplate::BenchRunner runner(options);
+  bool ok = RunStartupBenchmarks(cx, runner) &&
+            RunEvaluateBenchmarks(cx, runner) &&
+            RunCallBenchmarks(cx, runner) &&
+            RunPropertyBenchmarks(cx, runner) &&
+            RunResolveBenchmarks(cx, runner) &&
+            RunRootingBenchmarks(cx, runner) && RunGCBenchmarks(cx, runner);
+  if (!ok) {
+    std::cerr << "benchmark failed\n";
+    return false;
+  }
+
+  runner.report(std::cout);
+  return true;
+}
+
+int main(int argc, const char* argv[]) {
+  if (!options.parseArgs(argc, argv)) return 1;
+
+  boilerplate::RuntimeConfig config;
+  if (!config.readEnvironment() || !config.parseArgs(argc, argv)) return 1;
+
+  if (!boilerplate::RunExample(BenchExample, config)) return 1;
+  return 0;
+}
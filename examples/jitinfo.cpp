@@ -0,0 +1,277 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <jsapi.h>
+#include <jsfriendapi.h>
+
+#include <js/CompilationAndEvaluation.h>
+#include <js/Conversions.h>
+#include <js/SourceText.h>
+
+#include "boilerplate.h"
+#include "domclass.h"
+
+// This example shows how to define natives that the JIT can optimize, by
+// attaching a JSJitInfo to them like browsers do for their DOM bindings. See
+// 'domclass.cpp' for what the fields of JSJitInfo mean.
+//
+// It defines an Accumulator class with a `total` accessor, a read-only
+// `count` getter, and an `add()` method. Each of them is also available
+// without JSJitInfo under a name ending in "Plain", calling the same C++ code.
+// Then it runs a few tight loops over both versions, and prints the number of
+// operations per second.
+//
+// The number of iterations can be given as the first argument.
+
+static unsigned numIterations = 10000000;
+
+using Clock = std::chrono::steady_clock;
+using Seconds = std::chrono::duration<double>;
+
+class Accumulator {
+  double m_total;
+  int32_t m_count;
+
+ public:
+  Accumulator(void) : m_total(0.0), m_count(0) {}
+
+  // These are the ops that Ion calls directly. `self` is the C++ object,
+  // already taken from the JS object's DOMObjectSlot.
+
+  static bool getTotal(JSContext* cx, JS::HandleObject obj, void* self,
+                       JSJitGetterCallArgs args) {
+    args.rval().setDouble(static_cast<Accumulator*>(self)->m_total);
+    return true;
+  }
+
+  static bool setTotal(JSContext* cx, JS::HandleObject obj, void* self,
+                       JSJitSetterCallArgs args) {
+    double total;
+    if (!JS::ToNumber(cx, args[0], &total)) return false;
+    static_cast<Accumulator*>(self)->m_total = total;
+    return true;
+  }
+
+  static bool getCount(JSContext* cx, JS::HandleObject obj, void* self,
+                       JSJitGetterCallArgs args) {
+    args.rval().setInt32(static_cast<Accumulator*>(self)->m_count);
+    return true;
+  }
+
+  static bool add(JSContext* cx, JS::HandleObject obj, void* self,
+                  const JSJitMethodCallArgs& args) {
+    double value;
+    if (!JS::ToNumber(cx, args.get(0), &value)) return false;
+    auto* accumulator = static_cast<Accumulator*>(self);
+    accumulator->m_total += value;
+    accumulator->m_count++;
+    args.rval().setUndefined();
+    return true;
+  }
+
+  static bool constructor(JSContext* cx, unsigned argc, JS::Value* vp);
+  static void finalize(JSFreeOp* fop, JSObject* obj);
+  static bool define(JSContext* cx, JS::HandleObject global);
+
+  static const JSClassOps classOps;
+  static const boilerplate::DOMClass klass;
+};
+
+const JSClassOps Accumulator::classOps = {
+    nullptr,  // addProperty
+    nullptr,  // deleteProperty
+    nullptr,  // enumerate
+    nullptr,  // newEnumerate
+    nullptr,  // resolve
+    nullptr,  // mayResolve
+    &Accumulator::finalize,
+    nullptr,  // call
+    nullptr,  // hasInstance
+    nullptr,  // construct
+    nullptr,  // trace
+};
+
+const boilerplate::DOMClass Accumulator::klass = {
+    {
+        "Accumulator",
+        JSCLASS_IS_DOMJSCLASS | JSCLASS_HAS_RESERVED_SLOTS(1) |
+            JSCLASS_FOREGROUND_FINALIZE,
+        &Accumulator::classOps,
+    },
+    1,  // protoID
+};
+
+// The JSJitInfo for each op. The getters only read state that the setter and
+// add() can change, so they alias DOM sets, and since they can't fail, Ion may
+// hoist them out of loops that don't call the setter or add(). The setter and
+// add() can run arbitrary code while converting their argument to a number,
+// so they alias everything.
+
+static const JSJitInfo totalGetterInfo = boilerplate::GetterInfo(
+    &Accumulator::getTotal, &Accumulator::klass, JSVAL_TYPE_DOUBLE,
+    /* isInfallible = */ true, /* isMovable = */ true, JSJitInfo::AliasDOMSets);
+
+static const JSJitInfo totalSetterInfo =
+    boilerplate::SetterInfo(&Accumulator::setTotal, &Accumulator::klass);
+
+static const JSJitInfo countGetterInfo = boilerplate::GetterInfo(
+    &Accumulator::getCount, &Accumulator::klass, JSVAL_TYPE_INT32,
+    /* isInfallible = */ true, /* isMovable = */ true, JSJitInfo::AliasDOMSets);
+
+static const JSJitInfo addInfo = boilerplate::MethodInfo(
+    &Accumulator::add, &Accumulator::klass, JSVAL_TYPE_UNDEFINED,
+    /* isInfallible = */ false, /* isMovable = */ false,
+    JSJitInfo::AliasEverything);
+
+// The JSNatives used by the interpreter and baseline JIT, and by Ion for the
+// Plain versions.
+static constexpr const boilerplate::DOMClass* domClass = &Accumulator::klass;
+static constexpr JSNative totalGetter =
+    boilerplate::GenericGetter<domClass, &Accumulator::getTotal>;
+static constexpr JSNative totalSetter =
+    boilerplate::GenericSetter<domClass, &Accumulator::setTotal>;
+static constexpr JSNative countGetter =
+    boilerplate::GenericGetter<domClass, &Accumulator::getCount>;
+static constexpr JSNative addMethod =
+    boilerplate::GenericMethod<domClass, &Accumulator::add>;
+
+static const JSFunctionSpec accumulatorMethods[] = {
+    JS_FNINFO("add", addMethod, &addInfo, 1, JSPROP_ENUMERATE),
+    JS_FN("addPlain", addMethod, 1, JSPROP_ENUMERATE), JS_FS_END};
+
+bool Accumulator::constructor(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  if (!args.isConstructing()) {
+    JS_ReportErrorASCII(cx, "You must call this constructor with 'new'");
+    return false;
+  }
+
+  JS::RootedObject thisObj(
+      cx, JS_NewObjectForConstructor(cx, &Accumulator::klass.base, args));
+  if (!thisObj) return false;
+  boilerplate::SetDOMObject(thisObj, new Accumulator());
+
+  args.rval().setObject(*thisObj);
+  return true;
+}
+
+void Accumulator::finalize(JSFreeOp* fop, JSObject* obj) {
+  if (JS_GetReservedSlot(obj, boilerplate::DOMObjectSlot).isUndefined())
+    return;
+  delete boilerplate::GetDOMObject<Accumulator>(obj);
+}
+
+// We can't use JS_InitClass() for a DOM class, since that would make the
+// prototype an object of the DOM class as well. So we create a plain object as
+// the prototype, and link it to the constructor ourselves.
+bool Accumulator::define(JSContext* cx, JS::HandleObject global) {
+  JS::RootedObject proto(cx, JS_NewPlainObject(cx));
+  if (!proto) return false;
+
+  JSFunction* ctorFun = JS_NewFunction(cx, &Accumulator::constructor, 0,
+                                       JSFUN_CONSTRUCTOR, "Accumulator");
+  if (!ctorFun) return false;
+  JS::RootedObject ctor(cx, JS_GetFunctionObject(ctorFun));
+
+  return JS_LinkConstructorAndPrototype(cx, ctor, proto) &&
+         JS_DefineFunctions(cx, proto, accumulatorMethods) &&
+         boilerplate::DefineDOMAccessor(cx, proto, "total", totalGetter,
+                                        &totalGetterInfo, totalSetter,
+                                        &totalSetterInfo, JSPROP_ENUMERATE) &&
+         boilerplate::DefineDOMAccessor(cx, proto, "totalPlain", totalGetter,
+                                        nullptr, totalSetter, nullptr,
+                                        JSPROP_ENUMERATE) &&
+         boilerplate::DefineDOMAccessor(cx, proto, "count", countGetter,
+                                        &countGetterInfo, nullptr, nullptr,
+                                        JSPROP_ENUMERATE) &&
+         boilerplate::DefineDOMAccessor(cx, proto, "countPlain", countGetter,
+                                        nullptr, nullptr, nullptr,
+                                        JSPROP_ENUMERATE) &&
+         JS_DefineProperty(cx, global, "Accumulator", ctor, 0);
+}
+
+static const struct {
+  const char* name;
+  const char* body;  // %s is replaced by "" or "Plain"
+} benchmarks[] = {
+    // With JSJitInfo, Ion can hoist the getter out of the loop.
+    {"read getter", "x += acc.total%s;"},
+    // The setter prevents that, but Ion still calls the ops directly.
+    {"write setter", "acc.total%s = i;"},
+    {"call method", "acc.add%s(i);"},
+    {"call method, read getter", "acc.add%s(1); x += acc.count%s;"},
+};
+
+static std::string Substitute(const char* body, const char* suffix) {
+  std::string result;
+  for (const char* c = body; *c; c++) {
+    if (c[0] == '%' && c[1] == 's') {
+      result += suffix;
+      c++;
+    } else {
+      result += *c;
+    }
+  }
+  return result;
+}
+
+static bool TimeLoop(JSContext* cx, const std::string& body,
+                     double* opsPerSec) {
+  std::string code =
+      "(function (n) { const acc = new Accumulator(); acc.total = 1; "
+      "let x = 0; for (let i = 0; i < n; i++) { " +
+      body + " } return x; })";
+
+  JS::CompileOptions options(cx);
+  options.setFileAndLine("jitinfo", 1);
+  JS::SourceText<mozilla::Utf8Unit> source;
+  JS::RootedValue fn(cx);
+  if (!source.init(cx, code.c_str(), code.size(),
+                   JS::SourceOwnership::Borrowed) ||
+      !JS::Evaluate(cx, options, source, &fn))
+    return false;
+
+  JS::RootedValueArray<1> args(cx);
+  args[0].setNumber(numIterations);
+  JS::RootedValue rval(cx);
+
+  Clock::time_point start = Clock::now();
+  if (!JS_CallFunctionValue(cx, nullptr, fn, args, &rval)) return false;
+  Seconds elapsed = Clock::now() - start;
+  *opsPerSec = numIterations / elapsed.count();
+  return true;
+}
+
+static bool JitInfoExample(JSContext* cx) {
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) return false;
+
+  JSAutoRealm ar(cx, global);
+
+  // Without these callbacks, Ion doesn't know which objects are DOM objects,
+  // and ignores the JSJitInfo.
+  boilerplate::SetDOMCallbacks(cx);
+
+  if (!Accumulator::define(cx, global)) return false;
+
+  std::cout << numIterations << " iterations\n"
+            << "loop\twith JSJitInfo\twithout\n";
+  for (const auto& benchmark : benchmarks) {
+    double withInfo, without;
+    if (!TimeLoop(cx, Substitute(benchmark.body, ""), &withInfo) ||
+        !TimeLoop(cx, Substitute(benchmark.body, "Plain"), &without))
+      return false;
+    std::cout << benchmark.name << "\t" << withInfo / 1e6 << " M/s\t"
+              << without / 1e6 << " M/s\n";
+  }
+  return true;
+}
+
+int main(int argc, const char* argv[]) {
+  if (argc > 1) numIterations = strtoul(argv[1], nullptr, 10);
+
+  if (!boilerplate::RunExample(JitInfoExample)) return 1;
+  return 0;
+}
@@ -0,0 +1,186 @@
+#include <cstring>
+#include <new>
+
+#include <jsapi.h>
+
+#include "lazyproperties.h"
+
+// LazyProperties implements a class's resolve, mayResolve, and newEnumerate
+// hooks from the same JSFunctionSpec and JSPropertySpec tables that you would
+// otherwise pass to JS_InitClass() to define everything upfront. This keeps
+// the list of lazy members in one place, instead of repeating each name in
+// all three hooks.
+//
+// It's also faster than comparing the id's string against each name:
+//
+// - attach() atomizes and pins all the names once, and keeps their ids in a
+//   small holder object in a reserved slot of the prototype. Atoms are unique
+//   per runtime, so resolve() only has to compare ids, which are
+//   pointer-sized. Pinned atoms are never collected, so the ids don't need to
+//   be traced. The holder object's finalizer frees them, so the class using
+//   LazyProperties doesn't need a finalize hook of its own for this.
+//
+// - mayResolve() can't use those ids, because it gets no context or
+//   prototype, and it may be called on JIT helper threads. Instead it rejects
+//   most other names by their length and first character, using two bitmaps
+//   computed from the tables, before comparing any strings.
+//
+// - newEnumerate() returns the pinned ids without atomizing anything.
+//
+// The class's instances must leave idsSlot undefined; that's how the hooks
+// tell the prototype apart from instances. Names must be strings, not
+// well-known symbols (JS_SYM_FN) or array indices.
+
+static uint64_t LengthBit(size_t length) {
+  return uint64_t(1) << (length < 63 ? length : 63);
+}
+
+boilerplate::LazyProperties::LazyProperties(const JSFunctionSpec* methods,
+                                            const JSPropertySpec* properties,
+                                            uint32_t idsSlot)
+    : m_methods(methods),
+      m_properties(properties),
+      m_idsSlot(idsSlot),
+      m_numMethods(0),
+      m_numProperties(0),
+      m_lengths(0),
+      m_firstChars{0, 0} {
+  for (const JSFunctionSpec* fs = methods; fs && fs->name; fs++) {
+    addName(fs->name);
+    m_numMethods++;
+  }
+  for (const JSPropertySpec* ps = properties; ps && ps->name; ps++) {
+    addName(ps->name);
+    m_numProperties++;
+  }
+}
+
+void boilerplate::LazyProperties::addName(const char* name) {
+  m_lengths |= LengthBit(strlen(name));
+  unsigned char first = name[0];
+  m_firstChars[(first / 64) % 2] |= uint64_t(1) << (first % 64);
+}
+
+const char* boilerplate::LazyProperties::name(size_t ix) const {
+  if (ix < m_numMethods) return m_methods[ix].name;
+  return m_properties[ix - m_numMethods].name;
+}
+
+unsigned boilerplate::LazyProperties::flags(size_t ix) const {
+  if (ix < m_numMethods) return m_methods[ix].flags;
+  return m_properties[ix - m_numMethods].flags;
+}
+
+static void FinalizeIds(JSFreeOp* fop, JSObject* holder) {
+  delete[] static_cast<jsid*>(JS_GetPrivate(holder));
+}
+
+static constexpr JSClassOps idsClassOps = {
+    nullptr,  // addProperty
+    nullptr,  // deleteProperty
+    nullptr,  // enumerate
+    nullptr,  // newEnumerate
+    nullptr,  // resolve
+    nullptr,  // mayResolve
+    &FinalizeIds,
+    nullptr,  // call
+    nullptr,  // hasInstance
+    nullptr,  // construct
+    nullptr,  // trace
+};
+
+static constexpr JSClass idsClass = {
+    "LazyPropertyIds",
+    JSCLASS_HAS_PRIVATE | JSCLASS_BACKGROUND_FINALIZE,
+    &idsClassOps,
+};
+
+// Returns null if obj is not the prototype.
+const jsid* boilerplate::LazyProperties::ids(JSObject* obj) const {
+  JS::Value slot = JS_GetReservedSlot(obj, m_idsSlot);
+  if (slot.isUndefined()) return nullptr;
+  return static_cast<const jsid*>(JS_GetPrivate(&slot.toObject()));
+}
+
+bool boilerplate::LazyProperties::attach(JSContext* cx,
+                                         JS::HandleObject proto) const {
+  JS::RootedObject holder(cx, JS_NewObject(cx, &idsClass));
+  if (!holder) return false;
+
+  jsid* ids = new (std::nothrow) jsid[count() ? count() : 1];
+  if (!ids) {
+    JS_ReportOutOfMemory(cx);
+    return false;
+  }
+  JS_SetPrivate(holder, ids);
+
+  for (size_t ix = 0; ix < count(); ix++) {
+    JSString* atom = JS_AtomizeAndPinString(cx, name(ix));
+    if (!atom) return false;
+    ids[ix] = INTERNED_STRING_TO_JSID(cx, atom);
+  }
+
+  JS_SetReservedSlot(proto, m_idsSlot, JS::ObjectValue(*holder));
+  return true;
+}
+
+bool boilerplate::LazyProperties::resolve(JSContext* cx, JS::HandleObject obj,
+                                          JS::HandleId id,
+                                          bool* resolved) const {
+  *resolved = false;
+
+  // For instances, return immediately, and this will be called again on the
+  // prototype.
+  const jsid* protoIds = ids(obj);
+  if (!protoIds) return true;
+
+  for (size_t ix = 0; ix < count(); ix++) {
+    if (JSID_BITS(protoIds[ix]) != JSID_BITS(id.get())) continue;
+
+    // Define just this one entry, by copying it into a table of its own.
+    if (ix < m_numMethods) {
+      const JSFunctionSpec methods[] = {m_methods[ix], JS_FS_END};
+      if (!JS_DefineFunctions(cx, obj, methods)) return false;
+    } else {
+      const JSPropertySpec properties[] = {m_properties[ix - m_numMethods],
+                                           JS_PS_END};
+      if (!JS_DefineProperties(cx, obj, properties)) return false;
+    }
+    *resolved = true;
+    return true;
+  }
+
+  return true;
+}
+
+bool boilerplate::LazyProperties::mayResolve(jsid id) const {
+  if (!JSID_IS_STRING(id)) return false;
+
+  JSFlatString* str = JSID_TO_FLAT_STRING(id);
+  size_t length = JS_GetStringLength(JS_FORGET_STRING_FLATNESS(str));
+  if (length == 0 || !(m_lengths & LengthBit(length))) return false;
+
+  char16_t first = JS_GetFlatStringCharAt(str, 0);
+  if (first >= 128) return false;
+  if (!(m_firstChars[first / 64] & (uint64_t(1) << (first % 64)))) return false;
+
+  for (size_t ix = 0; ix < count(); ix++) {
+    if (JS_FlatStringEqualsAscii(str, name(ix))) return true;
+  }
+  return false;
+}
+
+bool boilerplate::LazyProperties::newEnumerate(
+    JSContext* cx, JS::HandleObject obj, JS::MutableHandleIdVector properties,
+    bool enumerableOnly) const {
+  // As in resolve(), instances have nothing to enumerate; this will be called
+  // again on the prototype.
+  const jsid* protoIds = ids(obj);
+  if (!protoIds) return true;
+
+  for (size_t ix = 0; ix < count(); ix++) {
+    if (enumerableOnly && !(flags(ix) & JSPROP_ENUMERATE)) continue;
+    if (!properties.append(protoIds[ix])) return false;
+  }
+  return true;
+}
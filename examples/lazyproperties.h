@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <jsapi.h>
+
+// See 'lazyproperties.cpp' for documentation.
+
+namespace boilerplate {
+
+class LazyProperties {
+ public:
+  // Both tables are terminated by JS_FS_END / JS_PS_END, and either may be
+  // null. idsSlot is a reserved slot of the class that is only used by the
+  // prototype (or by whichever object the members are resolved on, such as a
+  // global).
+  LazyProperties(const JSFunctionSpec* methods,
+                 const JSPropertySpec* properties, uint32_t idsSlot);
+
+  LazyProperties(const LazyProperties&) = delete;
+  LazyProperties& operator=(const LazyProperties&) = delete;
+
+  // Call this on the prototype after JS_InitClass().
+  bool attach(JSContext* cx, JS::HandleObject proto) const;
+
+  // The class's resolve, mayResolve, and newEnumerate hooks can forward to
+  // these.
+  bool resolve(JSContext* cx, JS::HandleObject obj, JS::HandleId id,
+               bool* resolved) const;
+  bool mayResolve(jsid id) const;
+  bool newEnumerate(JSContext* cx, JS::HandleObject obj,
+                    JS::MutableHandleIdVector properties,
+                    bool enumerableOnly) const;
+
+ private:
+  size_t count(void) const { return m_numMethods + m_numProperties; }
+  const char* name(size_t ix) const;
+  unsigned flags(size_t ix) const;
+  const jsid* ids(JSObject* obj) const;
+  void addName(const char* name);
+
+  const JSFunctionSpec* m_methods;
+  const JSPropertySpec* m_properties;
+  uint32_t m_idsSlot;
+  size_t m_numMethods;
+  size_t m_numProperties;
+  uint64_t m_lengths;        // bit N set if a name has length N (or >= 63)
+  uint64_t m_firstChars[2];  // bit C set if a name starts with ASCII char C
+};
+
+}  // namespace boilerplate
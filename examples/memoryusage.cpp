@@ -0,0 +1,208 @@
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__APPLE__)
+#  include <malloc/malloc.h>
+#else
+#  include <malloc.h>
+#endif
+
+#include <jsapi.h>
+#include <jsfriendapi.h>
+
+#include <js/MemoryMetrics.h>
+#include <js/UbiNode.h>
+#include <js/UbiNodeBreadthFirst.h>
+#include <mozilla/Maybe.h>
+
+#include "memoryusage.h"
+
+// Memory accounting per global, for finding out which scripts use the heap,
+// and for enforcing per-tenant quotas, without taking a heap dump.
+//
+// JS::CollectRuntimeStats() walks the whole GC heap once and adds up the sizes
+// of all GC things in each zone and realm, including the memory that they
+// have allocated with malloc, which it measures with a MallocSizeOf function.
+// We give it the system allocator's malloc_usable_size(). It doesn't count
+// things, so if asked to, we also walk the graph of reachable things with
+// JS::ubi::BreadthFirst and count objects per realm and strings per zone.
+//
+// Both are expensive: call them when you need a report, not on every
+// request. For a cheap check of a whole context's GC heap, use
+// JS_GetGCParameter(cx, JSGC_BYTES) instead.
+//
+// Globals created with boilerplate::CreateGlobal() or JS_NewGlobalObject()
+// with default options get a zone of their own, so the zone's strings are
+// theirs alone; realmsInZone tells you when that's not the case, as with
+// boilerplate::RealmTemplate.
+
+static size_t MallocSizeOf(const void* ptr) {
+#if defined(__APPLE__)
+  return malloc_size(ptr);
+#else
+  return malloc_usable_size(const_cast<void*>(ptr));
+#endif
+}
+
+namespace {
+
+class Stats : public JS::RuntimeStats {
+ public:
+  Stats(void) : JS::RuntimeStats(MallocSizeOf) {}
+
+  // Remember which zone and realm each set of stats is for.
+  void initExtraZoneStats(JS::Zone* zone, JS::ZoneStats* zStats) override {
+    zStats->extra = zone;
+  }
+  void initExtraRealmStats(JS::Realm* realm,
+                           JS::RealmStats* rStats) override {
+    rStats->extra = realm;
+  }
+};
+
+struct CountHandler {
+  struct NodeData {};
+
+  std::unordered_map<JS::Realm*, size_t> objects;
+  std::unordered_map<JS::Zone*, size_t> strings;
+
+  bool operator()(JS::ubi::BreadthFirst<CountHandler>& traversal,
+                  JS::ubi::Node origin, const JS::ubi::Edge& edge,
+                  NodeData* referentData, bool first) {
+    if (!first) return true;  // already counted
+
+    const JS::ubi::Node& node = edge.referent;
+    if (node.is<JSObject>())
+      objects[node.realm()]++;
+    else if (node.is<JSString>())
+      strings[node.zone()]++;
+    return true;
+  }
+};
+
+}  // namespace
+
+static bool CountCells(JSContext* cx, CountHandler* handler) {
+  mozilla::Maybe<JS::AutoCheckCannotGC> nogc;
+  JS::ubi::RootList roots(cx, nogc);
+  if (!roots.init()) {
+    JS_ReportOutOfMemory(cx);
+    return false;
+  }
+
+  JS::ubi::BreadthFirst<CountHandler> traversal(cx, *handler, nogc.ref());
+  traversal.wantNames = false;
+  if (!traversal.addStart(JS::ubi::Node(&roots)) || !traversal.traverse()) {
+    JS_ReportOutOfMemory(cx);
+    return false;
+  }
+  return true;
+}
+
+bool boilerplate::CollectMemoryUsage(JSContext* cx,
+                                     std::vector<MemoryUsage>* usage,
+                                     bool countCells) {
+  Stats stats;
+  if (!JS::CollectRuntimeStats(cx, &stats, nullptr, /* anonymize = */ false)) {
+    JS_ReportOutOfMemory(cx);
+    return false;
+  }
+
+  CountHandler counts;
+  if (countCells && !CountCells(cx, &counts)) return false;
+
+  std::unordered_map<JS::Zone*, const JS::ZoneStats*> zones;
+  for (const JS::ZoneStats& zStats : stats.zoneStatsVector)
+    zones[static_cast<JS::Zone*>(zStats.extra)] = &zStats;
+
+  std::unordered_map<JS::Zone*, size_t> realmsPerZone;
+  usage->clear();
+  for (const JS::RealmStats& rStats : stats.realmStatsVector) {
+    auto* realm = static_cast<JS::Realm*>(rStats.extra);
+    JSObject* global = JS::GetRealmGlobalOrNull(realm);
+    // Skip SpiderMonkey's self-hosting realm, and realms without a global.
+    if (!global || JS::RealmCreationOptionsRef(realm).invisibleToDebugger())
+      continue;
+
+    MemoryUsage entry = {};
+    entry.global = global;
+
+    const JS::ClassInfo& objects = rStats.classInfo;
+    size_t scriptsMalloc =
+        rStats.scriptsMallocHeapData + rStats.baselineData + rStats.ionData;
+    entry.gcHeapBytes = rStats.sizeOfLiveGCThings();
+    entry.objectBytes = objects.sizeOfAllThings();
+    entry.scriptBytes = rStats.scriptsGCHeap + scriptsMalloc;
+    entry.mallocBytes =
+        objects.sizeOfAllThings() - objects.objectsGCHeap + scriptsMalloc;
+
+    JS::Zone* zone = js::GetObjectZone(global);
+    auto zStats = zones.find(zone);
+    if (zStats != zones.end()) {
+      const JS::StringInfo& strings = zStats->second->stringInfo;
+      entry.stringBytes = strings.gcHeapLatin1 + strings.gcHeapTwoByte +
+                          strings.mallocHeapLatin1 + strings.mallocHeapTwoByte;
+    }
+    realmsPerZone[zone]++;
+
+    if (countCells) {
+      entry.counted = true;
+      entry.objectCount = counts.objects[realm];
+      entry.stringCount = counts.strings[zone];
+    }
+
+    usage->push_back(entry);
+  }
+
+  for (MemoryUsage& entry : *usage)
+    entry.realmsInZone = realmsPerZone[js::GetObjectZone(entry.global)];
+  return true;
+}
+
+bool boilerplate::GetMemoryUsage(JSContext* cx, JS::HandleObject global,
+                                 MemoryUsage* usage, bool countCells) {
+  std::vector<MemoryUsage> all;
+  if (!CollectMemoryUsage(cx, &all, countCells)) return false;
+
+  for (const MemoryUsage& entry : all) {
+    if (entry.global == global) {
+      *usage = entry;
+      return true;
+    }
+  }
+  JS_ReportErrorASCII(cx, "no memory usage found for this global");
+  return false;
+}
+
+JSObject* boilerplate::MemoryUsageToObject(JSContext* cx,
+                                           const MemoryUsage& usage) {
+  JS::RootedObject obj(cx, JS_NewPlainObject(cx));
+  if (!obj) return nullptr;
+
+  const struct {
+    const char* name;
+    size_t value;
+  } fields[] = {
+      {"gcHeapBytes", usage.gcHeapBytes},
+      {"mallocBytes", usage.mallocBytes},
+      {"objectBytes", usage.objectBytes},
+      {"scriptBytes", usage.scriptBytes},
+      {"stringBytes", usage.stringBytes},
+      {"realmsInZone", usage.realmsInZone},
+  };
+  for (const auto& field : fields) {
+    if (!JS_DefineProperty(cx, obj, field.name, double(field.value),
+                           JSPROP_ENUMERATE))
+      return nullptr;
+  }
+
+  if (usage.counted &&
+      (!JS_DefineProperty(cx, obj, "objectCount", double(usage.objectCount),
+                          JSPROP_ENUMERATE) ||
+       !JS_DefineProperty(cx, obj, "stringCount", double(usage.stringCount),
+                          JSPROP_ENUMERATE)))
+    return nullptr;
+
+  return obj;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <jsapi.h>
+
+// See 'memoryusage.cpp' for documentation.
+
+namespace boilerplate {
+
+struct MemoryUsage {
+  // The global whose realm this is about. Not rooted: only valid until the
+  // next GC.
+  JSObject* global;
+
+  size_t gcHeapBytes;  // GC things that belong to the realm
+  size_t mallocBytes;  // memory allocated outside the GC heap by those things
+  size_t objectBytes;  // of both, for objects (including their slots)
+  size_t scriptBytes;  // of both, for scripts and their JIT data
+
+  // Strings belong to a zone, not a realm; these are for all strings of the
+  // global's zone, which may be shared with other realms.
+  size_t stringBytes;
+  size_t realmsInZone;
+
+  // Only counted if asked for, since that walks the whole heap graph. Only
+  // things that are reachable are counted; that's also what will survive the
+  // next GC.
+  bool counted;
+  size_t objectCount;
+  size_t stringCount;  // in the zone
+};
+
+// Collects the memory usage of every global's realm, except SpiderMonkey's
+// own.
+bool CollectMemoryUsage(JSContext* cx, std::vector<MemoryUsage>* usage,
+                        bool countCells = false);
+
+// The same for one global.
+bool GetMemoryUsage(JSContext* cx, JS::HandleObject global, MemoryUsage* usage,
+                    bool countCells = false);
+
+// Returns an object with the fields of MemoryUsage, except 'global'.
+JSObject* MemoryUsageToObject(JSContext* cx, const MemoryUsage& usage);
+
+}  // namespace boilerplate
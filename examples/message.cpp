@@ -0,0 +1,60 @@
+#include <memory>
+
+#include <jsapi.h>
+
+#include <js/StructuredClone.h>
+
+#include "message.h"
+
+// A Message carries a JS value from one JSContext to another, usually on
+// another thread, without going through a string. It uses the structured
+// clone algorithm, the same one that postMessage() uses in browsers:
+//
+// - Plain objects, arrays, strings, numbers, Maps, Sets, Dates, RegExps,
+//   typed arrays and so on are copied into a flat buffer, and recreated in
+//   the other context. Cycles and shared references are preserved.
+// - ArrayBuffers listed in the transfer list are not copied at all. Their
+//   contents move into the message, and then into a new ArrayBuffer in the
+//   receiving context; the ArrayBuffer in the sending context becomes
+//   detached, with a byteLength of 0. This is how large binary payloads
+//   should be passed around.
+// - SharedArrayBuffers are neither copied nor transferred, but shared: both
+//   contexts see the same memory. Use Atomics to synchronize.
+//
+// The message is written with StructuredCloneScope::SameProcessDifferentThread,
+// which is what allows the transferred and shared memory to be passed as a
+// pointer. Such a message must not be saved or sent to another process.
+//
+// Functions, and objects of embedder-defined classes, can't be cloned; that
+// needs JSStructuredCloneCallbacks. Writing one throws a DataCloneError.
+//
+// A Message owns its buffer and may be moved to another thread, but must only
+// be used by one thread at a time. If it's destroyed without being read, the
+// transferred contents are freed.
+
+boilerplate::Message::Message(void) = default;
+
+boilerplate::Message::~Message(void) = default;
+
+bool boilerplate::Message::write(JSContext* cx, JS::HandleValue value,
+                                 JS::HandleValue transferList) {
+  m_buffer.reset(new JSAutoStructuredCloneBuffer(
+      JS::StructuredCloneScope::SameProcessDifferentThread, nullptr, nullptr));
+
+  if (!m_buffer->write(cx, value, transferList, JS::CloneDataPolicy())) {
+    m_buffer.reset();
+    return false;
+  }
+  return true;
+}
+
+bool boilerplate::Message::read(JSContext* cx, JS::MutableHandleValue value) {
+  if (!m_buffer) {
+    JS_ReportErrorASCII(cx, "message is empty, or was already read");
+    return false;
+  }
+
+  bool ok = m_buffer->read(cx, value);
+  m_buffer.reset();
+  return ok;
+}
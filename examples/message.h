@@ -0,0 +1,39 @@
+#pragma once
+
+#include <memory>
+
+#include <jsapi.h>
+
+#include <js/StructuredClone.h>
+
+// See 'message.cpp' for documentation.
+
+namespace boilerplate {
+
+class Message {
+ public:
+  Message(void);
+  ~Message(void);
+
+  Message(Message&&) = default;
+  Message& operator=(Message&&) = default;
+
+  // Serializes 'value'. 'transferList' is undefined, or an array of the
+  // ArrayBuffers whose contents are to be moved into the message instead of
+  // copied; they are detached from this context.
+  bool write(JSContext* cx, JS::HandleValue value,
+             JS::HandleValue transferList = JS::UndefinedHandleValue);
+
+  // Deserializes the value in the context of the current realm. A message can
+  // only be read once, since transferred contents move into the new
+  // ArrayBuffers.
+  bool read(JSContext* cx, JS::MutableHandleValue value);
+
+  bool empty(void) const { return !m_buffer; }
+  size_t nbytes(void) const { return m_buffer ? m_buffer->data().Size() : 0; }
+
+ private:
+  std::unique_ptr<JSAutoStructuredCloneBuffer> m_buffer;
+};
+
+}  // namespace boilerplate
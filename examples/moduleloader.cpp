@@ -0,0 +1,424 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <jsapi.h>
+
+#include <js/CharacterEncoding.h>
+
+#include "externalstrings.h"
+#include "moduleloader.h"
+#include "offthreadcompile.h"
+
+// ModuleLoader loads ES modules from files, with all of their imports, so
+// that a program made of many modules starts quickly.
+//
+// SpiderMonkey doesn't load modules itself. The embedding compiles each
+// module with JS::CompileModule(), and when a module is instantiated, the
+// engine asks the module resolve hook for the module object of each import.
+// The hook can't do any I/O, it must return a module that was compiled
+// already; so the whole graph of imports has to be loaded before the first
+// module can be instantiated.
+//
+// Loading the modules one after the other, reading a file, compiling it,
+// looking at its imports, and then reading the next file, spends most of its
+// time waiting. Instead, load() keeps the whole graph in flight at once:
+//
+// - A pool of fetch threads reads the files and decodes them into UTF-16,
+//   which is what the compiler takes in this version of SpiderMonkey. They
+//   use no JSAPI, so any number of them can run.
+// - As each file arrives, the main thread starts compiling it with
+//   OffThreadCompile, on one of SpiderMonkey's helper threads. Starting an
+//   off-thread compilation has a cost of its own (a fresh zone, merged into
+//   the realm afterwards), so the engine declines to do it for small
+//   sources, and those few kilobytes are compiled on the main thread right
+//   away, while the fetch threads carry on.
+// - As each compilation finishes, the main thread asks the module which
+//   modules it imports (JS::GetRequestedModules()) and sends every one that
+//   wasn't requested yet to the fetch threads.
+//
+// So the files of one level of the graph are read and compiled in parallel,
+// and the next level is requested as soon as any module of this one is
+// compiled, not when the whole level is done.
+//
+// Compiled modules are kept in a map by absolute path, and that map is what
+// the resolve hook looks in. Each module's private value is its path, so
+// that the hook can resolve relative imports, and so that import.meta can
+// tell a module where it is: import.meta.url, import.meta.filename, and
+// import.meta.dirname, the last being the module equivalent of Node's
+// __dirname.
+//
+// Only relative and absolute paths ('./a.js', '../b.js', '/c/d.js') can be
+// imported; there is no search path for bare names.
+
+// The hooks are per runtime and a runtime's context is only used on one
+// thread, so a thread-local will do.
+static thread_local boilerplate::ModuleLoader* currentLoader = nullptr;
+
+static std::string DirName(const std::string& path) {
+  size_t slash = path.rfind('/');
+  if (slash == 0 || slash == std::string::npos) return "/";
+  return path.substr(0, slash);
+}
+
+// Joins 'path' to 'base' if it is relative, and removes '.' and '..'
+// segments and repeated slashes.
+static std::string Normalize(const std::string& base, const std::string& path) {
+  std::string joined = path[0] == '/' ? path : base + '/' + path;
+  std::vector<std::string> segments;
+  size_t start = 0;
+  while (start <= joined.size()) {
+    size_t end = joined.find('/', start);
+    if (end == std::string::npos) end = joined.size();
+    std::string segment = joined.substr(start, end - start);
+    if (segment == "..") {
+      if (!segments.empty()) segments.pop_back();
+    } else if (!segment.empty() && segment != ".") {
+      segments.push_back(std::move(segment));
+    }
+    start = end + 1;
+  }
+
+  std::string normalized;
+  for (const std::string& segment : segments) normalized += '/' + segment;
+  return normalized.empty() ? "/" : normalized;
+}
+
+static bool IsPathSpecifier(const char* specifier) {
+  return specifier[0] == '/' || strncmp(specifier, "./", 2) == 0 ||
+         strncmp(specifier, "../", 3) == 0;
+}
+
+static std::string CurrentDirectory(void) {
+  std::string dir(256, '\0');
+  while (!getcwd(&dir[0], dir.size())) {
+    if (errno != ERANGE) return "/";
+    dir.resize(dir.size() * 2);
+  }
+  dir.resize(strlen(dir.c_str()));
+  return dir;
+}
+
+// Returns false, without an exception, on an error reading the file.
+static bool ReadFile(const std::string& path, std::string* contents,
+                     int* error) {
+  int fd = open(path.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    *error = errno;
+    if (fd >= 0) close(fd);
+    return false;
+  }
+
+  contents->resize(size_t(st.st_size));
+  size_t done = 0;
+  while (done < contents->size()) {
+    ssize_t count = read(fd, &(*contents)[done], contents->size() - done);
+    if (count < 0 && errno == EINTR) continue;
+    if (count <= 0) {
+      *error = count < 0 ? errno : EIO;  // the file shrank
+      close(fd);
+      return false;
+    }
+    done += size_t(count);
+  }
+  close(fd);
+  return true;
+}
+
+boilerplate::ModuleLoader::ModuleLoader(unsigned fetchThreads)
+    : m_runtime(nullptr), m_threadCount(fetchThreads), m_shuttingDown(false) {
+  if (m_threadCount == 0)
+    m_threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+boilerplate::ModuleLoader::~ModuleLoader(void) {
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_shuttingDown = true;
+  }
+  m_requestsChanged.notify_all();
+  for (std::thread& thread : m_threads) thread.join();
+
+  if (m_runtime) {
+    JS::SetModuleResolveHook(m_runtime, nullptr);
+    JS::SetModuleMetadataHook(m_runtime, nullptr);
+  }
+  if (currentLoader == this) currentLoader = nullptr;
+}
+
+bool boilerplate::ModuleLoader::init(JSContext* cx) {
+  if (currentLoader) {
+    JS_ReportErrorASCII(cx, "a module loader is already installed");
+    return false;
+  }
+  currentLoader = this;
+  m_runtime = JS_GetRuntime(cx);
+  JS::SetModuleResolveHook(m_runtime, &ModuleLoader::Resolve);
+  JS::SetModuleMetadataHook(m_runtime, &ModuleLoader::AddMetadata);
+  return true;
+}
+
+void boilerplate::ModuleLoader::fetch(std::string path) {
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_requests.push_back(std::move(path));
+    // Start the threads the first time they are needed.
+    if (m_threads.empty()) {
+      for (unsigned ix = 0; ix < m_threadCount; ix++)
+        m_threads.emplace_back(&ModuleLoader::fetchLoop, this);
+    }
+  }
+  m_requestsChanged.notify_one();
+}
+
+void boilerplate::ModuleLoader::fetchLoop(void) {
+  std::unique_lock<std::mutex> guard(m_lock);
+  for (;;) {
+    m_requestsChanged.wait(
+        guard, [this] { return m_shuttingDown || !m_requests.empty(); });
+    if (m_shuttingDown) return;
+
+    Fetched fetched;
+    fetched.path = std::move(m_requests.front());
+    m_requests.pop_front();
+    guard.unlock();
+
+    std::string contents;
+    fetched.error = 0;
+    if (ReadFile(fetched.path, &contents, &fetched.error)) {
+      // Skip a byte order mark, as a browser would.
+      size_t start = contents.compare(0, 3, "\xEF\xBB\xBF") == 0 ? 3 : 0;
+      fetched.text = UTF8ToUTF16(contents.data() + start,
+                                 contents.size() - start);
+    }
+
+    guard.lock();
+    m_results.push_back(std::move(fetched));
+    m_resultsChanged.notify_one();
+  }
+}
+
+std::vector<boilerplate::ModuleLoader::Fetched>
+boilerplate::ModuleLoader::takeFetched(std::chrono::milliseconds timeout) {
+  std::unique_lock<std::mutex> guard(m_lock);
+  auto ready = [this] { return !m_results.empty(); };
+  if (timeout.count() < 0)
+    m_resultsChanged.wait(guard, ready);
+  else
+    m_resultsChanged.wait_for(guard, timeout, ready);
+  std::vector<Fetched> results;
+  results.swap(m_results);
+  return results;
+}
+
+// Finds the path that 'specifier' refers to, relative to the module at
+// 'importer' (or to the current directory if empty). Reports an error if it
+// isn't a path.
+static bool ResolvePath(JSContext* cx, const std::string& importer,
+                        JS::HandleString specifier, std::string* path) {
+  JS::UniqueChars chars = JS_EncodeStringToUTF8(cx, specifier);
+  if (!chars) return false;
+  if (!IsPathSpecifier(chars.get())) {
+    JS_ReportErrorUTF8(cx, "%s: can't import '%s', only paths are supported",
+                       importer.c_str(), chars.get());
+    return false;
+  }
+  std::string base = importer.empty() ? CurrentDirectory() : DirName(importer);
+  *path = Normalize(base, chars.get());
+  return true;
+}
+
+static bool GetModulePath(JSContext* cx, JS::HandleValue privateValue,
+                          std::string* path) {
+  path->clear();
+  if (!privateValue.isString()) return true;
+  JS::RootedString str(cx, privateValue.toString());
+  JS::UniqueChars chars = JS_EncodeStringToUTF8(cx, str);
+  if (!chars) return false;
+  *path = chars.get();
+  return true;
+}
+
+namespace {
+struct Compilation {
+  std::string path;
+  boilerplate::OffThreadCompile compile;
+};
+}  // namespace
+
+bool boilerplate::ModuleLoader::load(JSContext* cx, const std::string& path,
+                                     JS::MutableHandleObject module) {
+  std::string root = Normalize(CurrentDirectory(), path);
+
+  // Paths requested during this load, and the modules added to the map, to
+  // be removed again if the load or the instantiation fails, so that a later
+  // load retries them instead of reusing modules in an errored state.
+  std::unordered_set<std::string> requested;
+  std::vector<std::string> added;
+  std::deque<std::unique_ptr<Compilation>> compiling;
+  size_t fetching = 0;
+  bool ok = true;
+
+  auto request = [&](const std::string& modulePath) {
+    if (m_modules.count(modulePath) || !requested.insert(modulePath).second)
+      return;
+    fetch(modulePath);
+    fetching++;
+  };
+
+  // Called when a module has been compiled.
+  auto compiled = [&](const std::string& modulePath,
+                      JS::HandleObject compiledModule) {
+    JS::RootedString pathStr(
+        cx, JS_NewStringCopyUTF8N(
+                cx, JS::UTF8Chars(modulePath.data(), modulePath.size())));
+    if (!pathStr) return false;
+    JS::SetModulePrivate(compiledModule, JS::StringValue(pathStr));
+    m_modules.emplace(modulePath,
+                      std::unique_ptr<JS::PersistentRootedObject>(
+                          new JS::PersistentRootedObject(cx, compiledModule)));
+    added.push_back(modulePath);
+
+    JS::RootedObject requests(cx,
+                              JS::GetRequestedModules(cx, compiledModule));
+    uint32_t length;
+    if (!requests || !JS_GetArrayLength(cx, requests, &length)) return false;
+    JS::RootedValue entry(cx);
+    JS::RootedString specifier(cx);
+    std::string imported;
+    for (uint32_t ix = 0; ix < length; ix++) {
+      if (!JS_GetElement(cx, requests, ix, &entry)) return false;
+      specifier = JS::GetRequestedModuleSpecifier(cx, entry);
+      if (!specifier || !ResolvePath(cx, modulePath, specifier, &imported))
+        return false;
+      request(imported);
+    }
+    return true;
+  };
+
+  request(root);
+
+  while (fetching || !compiling.empty()) {
+    // Don't wait long for files while there are compilations to finish, nor
+    // at all if no more files are coming.
+    int timeoutMs = compiling.empty() ? -1 : fetching ? 1 : 0;
+    std::chrono::milliseconds timeout(timeoutMs);
+    for (Fetched& fetched : takeFetched(timeout)) {
+      fetching--;
+      m_stats.fetched++;
+      if (!ok) continue;
+
+      if (fetched.error) {
+        JS_ReportErrorUTF8(cx, "could not load module %s: %s",
+                           fetched.path.c_str(), strerror(fetched.error));
+        ok = false;
+        continue;
+      }
+
+      std::unique_ptr<Compilation> compilation(new Compilation);
+      compilation->path = std::move(fetched.path);
+      JS::CompileOptions options(cx);
+      options.setFileAndLine(compilation->path.c_str(), 1);
+      if (!compilation->compile.startModule(cx, options,
+                                            std::move(fetched.text))) {
+        ok = false;
+        continue;
+      }
+      if (compilation->compile.isOffThread())
+        m_stats.compiledOffThread++;
+      else
+        m_stats.compiledOnThread++;
+      compiling.push_back(std::move(compilation));
+    }
+
+    // Finish the compilations that are done. If none are, and there are no
+    // files on the way that could be started meanwhile, wait for the oldest.
+    bool finishedAny = false;
+    for (auto it = compiling.begin(); ok && it != compiling.end();) {
+      Compilation& compilation = **it;
+      if (!compilation.compile.isReady() && (finishedAny || fetching)) {
+        ++it;
+        continue;
+      }
+      JS::RootedObject compiledModule(cx);
+      ok = compilation.compile.finishModule(cx, &compiledModule) &&
+           compiled(compilation.path, compiledModule);
+      it = compiling.erase(it);
+      finishedAny = true;
+    }
+
+    // After an error, drop the compilations still running and only wait for
+    // the files still on the way, so that none is left over for next time.
+    if (!ok) compiling.clear();
+  }
+
+  if (ok) {
+    module.set(*m_modules.at(root));
+    ok = JS::ModuleInstantiate(cx, module);
+  }
+  if (!ok) {
+    for (const std::string& modulePath : added) m_modules.erase(modulePath);
+    return false;
+  }
+  return true;
+}
+
+bool boilerplate::ModuleLoader::run(JSContext* cx, const std::string& path) {
+  JS::RootedObject module(cx);
+  return load(cx, path, &module) && JS::ModuleEvaluate(cx, module);
+}
+
+JSObject* boilerplate::ModuleLoader::Resolve(
+    JSContext* cx, JS::HandleValue referencingPrivate,
+    JS::HandleString specifier) {
+  std::string importer, path;
+  if (!GetModulePath(cx, referencingPrivate, &importer) ||
+      !ResolvePath(cx, importer, specifier, &path))
+    return nullptr;
+
+  auto found = currentLoader->m_modules.find(path);
+  if (found == currentLoader->m_modules.end()) {
+    // Only if a module was compiled some other way than with load().
+    JS_ReportErrorUTF8(cx, "module %s was not loaded", path.c_str());
+    return nullptr;
+  }
+  return *found->second;
+}
+
+bool boilerplate::ModuleLoader::AddMetadata(JSContext* cx,
+                                            JS::HandleValue privateValue,
+                                            JS::HandleObject metaObject) {
+  std::string path;
+  if (!GetModulePath(cx, privateValue, &path)) return false;
+  if (path.empty()) return true;
+
+  std::string url = "file://" + path;
+  std::string dir = DirName(path);
+  struct {
+    const char* name;
+    const std::string& value;
+  } fields[] = {{"url", url}, {"filename", path}, {"dirname", dir}};
+  JS::RootedString value(cx);
+  for (const auto& field : fields) {
+    value = JS_NewStringCopyUTF8N(
+        cx, JS::UTF8Chars(field.value.data(), field.value.size()));
+    if (!value ||
+        !JS_DefineProperty(cx, metaObject, field.name, value, JSPROP_ENUMERATE))
+      return false;
+  }
+  return true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <jsapi.h>
+
+// See 'moduleloader.cpp' for documentation.
+
+namespace boilerplate {
+
+class ModuleLoader {
+ public:
+  struct Stats {
+    size_t fetched = 0;
+    size_t compiledOffThread = 0;
+    size_t compiledOnThread = 0;
+  };
+
+  // 'fetchThreads' is the number of threads reading and decoding files; zero
+  // means one per CPU.
+  explicit ModuleLoader(unsigned fetchThreads = 0);
+  // Removes the module hooks again. Must run before the context is destroyed.
+  ~ModuleLoader(void);
+
+  ModuleLoader(const ModuleLoader&) = delete;
+  ModuleLoader& operator=(const ModuleLoader&) = delete;
+
+  // Installs the runtime's module hooks. Only one loader per thread.
+  bool init(JSContext* cx);
+
+  // Loads the module at 'path' and everything it imports, directly or not,
+  // and instantiates it. Modules that were loaded before are reused; if the
+  // load or the instantiation fails, the modules it added are forgotten, so
+  // that a later load compiles them again.
+  bool load(JSContext* cx, const std::string& path,
+            JS::MutableHandleObject module);
+
+  // Loads, instantiates, and evaluates the module at 'path'.
+  bool run(JSContext* cx, const std::string& path);
+
+  const Stats& stats(void) const { return m_stats; }
+
+ private:
+  struct Fetched {
+    std::string path;
+    std::u16string text;
+    int error;  // errno, if the file couldn't be read
+  };
+
+  static JSObject* Resolve(JSContext* cx, JS::HandleValue referencingPrivate,
+                           JS::HandleString specifier);
+  static bool AddMetadata(JSContext* cx, JS::HandleValue privateValue,
+                          JS::HandleObject metaObject);
+
+  void fetch(std::string path);
+  // Waits at most 'timeout' for fetched files, forever if negative.
+  std::vector<Fetched> takeFetched(std::chrono::milliseconds timeout);
+  void fetchLoop(void);
+
+  JSRuntime* m_runtime;  // whose hooks init() installed
+  unsigned m_threadCount;
+  std::vector<std::thread> m_threads;
+  std::mutex m_lock;
+  std::condition_variable m_requestsChanged;
+  std::condition_variable m_resultsChanged;
+  std::deque<std::string> m_requests;
+  std::vector<Fetched> m_results;
+  bool m_shuttingDown;
+
+  // Compiled modules by absolute path. Only used on the context's thread.
+  std::unordered_map<std::string, std::unique_ptr<JS::PersistentRootedObject>>
+      m_modules;
+  Stats m_stats;
+};
+
+}  // namespace boilerplate
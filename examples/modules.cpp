@@ -0,0 +1,214 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <jsapi.h>
+
+#include <js/Conversions.h>
+
+#include "boilerplate.h"
+#include "moduleloader.h"
+
+// This example shows how to load ES modules from files with
+// boilerplate::ModuleLoader; see 'moduleloader.cpp' for how it reads and
+// compiles the modules of a graph in parallel.
+//
+// It writes a few small modules to a temporary directory and runs the main
+// one, which imports the others by relative paths and uses import.meta to
+// find out where it is. Then it generates a graph of 400 modules, each
+// importing two others, and times loading it with a single fetch thread and
+// with one per CPU. The second run finds the files in the OS's page cache, as
+// an application's modules would usually be, so the first one is a cold
+// start.
+
+using Clock = std::chrono::steady_clock;
+
+static const unsigned GraphSize = 400;
+
+// The sample modules, as paths relative to the temporary directory.
+static const struct {
+  const char* path;
+  const char* code;
+} sampleModules[] = {
+    {"main.js", R"js(
+import { greeting } from './lib/greeting.js';
+import { pad } from './util/pad.js';
+
+print(greeting('modules'));
+print(pad('main.js', 12) + '|');
+print(`loaded from ${import.meta.dirname}`);
+)js"},
+    {"lib/greeting.js", R"js(
+import { pad } from '../util/pad.js';
+
+export function greeting(name) {
+  return `Hello, ${pad(name, 10)}| from ${import.meta.filename}`;
+}
+)js"},
+    {"util/pad.js", R"js(
+export function pad(text, width) {
+  return text + ' '.repeat(Math.max(0, width - text.length));
+}
+)js"},
+};
+
+// Removes the files that it created, and then the directories, when it goes
+// out of scope.
+class TempTree {
+  std::string m_root;
+  std::vector<std::string> m_files;
+  std::vector<std::string> m_dirs;
+
+ public:
+  ~TempTree(void) {
+    for (const std::string& file : m_files) unlink(file.c_str());
+    for (auto it = m_dirs.rbegin(); it != m_dirs.rend(); ++it)
+      rmdir(it->c_str());
+    if (!m_root.empty()) rmdir(m_root.c_str());
+  }
+
+  bool create(void) {
+    char root[] = "/tmp/modules-XXXXXX";
+    if (!mkdtemp(root)) {
+      perror("mkdtemp");
+      return false;
+    }
+    m_root = root;
+    return true;
+  }
+
+  const std::string& root(void) const { return m_root; }
+
+  bool mkdir(const std::string& dir) {
+    std::string path = m_root + '/' + dir;
+    if (::mkdir(path.c_str(), 0700) != 0) {
+      perror("mkdir");
+      return false;
+    }
+    m_dirs.push_back(path);
+    return true;
+  }
+
+  bool write(const std::string& file, const std::string& contents) {
+    std::string path = m_root + '/' + file;
+    std::ofstream out(path);
+    out << contents;
+    m_files.push_back(path);
+    if (!out) {
+      std::cerr << "could not write " << path << '\n';
+      return false;
+    }
+    return true;
+  }
+};
+
+static bool Print(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  JS::RootedString str(cx, JS::ToString(cx, args.get(0)));
+  if (!str) return false;
+  JS::UniqueChars chars = JS_EncodeStringToUTF8(cx, str);
+  if (!chars) return false;
+  std::cout << chars.get() << '\n';
+  args.rval().setUndefined();
+  return true;
+}
+
+static const JSFunctionSpec globalFunctions[] = {JS_FN("print", &Print, 1, 0),
+                                                 JS_FS_END};
+
+// Module n imports modules 2n + 1 and 2n + 2, if there are that many. Every
+// other module is large enough to be compiled off-thread.
+static std::string GraphModule(unsigned n) {
+  std::ostringstream out;
+  unsigned imports = 0;
+  for (unsigned child = 2 * n + 1; child <= 2 * n + 2; child++) {
+    if (child >= GraphSize) break;
+    out << "import { value as v" << child << " } from './m" << child
+        << ".js';\n";
+    imports++;
+  }
+
+  unsigned functions = n % 2 ? 200 : 5;
+  for (unsigned ix = 0; ix < functions; ix++) {
+    out << "function f" << ix << "(x) {\n"
+        << "  const y = x * " << ix + 1 << " + " << n << ";\n"
+        << "  return y % 7 === 0 ? y : y - 1;\n"
+        << "}\n";
+  }
+
+  out << "export const value = f0(" << n << ")";
+  for (unsigned child = 2 * n + 1; child < 2 * n + 1 + imports; child++)
+    out << " + v" << child;
+  out << ";\n";
+  return out.str();
+}
+
+static bool RunSample(JSContext* cx) {
+  TempTree tree;
+  if (!tree.create() || !tree.mkdir("lib") || !tree.mkdir("util"))
+    return false;
+  for (const auto& module : sampleModules) {
+    if (!tree.write(module.path, module.code)) return false;
+  }
+
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) return false;
+  JSAutoRealm ar(cx, global);
+  if (!JS_DefineFunctions(cx, global, globalFunctions)) return false;
+
+  boilerplate::ModuleLoader loader;
+  return loader.init(cx) && loader.run(cx, tree.root() + "/main.js");
+}
+
+static bool LoadGraph(JSContext* cx, const std::string& path,
+                      unsigned fetchThreads) {
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) return false;
+  JSAutoRealm ar(cx, global);
+
+  boilerplate::ModuleLoader loader(fetchThreads);
+  if (!loader.init(cx)) return false;
+
+  Clock::time_point start = Clock::now();
+  JS::RootedObject module(cx);
+  if (!loader.load(cx, path, &module)) return false;
+  std::chrono::duration<double, std::milli> loaded = Clock::now() - start;
+  if (!JS::ModuleEvaluate(cx, module)) return false;
+
+  const boilerplate::ModuleLoader::Stats& stats = loader.stats();
+  std::cout << (fetchThreads ? "1 fetch thread" : "1 fetch thread per CPU")
+            << ": " << loaded.count() << " ms for " << stats.fetched
+            << " modules, " << stats.compiledOffThread
+            << " compiled off-thread, " << stats.compiledOnThread
+            << " on the main thread\n";
+  return true;
+}
+
+static bool RunGraph(JSContext* cx) {
+  TempTree tree;
+  if (!tree.create()) return false;
+  for (unsigned n = 0; n < GraphSize; n++) {
+    if (!tree.write("m" + std::to_string(n) + ".js", GraphModule(n)))
+      return false;
+  }
+
+  std::string path = tree.root() + "/m0.js";
+  return LoadGraph(cx, path, 1) && LoadGraph(cx, path, 0);
+}
+
+static bool ModulesExample(JSContext* cx) {
+  return RunSample(cx) && RunGraph(cx);
+}
+
+int main(int argc, const char* argv[]) {
+  if (!boilerplate::RunExample(ModulesExample)) return 1;
+  return 0;
+}
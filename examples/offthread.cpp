@@ -0,0 +1,111 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <jsapi.h>
+
+#include <js/CompilationAndEvaluation.h>
+#include <js/SourceText.h>
+
+#include "boilerplate.h"
+#include "offthreadcompile.h"
+
+// This example shows how to compile large scripts on a helper thread with
+// boilerplate::OffThreadCompile, so that the main thread can keep running
+// other jobs in the meantime.
+//
+// For a range of source sizes it compares how long the main thread is blocked
+// when compiling synchronously, against how long it is blocked when compiling
+// off-thread (the time spent starting and finishing the compilation). While
+// the off-thread compilation is running, the main thread keeps executing a
+// small "ready job" and counts how many it got through.
+
+using Clock = std::chrono::steady_clock;
+using Milliseconds = std::chrono::duration<double, std::milli>;
+
+static std::u16string MakeSource(size_t targetBytes) {
+  static const char16_t chunk[] =
+      u"function f(a, b) { const xs = [a, b, 3]; "
+      u"return xs.map(x => x * 2).reduce((s, x) => s + x, 0); }\n";
+  std::u16string source;
+  while (source.length() * sizeof(char16_t) < targetBytes) source += chunk;
+  source += u"f(1, 2);\n";
+  return source;
+}
+
+static bool CompileReadyJob(JSContext* cx, JS::MutableHandleScript script) {
+  static const char* code = "[1, 2, 3].map(x => x + 1).length";
+
+  JS::CompileOptions options(cx);
+  options.setFileAndLine("job.js", 1);
+
+  JS::SourceText<mozilla::Utf8Unit> source;
+  return source.init(cx, code, strlen(code), JS::SourceOwnership::Borrowed) &&
+         JS::Compile(cx, options, source, script);
+}
+
+static bool MeasureSize(JSContext* cx, JS::HandleScript readyJob,
+                        size_t bytes) {
+  std::u16string text = MakeSource(bytes);
+
+  JS::CompileOptions options(cx);
+  options.setFileAndLine("big.js", 1);
+
+  // Synchronous: the main thread is blocked for the whole compilation.
+  Clock::time_point start = Clock::now();
+  {
+    JS::SourceText<char16_t> source;
+    JS::RootedScript script(cx);
+    if (!source.init(cx, text.data(), text.length(),
+                     JS::SourceOwnership::Borrowed) ||
+        !JS::Compile(cx, options, source, &script))
+      return false;
+  }
+  Milliseconds syncStall = Clock::now() - start;
+
+  // Off-thread: keep running ready jobs until the compilation is done.
+  boilerplate::OffThreadCompile compile;
+  start = Clock::now();
+  if (!compile.start(cx, options, std::move(text))) return false;
+  Milliseconds stall = Clock::now() - start;
+
+  unsigned jobsRun = 0;
+  JS::RootedValue rval(cx);
+  while (!compile.isReady()) {
+    if (!JS_ExecuteScript(cx, readyJob, &rval)) return false;
+    jobsRun++;
+  }
+
+  start = Clock::now();
+  JS::RootedScript script(cx);
+  if (!compile.finish(cx, &script)) return false;
+  stall += Clock::now() - start;
+
+  std::cout << bytes / 1024 << " KB\t" << syncStall.count() << " ms\t"
+            << stall.count() << " ms"
+            << (compile.isOffThread() ? "" : " (compiled on main thread)")
+            << '\t' << jobsRun << '\n';
+  return true;
+}
+
+static bool OffThreadExample(JSContext* cx) {
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) return false;
+
+  JSAutoRealm ar(cx, global);
+
+  JS::RootedScript readyJob(cx);
+  if (!CompileReadyJob(cx, &readyJob)) return false;
+
+  std::cout << "source\tsync stall\toff-thread stall\tjobs run meanwhile\n";
+  for (size_t kb : {4, 64, 256, 1024, 4096, 16384}) {
+    if (!MeasureSize(cx, readyJob, kb * 1024)) return false;
+  }
+  return true;
+}
+
+int main(int argc, const char* argv[]) {
+  if (!boilerplate::RunExample(OffThreadExample)) return 1;
+  return 0;
+}
@@ -0,0 +1,137 @@
+#include <jsapi.h>
+
+#include <js/CompilationAndEvaluation.h>
+
+#include "offthreadcompile.h"
+
+// OffThreadCompile compiles a script on one of SpiderMonkey's helper threads,
+// so that the thread running JavaScript doesn't stall while a large source is
+// parsed. The host starts the compilation, carries on with whatever else it
+// has to do (for example, running other jobs that are ready) and picks up the
+// compiled script with finish() once isReady() returns true.
+//
+// Compiling off-thread has some overhead of its own, so SpiderMonkey only
+// allows it for sources above a certain size (see JS::CanCompileOffThread()).
+// For smaller sources, start() doesn't do anything, and finish() compiles the
+// source on the current thread instead; callers don't have to tell the two
+// cases apart, although isOffThread() will tell them if they want to.
+//
+// The source text must stay alive until the compilation is finished, so
+// OffThreadCompile keeps its own copy.
+//
+// ES modules are compiled the same way with startModule() and
+// finishModule(); see 'moduleloader.cpp' for compiling many of them at once.
+
+boilerplate::OffThreadCompile::OffThreadCompile(void)
+    : m_cx(nullptr),
+      m_token(nullptr),
+      m_offThread(false),
+      m_module(false),
+      m_ready(false) {}
+
+boilerplate::OffThreadCompile::~OffThreadCompile(void) {
+  // A compilation that was started but never finished must be waited for and
+  // canceled, so that the helper thread lets go of our source text.
+  if (!m_offThread) return;
+  wait();
+  if (!m_token) return;
+  if (m_module)
+    JS::CancelOffThreadModule(m_cx, m_token);
+  else
+    JS::CancelOffThreadScript(m_cx, m_token);
+}
+
+bool boilerplate::OffThreadCompile::start(
+    JSContext* cx, const JS::ReadOnlyCompileOptions& options,
+    std::u16string text) {
+  return start(cx, options, std::move(text), false);
+}
+
+bool boilerplate::OffThreadCompile::startModule(
+    JSContext* cx, const JS::ReadOnlyCompileOptions& options,
+    std::u16string text) {
+  return start(cx, options, std::move(text), true);
+}
+
+bool boilerplate::OffThreadCompile::start(
+    JSContext* cx, const JS::ReadOnlyCompileOptions& options,
+    std::u16string text, bool module) {
+  m_cx = cx;
+  m_module = module;
+  m_text = std::move(text);
+  if (!m_source.init(cx, m_text.data(), m_text.length(),
+                     JS::SourceOwnership::Borrowed))
+    return false;
+
+  if (!JS::CanCompileOffThread(cx, options, m_text.length())) {
+    // Keep the options for compiling synchronously in finish().
+    m_syncOptions.emplace(cx);
+    if (!m_syncOptions->copy(cx, options)) return false;
+    m_ready = true;
+    return true;
+  }
+
+  if (module) {
+    m_offThread = JS::CompileOffThreadModule(
+        cx, options, m_source, &OffThreadCompile::OnCompiled, this);
+  } else {
+    m_offThread = JS::CompileOffThread(cx, options, m_source,
+                                       &OffThreadCompile::OnCompiled, this);
+  }
+  return m_offThread;
+}
+
+// Called on the helper thread when the compilation is done. It's not allowed
+// to use any JSAPI here; the result has to be picked up on the main thread
+// with JS::FinishOffThreadScript().
+void boilerplate::OffThreadCompile::OnCompiled(JS::OffThreadToken* token,
+                                               void* data) {
+  auto* self = static_cast<OffThreadCompile*>(data);
+  {
+    std::lock_guard<std::mutex> guard(self->m_lock);
+    self->m_token = token;
+    self->m_ready = true;
+  }
+  self->m_done.notify_all();
+}
+
+// Block until the compilation is done.
+void boilerplate::OffThreadCompile::wait(void) {
+  std::unique_lock<std::mutex> guard(m_lock);
+  m_done.wait(guard, [this] { return m_ready.load(); });
+}
+
+// Get the compiled script, waiting for it if it isn't ready yet. Returns false
+// with an exception pending if there was a syntax error.
+bool boilerplate::OffThreadCompile::finish(JSContext* cx,
+                                           JS::MutableHandleScript script) {
+  if (m_syncOptions) {
+    bool ok = JS::Compile(cx, *m_syncOptions, m_source, script);
+    m_syncOptions.reset();
+    return ok;
+  }
+
+  wait();
+
+  JS::OffThreadToken* token = m_token;
+  m_token = nullptr;
+  script.set(JS::FinishOffThreadScript(cx, token));
+  return !!script;
+}
+
+// The same for a module started with startModule().
+bool boilerplate::OffThreadCompile::finishModule(
+    JSContext* cx, JS::MutableHandleObject module) {
+  if (m_syncOptions) {
+    bool ok = JS::CompileModule(cx, *m_syncOptions, m_source, module);
+    m_syncOptions.reset();
+    return ok;
+  }
+
+  wait();
+
+  JS::OffThreadToken* token = m_token;
+  m_token = nullptr;
+  module.set(JS::FinishOffThreadModule(cx, token));
+  return !!module;
+}
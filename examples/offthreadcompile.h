@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+#include <jsapi.h>
+
+#include <mozilla/Maybe.h>
+
+#include <js/SourceText.h>
+
+// See 'offthreadcompile.cpp' for documentation.
+
+namespace boilerplate {
+
+class OffThreadCompile {
+ public:
+  OffThreadCompile(void);
+  ~OffThreadCompile(void);
+
+  OffThreadCompile(const OffThreadCompile&) = delete;
+  OffThreadCompile& operator=(const OffThreadCompile&) = delete;
+
+  bool start(JSContext* cx, const JS::ReadOnlyCompileOptions& options,
+             std::u16string text);
+  // The same for an ES module; pick it up with finishModule().
+  bool startModule(JSContext* cx, const JS::ReadOnlyCompileOptions& options,
+                   std::u16string text);
+  bool isOffThread(void) const { return m_offThread; }
+  bool isReady(void) const { return m_ready.load(); }
+  void wait(void);
+  bool finish(JSContext* cx, JS::MutableHandleScript script);
+  bool finishModule(JSContext* cx, JS::MutableHandleObject module);
+
+ private:
+  bool start(JSContext* cx, const JS::ReadOnlyCompileOptions& options,
+             std::u16string text, bool module);
+  static void OnCompiled(JS::OffThreadToken* token, void* data);
+
+  JSContext* m_cx;
+  std::u16string m_text;
+  JS::SourceText<char16_t> m_source;
+  JS::OffThreadToken* m_token;
+  bool m_offThread;
+  bool m_module;
+  mozilla::Maybe<JS::OwningCompileOptions> m_syncOptions;
+
+  std::atomic<bool> m_ready;
+  std::mutex m_lock;
+  std::condition_variable m_done;
+};
+
+}  // namespace boilerplate
@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <jsapi.h>
+#include <jsfriendapi.h>
+
+#include <js/JSON.h>
+
+#include "boilerplate.h"
+#include "opcodecounts.h"
+
+// Counts how many times each bytecode opcode is executed while an example
+// runs, which shows what a workload spends its time on at the level of the
+// engine, for example whether property accesses are by name or by element.
+//
+// This uses SpiderMonkey's PC count profiling: after
+// js::StartPCCountProfiling(), the engine keeps a counter for each
+// instruction of each script it runs, in the interpreter and in the Baseline
+// JIT. That makes the scripts slower, so the counts are for comparing
+// workloads, not for timing them. js::StopPCCountProfiling() keeps the
+// scripts and their counters, and js::GetPCCountScriptContents() gives them
+// for each script as JSON, in which each instruction has the opcode's name
+// and its count under "counts.interp":
+//
+//   {"opcodes": [{"id": 0, "line": 1, "name": "getgname",
+//                 "counts": {"interp": 1000}}, ...], ...}
+//
+// OpcodeCounter adds these up per opcode name. The names are all the report
+// gives: the engine has no public API for an opcode's value, length, stack
+// effects or flags, and a table of those compiled into the embedding is only
+// right for the exact engine version it was generated from. (If you need
+// them, tools/make_opcode_doc.py writes docs/Opcodes.json from the Opcodes.h
+// of the SpiderMonkey you build against.)
+//
+// RunExample() runs an example under an OpcodeCounter when it's given
+// --opcode-counts=FILE, or BOILERPLATE_OPCODE_COUNTS=FILE is set; see
+// 'boilerplate.cpp'.
+
+boilerplate::OpcodeCounter::OpcodeCounter(void) : m_total(0), m_scripts(0) {}
+
+void boilerplate::OpcodeCounter::start(JSContext* cx) {
+  m_counts.clear();
+  m_total = 0;
+  m_scripts = 0;
+  js::StartPCCountProfiling(cx);
+}
+
+bool boilerplate::OpcodeCounter::stop(JSContext* cx) {
+  js::StopPCCountProfiling(cx);
+
+  // Parsing the JSON needs a realm; the example's may be gone by now.
+  JS::RootedObject global(cx, CreateGlobal(cx));
+  if (!global) return false;
+  JSAutoRealm ar(cx, global);
+
+  size_t count = js::GetPCCountScriptCount(cx);
+  bool ok = true;
+  for (size_t ix = 0; ok && ix < count; ix++) ok = addScript(cx, ix);
+
+  // The engine keeps the scripts alive until the counts are purged.
+  js::PurgePCCounts(cx);
+  return ok;
+}
+
+static bool GetNumber(JSContext* cx, JS::HandleObject obj, const char* name,
+                      double* number) {
+  JS::RootedValue value(cx);
+  if (!JS_GetProperty(cx, obj, name, &value)) return false;
+  *number = value.isNumber() ? value.toNumber() : 0;
+  return true;
+}
+
+bool boilerplate::OpcodeCounter::addScript(JSContext* cx, size_t index) {
+  JS::RootedString contents(cx, js::GetPCCountScriptContents(cx, index));
+  if (!contents) return false;
+  JS::RootedValue json(cx);
+  if (!JS_ParseJSON(cx, contents, &json)) return false;
+  if (!json.isObject()) return true;
+  m_scripts++;
+
+  JS::RootedObject script(cx, &json.toObject());
+  JS::RootedValue value(cx);
+  if (!JS_GetProperty(cx, script, "opcodes", &value)) return false;
+  if (!value.isObject()) return true;
+  JS::RootedObject opcodes(cx, &value.toObject());
+  uint32_t length;
+  if (!JS_GetArrayLength(cx, opcodes, &length)) return false;
+
+  JS::RootedObject opcode(cx), counts(cx);
+  JS::RootedString name(cx);
+  std::string nameChars;
+  for (uint32_t ix = 0; ix < length; ix++) {
+    if (!JS_GetElement(cx, opcodes, ix, &value)) return false;
+    if (!value.isObject()) continue;
+    opcode = &value.toObject();
+
+    // Instructions that never ran have no counts.
+    if (!JS_GetProperty(cx, opcode, "counts", &value)) return false;
+    if (!value.isObject()) continue;
+    counts = &value.toObject();
+    double executed;
+    if (!GetNumber(cx, counts, "interp", &executed)) return false;
+    if (executed <= 0) continue;
+
+    if (!JS_GetProperty(cx, opcode, "name", &value)) return false;
+    if (!value.isString()) continue;
+    name = value.toString();
+    JS::UniqueChars chars = JS_EncodeStringToUTF8(cx, name);
+    if (!chars) return false;
+    nameChars = chars.get();
+
+    uint64_t n = uint64_t(executed);
+    m_total += n;
+    m_counts[nameChars] += n;
+  }
+  return true;
+}
+
+void boilerplate::OpcodeCounter::write(std::ostream& out) const {
+  std::vector<std::pair<uint64_t, const std::string*>> executed;
+  for (const auto& entry : m_counts)
+    executed.emplace_back(entry.second, &entry.first);
+  std::sort(executed.begin(), executed.end(),
+            [](const auto& a, const auto& b) {
+              return a.first > b.first ||
+                     (a.first == b.first && *a.second < *b.second);
+            });
+
+  for (const auto& entry : executed) {
+    double percent = m_total ? 100.0 * entry.first / m_total : 0.0;
+    out << entry.first << '\t' << percent << '\t' << *entry.second << '\n';
+  }
+}
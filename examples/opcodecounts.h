@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+#include <jsapi.h>
+
+// See 'opcodecounts.cpp' for documentation.
+
+namespace boilerplate {
+
+class OpcodeCounter {
+ public:
+  OpcodeCounter(void);
+
+  OpcodeCounter(const OpcodeCounter&) = delete;
+  OpcodeCounter& operator=(const OpcodeCounter&) = delete;
+
+  // Starts counting the opcodes executed by scripts in the runtime of 'cx'.
+  // Counts from an earlier start() are thrown away.
+  void start(JSContext* cx);
+
+  // Stops counting, and adds up the counts of each opcode. Returns false on
+  // failure, with an exception pending.
+  bool stop(JSContext* cx);
+
+  // Executions of the opcode with this name, as the engine's reports spell
+  // it (for example "getprop"), delivered by stop().
+  uint64_t count(const std::string& name) const {
+    auto found = m_counts.find(name);
+    return found != m_counts.end() ? found->second : 0;
+  }
+  uint64_t total(void) const { return m_total; }
+  size_t scripts(void) const { return m_scripts; }
+
+  // One line per opcode that was executed, the most executed first: the
+  // count, the percentage of the total, and the name, separated by tabs.
+  void write(std::ostream& out) const;
+
+ private:
+  bool addScript(JSContext* cx, size_t index);
+
+  std::unordered_map<std::string, uint64_t> m_counts;
+  uint64_t m_total;
+  size_t m_scripts;
+};
+
+}  // namespace boilerplate
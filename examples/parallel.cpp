@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <js/Initialization.h>
+
+#include "executor.h"
+
+// This example shows how to use all the cores in a machine from one process,
+// by running scripts on a boilerplate::ScriptExecutor. Each worker thread has
+// its own JSContext and global object; SpiderMonkey does not allow sharing a
+// context between threads.
+//
+// It runs the same batch of CPU-bound jobs on executors with 1 up to N threads
+// (N = number of cores by default, or the first argument) and reports the
+// throughput and the scaling relative to one thread.
+
+static const char* job = R"js(
+  function fib(n) { return n < 2 ? n : fib(n - 1) + fib(n - 2); }
+  fib(22);
+)js";
+
+static constexpr unsigned numJobs = 400;
+
+using Clock = std::chrono::steady_clock;
+
+static bool RunBatch(size_t numThreads, double* jobsPerSecond) {
+  boilerplate::ScriptExecutor executor(numThreads);
+  if (!executor.init()) return false;
+
+  std::vector<std::future<boilerplate::ScriptResult>> results;
+  results.reserve(numJobs);
+
+  Clock::time_point start = Clock::now();
+  for (unsigned ix = 0; ix < numJobs; ix++)
+    results.push_back(executor.submit(job));
+
+  bool ok = true;
+  for (auto& future : results) {
+    boilerplate::ScriptResult result = future.get();
+    if (!result.ok) {
+      std::cerr << "job failed: " << result.value << '\n';
+      ok = false;
+    }
+  }
+  std::chrono::duration<double> elapsed = Clock::now() - start;
+
+  *jobsPerSecond = numJobs / elapsed.count();
+  return ok;
+}
+
+int main(int argc, const char* argv[]) {
+  size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+  if (argc > 1) maxThreads = std::max(1, atoi(argv[1]));
+
+  if (!JS_Init()) return 1;
+
+  bool ok = true;
+  double baseline = 0;
+  std::cout << "threads  jobs/s  scaling\n";
+  for (size_t numThreads = 1; numThreads <= maxThreads; numThreads++) {
+    double jobsPerSecond;
+    if (!RunBatch(numThreads, &jobsPerSecond)) {
+      ok = false;
+      break;
+    }
+    if (numThreads == 1) baseline = jobsPerSecond;
+
+    std::cout << numThreads << "  " << jobsPerSecond << "  "
+              << jobsPerSecond / baseline << "x\n";
+  }
+
+  JS_ShutDown();
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,83 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include <jsapi.h>
+
+#include <js/Conversions.h>
+
+#include "boilerplate.h"
+#include "transcode.h"
+
+// This example shows how to cut the startup time of a program by loading
+// precompiled bytecode from disk, using the helpers in 'transcode.cpp'.
+//
+// The first time you run it, it compiles the program from source and writes
+// the bytecode to a file (by default 'precompile.xdr' in the current
+// directory, or the path given as the first argument). On later runs it loads
+// the bytecode from that file instead. If the file doesn't match, because it's
+// from a different build of SpiderMonkey or of this program, it falls back to
+// compiling the source and rewrites the file.
+
+static const char* cachePath = "precompile.xdr";
+
+// A program that is large enough that parsing it takes a measurable amount of
+// time. Real-world programs would of course be loaded from somewhere.
+static std::string MakeTestProgram(void) {
+  std::string program;
+  for (unsigned ix = 0; ix < 2000; ix++) {
+    std::string n = std::to_string(ix);
+    program += "function f" + n + "(a, b) {\n" +
+               "  const items = [a, b, " + n + "].map(x => x * 2);\n" +
+               "  return items.reduce((acc, x) => acc + x, 0);\n" +
+               "}\n";
+  }
+  program += "f0(1, 2) + f1999(3, 4);\n";
+  return program;
+}
+
+static bool PrecompileExample(JSContext* cx) {
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) return false;
+
+  JSAutoRealm ar(cx, global);
+
+  std::string program = MakeTestProgram();
+
+  JS::CompileOptions options(cx);
+  options.setFileAndLine("program.js", 1);
+
+  auto start = std::chrono::steady_clock::now();
+
+  JS::RootedScript script(cx);
+  bool fromCache;
+  if (!boilerplate::CompileWithBytecodeCache(cx, options, program.c_str(),
+                                             program.length(), cachePath,
+                                             &script, &fromCache))
+    return false;
+
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  JS::RootedValue rval(cx);
+  if (!JS_ExecuteScript(cx, script, &rval)) return false;
+
+  JS::RootedString rval_str(cx, JS::ToString(cx, rval));
+  if (!rval_str) return false;
+
+  std::cout << (fromCache ? "loaded bytecode from " : "compiled and wrote ")
+            << cachePath << " in " << elapsed.count() << " ms\n"
+            << "result: " << JS_EncodeStringToASCII(cx, rval_str).get()
+            << '\n';
+  return true;
+}
+
+int main(int argc, const char* argv[]) {
+  if (argc > 1) cachePath = argv[1];
+
+  // The build ID must be set before any scripts are encoded or decoded.
+  boilerplate::SetBuildIdOp();
+
+  if (!boilerplate::RunExample(PrecompileExample)) return 1;
+  return 0;
+}
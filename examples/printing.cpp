@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <chrono>
+#include <codecvt>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <locale>
+#include <string>
+
+#include <jsapi.h>
+
+#include <js/CompilationAndEvaluation.h>
+#include <js/Conversions.h>
+#include <js/SourceText.h>
+#include <mozilla/Range.h>
+
+#include "boilerplate.h"
+#include "textbuffer.h"
+
+// This example measures how fast large results can be turned into UTF-8 text
+// for printing, as the REPL does with every result. See 'textbuffer.cpp' for
+// how boilerplate::TextBuffer does it.
+//
+// For each of a few multi-megabyte results, it compares:
+//
+// - encode: JS::ToString(), JS_EncodeStringToUTF8(), and copying the result
+//   into a std::string, which is what the REPL used to do.
+// - codecvt: for two-byte strings only, std::wstring_convert, which the REPL
+//   used for the source lines in error messages.
+// - buffer: JS::ToString(), and TextBuffer::appendString() into a buffer that
+//   is reused from one iteration to the next.
+//
+// The size of the results, in millions of characters, can be given as an
+// argument.
+
+static unsigned megachars = 8;
+static constexpr unsigned iterations = 10;
+
+using Clock = std::chrono::steady_clock;
+using Seconds = std::chrono::duration<double>;
+
+static const struct {
+  const char* name;
+  const char* code;  // 'n' is the number of characters
+} results[] = {
+    {"ASCII", "'x'.repeat(n)"},
+    {"Latin-1", "'caf\\u00e9 '.repeat(n / 5)"},
+    {"two-byte, mostly ASCII", "'\\u20ac' + 'x'.repeat(n - 1)"},
+    {"two-byte, CJK", "'\\u65e5\\u672c\\u8a9e'.repeat(n / 3)"},
+    {"two-byte, emoji", "'\\ud83d\\ude00 '.repeat(n / 3)"},
+    {"array of numbers", "Array.from({length: n / 8}, (_, i) => i * 1000)"},
+};
+
+static bool Evaluate(JSContext* cx, const char* code,
+                     JS::MutableHandleValue rval) {
+  JS::CompileOptions options(cx);
+  options.setFileAndLine("printing", 1);
+  JS::SourceText<mozilla::Utf8Unit> source;
+  return source.init(cx, code, strlen(code), JS::SourceOwnership::Borrowed) &&
+         JS::Evaluate(cx, options, source, rval);
+}
+
+static bool WithEncode(JSContext* cx, JS::HandleValue value,
+                       std::string* out) {
+  JS::RootedString str(cx, JS::ToString(cx, value));
+  if (!str) return false;
+  JS::UniqueChars chars(JS_EncodeStringToUTF8(cx, str));
+  if (!chars) return false;
+  *out = chars.get();
+  return true;
+}
+
+static bool WithCodecvt(JSContext* cx, JS::HandleValue value,
+                        std::string* out) {
+  JS::RootedString str(cx, JS::ToString(cx, value));
+  if (!str) return false;
+
+  // Copy the characters, since wstring_convert may allocate; that's one more
+  // copy than the REPL made, which already had them in the error report.
+  size_t length = JS_GetStringLength(str);
+  std::u16string chars(length, u'\0');
+  if (!JS_CopyStringChars(
+          cx, mozilla::Range<char16_t>(&chars[0], length), str))
+    return false;
+
+  std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t> converter{};
+  *out = converter.to_bytes(chars);
+  return true;
+}
+
+static bool WithBuffer(JSContext* cx, JS::HandleValue value,
+                       boilerplate::TextBuffer* out) {
+  JS::RootedString str(cx, JS::ToString(cx, value));
+  if (!str) return false;
+  out->clear();
+  return out->appendString(cx, str);
+}
+
+// Runs 'format' a number of times and returns the best time, in seconds.
+template <typename F>
+static bool Measure(F format, double* best) {
+  *best = 1e9;
+  for (unsigned ix = 0; ix < iterations; ix++) {
+    Clock::time_point start = Clock::now();
+    if (!format()) return false;
+    Seconds elapsed = Clock::now() - start;
+    *best = std::min(*best, elapsed.count());
+  }
+  return true;
+}
+
+static bool PrintingExample(JSContext* cx) {
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) return false;
+  JSAutoRealm ar(cx, global);
+
+  std::string setup = "var n = " + std::to_string(megachars * 1000000) + ";";
+  JS::RootedValue value(cx);
+  if (!Evaluate(cx, setup.c_str(), &value)) return false;
+
+  std::cout << "result\tUTF-8 size\tencode\tcodecvt\tbuffer\n";
+
+  std::string text;
+  boilerplate::TextBuffer buffer;
+  for (const auto& result : results) {
+    if (!Evaluate(cx, result.code, &value)) return false;
+    bool twoByte =
+        value.isString() && !JS_StringHasLatin1Chars(value.toString());
+
+    double encode, codecvt = 0, buffered;
+    if (!Measure([&]() { return WithEncode(cx, value, &text); }, &encode) ||
+        (twoByte &&
+         !Measure([&]() { return WithCodecvt(cx, value, &text); }, &codecvt)) ||
+        !Measure([&]() { return WithBuffer(cx, value, &buffer); }, &buffered))
+      return false;
+
+    if (buffer.size() != text.size() ||
+        memcmp(buffer.data(), text.data(), text.size()) != 0) {
+      std::cerr << result.name << ": output differs\n";
+      return false;
+    }
+
+    double mb = text.size() / 1e6;
+    std::cout << result.name << '\t' << mb << " MB\t" << mb / encode
+              << " MB/s\t";
+    if (twoByte)
+      std::cout << mb / codecvt << " MB/s\t";
+    else
+      std::cout << "-\t";
+    std::cout << mb / buffered << " MB/s\n";
+  }
+  return true;
+}
+
+int main(int argc, const char* argv[]) {
+  if (argc > 1) megachars = strtoul(argv[1], nullptr, 10);
+
+  if (!boilerplate::RunExample(PrintingExample)) return 1;
+  return 0;
+}
@@ -0,0 +1,281 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <pthread.h>
+#include <signal.h>
+
+#include <jsapi.h>
+#include <jsfriendapi.h>
+
+#include <js/ProfilingStack.h>
+
+#include "profiler.h"
+
+// A Profiler finds out where the scripts of a context spend their time, by
+// sampling the context's JS stack at a fixed interval, and counting how often
+// each stack, and each line of each script, came up.
+//
+// SpiderMonkey keeps a "profiling stack" for this, the same one that the
+// Gecko profiler in Firefox reads. Once a js::ProfilingStack is registered
+// with js::SetContextProfilingStack() and enabled with
+// js::EnableContextProfilingStack(), every time a script is entered a frame
+// is pushed onto it, holding the script and its current bytecode position.
+// The stack is meant to be read while its thread is interrupted: a sampler
+// thread sends the context's thread a SIGPROF signal with pthread_kill(), and
+// the signal handler copies the stack, at whatever point the thread was.
+// Unlike the interrupt callback that boilerplate::Watchdog uses, that also
+// catches the thread when it is in a native function or in GC.
+//
+// A signal handler may only do a few things: it must not allocate, take
+// locks, or call into SpiderMonkey in any way that could. So the handler
+// formats the stack into a fixed buffer, using only the frames' labels and
+// strings, JS_GetScriptFilename(), and JS_PCToLineNumber(), which just read
+// the script; this is what Gecko's sampler does too. The sampler thread then
+// adds the formatted sample to its counts. Doing it while the thread is
+// stopped means the scripts can't be garbage collected from under us.
+//
+// Only frames that are entered through the interpreter or from C++ are
+// pushed; calls from JIT code to JIT code are not (Gecko finds those with
+// JS::ProfilingFrameIterator, which needs the machine registers of the
+// interrupted thread). By default, the Profiler turns the JITs off while it
+// runs, so that all frames show up; that makes the scripts much slower, but
+// usually not in a way that changes where they spend their time. Scripts that
+// already have JIT code keep using it, so start profiling before running the
+// scripts of interest. With 'useJit', the JITs stay on, and time spent in JIT
+// code counts towards the nearest frame that is on the profiling stack.
+//
+// SpiderMonkey updates a frame's bytecode position when it calls another
+// function, so lines are exact for all frames but the innermost, for which
+// the line is that of its last call, or else its first line.
+//
+// This file uses SIGPROF and pthread_kill(), so it only works on POSIX
+// systems. The handler is process-wide, so only one Profiler can run at a
+// time; running one takes over SIGPROF, also for setitimer().
+
+static std::atomic<boilerplate::Profiler*> activeProfiler{nullptr};
+
+namespace {
+
+// Appends text to a fixed buffer, truncating if it's full. Safe to use in a
+// signal handler.
+class SampleWriter {
+ public:
+  SampleWriter(char* buffer, size_t capacity)
+      : m_start(buffer), m_pos(buffer), m_end(buffer + capacity) {}
+
+  void append(char c) {
+    if (m_pos < m_end) *m_pos++ = c;
+  }
+
+  // Semicolons separate frames and newlines separate stacks in the output,
+  // so they can't appear in a frame's name.
+  void append(const char* str, size_t length) {
+    for (size_t ix = 0; ix < length; ix++)
+      append(str[ix] == ';' || str[ix] == '\n' ? ':' : str[ix]);
+  }
+  void append(const char* str) { append(str, strlen(str)); }
+
+  void append(unsigned value) {
+    char digits[10];
+    size_t count = 0;
+    do {
+      digits[count++] = char('0' + value % 10);
+      value /= 10;
+    } while (value);
+    while (count) append(digits[--count]);
+  }
+
+  size_t length(void) const { return m_pos - m_start; }
+
+ private:
+  char* m_start;
+  char* m_pos;
+  char* m_end;
+};
+
+}  // namespace
+
+// The name of the function a JS frame is in. Its dynamic string, which
+// SpiderMonkey creates once per script, reads "name (file:line:column)", or
+// just "file:line:column" for top-level code.
+static void AppendFunctionName(SampleWriter* out, const char* dynamicString) {
+  if (dynamicString) {
+    const char* paren = strrchr(dynamicString, '(');
+    if (paren && paren > dynamicString + 1 && paren[-1] == ' ') {
+      out->append(dynamicString, paren - 1 - dynamicString);
+      return;
+    }
+  }
+  out->append("(top level)");
+}
+
+boilerplate::Profiler::Profiler(std::chrono::microseconds interval,
+                                bool useJit)
+    : m_interval(interval),
+      m_useJit(useJit),
+      m_baselineEnabled(1),
+      m_ionEnabled(1),
+      m_cx(nullptr),
+      m_stopping(false),
+      m_sampleReady(false),
+      m_sampleLength(0),
+      m_leafStart(0),
+      m_leafLength(0),
+      m_samples(0),
+      m_idleSamples(0) {}
+
+boilerplate::Profiler::~Profiler(void) { stop(); }
+
+bool boilerplate::Profiler::start(JSContext* cx) {
+  Profiler* expected = nullptr;
+  if (!activeProfiler.compare_exchange_strong(expected, this)) {
+    JS_ReportErrorASCII(cx, "another profiler is already running");
+    return false;
+  }
+
+  struct sigaction action = {};
+  action.sa_handler = SignalHandler;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(SIGPROF, &action, nullptr) != 0) {
+    activeProfiler = nullptr;
+    JS_ReportErrorASCII(cx, "could not install the SIGPROF handler");
+    return false;
+  }
+
+  m_cx = cx;
+  m_target = pthread_self();
+  js::SetContextProfilingStack(cx, &m_stack);
+  js::EnableContextProfilingStack(cx, true);
+  if (!m_useJit) {
+    JS_GetGlobalJitCompilerOption(cx, JSJITCOMPILER_BASELINE_ENABLE,
+                                  &m_baselineEnabled);
+    JS_GetGlobalJitCompilerOption(cx, JSJITCOMPILER_ION_ENABLE, &m_ionEnabled);
+    JS_SetGlobalJitCompilerOption(cx, JSJITCOMPILER_BASELINE_ENABLE, 0);
+    JS_SetGlobalJitCompilerOption(cx, JSJITCOMPILER_ION_ENABLE, 0);
+  }
+
+  m_stopping = false;
+  m_thread = std::thread(&Profiler::threadMain, this);
+  return true;
+}
+
+// Must be called on the profiled context's thread.
+void boilerplate::Profiler::stop(void) {
+  if (!m_cx) return;
+
+  m_stopping = true;
+  m_thread.join();
+
+  signal(SIGPROF, SIG_IGN);
+  js::EnableContextProfilingStack(m_cx, false);
+  js::SetContextProfilingStack(m_cx, nullptr);
+  if (!m_useJit) {
+    JS_SetGlobalJitCompilerOption(m_cx, JSJITCOMPILER_BASELINE_ENABLE,
+                                  m_baselineEnabled);
+    JS_SetGlobalJitCompilerOption(m_cx, JSJITCOMPILER_ION_ENABLE, m_ionEnabled);
+  }
+
+  m_cx = nullptr;
+  activeProfiler = nullptr;
+}
+
+void boilerplate::Profiler::SignalHandler(int signum) {
+  Profiler* profiler = activeProfiler.load();
+  if (profiler && pthread_equal(pthread_self(), profiler->m_target))
+    profiler->takeSample();
+}
+
+// Runs in the signal handler, on the profiled thread.
+void boilerplate::Profiler::takeSample(void) {
+  SampleWriter out(m_sample, MaxSampleLength);
+  m_leafStart = m_leafLength = 0;
+
+  uint32_t depth = m_stack.stackSize();
+  for (uint32_t ix = 0; ix < depth; ix++) {
+    const js::ProfilingStackFrame& frame = m_stack.frames[ix];
+    if (frame.isSpMarkerFrame()) continue;
+
+    if (out.length()) out.append(';');
+
+    if (!frame.isJsFrame()) {
+      out.append(frame.label());
+      if (frame.dynamicString()) {
+        out.append(' ');
+        out.append(frame.dynamicString());
+      }
+      continue;
+    }
+
+    AppendFunctionName(&out, frame.dynamicString());
+    out.append(" (");
+    size_t leafStart = out.length();
+
+    JSScript* script = frame.script();
+    jsbytecode* pc = script ? frame.pc() : nullptr;
+    const char* filename = script ? JS_GetScriptFilename(script) : nullptr;
+    out.append(filename ? filename : "?");
+    out.append(':');
+    out.append(pc ? JS_PCToLineNumber(script, pc) : 0u);
+
+    m_leafStart = leafStart;
+    m_leafLength = out.length() - leafStart;
+    out.append(')');
+  }
+
+  m_sampleLength = out.length();
+  m_sampleReady.store(true, std::memory_order_release);
+}
+
+void boilerplate::Profiler::threadMain(void) {
+  auto next = std::chrono::steady_clock::now();
+  while (!m_stopping) {
+    next += m_interval;
+    std::this_thread::sleep_until(next);
+
+    m_sampleReady = false;
+    if (pthread_kill(m_target, SIGPROF) != 0) break;
+    while (!m_sampleReady.load(std::memory_order_acquire))
+      std::this_thread::yield();
+
+    m_samples++;
+    if (m_sampleLength == 0) {
+      m_idleSamples++;  // not running any JS
+      continue;
+    }
+    m_stacks[std::string(m_sample, m_sampleLength)]++;
+    if (m_leafLength)
+      m_lines[std::string(m_sample + m_leafStart, m_leafLength)]++;
+
+    // If sampling fell behind, for example because the signal took long to
+    // be delivered, skip the samples that were missed instead of taking them
+    // all at once.
+    auto now = std::chrono::steady_clock::now();
+    if (next < now) next = now;
+  }
+}
+
+void boilerplate::Profiler::writeFolded(std::ostream& out) const {
+  for (const auto& entry : m_stacks)
+    out << entry.first << ' ' << entry.second << '\n';
+}
+
+void boilerplate::Profiler::writeLines(std::ostream& out) const {
+  std::vector<std::pair<uint64_t, const std::string*>> lines;
+  lines.reserve(m_lines.size());
+  for (const auto& entry : m_lines)
+    lines.emplace_back(entry.second, &entry.first);
+  std::sort(lines.begin(), lines.end(), [](const auto& a, const auto& b) {
+    return a.first > b.first || (a.first == b.first && *a.second < *b.second);
+  });
+
+  for (const auto& line : lines)
+    out << line.first << '\t' << *line.second << '\n';
+}
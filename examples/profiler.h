@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include <pthread.h>
+
+#include <jsapi.h>
+
+#include <js/ProfilingStack.h>
+
+// See 'profiler.cpp' for documentation.
+
+namespace boilerplate {
+
+class Profiler {
+ public:
+  // With 'useJit' false, the JITs are turned off while profiling, so that
+  // every JS frame shows up in the samples; see 'profiler.cpp'.
+  explicit Profiler(
+      std::chrono::microseconds interval = std::chrono::microseconds(1000),
+      bool useJit = false);
+  ~Profiler(void);
+
+  Profiler(const Profiler&) = delete;
+  Profiler& operator=(const Profiler&) = delete;
+
+  // Starts sampling the JS stack of 'cx', which must be the current thread's
+  // context. Only one Profiler can run at a time in a process.
+  bool start(JSContext* cx);
+  void stop(void);
+
+  // One line per distinct stack: the frames from the outermost in, separated
+  // by semicolons, then a space and the number of samples. This is the input
+  // format of flamegraph.pl and most other flame graph tools.
+  void writeFolded(std::ostream& out) const;
+
+  // One line per script and line that was running when a sample was taken,
+  // the most frequent first: the number of samples, a tab, 'file:line'.
+  void writeLines(std::ostream& out) const;
+
+  uint64_t samples(void) const { return m_samples; }
+  uint64_t idleSamples(void) const { return m_idleSamples; }
+
+ private:
+  static constexpr size_t MaxSampleLength = 4096;
+
+  static void SignalHandler(int signum);
+  void takeSample(void);
+  void threadMain(void);
+
+  std::chrono::microseconds m_interval;
+  bool m_useJit;
+  uint32_t m_baselineEnabled;  // the JIT options to restore after stopping
+  uint32_t m_ionEnabled;
+
+  JSContext* m_cx;
+  pthread_t m_target;
+  js::ProfilingStack m_stack;
+  std::thread m_thread;
+  std::atomic<bool> m_stopping;
+
+  // Written by the signal handler on the target thread, then read by the
+  // sampler thread once m_sampleReady is set.
+  std::atomic<bool> m_sampleReady;
+  char m_sample[MaxSampleLength];
+  size_t m_sampleLength;
+  size_t m_leafStart;  // where the innermost JS frame's 'file:line' starts
+  size_t m_leafLength;
+
+  // Only touched by the sampler thread while running.
+  std::unordered_map<std::string, uint64_t> m_stacks;
+  std::unordered_map<std::string, uint64_t> m_lines;
+  uint64_t m_samples;
+  uint64_t m_idleSamples;
+};
+
+}  // namespace boilerplate
@@ -0,0 +1,109 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <jsapi.h>
+
+#include <js/CompilationAndEvaluation.h>
+#include <js/SourceText.h>
+
+#include "boilerplate.h"
+#include "profiler.h"
+
+// This example shows how to find the hot functions and lines of a script with
+// boilerplate::Profiler. See 'profiler.cpp' for how the profiler works.
+//
+// It runs a script that spends its time in a few functions, under the
+// profiler, and prints the lines where most samples were taken. Then it
+// writes the folded stacks to the file given as an argument, or to stdout,
+// which can be turned into a flame graph with, for example:
+//
+//   ./profiling profile.folded && flamegraph.pl profile.folded > profile.svg
+//
+// Any example that passes a boilerplate::RuntimeConfig to RunExample() can be
+// profiled the same way without changing its code, by passing it
+// --profile=FILE (or setting BOILERPLATE_PROFILE=FILE) and optionally
+// --profile-jit. For example, './cookbook --profile=cookbook.folded'.
+
+static const char* workload = R"js(
+function fib(n) {
+  return n < 2 ? n : fib(n - 1) + fib(n - 2);
+}
+
+function buildStrings(count) {
+  let parts = [];
+  for (let i = 0; i < count; i++)
+    parts.push('item ' + i);
+  return parts.join(',').length;
+}
+
+function sortNumbers(count) {
+  let numbers = [];
+  for (let i = 0; i < count; i++)
+    numbers.push((i * 7919) % count);
+  numbers.sort((a, b) => a - b);
+  return numbers[0];
+}
+
+function main() {
+  let total = 0;
+  for (let round = 0; round < 5; round++) {
+    total += fib(22);
+    total += buildStrings(50000);
+    total += sortNumbers(50000);
+  }
+  return total;
+}
+
+main();
+)js";
+
+static const char* foldedOutput = nullptr;
+
+static bool ProfilingExample(JSContext* cx) {
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) return false;
+  JSAutoRealm ar(cx, global);
+
+  boilerplate::Profiler profiler;
+  if (!profiler.start(cx)) return false;
+
+  JS::CompileOptions options(cx);
+  options.setFileAndLine("workload.js", 1);
+  JS::SourceText<mozilla::Utf8Unit> source;
+  JS::RootedValue rval(cx);
+  bool ok = source.init(cx, workload, strlen(workload),
+                        JS::SourceOwnership::Borrowed) &&
+            JS::Evaluate(cx, options, source, &rval);
+  profiler.stop();
+  if (!ok) return false;
+
+  std::cout << profiler.samples() << " samples, " << profiler.idleSamples()
+            << " outside of JS\n\nsamples\tline\n";
+
+  // Only the ten hottest lines.
+  std::ostringstream lines;
+  profiler.writeLines(lines);
+  std::istringstream input(lines.str());
+  std::string line;
+  for (int count = 0; count < 10 && std::getline(input, line); count++)
+    std::cout << line << '\n';
+
+  if (!foldedOutput) {
+    std::cout << "\nfolded stacks:\n";
+    profiler.writeFolded(std::cout);
+    return true;
+  }
+  std::ofstream folded(foldedOutput);
+  profiler.writeFolded(folded);
+  return bool(folded);
+}
+
+int main(int argc, const char* argv[]) {
+  if (argc > 1) foldedOutput = argv[1];
+
+  if (!boilerplate::RunExample(ProfilingExample)) return 1;
+  return 0;
+}
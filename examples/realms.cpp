@@ -0,0 +1,159 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <jsapi.h>
+
+#include <js/CompilationAndEvaluation.h>
+#include <js/Conversions.h>
+#include <js/SourceText.h>
+
+#include "boilerplate.h"
+#include "realmtemplate.h"
+
+// This example shows how to give every request a fresh, isolated global
+// without paying for a whole new compartment and a full set of functions each
+// time, using boilerplate::RealmTemplate. See 'realmtemplate.cpp' for how it
+// works.
+//
+// For each of three ways to create a global, it creates a number of them while
+// keeping them all alive, measures how long each creation plus a small
+// request script takes, and how much the GC heap grows per global:
+//
+// - eager: boilerplate::CreateGlobal(), then all standard classes and the
+//   embedding's functions are defined upfront.
+// - fresh compartment: boilerplate::CreateGlobal(), which resolves standard
+//   classes lazily, then the embedding's functions are defined upfront.
+// - template realm: RealmTemplate::newRealm(), sharing one compartment, with
+//   everything resolved lazily.
+//
+// The number of globals can be given as the first argument.
+
+static unsigned numRealms = 2000;
+
+using Clock = std::chrono::steady_clock;
+using Microseconds = std::chrono::duration<double, std::micro>;
+
+static bool Noop(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  args.rval().setUndefined();
+  return true;
+}
+
+static bool Add(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  double a, b;
+  if (!JS::ToNumber(cx, args.get(0), &a) || !JS::ToNumber(cx, args.get(1), &b))
+    return false;
+  args.rval().setNumber(a + b);
+  return true;
+}
+
+// A typical embedding defines a few dozen functions on each global; we stand
+// in for them with these. The request script only uses one.
+static const JSFunctionSpec requestFunctions[] = {
+    JS_FN("add", Add, 2, 0),
+    JS_FN("log", Noop, 1, 0),
+    JS_FN("warn", Noop, 1, 0),
+    JS_FN("error", Noop, 1, 0),
+    JS_FN("fetch", Noop, 1, 0),
+    JS_FN("setHeader", Noop, 2, 0),
+    JS_FN("getHeader", Noop, 1, 0),
+    JS_FN("respond", Noop, 1, 0),
+    JS_FN("readBody", Noop, 0, 0),
+    JS_FN("getCookie", Noop, 1, 0),
+    JS_FN("setCookie", Noop, 2, 0),
+    JS_FN("redirect", Noop, 1, 0),
+    JS_FN("encodeBase64", Noop, 1, 0),
+    JS_FN("decodeBase64", Noop, 1, 0),
+    JS_FN("hash", Noop, 1, 0),
+    JS_FN("now", Noop, 0, 0),
+    JS_FS_END};
+
+static const char* requestScript =
+    "JSON.stringify({sum: add(1, 2), items: [1, 2, 3].map(x => x * 2)});";
+
+static JSObject* EagerGlobal(JSContext* cx) {
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) return nullptr;
+  JSAutoRealm ar(cx, global);
+  if (!JS::InitRealmStandardClasses(cx) ||
+      !JS_DefineFunctions(cx, global, requestFunctions))
+    return nullptr;
+  return global;
+}
+
+static JSObject* FreshCompartmentGlobal(JSContext* cx) {
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) return nullptr;
+  JSAutoRealm ar(cx, global);
+  if (!JS_DefineFunctions(cx, global, requestFunctions)) return nullptr;
+  return global;
+}
+
+static boilerplate::RealmTemplate* realmTemplate = nullptr;
+
+static JSObject* TemplateRealmGlobal(JSContext* cx) {
+  return realmTemplate->newRealm(cx);
+}
+
+static bool RunRequest(JSContext* cx, JS::HandleObject global) {
+  JSAutoRealm ar(cx, global);
+
+  JS::CompileOptions options(cx);
+  options.setFileAndLine("request", 1);
+  JS::SourceText<mozilla::Utf8Unit> source;
+  JS::RootedValue rval(cx);
+  return source.init(cx, requestScript, strlen(requestScript),
+                     JS::SourceOwnership::Borrowed) &&
+         JS::Evaluate(cx, options, source, &rval);
+}
+
+static bool Measure(JSContext* cx, const char* name,
+                    JSObject* (*createGlobal)(JSContext*)) {
+  JS_GC(cx);
+  uint32_t heapBefore = JS_GetGCParameter(cx, JSGC_BYTES);
+
+  JS::AutoObjectVector globals(cx);
+  if (!globals.reserve(numRealms)) return false;
+
+  JS::RootedObject global(cx);
+  Clock::time_point start = Clock::now();
+  for (unsigned ix = 0; ix < numRealms; ix++) {
+    global = createGlobal(cx);
+    if (!global || !RunRequest(cx, global)) return false;
+    globals.infallibleAppend(global);
+  }
+  Microseconds elapsed = Clock::now() - start;
+
+  JS_GC(cx);
+  uint32_t heapAfter = JS_GetGCParameter(cx, JSGC_BYTES);
+
+  std::cout << name << "\t" << elapsed.count() / numRealms << " us\t"
+            << (double(heapAfter) - heapBefore) / numRealms / 1024
+            << " KB\n";
+  return true;
+}
+
+static bool RealmsExample(JSContext* cx) {
+  boilerplate::RealmTemplate templ(requestFunctions, nullptr);
+  if (!templ.init(cx)) return false;
+  realmTemplate = &templ;
+
+  std::cout << numRealms << " globals\n"
+            << "kind\tcreate + request\tGC heap per global\n";
+  bool ok = Measure(cx, "eager", EagerGlobal) &&
+            Measure(cx, "fresh compartment", FreshCompartmentGlobal) &&
+            Measure(cx, "template realm", TemplateRealmGlobal);
+
+  realmTemplate = nullptr;
+  return ok;
+}
+
+int main(int argc, const char* argv[]) {
+  if (argc > 1) numRealms = strtoul(argv[1], nullptr, 10);
+
+  if (!boilerplate::RunExample(RealmsExample)) return 1;
+  return 0;
+}
@@ -0,0 +1,136 @@
+#include <jsapi.h>
+
+#include "realmtemplate.h"
+
+// A RealmTemplate creates fresh, isolated globals cheaply, for embeddings that
+// want to run each request in a clean environment.
+//
+// Creating a global with boilerplate::CreateGlobal() and then defining the
+// embedding's functions on it costs a new compartment, and creating every
+// function object, each time. Instead, the template creates one global in a
+// new compartment up front, and each request realm is created in that same
+// compartment with RealmCreationOptions::setExistingCompartment(). Realms
+// in one compartment share one set of cross-compartment wrappers, and live in
+// the same zone, which saves a lot of memory per realm. They still each have
+// their own global and their own standard classes, and scripts in one realm
+// can't reach the objects of another except through objects the embedding
+// hands them; but because no wrappers stand between objects of different
+// realms of a compartment, don't do that unless you mean to share the object.
+//
+// Nothing is defined on the new globals upfront. Like the default global
+// class ops, the global's class resolves standard classes such as Array or
+// Math lazily with JS_ResolveStandardClass(), when a script first uses them.
+// The embedding's own functions and properties are resolved lazily as well,
+// by a boilerplate::LazyProperties built from the JSFunctionSpec and
+// JSPropertySpec tables. The pinned ids that LazyProperties uses are created
+// once, on the template global, and each request global just points to the
+// same holder object, which is possible because they are in the same
+// compartment.
+//
+// Things that must be defined eagerly, such as classes created with
+// JS_InitClass(), can be set up in the RealmInit callback, which runs for each
+// new realm.
+//
+// mayResolve is called without an object in some cases; then it can't find
+// the LazyProperties and must say that any id may be resolved. That only
+// makes some JIT optimizations on the global less effective.
+
+const JSClassOps boilerplate::RealmTemplate::classOps = {
+    nullptr,  // addProperty
+    nullptr,  // deleteProperty
+    nullptr,  // enumerate
+    &RealmTemplate::NewEnumerate,
+    &RealmTemplate::Resolve,
+    &RealmTemplate::MayResolve,
+    nullptr,  // finalize
+    nullptr,  // call
+    nullptr,  // hasInstance
+    nullptr,  // construct
+    JS_GlobalObjectTraceHook,
+};
+
+const JSClass boilerplate::RealmTemplate::klass = {
+    "RequestGlobal", JSCLASS_GLOBAL_FLAGS, &RealmTemplate::classOps};
+
+constexpr uint32_t boilerplate::RealmTemplate::IdsSlot;
+constexpr uint32_t boilerplate::RealmTemplate::TemplateSlot;
+
+boilerplate::RealmTemplate::RealmTemplate(const JSFunctionSpec* functions,
+                                          const JSPropertySpec* properties,
+                                          RealmInit init)
+    : m_lazy(functions, properties, IdsSlot), m_init(init) {}
+
+boilerplate::RealmTemplate* boilerplate::RealmTemplate::FromGlobal(
+    JSObject* global) {
+  JS::Value slot = JS_GetReservedSlot(global, TemplateSlot);
+  if (slot.isUndefined()) return nullptr;  // still being set up
+  return static_cast<RealmTemplate*>(slot.toPrivate());
+}
+
+JSObject* boilerplate::RealmTemplate::createGlobal(
+    JSContext* cx, const JS::RealmOptions& options) {
+  // Don't fire the debugger's new global hook until the slots are set, since
+  // the debugger may look up properties on the global.
+  JS::RootedObject global(
+      cx, JS_NewGlobalObject(cx, &klass, nullptr, JS::DontFireOnNewGlobalHook,
+                             options));
+  if (!global) return nullptr;
+
+  JSAutoRealm ar(cx, global);
+  if (m_template) {
+    JS_SetReservedSlot(global, IdsSlot,
+                       JS_GetReservedSlot(m_template, IdsSlot));
+  } else if (!m_lazy.attach(cx, global)) {
+    return nullptr;
+  }
+  JS_SetReservedSlot(global, TemplateSlot, JS::PrivateValue(this));
+
+  if (m_init && !m_init(cx, global)) return nullptr;
+
+  JS_FireOnNewGlobalObject(cx, global);
+  return global;
+}
+
+bool boilerplate::RealmTemplate::init(JSContext* cx) {
+  JS::RealmOptions options;
+  JSObject* global = createGlobal(cx, options);
+  if (!global) return false;
+  m_template.init(cx, global);
+  return true;
+}
+
+JSObject* boilerplate::RealmTemplate::newRealm(JSContext* cx) {
+  JS::RealmOptions options;
+  options.creationOptions().setExistingCompartment(m_template);
+  return createGlobal(cx, options);
+}
+
+bool boilerplate::RealmTemplate::Resolve(JSContext* cx, JS::HandleObject obj,
+                                         JS::HandleId id, bool* resolved) {
+  if (!JS_ResolveStandardClass(cx, obj, id, resolved)) return false;
+  if (*resolved) return true;
+
+  RealmTemplate* self = FromGlobal(obj);
+  if (!self) return true;
+  return self->m_lazy.resolve(cx, obj, id, resolved);
+}
+
+bool boilerplate::RealmTemplate::MayResolve(const JSAtomState& names, jsid id,
+                                            JSObject* maybeObj) {
+  if (JS_MayResolveStandardClass(names, id, maybeObj)) return true;
+  if (!maybeObj) return true;
+
+  RealmTemplate* self = FromGlobal(maybeObj);
+  return !self || self->m_lazy.mayResolve(id);
+}
+
+bool boilerplate::RealmTemplate::NewEnumerate(
+    JSContext* cx, JS::HandleObject obj, JS::MutableHandleIdVector properties,
+    bool enumerableOnly) {
+  if (!JS_NewEnumerateStandardClasses(cx, obj, properties, enumerableOnly))
+    return false;
+
+  RealmTemplate* self = FromGlobal(obj);
+  if (!self) return true;
+  return self->m_lazy.newEnumerate(cx, obj, properties, enumerableOnly);
+}
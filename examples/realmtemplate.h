@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+
+#include <jsapi.h>
+
+#include "lazyproperties.h"
+
+// See 'realmtemplate.cpp' for documentation.
+
+namespace boilerplate {
+
+class RealmTemplate {
+ public:
+  // Runs once for each new realm, with the realm entered, for anything that
+  // can't be defined lazily. May be null.
+  using RealmInit = bool (*)(JSContext* cx, JS::HandleObject global);
+
+  // Both tables are terminated by JS_FS_END / JS_PS_END, and either may be
+  // null.
+  RealmTemplate(const JSFunctionSpec* functions,
+                const JSPropertySpec* properties, RealmInit init = nullptr);
+
+  RealmTemplate(const RealmTemplate&) = delete;
+  RealmTemplate& operator=(const RealmTemplate&) = delete;
+
+  bool init(JSContext* cx);
+
+  // Creates a new realm with a fresh global, in the template's compartment.
+  JSObject* newRealm(JSContext* cx);
+
+  JSObject* templateGlobal(void) const { return m_template; }
+
+ private:
+  static constexpr uint32_t IdsSlot = 0;
+  static constexpr uint32_t TemplateSlot = 1;
+  static_assert(TemplateSlot < JSCLASS_GLOBAL_APPLICATION_SLOTS,
+                "slots must be application slots of the global");
+
+  JSObject* createGlobal(JSContext* cx, const JS::RealmOptions& options);
+
+  static RealmTemplate* FromGlobal(JSObject* global);
+  static bool Resolve(JSContext* cx, JS::HandleObject obj, JS::HandleId id,
+                      bool* resolved);
+  static bool MayResolve(const JSAtomState& names, jsid id,
+                         JSObject* maybeObj);
+  static bool NewEnumerate(JSContext* cx, JS::HandleObject obj,
+                           JS::MutableHandleIdVector properties,
+                           bool enumerableOnly);
+
+  static const JSClassOps classOps;
+  static const JSClass klass;
+
+  LazyProperties m_lazy;
+  RealmInit m_init;
+  JS::PersistentRooted<JSObject*> m_template;
+};
+
+}  // namespace boilerplate
@@ -1,15 +1,15 @@
-#include <cassert>
-#include <codecvt>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <locale>
-#include <sstream>
 #include <string>
+#include <vector>
 
 #include <jsapi.h>
 #include <jsfriendapi.h>
 
-#include <mozilla/Unused.h>
-
 #include <js/CompilationAndEvaluation.h>
 #include <js/Conversions.h>
 #include <js/Initialization.h>
@@ -20,6 +20,11 @@
 #include <readline/readline.h>
 
 #include "boilerplate.h"
+#include "errorreporter.h"
+#include "gcstats.h"
+#include "memoryusage.h"
+#include "textbuffer.h"
+#include "watchdog.h"
 
 /* This is a longer example that illustrates how to build a simple
  * REPL (Read-Eval-Print Loop). */
@@ -29,14 +34,16 @@
  * Windows you may have to set your terminal's codepage to UTF-8. */
 
 class ReplGlobal {
-  bool m_shouldQuit : 1;
-
-  ReplGlobal(void) : m_shouldQuit(false) {}
-
-  static ReplGlobal* priv(JSObject* global) {
-    auto* retval = static_cast<ReplGlobal*>(JS_GetPrivate(global));
-    assert(retval);
-    return retval;
+  // The REPL's only state is one flag, so we store it in one of the reserved
+  // slots that global objects have available for the embedding's use, rather
+  // than allocating a C++ object and storing a pointer to it in the global's
+  // private slot.
+  static constexpr uint32_t ShouldQuitSlot = 0;
+  static_assert(ShouldQuitSlot < JSCLASS_GLOBAL_APPLICATION_SLOTS,
+                "slot must be one of the application slots of the global");
+
+  static bool shouldQuit(JSObject* global) {
+    return JS_GetReservedSlot(global, ShouldQuitSlot).isTrue();
   }
 
   static bool quit(JSContext* cx, unsigned argc, JS::Value* vp) {
@@ -46,24 +53,50 @@ class ReplGlobal {
 
     // Return an "uncatchable" exception, by returning false without setting an
     // exception to be pending. We distinguish it from any other uncatchable
-    // that the JS engine might throw, by setting m_shouldQuit
-    priv(global)->m_shouldQuit = true;
+    // that the JS engine might throw, by setting the should-quit flag
+    JS_SetReservedSlot(global, ShouldQuitSlot, JS::TrueValue());
     js::StopDrainingJobQueue(cx);
     return false;
   }
 
+  // memoryUsage() returns the memory used by the REPL's global, as an object
+  // with the fields of boilerplate::MemoryUsage. memoryUsage(true) also counts
+  // the objects and strings, which takes longer.
+  static bool memoryUsage(JSContext* cx, unsigned argc, JS::Value* vp) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    JS::RootedObject global(cx, JS::GetNonCCWObjectGlobal(&args.callee()));
+    if (!global) return false;
+
+    boilerplate::MemoryUsage usage;
+    if (!boilerplate::GetMemoryUsage(cx, global, &usage,
+                                     JS::ToBoolean(args.get(0))))
+      return false;
+
+    JSObject* result = boilerplate::MemoryUsageToObject(cx, usage);
+    if (!result) return false;
+    args.rval().setObject(*result);
+    return true;
+  }
+
   /* The class of the global object. */
   static constexpr JSClass klass = {"ReplGlobal",
-                                    JSCLASS_GLOBAL_FLAGS | JSCLASS_HAS_PRIVATE,
+                                    JSCLASS_GLOBAL_FLAGS,
                                     &JS::DefaultGlobalClassOps};
 
   static constexpr JSFunctionSpec functions[] = {
-      JS_FN("quit", &ReplGlobal::quit, 0, 0), JS_FS_END};
+      JS_FN("quit", &ReplGlobal::quit, 0, 0),
+      JS_FN("memoryUsage", &ReplGlobal::memoryUsage, 0, 0), JS_FS_END};
 
  public:
   static JSObject* create(JSContext* cx);
   static void loop(JSContext* cx, JS::HandleObject global);
+  static void stream(JSContext* cx, JS::HandleObject global);
+
+ private:
+  static void evaluate(JSContext* cx, JS::HandleObject global,
+                       const std::string& buffer, unsigned startline);
 };
+constexpr uint32_t ReplGlobal::ShouldQuitSlot;
 constexpr JSClass ReplGlobal::klass;
 constexpr JSFunctionSpec ReplGlobal::functions[];
 
@@ -72,129 +105,41 @@ static void die(const char* why) {
   exit(1);
 }
 
-// The PrintError functions are modified versions of private SpiderMonkey API:
-// js/src/vm/JSContext.cpp, js::PrintError()
-
-enum class PrintErrorKind { Error, Warning, StrictWarning, Note };
-
-static void PrintErrorLine(const std::string& prefix, JSErrorReport* report) {
-  const char16_t* linebuf = report->linebuf();
-  if (!linebuf) return;
-
-  size_t n = report->linebufLength();
-
-  std::cerr << ":\n";
-  if (!prefix.empty()) std::cerr << prefix;
-
-  std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t> converter{};
-  std::string linebuf_utf8 = converter.to_bytes(linebuf);
-  std::cerr << linebuf_utf8;
-
-  // linebuf usually ends with a newline. If not, add one here.
-  if (n == 0 || linebuf[n - 1] != '\n') std::cerr << '\n';
-
-  if (!prefix.empty()) std::cerr << prefix;
-
-  n = report->tokenOffset();
-  size_t ndots = 0;
-  for (size_t i = 0; i < n; i++) {
-    if (linebuf[i] == '\t') {
-      ndots += (ndots + 8) & ~7;
-      continue;
-    }
-    ndots++;
-  }
-  std::cerr << std::string(ndots, '.') << '^';
-}
-
-static void PrintErrorLine(const std::string& prefix,
-                           JSErrorNotes::Note* note) {}
-
-template <typename T>
-static bool PrintSingleError(T* report, PrintErrorKind kind) {
-  std::ostringstream prefix;
-  if (report->filename) prefix << report->filename << ':';
-
-  if (report->lineno) prefix << report->lineno << ':' << report->column << ' ';
-
-  if (kind != PrintErrorKind::Error) {
-    const char* kindPrefix = nullptr;
-    switch (kind) {
-      case PrintErrorKind::Error:
-        MOZ_CRASH("unreachable");
-      case PrintErrorKind::Warning:
-        kindPrefix = "warning";
-        break;
-      case PrintErrorKind::StrictWarning:
-        kindPrefix = "strict warning";
-        break;
-      case PrintErrorKind::Note:
-        kindPrefix = "note";
-        break;
-    }
-
-    prefix << kindPrefix << ": ";
-  }
-
-  const char* message = report->message().c_str();
-
-  /* embedded newlines -- argh! */
-  const char* ctmp;
-  while ((ctmp = strchr(message, '\n')) != 0) {
-    ctmp++;
-    if (prefix) std::cerr << prefix.str();
-    std::cerr.write(message, ctmp - message);
-    message = ctmp;
-  }
-
-  /* If there were no filename or lineno, the prefix might be empty */
-  if (!prefix.str().empty()) std::cerr << prefix.str();
-  std::cerr << message;
-
-  PrintErrorLine(prefix.str(), report);
-  std::cerr << std::endl;  // flushes
-  return true;
-}
-
-static void PrintError(JSErrorReport* report) {
-  assert(report);
-
-  PrintErrorKind kind = PrintErrorKind::Error;
-  if (JSREPORT_IS_WARNING(report->flags)) {
-    if (JSREPORT_IS_STRICT(report->flags))
-      kind = PrintErrorKind::StrictWarning;
-    else
-      kind = PrintErrorKind::Warning;
-  }
-  PrintSingleError(report, kind);
-
-  if (report->notes) {
-    for (auto&& note : *report->notes)
-      PrintSingleError(note.get(), PrintErrorKind::Note);
-  }
-}
-
-std::string FormatString(JSContext* cx, JS::HandleString string) {
-  std::string buf = "\"";
-
-  JS::UniqueChars chars(JS_EncodeStringToUTF8(cx, string));
-  if (!chars) {
+// Errors and warnings are written by a boilerplate::ErrorReporter, in the
+// format of SpiderMonkey's own shell; see 'errorreporter.cpp'. The REPL
+// flushes it after each line of input, so that they come before the prompt.
+static boilerplate::ErrorReporter errors([] {
+  boilerplate::ErrorReporter::Options options;
+  options.stacks = false;
+  return options;
+}());
+
+// These append the text to 'out', which the caller can reuse from one result
+// to the next. The string's characters are transcoded straight into it,
+// rather than into a temporary UTF-8 copy first.
+
+static void FormatString(JSContext* cx, JS::HandleString string,
+                         boilerplate::TextBuffer* out) {
+  size_t start = out->size();
+  out->append('"');
+  if (!out->appendString(cx, string)) {
     JS_ClearPendingException(cx);
-    return "[invalid string]";
+    out->truncate(start);
+    out->append("[invalid string]");
+    return;
   }
-
-  buf += chars.get();
-  buf += '"';
-  return buf;
+  out->append('"');
 }
 
-std::string FormatResult(JSContext* cx, JS::HandleValue value) {
+static void FormatResult(JSContext* cx, JS::HandleValue value,
+                         boilerplate::TextBuffer* out) {
   JS::RootedString str(cx);
 
   /* Special case format for strings */
   if (value.isString()) {
     str = value.toString();
-    return FormatString(cx, str);
+    FormatString(cx, str, out);
+    return;
   }
 
   str = JS::ToString(cx, value);
@@ -208,53 +153,26 @@ std::string FormatResult(JSContext* cx, JS::HandleValue value) {
     JS_ClearPendingException(cx);
     if (value.isObject()) {
       const JSClass* klass = JS_GetClass(&value.toObject());
-      if (klass)
-        str = JS_NewStringCopyZ(cx, klass->name);
-      else
-        return "[unknown object]";
+      if (klass) {
+        out->append(klass->name);
+        return;
+      }
+      out->append("[unknown object]");
     } else {
-      return "[unknown non-object]";
+      out->append("[unknown non-object]");
     }
+    return;
   }
 
-  if (!str) {
-    JS_ClearPendingException(cx);
-    return "[invalid class]";
-  }
-
-  JS::UniqueChars bytes(JS_EncodeStringToUTF8(cx, str));
-  if (!bytes) {
+  if (!out->appendString(cx, str)) {
     JS_ClearPendingException(cx);
-    return "[invalid string]";
+    out->append("[invalid string]");
   }
-
-  return bytes.get();
-}
-
-static JSErrorReport* ErrorFromExceptionValue(JSContext* cx,
-                                              JS::HandleValue exception) {
-  if (!exception.isObject()) return nullptr;
-  JS::RootedObject exceptionObject(cx, &exception.toObject());
-  return JS_ErrorFromException(cx, exceptionObject);
 }
 
 static void ReportAndClearException(JSContext* cx) {
-  /* Get exception object before printing and clearing exception. */
-  JS::RootedValue exception(cx);
-  if (!JS_GetPendingException(cx, &exception))
+  if (!errors.reportPendingException(cx))
     die("Uncatchable exception thrown, out of memory or something");
-
-  JS_ClearPendingException(cx);
-
-  JSErrorReport* report = ErrorFromExceptionValue(cx, exception);
-  if (!report) {
-    JS_ClearPendingException(cx);
-    std::cerr << "error: " << FormatResult(cx, exception) << '\n';
-    return;
-  }
-
-  assert(!JSREPORT_IS_WARNING(report->flags));
-  PrintError(report);
 }
 
 JSObject* ReplGlobal::create(JSContext* cx) {
@@ -262,9 +180,9 @@ JSObject* ReplGlobal::create(JSContext* cx) {
   JS::RootedObject global(cx,
                           JS_NewGlobalObject(cx, &ReplGlobal::klass, nullptr,
                                              JS::FireOnNewGlobalHook, options));
+  if (!global) return nullptr;
 
-  ReplGlobal* priv = new ReplGlobal();
-  JS_SetPrivate(global, priv);
+  JS_SetReservedSlot(global, ShouldQuitSlot, JS::FalseValue());
 
   // Define any extra global functions that we want in our environment.
   JSAutoRealm ar(cx, global);
@@ -273,6 +191,37 @@ JSObject* ReplGlobal::create(JSContext* cx) {
   return global;
 }
 
+// GC pause statistics for the REPL's context, shown with the :gcstats command.
+static boilerplate::GCStats gcStats;
+
+// Optionally, with --time-limit-ms=N, each line of input is stopped if it runs
+// for longer than N milliseconds of CPU time, so that an accidental infinite
+// loop doesn't take down the whole session.
+static boilerplate::Watchdog watchdog;
+static boilerplate::ScriptLimits limits;
+
+// See ReplGlobal::stream().
+static bool readStdin = false;
+
+// Lines starting with a colon are commands to the REPL itself, rather than
+// JavaScript code. Returns false if the line is not a known command.
+static bool HandleCommand(const std::string& line) {
+  if (line == ":gcstats") {
+    boilerplate::GCStats::Summary summary = gcStats.summarize();
+    std::cout << "GC cycles: " << summary.cycles
+              << ", slices: " << summary.slices << '\n'
+              << "pause p50: " << summary.p50Ms
+              << " ms, p99: " << summary.p99Ms << " ms, max: " << summary.maxMs
+              << " ms, total: " << summary.totalMs << " ms\n";
+    return true;
+  }
+  if (line == ":gcstats json") {
+    std::cout << gcStats.toJSON() << '\n';
+    return true;
+  }
+  return false;
+}
+
 bool EvalAndPrint(JSContext* cx, const std::string& buffer, unsigned lineno) {
   JS::CompileOptions options(cx);
   options.setFileAndLine("typein", lineno);
@@ -290,50 +239,358 @@ bool EvalAndPrint(JSContext* cx, const std::string& buffer, unsigned lineno) {
 
   if (result.isUndefined()) return true;
 
-  std::string display_str = FormatResult(cx, result);
-  if (!display_str.empty()) std::cout << display_str << '\n';
+  // Reused for every result, so printing doesn't allocate once the buffer is
+  // big enough.
+  static boilerplate::TextBuffer display;
+  display.clear();
+  FormatResult(cx, result, &display);
+  if (!display.empty()) {
+    display.append('\n');
+    display.writeTo(std::cout);
+  }
+  return true;
+}
+
+// Tracks just enough of the structure of JavaScript source, line by line, to
+// tell when the input so far can't be complete yet: inside brackets, a block
+// comment, or a template literal. Only when it might be complete do we ask
+// the engine with JS_Utf8BufferIsCompilableUnit(), which parses the whole
+// buffer; asking after every line would make pasting an n-line script take
+// O(n^2) time.
+//
+// The scanner doesn't know the grammar, so it guesses whether a '/' starts a
+// regular expression from what comes before it. When it guesses wrong, it may
+// think that the input is incomplete when it isn't; so the engine is also
+// asked each time the buffer has doubled in size since it was last asked,
+// which still keeps the total work linear.
+class InputScanner {
+ public:
+  InputScanner(void) { reset(); }
+
+  void reset(void) {
+    m_state = State::Code;
+    m_quote = '\0';
+    m_escaped = false;
+    m_regexAllowed = true;
+    m_depth = 0;
+    m_templateDepths.clear();
+    m_word.clear();
+  }
+
+  // Takes one or more whole lines, each ending with a newline.
+  void scan(const char* chars, size_t length) {
+    for (size_t ix = 0; ix < length; ix++) {
+      char c = chars[ix];
+      char next = ix + 1 < length ? chars[ix + 1] : '\0';
+      switch (m_state) {
+        case State::Code:
+          ix += scanCode(c, next);
+          break;
+        case State::LineComment:
+          if (c == '\n') m_state = State::Code;
+          break;
+        case State::BlockComment:
+          if (c == '*' && next == '/') {
+            m_state = State::Code;
+            ix++;
+          }
+          break;
+        case State::String:
+        case State::Regex:
+        case State::RegexClass:
+          scanLiteral(c);
+          break;
+        case State::Template:
+          if (m_escaped) {
+            m_escaped = false;
+          } else if (c == '\\') {
+            m_escaped = true;
+          } else if (c == '`') {
+            m_state = State::Code;
+            m_regexAllowed = false;
+          } else if (c == '$' && next == '{') {
+            m_templateDepths.push_back(m_depth);
+            m_state = State::Code;
+            m_regexAllowed = true;
+            ix++;
+          }
+          break;
+      }
+    }
+  }
+
+  bool mightBeComplete(void) const {
+    return m_state == State::Code && m_depth <= 0 && m_templateDepths.empty();
+  }
+
+ private:
+  enum class State {
+    Code,
+    LineComment,
+    BlockComment,
+    String,
+    Template,
+    Regex,
+    RegexClass
+  };
+
+  static bool IsIdentifierChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           (c >= '0' && c <= '9') || c == '_' || c == '$' ||
+           static_cast<unsigned char>(c) >= 0x80;
+  }
+
+  // After these keywords, a '/' starts a regular expression. After any other
+  // identifier, it's a division.
+  static bool IsKeywordBeforeExpression(const std::string& word) {
+    static const char* keywords[] = {
+        "await", "case",   "delete", "do",     "else",       "in",
+        "new",   "of",     "return", "throw",  "instanceof", "typeof",
+        "void",  "yield"};
+    for (const char* keyword : keywords) {
+      if (word == keyword) return true;
+    }
+    return false;
+  }
+
+  // Returns how many characters to skip after 'c'.
+  size_t scanCode(char c, char next) {
+    if (IsIdentifierChar(c)) {
+      m_word += c;
+      return 0;
+    }
+    if (!m_word.empty()) {
+      m_regexAllowed = IsKeywordBeforeExpression(m_word);
+      m_word.clear();
+    }
+
+    switch (c) {
+      case ' ':
+      case '\t':
+      case '\r':
+      case '\n':
+        return 0;
+      case '/':
+        if (next == '/') {
+          m_state = State::LineComment;
+          return 1;
+        }
+        if (next == '*') {
+          m_state = State::BlockComment;
+          return 1;
+        }
+        if (m_regexAllowed)
+          m_state = State::Regex;
+        else
+          m_regexAllowed = true;
+        return 0;
+      case '\'':
+      case '"':
+        m_state = State::String;
+        m_quote = c;
+        return 0;
+      case '`':
+        m_state = State::Template;
+        return 0;
+      case '(':
+      case '[':
+      case '{':
+        m_depth++;
+        m_regexAllowed = true;
+        return 0;
+      case ')':
+      case ']':
+        m_depth--;
+        m_regexAllowed = false;
+        return 0;
+      case '}':
+        if (!m_templateDepths.empty() && m_templateDepths.back() == m_depth) {
+          m_templateDepths.pop_back();
+          m_state = State::Template;
+          return 0;
+        }
+        m_depth--;
+        m_regexAllowed = true;
+        return 0;
+      default:  // operators and punctuation
+        m_regexAllowed = true;
+        return 0;
+    }
+  }
+
+  // Strings and regular expressions can't span lines (except for an escaped
+  // newline in a string); if one does, that's a syntax error, which the
+  // engine will report.
+  void scanLiteral(char c) {
+    if (m_escaped) {
+      m_escaped = false;
+      return;
+    }
+    if (c == '\\') {
+      m_escaped = true;
+    } else if (c == '\n') {
+      m_state = State::Code;
+    } else if (m_state == State::String && c == m_quote) {
+      m_state = State::Code;
+      m_regexAllowed = false;
+    } else if (m_state == State::Regex && c == '[') {
+      m_state = State::RegexClass;
+    } else if (m_state == State::RegexClass && c == ']') {
+      m_state = State::Regex;
+    } else if (m_state == State::Regex && c == '/') {
+      m_state = State::Code;
+      m_regexAllowed = false;
+    }
+  }
+
+  State m_state;
+  char m_quote;
+  bool m_escaped;
+  bool m_regexAllowed;  // whether a '/' here would start a regular expression
+  int m_depth;          // of all kinds of brackets
+  std::vector<int> m_templateDepths;  // m_depth at each open '${'
+  std::string m_word;                 // the identifier being scanned
+};
+
+// Appends a line to the buffer, and returns whether the buffer should be
+// passed to the engine now, because it might be a compilable unit.
+static bool AppendLine(const char* line, size_t length, std::string* buffer,
+                       InputScanner* scanner, size_t* checkedSize) {
+  size_t start = buffer->size();
+  buffer->append(line, length);
+  *buffer += '\n';
+  scanner->scan(buffer->data() + start, buffer->size() - start);
+
+  if (!scanner->mightBeComplete() && buffer->size() < 2 * *checkedSize)
+    return false;
+  *checkedSize = buffer->size();
   return true;
 }
 
+// Runs one compilable unit of input, reporting its result or error, and then
+// any Promise jobs that it queued.
+void ReplGlobal::evaluate(JSContext* cx, JS::HandleObject global,
+                          const std::string& buffer, unsigned startline) {
+  bool ok, timedOut;
+  {
+    boilerplate::ScriptBudget budget(watchdog, cx, limits);
+    ok = EvalAndPrint(cx, buffer, startline);
+    timedOut = budget.exceeded();
+  }
+  if (!ok) {
+    if (timedOut)
+      std::cerr << "Terminated after " << limits.cpuTime.count()
+                << " ms of CPU time\n";
+    else if (!shouldQuit(global))
+      ReportAndClearException(cx);
+  }
+
+  js::RunJobs(cx);
+  errors.flush();
+}
+
 void ReplGlobal::loop(JSContext* cx, JS::HandleObject global) {
   bool eof = false;
   unsigned lineno = 1;
+  InputScanner scanner;
   do {
     // Accumulate lines until we get a 'compilable unit' - one that either
     // generates an error (before running out of source) or that compiles
     // cleanly.  This should be whenever we get a complete statement that
     // coincides with the end of a line.
+    //
+    // After the :paste command, lines are accumulated without checking, until
+    // a line with :end or Ctrl-D, and then run as one script.
     unsigned startline = lineno;
     std::string buffer;
+    size_t checkedSize = 0;
+    bool paste = false;
+    scanner.reset();
 
-    do {
-      const char* prompt = startline == lineno ? "js> " : "... ";
+    for (;;) {
+      const char* prompt = paste ? "" : startline == lineno ? "js> " : "... ";
       char* line = readline(prompt);
       if (!line) {
-        eof = true;
+        eof = !paste;
+        break;
+      }
+      if (paste && strcmp(line, ":end") == 0) {
+        free(line);
         break;
       }
-      if (line[0] != '\0') add_history(line);
-      buffer += line;
+      if (line[0] != '\0' && !paste) add_history(line);
+      if (startline == lineno && line[0] == ':' && !paste) {
+        if (strcmp(line, ":paste") == 0) {
+          std::cout << "// Paste mode; finish with :end or Ctrl-D\n";
+          paste = true;
+          free(line);
+          continue;
+        }
+        if (HandleCommand(line)) {
+          free(line);
+          continue;
+        }
+      }
+
+      bool check =
+          AppendLine(line, strlen(line), &buffer, &scanner, &checkedSize);
+      free(line);
       lineno++;
-    } while (!JS_Utf8BufferIsCompilableUnit(cx, global, buffer.c_str(),
-                                            buffer.length()));
+      if (!paste && check &&
+          JS_Utf8BufferIsCompilableUnit(cx, global, buffer.c_str(),
+                                        buffer.length()))
+        break;
+    }
+
+    if (!buffer.empty()) evaluate(cx, global, buffer, startline);
+  } while (!eof && !shouldQuit(global));
+}
+
+// With --stdin, the REPL reads its input from standard input without
+// readline or prompts, as when a script is piped into it, and evaluates it in
+// chunks of at least ChunkSize bytes, each ending on a complete statement.
+// That's much faster than evaluating it line by line, but only the result of
+// the last statement of each chunk is printed.
+static constexpr size_t ChunkSize = 64 * 1024;
 
-    if (!EvalAndPrint(cx, buffer, startline)) {
-      if (!priv(global)->m_shouldQuit) ReportAndClearException(cx);
+void ReplGlobal::stream(JSContext* cx, JS::HandleObject global) {
+  unsigned lineno = 1;
+  unsigned startline = 1;
+  std::string buffer;
+  std::string line;
+  size_t checkedSize = 0;
+  InputScanner scanner;
+  buffer.reserve(2 * ChunkSize);
+
+  while (!shouldQuit(global)) {
+    bool eof = !std::getline(std::cin, line);
+    if (!eof) {
+      bool check = AppendLine(line.data(), line.size(), &buffer, &scanner,
+                              &checkedSize);
+      lineno++;
+      if (buffer.size() < ChunkSize || !check ||
+          !JS_Utf8BufferIsCompilableUnit(cx, global, buffer.c_str(),
+                                         buffer.length()))
+        continue;
     }
 
-    js::RunJobs(cx);
-  } while (!eof && !priv(global)->m_shouldQuit);
+    if (!buffer.empty()) evaluate(cx, global, buffer, startline);
+    if (eof) break;
+
+    buffer.clear();
+    scanner.reset();
+    checkedSize = 0;
+    startline = lineno;
+  }
 }
 
 static bool RunREPL(JSContext* cx) {
   // In order to use Promises in the REPL, we need a job queue to process
   // events after each line of input is processed.
   //
-  // A more sophisticated embedding would schedule it's own tasks and use
-  // JS::SetEnqueuePromiseJobCallback(), JS::SetGetIncumbentGlobalCallback(),
-  // and JS::SetPromiseRejectionTrackerCallback().
+  // A more sophisticated embedding would schedule its own tasks with a
+  // JS::JobQueue and JS::SetPromiseRejectionTrackerCallback(); see
+  // boilerplate::EventLoop in 'eventloop.cpp'.
   if (!js::UseInternalJobQueues(cx)) return false;
 
   // We must instantiate self-hosting *after* setting up job queue.
@@ -344,17 +601,54 @@ static bool RunREPL(JSContext* cx) {
 
   JSAutoRealm ar(cx, global);
 
-  JS::SetWarningReporter(
-      cx, [](JSContext*, JSErrorReport* report) { PrintError(report); });
+  JS::SetWarningReporter(cx, [](JSContext* cx, JSErrorReport* report) {
+    errors.report(cx, report);
+  });
 
-  ReplGlobal::loop(cx, global);
+  gcStats.install(cx);
 
-  std::cout << '\n';
+  if (limits.cpuTime.count() > 0 &&
+      (!watchdog.start() || !boilerplate::Watchdog::Install(cx)))
+    return false;
+
+  if (readStdin)
+    ReplGlobal::stream(cx, global);
+  else
+    ReplGlobal::loop(cx, global);
+
+  gcStats.uninstall();
+
+  if (!readStdin) std::cout << '\n';
   return true;
 }
 
 int main(int argc, const char* argv[]) {
-  if (!boilerplate::RunExample(RunREPL, /* initSelfHosting = */ false))
+  // Heap and GC settings can be tuned with --gc-*=N arguments or
+  // BOILERPLATE_GC_* environment variables; see boilerplate::RuntimeConfig.
+  boilerplate::RuntimeConfig config;
+  if (!config.readEnvironment() || !config.parseArgs(argc, argv)) return 1;
+
+  for (int ix = 1; ix < argc; ix++) {
+    if (strncmp(argv[ix], "--time-limit-ms=", 16) == 0) {
+      const char* text = argv[ix] + 16;
+      char* end;
+      errno = 0;
+      unsigned long ms = strtoul(text, &end, 10);
+      if (*text < '0' || *text > '9' || *end != '\0' || errno == ERANGE ||
+          ms > UINT32_MAX) {
+        std::cerr << "invalid value for --time-limit-ms: " << text << '\n';
+        return 1;
+      }
+      limits.cpuTime = std::chrono::milliseconds(ms);
+    } else if (strcmp(argv[ix], "--stdin") == 0)
+      readStdin = true;
+  }
+
+  // Reading large input through std::cin is much faster when it doesn't have
+  // to stay in sync with C stdio.
+  if (readStdin) std::ios::sync_with_stdio(false);
+
+  if (!boilerplate::RunExample(RunREPL, config, /* initSelfHosting = */ false))
     return 1;
   return 0;
 }
@@ -1,5 +1,6 @@
+#include <chrono>
+#include <cstring>
 #include <iostream>
-#include <limits>
 
 #include <jsapi.h>
 #include <jsfriendapi.h>
@@ -10,66 +11,126 @@
 #include <js/SourceText.h>
 
 #include "boilerplate.h"
-
-namespace zlib {
-#include <zlib.h>
-}
+#include "crc32.h"
+#include "errorreporter.h"
+#include "lazyproperties.h"
 
 /* This example illustrates how to set up a class with a custom resolve hook, in
  * order to do lazy property resolution.
  *
- * We'll use the CRC-32 checksum API from zlib as an example. Not because it's
- * an incredibly useful API, but zlib is already a dependency of SpiderMonkey,
- * so it's likely to be installed anywhere these examples are being compiled.
+ * We'll use the CRC-32 checksum as an example, computed with the same
+ * algorithm as zlib's crc32(). Not because it's an incredibly useful API, but
+ * zlib is already a dependency of SpiderMonkey, so it's likely to be installed
+ * anywhere these examples are being compiled. See 'crc32.cpp' for the faster
+ * hardware code paths used on CPUs that support them.
  *
  * There will be two properties that can resolve lazily: an `update()` method,
  * and a `checksum` property. */
 
 class Crc {
-  unsigned long m_crc;
-
-  Crc(void) : m_crc(zlib::crc32(0L, nullptr, 0)) {}
+  // The checksum is only 32 bits, so instead of allocating a C++ object for
+  // each instance and storing a pointer to it in the object's private slot,
+  // we keep it directly in a reserved slot of the object. Creating a Crc then
+  // doesn't need any malloc(), and the class doesn't need a finalize hook to
+  // free anything. Objects of classes without a finalize hook can also be
+  // allocated in the GC's nursery, so short-lived instances are cheap to
+  // collect.
+  //
+  // The class has two reserved slots. The first is used on the prototype by
+  // LazyProperties (see below.) The second one holds the checksum as a
+  // PrivateUint32Value on instances, and is undefined on the prototype.
+  static constexpr uint32_t LazyIdsSlot = 0;
+  static constexpr uint32_t ChecksumSlot = 1;
+
+  static uint32_t getChecksumSlot(JSObject* obj) {
+    return JS_GetReservedSlot(obj, ChecksumSlot).toPrivateUint32();
+  }
 
-  bool updateImpl(JSContext* cx, const JS::CallArgs& args) {
-    if (!args.requireAtLeast(cx, "update", 1)) return false;
+  static void setChecksumSlot(JSObject* obj, uint32_t crc) {
+    JS_SetReservedSlot(obj, ChecksumSlot, JS::PrivateUint32Value(crc));
+  }
 
-    if (!args[0].isObject() || !JS_IsUint8Array(&args[0].toObject())) {
-      JS_ReportErrorASCII(cx, "argument to update() should be a Uint8Array");
-      return false;
+  // Get the bytes of any ArrayBuffer, SharedArrayBuffer, typed array or
+  // DataView. The Unwrap functions also see through cross-compartment
+  // wrappers, and return null if the object is not of that type.
+  //
+  // The pointer is only valid as long as no GC can happen.
+  static bool getBytes(JSObject* obj, uint8_t** data, size_t* length,
+                       bool* isSharedMemory, const JS::AutoRequireNoGC& nogc) {
+    if (JSObject* view = js::UnwrapArrayBufferView(obj)) {
+      *length = JS_GetArrayBufferViewByteLength(view);
+      *data = static_cast<uint8_t*>(
+          JS_GetArrayBufferViewData(view, isSharedMemory, nogc));
+      return true;
     }
-
-    JSObject* buffer = &args[0].toObject();
-
-    size_t len = JS_GetTypedArrayLength(buffer);
-    if (len > std::numeric_limits<unsigned>::max()) {
-      JS_ReportErrorASCII(cx, "array has too many bytes");
-      return false;
+    if (JSObject* buffer = js::UnwrapArrayBuffer(obj)) {
+      *length = JS_GetArrayBufferByteLength(buffer);
+      *data = JS_GetArrayBufferData(buffer, isSharedMemory, nogc);
+      return true;
+    }
+    if (JSObject* buffer = js::UnwrapSharedArrayBuffer(obj)) {
+      *length = JS_GetSharedArrayBufferByteLength(buffer);
+      *data = JS_GetSharedArrayBufferData(buffer, isSharedMemory, nogc);
+      return true;
     }
+    return false;
+  }
 
-    {
+  static bool updateImpl(JSContext* cx, JS::HandleObject obj,
+                         const JS::CallArgs& args) {
+    if (!args.requireAtLeast(cx, "update", 1)) return false;
+
+    bool isBuffer = false;
+    if (args[0].isObject()) {
+      // Crc32Update() processes the whole buffer in place, without copying
+      // it and without any limit on its size. We must not GC while it runs,
+      // because the GC could move or free the data.
+      //
+      // If the memory is shared (isSharedMemory), other threads may be
+      // writing to it while we read it. That's allowed, and then the checksum
+      // is just of whatever bytes we happened to see. Scripts that need a
+      // consistent checksum of shared memory have to synchronize with
+      // Atomics themselves.
+      JS::AutoCheckCannotGC nogc;
+      uint8_t* data;
+      size_t len;
       bool isSharedMemory;
-      JS::AutoAssertNoGC nogc;
-      uint8_t* data = JS_GetUint8ArrayData(buffer, &isSharedMemory, nogc);
+      isBuffer =
+          getBytes(&args[0].toObject(), &data, &len, &isSharedMemory, nogc);
+      if (isBuffer)
+        setChecksumSlot(obj, Crc32Update(getChecksumSlot(obj), data, len));
+    }
 
-      m_crc = zlib::crc32(m_crc, data, unsigned(len));
+    // Report the error only once the no-GC scope is over, since reporting
+    // an error allocates.
+    if (!isBuffer) {
+      JS_ReportErrorASCII(cx,
+                          "argument to update() should be an ArrayBuffer, "
+                          "SharedArrayBuffer, typed array, or DataView");
+      return false;
     }
 
     args.rval().setUndefined();
     return true;
   }
 
-  bool getChecksumImpl(JSContext* cx, const JS::CallArgs& args) {
-    args.rval().setNumber(uint32_t(m_crc));
+  static bool getChecksumImpl(JSContext* cx, JS::HandleObject obj,
+                              const JS::CallArgs& args) {
+    args.rval().setNumber(getChecksumSlot(obj));
     return true;
   }
 
-  static Crc* getPriv(JSObject* obj) {
-    return static_cast<Crc*>(JS_GetPrivate(obj));
+  static bool isPrototype(JSObject* obj) {
+    return JS_GetReservedSlot(obj, ChecksumSlot).isUndefined();
   }
 
-  static bool isPrototype(JSObject* obj) { return getPriv(obj) == nullptr; }
-
   static bool checkIsInstance(JSContext* cx, JSObject* obj, const char* what) {
+    // We must check the class before reading any reserved slots, since the
+    // method could have been called on some other kind of object.
+    if (JS_GetClass(obj) != &Crc::klass) {
+      JS_ReportErrorASCII(cx, "can't %s on an object that is not a Crc", what);
+      return false;
+    }
     if (isPrototype(obj)) {
       JS_ReportErrorASCII(cx, "can't %s on Crc.prototype", what);
       return false;
@@ -90,8 +151,7 @@ class Crc {
                             JS_NewObjectForConstructor(cx, &Crc::klass, args));
     if (!newObj) return false;
 
-    Crc* priv = new Crc();
-    JS_SetPrivate(newObj, priv);
+    setChecksumSlot(newObj, Crc32Update(0, nullptr, 0));
 
     args.rval().setObject(*newObj);
     return true;
@@ -102,7 +162,7 @@ class Crc {
     JS::RootedObject thisObj(cx);
     if (!args.computeThis(cx, &thisObj)) return false;
     if (!checkIsInstance(cx, thisObj, "call update()")) return false;
-    return getPriv(thisObj)->updateImpl(cx, args);
+    return updateImpl(cx, thisObj, args);
   }
 
   static bool getChecksum(JSContext* cx, unsigned argc, JS::Value* vp) {
@@ -110,79 +170,37 @@ class Crc {
     JS::RootedObject thisObj(cx);
     if (!args.computeThis(cx, &thisObj)) return false;
     if (!checkIsInstance(cx, thisObj, "read checksum")) return false;
-    return getPriv(thisObj)->getChecksumImpl(cx, args);
+    return getChecksumImpl(cx, thisObj, args);
   }
 
+  // All of the lazy members are listed in these two tables, and the
+  // LazyProperties helper generates the newEnumerate, resolve, and mayResolve
+  // hooks from them. See 'lazyproperties.cpp'. The tables are constant
+  // data; only the name filters in 'lazy' are computed, once at startup.
+  static constexpr JSFunctionSpec methods[] = {
+      JS_FN("update", &Crc::update, 1, JSPROP_ENUMERATE),
+      JS_FS_END,
+  };
+  static constexpr JSPropertySpec properties[] = {
+      JS_PSG("checksum", &Crc::getChecksum, JSPROP_ENUMERATE),
+      JS_PS_END,
+  };
+  static const boilerplate::LazyProperties lazy;
+
   static bool newEnumerate(JSContext* cx, JS::HandleObject obj,
                            JS::MutableHandleIdVector properties,
                            bool enumerableOnly) {
-    // We only want to enumerate if obj is the prototype. For instances, we
-    // should return immediately, and this will be called again on the
-    // prototype.
-    if (!isPrototype(obj)) return true;
-
-    jsid idUpdate =
-        INTERNED_STRING_TO_JSID(cx, JS_AtomizeAndPinString(cx, "update"));
-    if (!properties.append(idUpdate)) return false;
-
-    jsid idChecksum =
-        INTERNED_STRING_TO_JSID(cx, JS_AtomizeAndPinString(cx, "checksum"));
-    if (!properties.append(idChecksum)) return false;
-
-    return true;
+    return lazy.newEnumerate(cx, obj, properties, enumerableOnly);
   }
 
   static bool resolve(JSContext* cx, JS::HandleObject obj, JS::HandleId id,
                       bool* resolved) {
-    // We only want to resolve if obj is the prototype. For instances, we should
-    // return immediately, and this will be called again on the prototype.
-    if (!isPrototype(obj)) {
-      *resolved = false;
-      return true;
-    }
-
-    if (!JSID_IS_STRING(id)) {
-      *resolved = false;
-      return true;
-    }
-
-    JSFlatString* str = JSID_TO_FLAT_STRING(id);
-
-    if (JS_FlatStringEqualsAscii(str, "update")) {
-      if (!JS_DefineFunctionById(cx, obj, id, &Crc::update, 1,
-                                 JSPROP_ENUMERATE))
-        return false;
-      *resolved = true;
-      return true;
-    }
-
-    if (JS_FlatStringEqualsAscii(str, "checksum")) {
-      if (!JS_DefinePropertyById(cx, obj, id, &Crc::getChecksum, nullptr,
-                                 JSPROP_ENUMERATE))
-        return false;
-      *resolved = true;
-      return true;
-    }
-
-    *resolved = false;
-    return true;
+    return lazy.resolve(cx, obj, id, resolved);
   }
 
   static bool mayResolve(const JSAtomState& names, jsid id,
                          JSObject* maybeObj) {
-    if (!JSID_IS_STRING(id)) return false;
-
-    JSFlatString* str = JSID_TO_FLAT_STRING(id);
-    return JS_FlatStringEqualsAscii(str, "update") ||
-           JS_FlatStringEqualsAscii(str, "checksum");
-  }
-
-  static void finalize(JSFreeOp* fop, JSObject* obj) {
-    Crc* priv = getPriv(obj);
-    if (priv) {
-      delete priv;
-      JS_SetPrivate(obj, nullptr);
-    }
+    return lazy.mayResolve(id);
   }
 
   // Note that this vtable applies both to the prototype and instances. The
@@ -194,7 +212,7 @@ class Crc {
       &Crc::newEnumerate,
       &Crc::resolve,
       &Crc::mayResolve,
-      &Crc::finalize,
+      nullptr,  // finalize
       nullptr,  // call
       nullptr,  // hasInstance
       nullptr,  // construct
@@ -203,7 +221,7 @@ class Crc {
 
   static constexpr JSClass klass = {
       "Crc",
-      JSCLASS_HAS_PRIVATE | JSCLASS_BACKGROUND_FINALIZE,
+      JSCLASS_HAS_RESERVED_SLOTS(2),
       &Crc::classOps,
   };
 
@@ -224,21 +242,115 @@ class Crc {
                          nullptr, nullptr, nullptr, nullptr));
     if (!proto) return false;
 
-    // Here's how we tell the prototype apart from instances. The private
-    // pointer will be null.
-    JS_SetPrivate(proto, nullptr);
-    return true;
+    // Here's how we tell the prototype apart from instances. The checksum
+    // slot will be undefined, since JS_InitClass() doesn't call our
+    // constructor to create the prototype.
+    return lazy.attach(cx, proto);
   }
 };
 constexpr JSClassOps Crc::classOps;
 constexpr JSClass Crc::klass;
+constexpr uint32_t Crc::LazyIdsSlot;
+constexpr uint32_t Crc::ChecksumSlot;
+constexpr JSFunctionSpec Crc::methods[];
+constexpr JSPropertySpec Crc::properties[];
+
+const boilerplate::LazyProperties Crc::lazy(Crc::methods, Crc::properties,
+                                            Crc::LazyIdsSlot);
 
 static const char* testProgram = R"js(
   const crc = new Crc();
   crc.update(new Uint8Array([1, 2, 3, 4, 5]));
+  // Any view or buffer works, and so does a piece of a larger buffer.
+  crc.update(new Uint16Array([0x0706, 0x0908]));
+  crc.update(new DataView(new ArrayBuffer(16), 4, 8));
+  crc.update(new Uint8Array([10, 11, 12]).buffer);
   crc.checksum;
 )js";
 
+// Sizes for the --bench mode, and how many bytes to process for each of them.
+// Every size does the same total amount of work, so the small sizes show the
+// fixed overhead of calling update() and the large ones the raw speed.
+static const size_t benchSizes[] = {
+    64, 4 * 1024, 256 * 1024, 1024 * 1024, 16 * 1024 * 1024, 256 * 1024 * 1024,
+};
+static const size_t benchTotalBytes = 2UL * 1024 * 1024 * 1024;
+
+// Benchmarks of creating Crc objects and accessing their lazy members, also
+// for the --bench mode. Each one is a function called with a Crc instance and
+// an iteration count.
+//
+// Creating a Crc allocates nothing but the JS object itself, so it should cost
+// about the same as creating a plain object. Looking up a name that Crc
+// doesn't have calls the resolve hook on the instance and on the prototype,
+// unless the JIT can skip it because mayResolve() said no. for-in calls the
+// newEnumerate hook every time.
+static const struct {
+  const char* name;
+  const char* code;
+} scriptBenchmarks[] = {
+    {"new Crc()", R"js(
+      (function (crc, n) {
+        let x;
+        for (let i = 0; i < n; i++) x = new Crc();
+        return x;
+      })
+    )js"},
+    {"new Crc() and update", R"js(
+      (function (crc, n) {
+        const bytes = new Uint8Array([1, 2, 3, 4]);
+        let x;
+        for (let i = 0; i < n; i++) {
+          const c = new Crc();
+          c.update(bytes);
+          x = c.checksum;
+        }
+        return x;
+      })
+    )js"},
+    {"new plain object, for comparison", R"js(
+      (function (crc, n) {
+        let x;
+        for (let i = 0; i < n; i++) x = {checksum: i};
+        return x;
+      })
+    )js"},
+    {"get checksum", R"js(
+      (function (crc, n) {
+        let x;
+        for (let i = 0; i < n; i++) x = crc.checksum;
+        return x;
+      })
+    )js"},
+    {"get missing property", R"js(
+      (function (crc, n) {
+        const names = ["updated", "check", "toJSON", "length"];
+        let x;
+        for (let i = 0; i < n; i++) x = crc[names[i & 3]];
+        return x;
+      })
+    )js"},
+    {"own property lookup", R"js(
+      (function (crc, n) {
+        const proto = Object.getPrototypeOf(crc);
+        const names = ["update", "checksum", "updated", "check"];
+        let x;
+        for (let i = 0; i < n; i++)
+          x = Object.prototype.hasOwnProperty.call(proto, names[i & 3]);
+        return x;
+      })
+    )js"},
+    {"enumerate", R"js(
+      (function (crc, n) {
+        let x;
+        for (let i = 0; i < n; i++)
+          for (const key in crc) x = key;
+        return x;
+      })
+    )js"},
+};
+static const unsigned scriptBenchmarkIterations = 1000000;
+
 /**** BOILERPLATE *************************************************************/
 // Below here, the code is very similar to what is found in hello.cpp
 
@@ -275,11 +387,10 @@ void LogException(JSContext* cx) {
 
   JS_ClearPendingException(cx);
 
-  JS::RootedString exc_str(cx, JS::ToString(cx, exception));
-  if (!exc_str) die("Exception thrown, could not be converted to string");
-
-  std::cout << "Exception thrown: " << JS_EncodeStringToUTF8(cx, exc_str).get()
-            << '\n';
+  // Flushed, so that it comes out before anything written to stdout after.
+  boilerplate::ErrorReporter& errors = boilerplate::DefaultErrorReporter();
+  errors.reportException(cx, exception);
+  errors.flush();
 }
 
 static bool ResolveExample(JSContext* cx) {
@@ -303,7 +414,127 @@ static bool ResolveExample(JSContext* cx) {
   return true;
 }
 
+static bool BenchmarkSize(JSContext* cx, JS::HandleObject global,
+                          size_t size) {
+  JS::RootedObject buffer(cx, JS_NewUint8Array(cx, size));
+  if (!buffer) return false;
+  {
+    JS::AutoCheckCannotGC nogc;
+    bool isSharedMemory;
+    uint8_t* data = JS_GetUint8ArrayData(buffer, &isSharedMemory, nogc);
+    for (size_t ix = 0; ix < size; ix++) data[ix] = uint8_t(ix * 31 + 7);
+  }
+
+  JS::RootedValue fn(cx);
+  static const char* benchCode = R"js(
+    (function (buffer, iterations) {
+      const crc = new Crc();
+      for (let i = 0; i < iterations; i++)
+        crc.update(buffer);
+      return crc.checksum;
+    })
+  )js";
+  JS::CompileOptions options(cx);
+  options.setFileAndLine("bench", 1);
+  JS::SourceText<mozilla::Utf8Unit> source;
+  if (!source.init(cx, benchCode, strlen(benchCode),
+                   JS::SourceOwnership::Borrowed) ||
+      !JS::Evaluate(cx, options, source, &fn))
+    return false;
+
+  size_t iterations = benchTotalBytes / size;
+  JS::RootedValueArray<2> args(cx);
+  args[0].setObject(*buffer);
+  args[1].setNumber(double(iterations));
+  JS::RootedValue rval(cx);
+
+  auto start = std::chrono::steady_clock::now();
+  if (!JS_CallFunctionValue(cx, global, fn, args, &rval)) return false;
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  double gbPerSec = double(size) * iterations / elapsed.count() / 1e9;
+  std::cout << size << " bytes x " << iterations << ": " << gbPerSec
+            << " GB/s\n";
+  return true;
+}
+
+static bool BenchmarkScript(JSContext* cx, JS::HandleObject global,
+                            const char* name, const char* code) {
+  JS::CompileOptions options(cx);
+  options.setFileAndLine(name, 1);
+  JS::SourceText<mozilla::Utf8Unit> source;
+  JS::RootedValue fn(cx);
+  if (!source.init(cx, code, strlen(code), JS::SourceOwnership::Borrowed) ||
+      !JS::Evaluate(cx, options, source, &fn))
+    return false;
+
+  static const char* newCrc = "new Crc()";
+  JS::SourceText<mozilla::Utf8Unit> crcSource;
+  JS::RootedValue crc(cx);
+  if (!crcSource.init(cx, newCrc, strlen(newCrc),
+                      JS::SourceOwnership::Borrowed) ||
+      !JS::Evaluate(cx, options, crcSource, &crc))
+    return false;
+
+  JS::RootedValueArray<2> args(cx);
+  args[0].setObject(crc.toObject());
+  args[1].setNumber(scriptBenchmarkIterations);
+  JS::RootedValue rval(cx);
+
+  auto start = std::chrono::steady_clock::now();
+  if (!JS_CallFunctionValue(cx, global, fn, args, &rval)) return false;
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  double ns = elapsed.count() / scriptBenchmarkIterations;
+  std::cout << name << ": " << ns << " ns (" << 1e3 / ns << " M/s)\n";
+  return true;
+}
+
+static bool BenchmarkExample(JSContext* cx) {
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) {
+    return false;
+  }
+
+  JSAutoRealm ar(cx, global);
+
+  if (!Crc::DefinePrototype(cx)) {
+    LogException(cx);
+    return false;
+  }
+
+  std::cout << "CRC-32 implementation: " << Crc32Implementation() << '\n';
+  for (size_t size : benchSizes) {
+    if (!BenchmarkSize(cx, global, size)) {
+      LogException(cx);
+      return false;
+    }
+  }
+
+  for (const auto& benchmark : scriptBenchmarks) {
+    if (!BenchmarkScript(cx, global, benchmark.name, benchmark.code)) {
+      LogException(cx);
+      return false;
+    }
+  }
+
+  return true;
+}
+
 int main(int argc, const char* argv[]) {
-  if (!boilerplate::RunExample(ResolveExample)) return 1;
+  bool bench = false;
+  for (int ix = 1; ix < argc; ix++) {
+    if (strcmp(argv[ix], "--bench") == 0) bench = true;
+  }
+
+  // Pass --profile=FILE to see where the time goes; see 'profiler.cpp'.
+  boilerplate::RuntimeConfig config;
+  if (!config.readEnvironment() || !config.parseArgs(argc, argv)) return 1;
+
+  if (!boilerplate::RunExample(bench ? BenchmarkExample : ResolveExample,
+                               config))
+    return 1;
   return 0;
 }
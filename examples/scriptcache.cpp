@@ -0,0 +1,206 @@
+#include <cstring>
+
+#include <jsapi.h>
+
+#include <js/CompilationAndEvaluation.h>
+#include <js/SourceText.h>
+
+#include "scriptcache.h"
+
+// A ScriptCache avoids parsing and compiling the same source text over and
+// over. JS::Evaluate() compiles its source every time it is called; instead,
+// the cache compiles each distinct source once with JS::Compile(), keeps the
+// JSScript alive with a PersistentRooted, and runs it again with
+// JS_ExecuteScript() the next time the same source is seen.
+//
+// Entries are keyed by a hash of the source text and of the compile options
+// that affect the result: the position and introduction info that end up in
+// the script and its error messages, strict mode, whether the completion
+// value is kept, and so on; see ScriptCache::Options. Since two different
+// sources can hash to the same value, each entry keeps a copy of its source
+// and options, and they are compared in full on a hit; that's still much
+// cheaper than parsing the source. When there are more than 'maxEntries'
+// entries, or the cached sources take up more than 'maxBytes', the least
+// recently used entries are evicted.
+//
+// Scripts compiled with isRunOnce or nonSyntacticScope must not be executed
+// again in the global, so those are compiled as usual but never cached.
+//
+// A script belongs to the realm it was compiled in, so a ScriptCache is bound
+// to one global object, and all scripts are compiled and executed in that
+// global's realm.
+
+// 64-bit FNV-1a. Not cryptographically strong, which is fine since the cache
+// verifies the full source on a hit anyway.
+static constexpr uint64_t FNVOffsetBasis = 0xcbf29ce484222325ull;
+static constexpr uint64_t FNVPrime = 0x100000001b3ull;
+
+static uint64_t HashBytes(uint64_t hash, const void* bytes, size_t length) {
+  auto* data = static_cast<const unsigned char*>(bytes);
+  for (size_t ix = 0; ix < length; ix++) {
+    hash ^= data[ix];
+    hash *= FNVPrime;
+  }
+  return hash;
+}
+
+template <typename T>
+static uint64_t HashValue(uint64_t hash, T value) {
+  return HashBytes(hash, &value, sizeof(value));
+}
+
+static uint64_t HashString(uint64_t hash, const char* str) {
+  if (!str) str = "";
+  return HashBytes(hash, str, strlen(str) + 1);
+}
+
+static uint64_t HashSource(const JS::ReadOnlyCompileOptions& options,
+                           const char* code, size_t length) {
+  uint64_t hash = FNVOffsetBasis;
+  hash = HashString(hash, options.filename());
+  hash = HashString(hash, options.introductionType);
+  hash = HashValue(hash, options.lineno);
+  hash = HashValue(hash, options.column);
+  hash = HashValue(hash, options.introductionLineno);
+  hash = HashValue(hash, options.introductionOffset);
+  uint32_t flags = options.hasIntroductionInfo |
+                   options.forceStrictMode() << 1 |
+                   options.mutedErrors() << 2 | options.noScriptRval << 3 |
+                   options.selfHostingMode << 4 | options.forceAsync << 5 |
+                   options.extraWarningsOption << 6 |
+                   options.werrorOption << 7;
+  hash = HashValue(hash, flags);
+  hash = HashValue(hash, options.asmJSOption);
+  return HashBytes(hash, code, length);
+}
+
+static const char* OrEmpty(const char* str) { return str ? str : ""; }
+
+boilerplate::ScriptCache::Options::Options(
+    const JS::ReadOnlyCompileOptions& options)
+    : filename(OrEmpty(options.filename())),
+      introductionType(OrEmpty(options.introductionType)),
+      lineno(options.lineno),
+      column(options.column),
+      introductionLineno(options.introductionLineno),
+      introductionOffset(options.introductionOffset),
+      hasIntroductionInfo(options.hasIntroductionInfo),
+      forceStrictMode(options.forceStrictMode()),
+      mutedErrors(options.mutedErrors()),
+      noScriptRval(options.noScriptRval),
+      selfHostingMode(options.selfHostingMode),
+      forceAsync(options.forceAsync),
+      extraWarnings(options.extraWarningsOption),
+      werror(options.werrorOption),
+      asmJS(options.asmJSOption) {}
+
+bool boilerplate::ScriptCache::Options::matches(
+    const JS::ReadOnlyCompileOptions& options) const {
+  return lineno == options.lineno && column == options.column &&
+         introductionLineno == options.introductionLineno &&
+         introductionOffset == options.introductionOffset &&
+         hasIntroductionInfo == options.hasIntroductionInfo &&
+         forceStrictMode == options.forceStrictMode() &&
+         mutedErrors == options.mutedErrors() &&
+         noScriptRval == options.noScriptRval &&
+         selfHostingMode == options.selfHostingMode &&
+         forceAsync == options.forceAsync &&
+         extraWarnings == options.extraWarningsOption &&
+         werror == options.werrorOption && asmJS == options.asmJSOption &&
+         filename == OrEmpty(options.filename()) &&
+         introductionType == OrEmpty(options.introductionType);
+}
+
+boilerplate::ScriptCache::ScriptCache(JSContext* cx, JS::HandleObject global,
+                                      size_t maxEntries, size_t maxBytes)
+    : m_global(cx, global), m_maxEntries(maxEntries), m_maxBytes(maxBytes) {}
+
+void boilerplate::ScriptCache::evictToFit(size_t incomingBytes) {
+  while (!m_lru.empty() && (m_lru.size() + 1 > m_maxEntries ||
+                            m_stats.bytes + incomingBytes > m_maxBytes)) {
+    Entry& victim = m_lru.back();
+    m_stats.bytes -= victim.bytes();
+    m_index.erase(victim.hash);
+    m_lru.pop_back();
+    m_stats.evictions++;
+  }
+  m_stats.entries = m_lru.size();
+}
+
+// Look up the compiled script for this source, compiling and caching it if it
+// isn't there yet.
+bool boilerplate::ScriptCache::getOrCompile(
+    JSContext* cx, const JS::ReadOnlyCompileOptions& options, const char* code,
+    size_t length, JS::MutableHandleScript script) {
+  if (options.isRunOnce || options.nonSyntacticScope) {
+    m_stats.misses++;
+    JSAutoRealm ar(cx, m_global);
+    JS::SourceText<mozilla::Utf8Unit> source;
+    return source.init(cx, code, length, JS::SourceOwnership::Borrowed) &&
+           JS::Compile(cx, options, source, script);
+  }
+
+  uint64_t hash = HashSource(options, code, length);
+
+  auto found = m_index.find(hash);
+  if (found != m_index.end()) {
+    Entry& entry = *found->second;
+    if (entry.options.matches(options) && entry.source.size() == length &&
+        memcmp(entry.source.data(), code, length) == 0) {
+      m_stats.hits++;
+      m_lru.splice(m_lru.begin(), m_lru, found->second);
+      script.set(entry.script);
+      return true;
+    }
+
+    // A hash collision; the new source replaces the old entry below.
+    m_stats.bytes -= entry.bytes();
+    m_lru.erase(found->second);
+    m_index.erase(found);
+    m_stats.entries = m_lru.size();
+  }
+
+  m_stats.misses++;
+
+  JSAutoRealm ar(cx, m_global);
+
+  JS::SourceText<mozilla::Utf8Unit> source;
+  if (!source.init(cx, code, length, JS::SourceOwnership::Borrowed) ||
+      !JS::Compile(cx, options, source, script)) {
+    return false;
+  }
+
+  // Scripts that don't fit in the cache at all are still returned, but not
+  // kept.
+  size_t bytes = length + strlen(OrEmpty(options.filename())) +
+                 strlen(OrEmpty(options.introductionType));
+  if (m_maxEntries == 0 || bytes > m_maxBytes) return true;
+
+  evictToFit(bytes);
+  m_lru.emplace_front(cx, hash, options, code, length);
+  m_lru.front().script = script;
+  m_index[hash] = m_lru.begin();
+  m_stats.bytes += bytes;
+  m_stats.entries = m_lru.size();
+
+  return true;
+}
+
+// Equivalent to JS::Evaluate() in the cache's global, but only compiles the
+// source the first time it is seen.
+bool boilerplate::ScriptCache::evaluate(
+    JSContext* cx, const JS::ReadOnlyCompileOptions& options, const char* code,
+    size_t length, JS::MutableHandleValue rval) {
+  JS::RootedScript script(cx);
+  if (!getOrCompile(cx, options, code, length, &script)) return false;
+
+  JSAutoRealm ar(cx, m_global);
+  return JS_ExecuteScript(cx, script, rval);
+}
+
+void boilerplate::ScriptCache::clear(void) {
+  m_index.clear();
+  m_lru.clear();
+  m_stats.entries = 0;
+  m_stats.bytes = 0;
+}
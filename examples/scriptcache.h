@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include <jsapi.h>
+
+// See 'scriptcache.cpp' for documentation.
+
+namespace boilerplate {
+
+class ScriptCache {
+ public:
+  struct Stats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+  };
+
+  static constexpr size_t DefaultMaxEntries = 256;
+  static constexpr size_t DefaultMaxBytes = 16 * 1024 * 1024;
+
+  ScriptCache(JSContext* cx, JS::HandleObject global,
+              size_t maxEntries = DefaultMaxEntries,
+              size_t maxBytes = DefaultMaxBytes);
+
+  bool getOrCompile(JSContext* cx, const JS::ReadOnlyCompileOptions& options,
+                    const char* code, size_t length,
+                    JS::MutableHandleScript script);
+  bool evaluate(JSContext* cx, const JS::ReadOnlyCompileOptions& options,
+                const char* code, size_t length, JS::MutableHandleValue rval);
+
+  void clear(void);
+  const Stats& stats(void) const { return m_stats; }
+
+ private:
+  // The compile options that make a difference to the script JS::Compile()
+  // returns. Two compiles of the same source share a script only if all of
+  // these are the same.
+  struct Options {
+    std::string filename;
+    std::string introductionType;
+    unsigned lineno;
+    unsigned column;
+    unsigned introductionLineno;
+    uint32_t introductionOffset;
+    bool hasIntroductionInfo;
+    bool forceStrictMode;
+    bool mutedErrors;
+    bool noScriptRval;
+    bool selfHostingMode;
+    bool forceAsync;
+    bool extraWarnings;
+    bool werror;
+    JS::AsmJSOption asmJS;
+
+    explicit Options(const JS::ReadOnlyCompileOptions& options);
+    bool matches(const JS::ReadOnlyCompileOptions& options) const;
+  };
+
+  struct Entry {
+    uint64_t hash;
+    Options options;
+    std::string source;
+    JS::PersistentRooted<JSScript*> script;
+
+    Entry(JSContext* cx, uint64_t hash_,
+          const JS::ReadOnlyCompileOptions& options_, const char* code,
+          size_t length)
+        : hash(hash_), options(options_), source(code, length), script(cx) {}
+
+    size_t bytes(void) const {
+      return source.size() + options.filename.size() +
+             options.introductionType.size();
+    }
+  };
+
+  using LRUList = std::list<Entry>;
+
+  void evictToFit(size_t incomingBytes);
+
+  JS::PersistentRooted<JSObject*> m_global;
+  size_t m_maxEntries;
+  size_t m_maxBytes;
+  Stats m_stats;
+
+  LRUList m_lru;  // most recently used at the front
+  std::unordered_map<uint64_t, LRUList::iterator> m_index;
+};
+
+}  // namespace boilerplate
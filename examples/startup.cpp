@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <jsapi.h>
+#include <js/CompilationAndEvaluation.h>
+#include <js/Initialization.h>
+#include <js/SourceText.h>
+
+#include "boilerplate.h"
+
+// This example measures how much time goes into setting up a JSContext
+// compared to running a short script in it, and shows how a
+// boilerplate::ContextPool can take the setup cost out of each task.
+//
+// The "cold" case creates a new context and initializes self-hosting for every
+// task, which is what a host does when it calls RunExample() per script. (We
+// can't literally call RunExample() in a loop, because SpiderMonkey doesn't
+// support calling JS_Init() again after JS_ShutDown().) The "warm" case hands
+// the same task to a pool of contexts that were set up once.
+
+static const char* testProgram = R"js(
+  let sum = 0;
+  for (let i = 0; i < 100; i++) sum += i;
+  sum;
+)js";
+
+static bool RunShortScript(JSContext* cx) {
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) return false;
+
+  JSAutoRealm ar(cx, global);
+
+  JS::CompileOptions options(cx);
+  options.setFileAndLine("noname", 1);
+
+  JS::SourceText<mozilla::Utf8Unit> source;
+  if (!source.init(cx, testProgram, strlen(testProgram),
+                   JS::SourceOwnership::Borrowed)) {
+    return false;
+  }
+
+  JS::RootedValue rval(cx);
+  return JS::Evaluate(cx, options, source, &rval);
+}
+
+static bool RunCold(void) {
+  JSContext* cx = JS_NewContext(JS::DefaultHeapMaxBytes);
+  if (!cx) return false;
+
+  bool ok = JS::InitSelfHostedCode(cx) && RunShortScript(cx);
+
+  JS_DestroyContext(cx);
+  return ok;
+}
+
+using Clock = std::chrono::steady_clock;
+
+static double MicrosecondsPerTask(Clock::time_point start, unsigned tasks) {
+  std::chrono::duration<double, std::micro> elapsed = Clock::now() - start;
+  return elapsed.count() / tasks;
+}
+
+static unsigned numTasks = 200;
+
+static bool StartupBenchmark(boilerplate::ContextPool& pool) {
+  Clock::time_point start = Clock::now();
+  for (unsigned ix = 0; ix < numTasks; ix++) {
+    if (!RunCold()) return false;
+  }
+  double cold = MicrosecondsPerTask(start, numTasks);
+
+  start = Clock::now();
+  for (unsigned ix = 0; ix < numTasks; ix++) {
+    if (!pool.run(RunShortScript)) return false;
+  }
+  double warm = MicrosecondsPerTask(start, numTasks);
+
+  std::cout << "tasks:          " << numTasks << '\n'
+            << "cold (us/task): " << cold << '\n'
+            << "warm (us/task): " << warm << '\n'
+            << "speedup:        " << cold / warm << "x\n";
+  return true;
+}
+
+int main(int argc, const char* argv[]) {
+  if (argc > 1) numTasks = std::max(1, atoi(argv[1]));
+
+  // One warm context is enough here, since the tasks are run one at a time;
+  // this measures per-task latency, not throughput.
+  if (!boilerplate::RunExampleWithPool(StartupBenchmark, 1)) return 1;
+  return 0;
+}
@@ -0,0 +1,429 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <jsapi.h>
+#include <jsfriendapi.h>
+
+#include <js/GCVector.h>
+#include <js/SweepingAPI.h>
+#include <js/TracingAPI.h>
+
+#include "hash.h"
+#include "stringhash.h"
+#include "textbuffer.h"
+
+// Hashing the contents of JS strings from native code, for content hashes
+// and cache keys, without first converting each string into a UTF-8 copy.
+//
+// A string is hashed as its UTF-8 encoding, so that the digest is the same as
+// that of the same text in a file, or computed by another system. SpiderMonkey
+// stores the characters either as Latin-1 or as UTF-16, and StringHasher
+// reads them in place, a chunk at a time. A chunk of Latin-1 characters that
+// are all ASCII is already UTF-8, so it is hashed where it is, without any
+// copying; any other chunk is transcoded into a small reused TextBuffer first.
+// So there is no allocation proportional to the size of the string.
+//
+// A rope, the result of concatenating strings, has no characters of its own
+// until it is flattened. JS_EnsureLinearString() flattens it in place, so the
+// rope is only ever flattened once, and later hashes of the same string (or
+// anything else that needs its characters) find the flat string.
+//
+// HashString() can also remember digests, for programs that hash the same
+// long strings again and again. Strings are immutable, so the digest of a
+// particular string never changes; the difficulty is only that the GC may
+// move or free the string, so its address isn't a stable key. StringHashCache
+// keeps its entries in a JS::WeakCache: the GC sweeps it as part of every
+// collection, dropping the entries whose strings have died and updating the
+// pointers of strings that were moved. Only strings of at least MinLength
+// characters are remembered, and only the most recent Capacity of them, so a
+// lookup is a short linear search that costs nothing compared to hashing.
+//
+// For scripts, DefineHashFunctions() adds:
+//
+//   hash(value, algorithm = "sha256")
+//     The hex digest of a string, or of the bytes of an ArrayBuffer,
+//     SharedArrayBuffer, typed array, or DataView.
+//
+//   new Hash(algorithm = "sha256"), hash.update(value), hash.digest()
+//     The same for input that arrives in pieces, like the Crc class in
+//     resolve.cpp. digest() can be called at any point; update() can still be
+//     called afterwards.
+//
+// The algorithms are "md5", "sha256", and "xxh64"; see 'hash.cpp'.
+
+static constexpr size_t ChunkLength = 16 * 1024;
+
+static thread_local boilerplate::StringHashCache* currentCache = nullptr;
+
+bool boilerplate::ParseHashAlgorithm(const char* name,
+                                     HashAlgorithm* algorithm) {
+  if (strcmp(name, "md5") == 0)
+    *algorithm = HashAlgorithm::Md5;
+  else if (strcmp(name, "sha256") == 0)
+    *algorithm = HashAlgorithm::Sha256;
+  else if (strcmp(name, "xxh64") == 0)
+    *algorithm = HashAlgorithm::XxHash64;
+  else
+    return false;
+  return true;
+}
+
+boilerplate::StringHasher::StringHasher(HashAlgorithm algorithm)
+    : m_algorithm(algorithm) {}
+
+void boilerplate::StringHasher::update(const void* data, size_t length) {
+  switch (m_algorithm) {
+    case HashAlgorithm::Md5:
+      m_md5.update(data, length);
+      break;
+    case HashAlgorithm::Sha256:
+      m_sha256.update(data, length);
+      break;
+    case HashAlgorithm::XxHash64:
+      m_xxHash64.update(data, length);
+      break;
+  }
+}
+
+static bool IsAscii(const JS::Latin1Char* chars, size_t length) {
+  uint64_t bits = 0;
+  size_t ix = 0;
+  for (; ix + 8 <= length; ix += 8) {
+    uint64_t word;
+    memcpy(&word, chars + ix, 8);
+    bits |= word;
+  }
+  for (; ix < length; ix++) bits |= chars[ix];
+  return (bits & 0x8080808080808080ull) == 0;
+}
+
+static inline bool IsLeadSurrogate(char16_t c) {
+  return c >= 0xD800 && c <= 0xDBFF;
+}
+
+bool boilerplate::StringHasher::update(JSContext* cx, JS::HandleString str) {
+  // Flattening a rope allocates, so it has to happen before the no-GC scope.
+  if (!JS_EnsureLinearString(cx, str)) return false;
+
+  JS::AutoCheckCannotGC nogc;
+  size_t length;
+  if (JS_StringHasLatin1Chars(str)) {
+    const JS::Latin1Char* chars =
+        JS_GetLatin1StringCharsAndLength(cx, nogc, str, &length);
+    if (!chars) return false;
+    for (size_t start = 0; start < length; start += ChunkLength) {
+      size_t count = std::min(ChunkLength, length - start);
+      if (IsAscii(chars + start, count)) {
+        update(chars + start, count);
+        continue;
+      }
+      m_utf8.clear();
+      m_utf8.appendLatin1(chars + start, count);
+      update(m_utf8.data(), m_utf8.size());
+    }
+    return true;
+  }
+
+  const char16_t* chars =
+      JS_GetTwoByteStringCharsAndLength(cx, nogc, str, &length);
+  if (!chars) return false;
+  size_t start = 0;
+  while (start < length) {
+    size_t count = std::min(ChunkLength, length - start);
+    // Don't split a surrogate pair between two chunks, or each half would
+    // become a U+FFFD.
+    if (start + count < length && IsLeadSurrogate(chars[start + count - 1]))
+      count++;
+    m_utf8.clear();
+    m_utf8.appendTwoByte(chars + start, count);
+    update(m_utf8.data(), m_utf8.size());
+    start += count;
+  }
+  return true;
+}
+
+std::string boilerplate::StringHasher::hexDigest(void) const {
+  // Finish a copy of the state, so this one can take more input.
+  switch (m_algorithm) {
+    case HashAlgorithm::Md5: {
+      uint8_t digest[Md5::DigestLength];
+      Md5(m_md5).finish(digest);
+      return HexDigest(digest, sizeof(digest));
+    }
+    case HashAlgorithm::Sha256: {
+      uint8_t digest[Sha256::DigestLength];
+      Sha256(m_sha256).finish(digest);
+      return HexDigest(digest, sizeof(digest));
+    }
+    case HashAlgorithm::XxHash64:
+    default: {
+      uint8_t digest[XxHash64::DigestLength];
+      m_xxHash64.finish(digest);
+      return HexDigest(digest, sizeof(digest));
+    }
+  }
+}
+
+///// StringHashCache /////////////////////////////////////////////////////////
+
+constexpr size_t boilerplate::StringHashCache::MinLength;
+constexpr size_t boilerplate::StringHashCache::Capacity;
+
+void boilerplate::StringHashCache::Entry::trace(JSTracer* trc,
+                                                const char* name) {
+  JS::TraceEdge(trc, &str, name);
+}
+
+// Also updates 'str' if the string was moved.
+bool boilerplate::StringHashCache::Entry::needsSweep(void) {
+  return JS::GCPolicy<JS::Heap<JSString*>>::needsSweep(&str);
+}
+
+boilerplate::StringHashCache::StringHashCache(JSContext* cx)
+    : m_entries(JS_GetRuntime(cx)), m_hits(0), m_misses(0) {
+  currentCache = this;
+}
+
+boilerplate::StringHashCache::~StringHashCache(void) {
+  if (currentCache == this) currentCache = nullptr;
+}
+
+bool boilerplate::StringHashCache::lookup(JSString* str,
+                                          HashAlgorithm algorithm,
+                                          std::string* hexDigest) const {
+  for (const Entry& entry : m_entries.get()) {
+    if (entry.str.unbarrieredGet() == str && entry.algorithm == algorithm) {
+      *hexDigest = entry.hexDigest;
+      m_hits++;
+      return true;
+    }
+  }
+  m_misses++;
+  return false;
+}
+
+// Failing to remember a digest is not an error, so running out of memory is
+// ignored.
+void boilerplate::StringHashCache::put(JSString* str, HashAlgorithm algorithm,
+                                       const std::string& hexDigest) {
+  auto& entries = m_entries.get();
+  if (entries.length() >= Capacity) entries.erase(entries.begin());
+  (void)entries.append(
+      Entry{JS::Heap<JSString*>(str), algorithm, hexDigest});
+}
+
+bool boilerplate::HashString(JSContext* cx, JS::HandleString str,
+                             HashAlgorithm algorithm, std::string* hexDigest) {
+  StringHashCache* cache = currentCache;
+  bool cacheable =
+      cache && JS_GetStringLength(str) >= StringHashCache::MinLength;
+  if (cacheable && cache->lookup(str, algorithm, hexDigest)) return true;
+
+  StringHasher hasher(algorithm);
+  if (!hasher.update(cx, str)) return false;
+  *hexDigest = hasher.hexDigest();
+
+  if (cacheable) cache->put(str, algorithm, *hexDigest);
+  return true;
+}
+
+///// The JS functions ////////////////////////////////////////////////////////
+
+static bool GetAlgorithm(JSContext* cx, JS::HandleValue value,
+                         boilerplate::HashAlgorithm* algorithm) {
+  if (value.isUndefined()) {
+    *algorithm = boilerplate::HashAlgorithm::Sha256;
+    return true;
+  }
+  JS::RootedString str(cx, JS::ToString(cx, value));
+  if (!str) return false;
+  JS::UniqueChars name = JS_EncodeStringToUTF8(cx, str);
+  if (!name) return false;
+  if (!boilerplate::ParseHashAlgorithm(name.get(), algorithm)) {
+    JS_ReportErrorUTF8(cx, "unknown hash algorithm '%s'", name.get());
+    return false;
+  }
+  return true;
+}
+
+// Get the bytes of any ArrayBuffer, SharedArrayBuffer, typed array or
+// DataView, as in resolve.cpp's Crc. The pointer is only valid as long as no
+// GC can happen.
+static bool GetBytes(JSObject* obj, uint8_t** data, size_t* length,
+                     const JS::AutoRequireNoGC& nogc) {
+  bool isSharedMemory;
+  if (JSObject* view = js::UnwrapArrayBufferView(obj)) {
+    *length = JS_GetArrayBufferViewByteLength(view);
+    *data = static_cast<uint8_t*>(
+        JS_GetArrayBufferViewData(view, &isSharedMemory, nogc));
+    return true;
+  }
+  if (JSObject* buffer = js::UnwrapArrayBuffer(obj)) {
+    *length = JS_GetArrayBufferByteLength(buffer);
+    *data = JS_GetArrayBufferData(buffer, &isSharedMemory, nogc);
+    return true;
+  }
+  if (JSObject* buffer = js::UnwrapSharedArrayBuffer(obj)) {
+    *length = JS_GetSharedArrayBufferByteLength(buffer);
+    *data = JS_GetSharedArrayBufferData(buffer, &isSharedMemory, nogc);
+    return true;
+  }
+  return false;
+}
+
+// Adds a string or the bytes of a buffer to 'hasher'.
+static bool Update(JSContext* cx, boilerplate::StringHasher* hasher,
+                   JS::HandleValue value) {
+  if (value.isString()) {
+    JS::RootedString str(cx, value.toString());
+    return hasher->update(cx, str);
+  }
+
+  bool isBuffer = false;
+  if (value.isObject()) {
+    // As in Crc::update(), shared memory is hashed as it is seen.
+    JS::AutoCheckCannotGC nogc;
+    uint8_t* data;
+    size_t length;
+    isBuffer = GetBytes(&value.toObject(), &data, &length, nogc);
+    if (isBuffer) hasher->update(data, length);
+  }
+  if (!isBuffer) {
+    JS_ReportErrorASCII(cx,
+                        "can only hash a string, ArrayBuffer, "
+                        "SharedArrayBuffer, typed array, or DataView");
+    return false;
+  }
+  return true;
+}
+
+static bool SetDigest(JSContext* cx, const std::string& hexDigest,
+                      JS::MutableHandleValue rval) {
+  JSString* str = JS_NewStringCopyN(cx, hexDigest.data(), hexDigest.size());
+  if (!str) return false;
+  rval.setString(str);
+  return true;
+}
+
+static bool Hash(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  if (!args.requireAtLeast(cx, "hash", 1)) return false;
+  boilerplate::HashAlgorithm algorithm;
+  if (!GetAlgorithm(cx, args.get(1), &algorithm)) return false;
+
+  std::string digest;
+  if (args[0].isString()) {
+    JS::RootedString str(cx, args[0].toString());
+    if (!boilerplate::HashString(cx, str, algorithm, &digest)) return false;
+  } else {
+    boilerplate::StringHasher hasher(algorithm);
+    if (!Update(cx, &hasher, args[0])) return false;
+    digest = hasher.hexDigest();
+  }
+  return SetDigest(cx, digest, args.rval());
+}
+
+// The streaming hasher. Unlike the Crc class, whose whole state fits in a
+// reserved slot, the state of a hash is a C++ object, kept in the private
+// slot and deleted by the finalizer. Deleting it doesn't touch the JS heap,
+// so the finalizer can run on the GC's background thread.
+class HashObject {
+  static boilerplate::StringHasher* getHasher(JSContext* cx,
+                                              JS::HandleObject obj,
+                                              JS::CallArgs& args) {
+    auto* hasher = static_cast<boilerplate::StringHasher*>(
+        JS_GetInstancePrivate(cx, obj, &klass, &args));
+    // The prototype is a Hash too, but has no hasher.
+    if (!hasher && !JS_IsExceptionPending(cx))
+      JS_ReportErrorASCII(cx, "Hash method called on incompatible object");
+    return hasher;
+  }
+
+  static bool constructor(JSContext* cx, unsigned argc, JS::Value* vp) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    if (!args.isConstructing()) {
+      JS_ReportErrorNumberASCII(cx, js::GetErrorMessage, nullptr,
+                                JSMSG_CANT_CALL_CLASS_CONSTRUCTOR);
+      return false;
+    }
+
+    boilerplate::HashAlgorithm algorithm;
+    if (!GetAlgorithm(cx, args.get(0), &algorithm)) return false;
+
+    JS::RootedObject obj(cx, JS_NewObjectForConstructor(cx, &klass, args));
+    if (!obj) return false;
+    JS_SetPrivate(obj, new boilerplate::StringHasher(algorithm));
+    args.rval().setObject(*obj);
+    return true;
+  }
+
+  static bool update(JSContext* cx, unsigned argc, JS::Value* vp) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    JS::RootedObject thisObj(cx);
+    if (!args.computeThis(cx, &thisObj)) return false;
+    boilerplate::StringHasher* hasher = getHasher(cx, thisObj, args);
+    if (!hasher || !args.requireAtLeast(cx, "update", 1) ||
+        !Update(cx, hasher, args[0]))
+      return false;
+    // Return the object, for chaining.
+    args.rval().setObject(*thisObj);
+    return true;
+  }
+
+  static bool digest(JSContext* cx, unsigned argc, JS::Value* vp) {
+    JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+    JS::RootedObject thisObj(cx);
+    if (!args.computeThis(cx, &thisObj)) return false;
+    boilerplate::StringHasher* hasher = getHasher(cx, thisObj, args);
+    return hasher && SetDigest(cx, hasher->hexDigest(), args.rval());
+  }
+
+  static void finalize(JSFreeOp* fop, JSObject* obj) {
+    delete static_cast<boilerplate::StringHasher*>(JS_GetPrivate(obj));
+  }
+
+  static constexpr JSClassOps classOps = {
+      nullptr,  // addProperty
+      nullptr,  // delProperty
+      nullptr,  // enumerate
+      nullptr,  // newEnumerate
+      nullptr,  // resolve
+      nullptr,  // mayResolve
+      &HashObject::finalize,
+      nullptr,  // call
+      nullptr,  // hasInstance
+      nullptr,  // construct
+      nullptr,  // trace
+  };
+
+  static const JSFunctionSpec methods[];
+
+ public:
+  static constexpr JSClass klass = {
+      "Hash",
+      JSCLASS_HAS_PRIVATE | JSCLASS_BACKGROUND_FINALIZE,
+      &HashObject::classOps,
+  };
+
+  static bool DefinePrototype(JSContext* cx, JS::HandleObject global) {
+    return !!JS_InitClass(cx, global, nullptr, &klass,
+                          &HashObject::constructor, 0, nullptr, methods,
+                          nullptr, nullptr);
+  }
+};
+constexpr JSClassOps HashObject::classOps;
+constexpr JSClass HashObject::klass;
+
+const JSFunctionSpec HashObject::methods[] = {
+    JS_FN("update", &HashObject::update, 1, JSPROP_ENUMERATE),
+    JS_FN("digest", &HashObject::digest, 0, JSPROP_ENUMERATE),
+    JS_FS_END,
+};
+
+bool boilerplate::DefineHashFunctions(JSContext* cx, JS::HandleObject global) {
+  return JS_DefineFunction(cx, global, "hash", &Hash, 1, 0) &&
+         HashObject::DefinePrototype(cx, global);
+}
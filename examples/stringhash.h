@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <jsapi.h>
+
+#include <js/GCVector.h>
+#include <js/SweepingAPI.h>
+
+#include "hash.h"
+#include "textbuffer.h"
+
+// See 'stringhash.cpp' for documentation.
+
+namespace boilerplate {
+
+enum class HashAlgorithm { Md5, Sha256, XxHash64 };
+
+// Accepts "md5", "sha256", and "xxh64".
+bool ParseHashAlgorithm(const char* name, HashAlgorithm* algorithm);
+
+// Hashes any mix of bytes and JS strings; strings are hashed as UTF-8.
+class StringHasher {
+ public:
+  explicit StringHasher(HashAlgorithm algorithm);
+
+  void update(const void* data, size_t length);
+  // Returns false, with an exception pending, if the string is a rope that
+  // couldn't be flattened.
+  bool update(JSContext* cx, JS::HandleString str);
+
+  // The digest of everything so far. More can still be added afterwards.
+  std::string hexDigest(void) const;
+
+ private:
+  HashAlgorithm m_algorithm;
+  Md5 m_md5;
+  Sha256 m_sha256;
+  XxHash64 m_xxHash64;
+  TextBuffer m_utf8;  // reused for transcoding non-ASCII text
+};
+
+// While one of these exists, HashString() remembers the digests of long
+// strings on this thread, until the strings are garbage collected. It must be
+// destroyed before the JSContext.
+class StringHashCache {
+ public:
+  // Shorter strings aren't worth remembering.
+  static constexpr size_t MinLength = 4096;
+  static constexpr size_t Capacity = 64;
+
+  explicit StringHashCache(JSContext* cx);
+  ~StringHashCache(void);
+
+  StringHashCache(const StringHashCache&) = delete;
+  StringHashCache& operator=(const StringHashCache&) = delete;
+
+  bool lookup(JSString* str, HashAlgorithm algorithm,
+              std::string* hexDigest) const;
+  void put(JSString* str, HashAlgorithm algorithm,
+           const std::string& hexDigest);
+
+  size_t hits(void) const { return m_hits; }
+  size_t misses(void) const { return m_misses; }
+
+ private:
+  struct Entry {
+    JS::Heap<JSString*> str;
+    HashAlgorithm algorithm;
+    std::string hexDigest;
+
+    void trace(JSTracer* trc, const char* name);
+    bool needsSweep(void);
+  };
+
+  JS::WeakCache<JS::GCVector<Entry, 0, js::SystemAllocPolicy>> m_entries;
+  mutable size_t m_hits;
+  mutable size_t m_misses;
+};
+
+// The hex digest of the string's UTF-8 encoding, from this thread's
+// StringHashCache if there is one.
+bool HashString(JSContext* cx, JS::HandleString str, HashAlgorithm algorithm,
+                std::string* hexDigest);
+
+// Defines hash(value, algorithm) and the Hash class on the global; see
+// 'stringhash.cpp'.
+bool DefineHashFunctions(JSContext* cx, JS::HandleObject global);
+
+}  // namespace boilerplate
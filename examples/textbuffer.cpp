@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
+#include <jsapi.h>
+
+#include <js/GCAPI.h>
+
+#include "textbuffer.h"
+
+// A TextBuffer collects UTF-8 output, such as a result to be printed, in one
+// block of memory that is reused from one use to the next.
+//
+// The usual way to get a JS string's contents into C++ is
+// JS_EncodeStringToUTF8(), which allocates a new, exactly sized buffer each
+// time; if the result then goes into a std::string, the whole text is copied
+// once more. For large output, that's slower than producing the string in
+// the first place. appendString() instead reads the string's characters in
+// place, and transcodes them directly into the buffer.
+//
+// SpiderMonkey stores strings either as Latin-1 (one byte per character, for
+// strings where all characters fit) or as UTF-16. Either way, most text is
+// ASCII, so that is the fast path: with SSE2, 16 characters at a time are
+// checked for being ASCII and copied (narrowed, from UTF-16) with a single
+// store. Only the non-ASCII characters go through the scalar encoder.
+//
+// Without SSE2, the same code runs one character at a time.
+
+// Worst case growth of the text when encoded as UTF-8: Latin-1 characters
+// over 0x7F take two bytes; UTF-16 code units take at most three bytes (a
+// surrogate pair is two units and four bytes.)
+static constexpr size_t MaxUtf8PerLatin1 = 2;
+static constexpr size_t MaxUtf8PerTwoByte = 3;
+
+static constexpr char16_t ReplacementChar = 0xFFFD;
+
+// These copy ASCII characters from the start of 'src' to 'dst', and return
+// how many there were. 'dst' must have room for 16 bytes more than 'length'
+// when using SSE2; grow() makes sure of that.
+
+static size_t CopyAscii(const JS::Latin1Char* src, size_t length, char* dst) {
+  size_t ix = 0;
+#if defined(__SSE2__)
+  for (; ix + 16 <= length; ix += 16) {
+    __m128i chars =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + ix));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + ix), chars);
+    // The high bit of each byte is set for non-ASCII characters.
+    int nonAscii = _mm_movemask_epi8(chars);
+    if (nonAscii) return ix + __builtin_ctz(nonAscii);
+  }
+#endif
+  for (; ix < length && src[ix] < 0x80; ix++) dst[ix] = char(src[ix]);
+  return ix;
+}
+
+static size_t CopyAscii(const char16_t* src, size_t length, char* dst) {
+  size_t ix = 0;
+#if defined(__SSE2__)
+  const __m128i nonAsciiBits = _mm_set1_epi16(int16_t(0xFF80));
+  const __m128i zero = _mm_setzero_si128();
+  for (; ix + 16 <= length; ix += 16) {
+    __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + ix));
+    __m128i hi =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + ix + 8));
+    __m128i bits = _mm_and_si128(_mm_or_si128(lo, hi), nonAsciiBits);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi16(bits, zero)) != 0xFFFF)
+      break;  // find the exact position below
+    // All 16 are below 0x80, so narrowing them with saturation is exact.
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + ix),
+                     _mm_packus_epi16(lo, hi));
+  }
+#endif
+  for (; ix < length && src[ix] < 0x80; ix++) dst[ix] = char(src[ix]);
+  return ix;
+}
+
+static inline char* EncodeUtf8(uint32_t c, char* out) {
+  if (c < 0x80) {
+    *out++ = char(c);
+  } else if (c < 0x800) {
+    *out++ = char(0xC0 | (c >> 6));
+    *out++ = char(0x80 | (c & 0x3F));
+  } else if (c < 0x10000) {
+    *out++ = char(0xE0 | (c >> 12));
+    *out++ = char(0x80 | ((c >> 6) & 0x3F));
+    *out++ = char(0x80 | (c & 0x3F));
+  } else {
+    *out++ = char(0xF0 | (c >> 18));
+    *out++ = char(0x80 | ((c >> 12) & 0x3F));
+    *out++ = char(0x80 | ((c >> 6) & 0x3F));
+    *out++ = char(0x80 | (c & 0x3F));
+  }
+  return out;
+}
+
+char* boilerplate::TextBuffer::grow(size_t length) {
+  // The SIMD loops may store up to 16 bytes past the characters they copy.
+  size_t needed = m_length + length + 16;
+  if (needed > m_capacity) {
+    size_t capacity = std::max(needed, std::max<size_t>(4096, 2 * m_capacity));
+    std::unique_ptr<char[]> chars(new char[capacity]);
+    if (m_length) memcpy(chars.get(), m_chars.get(), m_length);
+    m_chars = std::move(chars);
+    m_capacity = capacity;
+  }
+  return m_chars.get() + m_length;
+}
+
+void boilerplate::TextBuffer::append(const char* chars, size_t length) {
+  memcpy(grow(length), chars, length);
+  m_length += length;
+}
+
+void boilerplate::TextBuffer::appendLatin1(const JS::Latin1Char* chars,
+                                           size_t length) {
+  char* start = grow(length * MaxUtf8PerLatin1);
+  char* out = start;
+  size_t ix = 0;
+  while (ix < length) {
+    size_t ascii = CopyAscii(chars + ix, length - ix, out);
+    ix += ascii;
+    out += ascii;
+    for (; ix < length && chars[ix] >= 0x80; ix++)
+      out = EncodeUtf8(chars[ix], out);
+  }
+  m_length += out - start;
+}
+
+void boilerplate::TextBuffer::appendTwoByte(const char16_t* chars,
+                                            size_t length) {
+  char* start = grow(length * MaxUtf8PerTwoByte);
+  char* out = start;
+  size_t ix = 0;
+  while (ix < length) {
+    size_t ascii = CopyAscii(chars + ix, length - ix, out);
+    ix += ascii;
+    out += ascii;
+    for (; ix < length && chars[ix] >= 0x80; ix++) {
+      uint32_t c = chars[ix];
+      if (c >= 0xD800 && c <= 0xDFFF) {
+        char16_t next = ix + 1 < length ? chars[ix + 1] : 0;
+        if (c <= 0xDBFF && next >= 0xDC00 && next <= 0xDFFF) {
+          c = 0x10000 + ((c - 0xD800) << 10) + (next - 0xDC00);
+          ix++;
+        } else {
+          c = ReplacementChar;
+        }
+      }
+      out = EncodeUtf8(c, out);
+    }
+  }
+  m_length += out - start;
+}
+
+bool boilerplate::TextBuffer::appendString(JSContext* cx,
+                                           JS::HandleString str) {
+  // A rope (the result of concatenating strings) has no characters of its
+  // own until it is flattened, which may allocate; do that before we promise
+  // not to GC.
+  if (!JS_EnsureLinearString(cx, str)) return false;
+
+  JS::AutoCheckCannotGC nogc;
+  size_t length;
+  if (JS_StringHasLatin1Chars(str)) {
+    const JS::Latin1Char* chars =
+        JS_GetLatin1StringCharsAndLength(cx, nogc, str, &length);
+    if (!chars) return false;
+    appendLatin1(chars, length);
+  } else {
+    const char16_t* chars =
+        JS_GetTwoByteStringCharsAndLength(cx, nogc, str, &length);
+    if (!chars) return false;
+    appendTwoByte(chars, length);
+  }
+  return true;
+}
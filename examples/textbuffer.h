@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+
+#include <jsapi.h>
+
+// See 'textbuffer.cpp' for documentation.
+
+namespace boilerplate {
+
+class TextBuffer {
+ public:
+  TextBuffer(void) : m_length(0), m_capacity(0) {}
+
+  TextBuffer(const TextBuffer&) = delete;
+  TextBuffer& operator=(const TextBuffer&) = delete;
+
+  // Keeps the allocated memory, for the next use.
+  void clear(void) { m_length = 0; }
+  void truncate(size_t length) {
+    if (length < m_length) m_length = length;
+  }
+
+  void append(char c) {
+    *grow(1) = c;
+    m_length++;
+  }
+  void append(const char* chars, size_t length);
+  void append(const char* str) { append(str, strlen(str)); }
+
+  // Both encode as UTF-8. Unpaired surrogates in two-byte text become U+FFFD,
+  // as with JS_EncodeStringToUTF8().
+  void appendLatin1(const JS::Latin1Char* chars, size_t length);
+  void appendTwoByte(const char16_t* chars, size_t length);
+
+  // Appends the string's characters as UTF-8 without copying them into a
+  // temporary first. Returns false (with an exception pending) if out of
+  // memory.
+  bool appendString(JSContext* cx, JS::HandleString str);
+
+  const char* data(void) const { return m_chars.get(); }
+  size_t size(void) const { return m_length; }
+  bool empty(void) const { return m_length == 0; }
+  std::string str(void) const { return std::string(data(), size()); }
+
+  void writeTo(std::ostream& out) const { out.write(data(), size()); }
+
+  // Exchanges the contents and memory of the two buffers.
+  void swap(TextBuffer& other) {
+    std::swap(m_chars, other.m_chars);
+    std::swap(m_length, other.m_length);
+    std::swap(m_capacity, other.m_capacity);
+  }
+
+ private:
+  // Makes room for at least 'length' more bytes, without initializing them,
+  // and returns a pointer to the first one.
+  char* grow(size_t length);
+
+  std::unique_ptr<char[]> m_chars;
+  size_t m_length;
+  size_t m_capacity;
+};
+
+}  // namespace boilerplate
@@ -0,0 +1,197 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <jsapi.h>
+#include <jsfriendapi.h>
+
+#include <js/CompilationAndEvaluation.h>
+#include <js/Conversions.h>
+#include <js/Initialization.h>
+#include <js/SourceText.h>
+
+#include "boilerplate.h"
+#include "eventloop.h"
+
+// This example shows how to run Promise jobs and timers from the embedding's
+// own event loop, boilerplate::EventLoop, instead of SpiderMonkey's internal
+// job queue. See 'eventloop.cpp' for how the event loop works.
+//
+// First it runs a script that prints the order in which synchronous code,
+// microtasks, and timers run, and leaves a rejected promise unhandled. Then it
+// measures how many Promise jobs per second the event loop runs, for a few
+// ways of creating them.
+//
+// With --internal, the benchmarks use js::UseInternalJobQueues() and
+// js::RunJobs() instead, for comparison. The number of jobs per benchmark can
+// be given as an argument.
+
+static unsigned numJobs = 1000000;
+static bool useInternalQueue = false;
+
+using Clock = std::chrono::steady_clock;
+using Seconds = std::chrono::duration<double>;
+
+static const char* orderingScript = R"js(
+  const log = [];
+  setTimeout(() => log.push('timer 20ms'), 20);
+  const cleared = setTimeout(() => log.push('cleared timer'), 10);
+  setTimeout(() => {
+    log.push('timer 0ms');
+    Promise.resolve().then(() => log.push('microtask from timer'));
+  }, 0);
+  setTimeout(() => log.push('second timer 0ms'), 0);
+  Promise.resolve().then(() => log.push('microtask 1'))
+    .then(() => log.push('microtask 2'));
+  queueMicrotask(() => log.push('queueMicrotask'));
+  clearTimeout(cleared);
+  Promise.reject(new Error('nobody handles this'));
+  log.push('synchronous');
+  setTimeout(() => print(log.join('\n')), 30);
+)js";
+
+// The benchmarks each resolve numJobs promises in a different way, and then
+// call done() from the last job.
+static const struct {
+  const char* name;
+  const char* code;
+} benchmarks[] = {
+    {"then() chain",
+     "let p = Promise.resolve(); for (let i = 0; i < n; i++) p = p.then(() => "
+     "{}); p.then(done);"},
+    {"Promise.resolve().then() fan-out",
+     "let left = n; for (let i = 0; i < n; i++) Promise.resolve(i).then(() => "
+     "{ if (--left === 0) done(); });"},
+    {"await loop",
+     "(async function () { for (let i = 0; i < n; i++) await i; done(); })();"},
+    {"queueMicrotask",
+     "let left = n; const job = () => { if (--left === 0) done(); }; for (let "
+     "i = 0; i < n; i++) queueMicrotask(job);"},
+};
+
+static bool Print(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  JS::RootedString str(cx, JS::ToString(cx, args.get(0)));
+  if (!str) return false;
+  JS::UniqueChars chars = JS_EncodeStringToUTF8(cx, str);
+  if (!chars) return false;
+  std::cout << chars.get() << '\n';
+  args.rval().setUndefined();
+  return true;
+}
+
+static bool finished = false;
+
+static bool Done(JSContext* cx, unsigned argc, JS::Value* vp) {
+  JS::CallArgs args = JS::CallArgsFromVp(argc, vp);
+  finished = true;
+  args.rval().setUndefined();
+  return true;
+}
+
+static const JSFunctionSpec globalFunctions[] = {
+    JS_FN("print", &Print, 1, 0), JS_FN("done", &Done, 0, 0), JS_FS_END};
+
+// queueMicrotask() isn't available on the internal job queue, so we provide
+// a simple replacement that goes through a resolved promise.
+static const char* internalQueueMicrotask =
+    "this.queueMicrotask = f => { Promise.resolve().then(f); };";
+
+static bool RunScript(JSContext* cx, const char* name, const char* code) {
+  JS::CompileOptions options(cx);
+  options.setFileAndLine(name, 1);
+
+  JS::SourceText<mozilla::Utf8Unit> source;
+  if (!source.init(cx, code, strlen(code), JS::SourceOwnership::Borrowed))
+    return false;
+
+  JS::RootedValue rval(cx);
+  return JS::Evaluate(cx, options, source, &rval);
+}
+
+static bool RunBenchmark(JSContext* cx, boilerplate::EventLoop* loop,
+                         const char* name, const char* body) {
+  std::string code = "(function (n) { " + std::string(body) + " })";
+
+  JS::CompileOptions options(cx);
+  options.setFileAndLine(name, 1);
+  JS::SourceText<mozilla::Utf8Unit> source;
+  JS::RootedValue fn(cx);
+  if (!source.init(cx, code.c_str(), code.size(),
+                   JS::SourceOwnership::Borrowed) ||
+      !JS::Evaluate(cx, options, source, &fn))
+    return false;
+
+  JS::RootedValueArray<1> args(cx);
+  args[0].setNumber(numJobs);
+  JS::RootedValue rval(cx);
+
+  finished = false;
+  Clock::time_point start = Clock::now();
+  if (!JS_CallFunctionValue(cx, nullptr, fn, args, &rval)) return false;
+  if (loop)
+    loop->run(cx);
+  else
+    js::RunJobs(cx);
+  Seconds elapsed = Clock::now() - start;
+
+  if (!finished) {
+    std::cerr << name << ": done() was not called\n";
+    return false;
+  }
+  std::cout << name << "\t" << numJobs / elapsed.count() / 1e6
+            << " M jobs/s\n";
+  return true;
+}
+
+static bool TimersExample(JSContext* cx) {
+  boilerplate::EventLoop loop;
+  if (useInternalQueue) {
+    if (!js::UseInternalJobQueues(cx)) return false;
+  } else if (!loop.init(cx)) {
+    return false;
+  }
+
+  // Self-hosting must be initialized after setting up the job queue.
+  if (!JS::InitSelfHostedCode(cx)) return false;
+
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) return false;
+
+  JSAutoRealm ar(cx, global);
+
+  if (!JS_DefineFunctions(cx, global, globalFunctions)) return false;
+
+  if (useInternalQueue) {
+    if (!RunScript(cx, "queueMicrotask", internalQueueMicrotask)) return false;
+  } else {
+    if (!loop.defineFunctions(cx, global) ||
+        !RunScript(cx, "ordering", orderingScript))
+      return false;
+    loop.run(cx);
+  }
+
+  std::cout << numJobs << " jobs per benchmark, "
+            << (useInternalQueue ? "internal job queue" : "EventLoop") << '\n';
+  for (const auto& benchmark : benchmarks) {
+    if (!RunBenchmark(cx, useInternalQueue ? nullptr : &loop, benchmark.name,
+                      benchmark.code))
+      return false;
+  }
+  return true;
+}
+
+int main(int argc, const char* argv[]) {
+  for (int ix = 1; ix < argc; ix++) {
+    if (strcmp(argv[ix], "--internal") == 0)
+      useInternalQueue = true;
+    else
+      numJobs = strtoul(argv[ix], nullptr, 10);
+  }
+
+  if (!boilerplate::RunExample(TimersExample, /* initSelfHosting = */ false))
+    return 1;
+  return 0;
+}
@@ -1,14 +1,20 @@
+#include <chrono>
+#include <iostream>
 #include <memory>
 #include <vector>
 
 #include <jsapi.h>
 
+#include <js/GCVector.h>
+
 #include "boilerplate.h"
+#include "gcstats.h"
 
 // This example illustrates how to safely store GC pointers in the embedding's
 // data structures by implementing appropriate tracing mechanisms. This example
 // covers using strong references where C++ keeps the JS objects alive. Weak
-// references use a different implementation strategy that is not covered here.
+// references use a different implementation strategy that is not covered here;
+// see boilerplate::WeakObjectMap (weakobjectmap.h) and weakrefs.cpp for that.
 
 ////////////////////////////////////////////////////////////
 
@@ -96,7 +102,9 @@ static bool ExistingTypeExample(JSContext* cx) {
 // can be a performance overhead if you rapidly create / destroy C++ objects.
 // If you have an array of C++ objects it is preferable to root the container
 // rather than putting a PersistentRooted in each element. See the
-// SafeBox::container field in the example above.
+// SafeBox::container field in the example above, or boilerplate::HandleTable
+// (handletable.cpp) for a table of values that C++ code can add to and remove
+// from individually.
 
 // A global PersistentRooted is created before SpiderMonkey has initialized so
 // we must be careful to not create any JS::Heap fields during construction.
@@ -144,6 +152,76 @@ static bool EmbeddingRootExample(JSContext* cx) {
 
 ////////////////////////////////////////////////////////////
 
+// To put numbers on the advice above, here we keep the same number of objects
+// alive in two ways: with one PersistentRooted per object, and with a single
+// Rooted container. We measure how long it takes to create and drop the roots,
+// and use boilerplate::GCStats to see how long a full GC takes while they are
+// alive.
+
+static constexpr size_t numRootedObjects = 100000;
+
+static void PrintRootingCost(const char* what,
+                             std::chrono::duration<double, std::milli> elapsed,
+                             const boilerplate::GCStats& stats) {
+  boilerplate::GCStats::Summary summary = stats.summarize();
+  std::cout << what << ": " << elapsed.count() << " ms to root and unroot, "
+            << summary.maxMs << " ms max GC pause\n";
+}
+
+static bool RootingCostExample(JSContext* cx) {
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) return false;
+
+  JSAutoRealm ar(cx, global);
+
+  using Clock = std::chrono::steady_clock;
+
+  {
+    boilerplate::GCStats stats;
+    stats.install(cx);
+
+    Clock::time_point start = Clock::now();
+    std::vector<std::unique_ptr<JS::PersistentRooted<JSObject*>>> roots;
+    roots.reserve(numRootedObjects);
+    for (size_t ix = 0; ix < numRootedObjects; ix++) {
+      JSObject* obj = JS_NewPlainObject(cx);
+      if (!obj) return false;
+      roots.emplace_back(new JS::PersistentRooted<JSObject*>(cx, obj));
+    }
+    JS_GC(cx);
+    roots.clear();
+    std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+
+    stats.uninstall();
+    PrintRootingCost("PersistentRooted per object", elapsed, stats);
+  }
+
+  {
+    boilerplate::GCStats stats;
+    stats.install(cx);
+
+    Clock::time_point start = Clock::now();
+    {
+      JS::Rooted<JS::GCVector<JSObject*>> container(
+          cx, JS::GCVector<JSObject*>(cx));
+      if (!container.reserve(numRootedObjects)) return false;
+      for (size_t ix = 0; ix < numRootedObjects; ix++) {
+        JSObject* obj = JS_NewPlainObject(cx);
+        if (!obj || !container.append(obj)) return false;
+      }
+      JS_GC(cx);
+    }
+    std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+
+    stats.uninstall();
+    PrintRootingCost("one rooted container", elapsed, stats);
+  }
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////
+
 static bool TracingExample(JSContext* cx) {
   if (!CustomTypeExample(cx)) {
     return false;
@@ -157,6 +235,9 @@ static bool TracingExample(JSContext* cx) {
   if (!EmbeddingRootExample(cx)) {
     return false;
   }
+  if (!RootingCostExample(cx)) {
+    return false;
+  }
 
   return true;
 }
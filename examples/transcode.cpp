@@ -0,0 +1,160 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <jsapi.h>
+
+#include <js/BuildId.h>
+#include <js/CompilationAndEvaluation.h>
+#include <js/SourceText.h>
+
+#include "transcode.h"
+
+// These helpers save compiled scripts to disk using SpiderMonkey's XDR
+// ("eXternal Data Representation") transcoding, so that a later process can
+// load the bytecode instead of parsing the source again.
+//
+// XDR data is only valid for the exact build of SpiderMonkey that produced it.
+// SpiderMonkey embeds a build ID in the encoded data and refuses to decode data
+// with a different build ID, but it's the embedding's job to provide the build
+// ID; see SetBuildIdOp() below. Whenever decoding fails for that or any other
+// reason, we just compile the source normally and overwrite the file.
+//
+// On disk, the XDR data is preceded by a small header of our own, which holds
+// a hash of the source text. That way we notice when the source has changed
+// since the file was written, without reading the rest of the file. The
+// header is 16 bytes so that the XDR data after it stays 8-byte aligned.
+
+static constexpr char Magic[4] = {'S', 'M', 'X', 'D'};
+
+struct FileHeader {
+  char magic[4];
+  uint32_t reserved;
+  uint64_t sourceHash;
+};
+static_assert(sizeof(FileHeader) == 16, "XDR data must stay aligned");
+
+// 64-bit FNV-1a, as in scriptcache.cpp.
+static uint64_t HashSource(const char* code, size_t length) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (size_t ix = 0; ix < length; ix++) {
+    hash ^= static_cast<unsigned char>(code[ix]);
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+// The build ID must change whenever the bytecode format might change. Both
+// this program's build time and the SpiderMonkey version are part of it, so
+// that rebuilding the program or upgrading the SpiderMonkey library both
+// invalidate old files.
+static bool GetBuildId(JS::BuildIdCharVector* buildId) {
+  const char* version = JS_GetImplementationVersion();
+  static const char buildTime[] = __DATE__ " " __TIME__;
+  return buildId->append(version, strlen(version)) &&
+         buildId->append(buildTime, strlen(buildTime));
+}
+
+// Must be called once per process before encoding or decoding any scripts.
+void boilerplate::SetBuildIdOp(void) { JS::SetProcessBuildIdOp(GetBuildId); }
+
+// Encode 'script' and write it to 'path'. 'code' is the source text it was
+// compiled from, which is used to validate the file when decoding.
+bool boilerplate::EncodeScriptToFile(JSContext* cx, JS::HandleScript script,
+                                     const char* path, const char* code,
+                                     size_t length) {
+  JS::TranscodeBuffer buffer;
+  JS::TranscodeResult result = JS::EncodeScript(cx, buffer, script);
+  if (result == JS::TranscodeResult_Throw) return false;
+  if (result != JS::TranscodeResult_Ok) {
+    JS_ReportErrorASCII(cx, "could not encode script (error %d)", result);
+    return false;
+  }
+
+  FileHeader header;
+  memcpy(header.magic, Magic, sizeof(Magic));
+  header.reserved = 0;
+  header.sourceHash = HashSource(code, length);
+
+  FILE* fp = fopen(path, "wb");
+  if (!fp) {
+    JS_ReportErrorUTF8(cx, "could not open %s for writing", path);
+    return false;
+  }
+  bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+            fwrite(buffer.begin(), 1, buffer.length(), fp) == buffer.length();
+  ok = fclose(fp) == 0 && ok;
+  if (!ok) {
+    std::remove(path);
+    JS_ReportErrorUTF8(cx, "could not write %s", path);
+    return false;
+  }
+  return true;
+}
+
+// Read the file at 'path' and decode the script from it. The header is read
+// first, so that a file for a different source is rejected without reading
+// the XDR data. '*decoded' is set to false, and no exception is thrown, if the
+// file doesn't exist or can't be used for 'code'; only returns false for
+// errors that the caller can't recover from by compiling.
+bool boilerplate::DecodeScriptFromFile(JSContext* cx, const char* path,
+                                       const char* code, size_t length,
+                                       JS::MutableHandleScript script,
+                                       bool* decoded) {
+  *decoded = false;
+
+  std::ifstream in(path, std::ios::binary);
+  FileHeader header;
+  if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      memcmp(header.magic, Magic, sizeof(Magic)) != 0 ||
+      header.sourceHash != HashSource(code, length))
+    return true;
+
+  in.seekg(0, std::ios::end);
+  std::streamoff end = in.tellg();
+  if (!in || end <= std::streamoff(sizeof(header))) return true;
+  size_t size = size_t(end) - sizeof(header);
+
+  JS::TranscodeBuffer buffer;
+  if (!buffer.resize(size)) {
+    JS_ReportOutOfMemory(cx);
+    return false;
+  }
+  in.seekg(sizeof(header));
+  if (!in.read(reinterpret_cast<char*>(buffer.begin()), size)) return true;
+
+  JS::TranscodeRange range(buffer.begin(), buffer.length());
+  JS::TranscodeResult result = JS::DecodeScript(cx, range, script);
+  if (result == JS::TranscodeResult_Throw) return false;
+  *decoded = result == JS::TranscodeResult_Ok;
+  return true;
+}
+
+// Load the compiled form of 'code' from 'cachePath' if possible, otherwise
+// compile it from source and update 'cachePath' for next time. If 'fromCache'
+// is given, it is set to whether the script was loaded from the file.
+//
+// Failing to write the cache file is not an error; the script can still run.
+bool boilerplate::CompileWithBytecodeCache(
+    JSContext* cx, const JS::ReadOnlyCompileOptions& options, const char* code,
+    size_t length, const char* cachePath, JS::MutableHandleScript script,
+    bool* fromCache) {
+  bool decoded;
+  if (!DecodeScriptFromFile(cx, cachePath, code, length, script, &decoded))
+    return false;
+
+  if (fromCache) *fromCache = decoded;
+  if (decoded) return true;
+
+  JS::SourceText<mozilla::Utf8Unit> source;
+  if (!source.init(cx, code, length, JS::SourceOwnership::Borrowed) ||
+      !JS::Compile(cx, options, source, script)) {
+    return false;
+  }
+
+  if (!EncodeScriptToFile(cx, script, cachePath, code, length))
+    JS_ClearPendingException(cx);
+
+  return true;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+
+#include <jsapi.h>
+
+// See 'transcode.cpp' for documentation.
+
+namespace boilerplate {
+
+void SetBuildIdOp(void);
+
+bool EncodeScriptToFile(JSContext* cx, JS::HandleScript script,
+                        const char* path, const char* code, size_t length);
+
+bool DecodeScriptFromFile(JSContext* cx, const char* path, const char* code,
+                          size_t length, JS::MutableHandleScript script,
+                          bool* decoded);
+
+bool CompileWithBytecodeCache(JSContext* cx,
+                              const JS::ReadOnlyCompileOptions& options,
+                              const char* code, size_t length,
+                              const char* cachePath,
+                              JS::MutableHandleScript script,
+                              bool* fromCache = nullptr);
+
+}  // namespace boilerplate
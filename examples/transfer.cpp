@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <jsapi.h>
+
+#include <js/CompilationAndEvaluation.h>
+#include <js/JSON.h>
+#include <js/SourceText.h>
+
+#include "boilerplate.h"
+#include "message.h"
+
+// This example shows how to pass values between contexts on different threads
+// with boilerplate::Message, which uses the structured clone algorithm, and
+// compares that with passing JSON strings. See 'message.cpp' for how
+// transferring and sharing work.
+//
+// For payload sizes from 1 KB to 100 MB, it sends a payload to a worker
+// context on another thread and back, many times, and prints the throughput
+// for each way of doing that:
+//
+// - JSON: an object with a string of that size, stringified, copied as a
+//   std::string, and parsed again on the other side.
+// - clone: the same object, with the structured clone algorithm.
+// - transfer: an object with an ArrayBuffer of that size, transferred each
+//   way, so that the buffer's contents are never copied.
+// - shared: an object with a SharedArrayBuffer of that size, which both
+//   contexts share.
+
+static constexpr size_t KB = 1024;
+static constexpr size_t MB = 1024 * KB;
+static const size_t payloadSizes[] = {1 * KB,   16 * KB, 256 * KB,
+                                      4 * MB,   32 * MB, 100 * MB};
+static constexpr size_t bytesPerBenchmark = 512 * MB;
+
+using Clock = std::chrono::steady_clock;
+using Seconds = std::chrono::duration<double>;
+
+// Each context has a global with SharedArrayBuffer enabled, which it isn't by
+// default. The worker's global is kept here by the pool's worker hooks.
+static JSObject* CreateSharedMemoryGlobal(JSContext* cx) {
+  JS::RealmOptions options;
+  options.creationOptions().setSharedMemoryAndAtomicsEnabled(true);
+
+  static constexpr JSClass klass = {"TransferGlobal", JSCLASS_GLOBAL_FLAGS,
+                                    &JS::DefaultGlobalClassOps};
+  return JS_NewGlobalObject(cx, &klass, nullptr, JS::FireOnNewGlobalHook,
+                            options);
+}
+
+static thread_local JS::PersistentRooted<JSObject*>* workerGlobal = nullptr;
+
+// Creates the payloads, and picks what to transfer when sending one: the
+// ArrayBuffer, if there is one. A SharedArrayBuffer can't be transferred; it
+// is shared instead.
+static const char* setupScript = R"js(
+  function makePayload(kind, size) {
+    switch (kind) {
+      case 'json':
+      case 'clone':
+        return {id: 1, text: 'x'.repeat(size)};
+      case 'transfer':
+        return {id: 1, data: new ArrayBuffer(size)};
+      case 'shared':
+        return {id: 1, data: new SharedArrayBuffer(size)};
+    }
+  }
+  function transferList(payload) {
+    return payload.data instanceof ArrayBuffer ? [payload.data] : undefined;
+  }
+)js";
+
+static bool RunScript(JSContext* cx, const char* code,
+                      JS::MutableHandleValue rval) {
+  JS::CompileOptions options(cx);
+  options.setFileAndLine("transfer", 1);
+  JS::SourceText<mozilla::Utf8Unit> source;
+  return source.init(cx, code, strlen(code), JS::SourceOwnership::Borrowed) &&
+         JS::Evaluate(cx, options, source, rval);
+}
+
+static bool SetUpWorker(JSContext* cx) {
+  JS::RootedObject global(cx, CreateSharedMemoryGlobal(cx));
+  if (!global) return false;
+
+  JSAutoRealm ar(cx, global);
+  JS::RootedValue unused(cx);
+  if (!RunScript(cx, setupScript, &unused)) return false;
+
+  workerGlobal = new JS::PersistentRooted<JSObject*>(cx, global);
+  return true;
+}
+
+static void TearDownWorker(JSContext* cx) {
+  delete workerGlobal;
+  workerGlobal = nullptr;
+}
+
+static bool TransferList(JSContext* cx, JS::HandleObject global,
+                         JS::HandleValue payload,
+                         JS::MutableHandleValue list) {
+  JS::RootedValueArray<1> args(cx);
+  args[0].set(payload);
+  return JS_CallFunctionName(cx, global, "transferList", args, list);
+}
+
+static bool Stringify(JSContext* cx, JS::MutableHandleValue value,
+                      std::string* out) {
+  out->clear();
+  auto append = [](const char16_t* chars, uint32_t len, void* data) {
+    auto* str = static_cast<std::string*>(data);
+    for (uint32_t ix = 0; ix < len; ix++) *str += char(chars[ix]);  // ASCII
+    return true;
+  };
+  return JS_Stringify(cx, value, nullptr, JS::NullHandleValue, append, out);
+}
+
+static bool Parse(JSContext* cx, const std::string& json,
+                  JS::MutableHandleValue value) {
+  JS::RootedString str(cx,
+                       JS_NewStringCopyN(cx, json.data(), json.size()));
+  return str && JS_ParseJSON(cx, str, value);
+}
+
+// Sends the payload to the worker and back with JSON.
+static bool RoundTripJSON(JSContext* cx, boilerplate::ContextPool& pool,
+                          JS::MutableHandleValue payload) {
+  auto json = std::make_shared<std::string>();
+  if (!Stringify(cx, payload, json.get())) return false;
+
+  bool ok = pool.run([json](JSContext* wcx) {
+    JSAutoRealm ar(wcx, *workerGlobal);
+    JS::RootedValue value(wcx);
+    return Parse(wcx, *json, &value) && Stringify(wcx, &value, json.get());
+  });
+  return ok && Parse(cx, *json, payload);
+}
+
+// Sends the payload to the worker and back with structured clone, transferring
+// whatever transferList() says.
+static bool RoundTripClone(JSContext* cx, JS::HandleObject global,
+                           boilerplate::ContextPool& pool,
+                           JS::MutableHandleValue payload) {
+  auto message = std::make_shared<boilerplate::Message>();
+  JS::RootedValue transfer(cx);
+  if (!TransferList(cx, global, payload, &transfer) ||
+      !message->write(cx, payload, transfer))
+    return false;
+
+  bool ok = pool.run([message](JSContext* wcx) {
+    JS::RootedObject wglobal(wcx, *workerGlobal);
+    JSAutoRealm ar(wcx, wglobal);
+    JS::RootedValue value(wcx), transfer(wcx);
+    return message->read(wcx, &value) &&
+           TransferList(wcx, wglobal, value, &transfer) &&
+           message->write(wcx, value, transfer);
+  });
+  return ok && message->read(cx, payload);
+}
+
+static bool Benchmark(JSContext* cx, JS::HandleObject global,
+                      boilerplate::ContextPool& pool, const char* kind,
+                      size_t size, double* bytesPerSec) {
+  std::string code = "makePayload('" + std::string(kind) + "', " +
+                     std::to_string(size) + ");";
+  JS::RootedValue payload(cx);
+  if (!RunScript(cx, code.c_str(), &payload)) return false;
+
+  size_t iterations =
+      std::max<size_t>(3, std::min<size_t>(10000, bytesPerBenchmark / size));
+  bool json = strcmp(kind, "json") == 0;
+
+  Clock::time_point start = Clock::now();
+  for (size_t ix = 0; ix < iterations; ix++) {
+    if (json ? !RoundTripJSON(cx, pool, &payload)
+             : !RoundTripClone(cx, global, pool, &payload))
+      return false;
+  }
+  Seconds elapsed = Clock::now() - start;
+
+  // Each round trip moves the payload twice.
+  *bytesPerSec = 2.0 * iterations * size / elapsed.count();
+  return true;
+}
+
+static bool TransferExample(JSContext* cx) {
+  boilerplate::ContextPool pool(1);
+  pool.setWorkerHooks(SetUpWorker, TearDownWorker);
+  if (!pool.init()) return false;
+
+  JS::RootedObject global(cx, CreateSharedMemoryGlobal(cx));
+  if (!global) return false;
+
+  JSAutoRealm ar(cx, global);
+  JS::RootedValue unused(cx);
+  if (!RunScript(cx, setupScript, &unused)) return false;
+
+  static const char* kinds[] = {"json", "clone", "transfer", "shared"};
+  std::cout << "size";
+  for (const char* kind : kinds) std::cout << '\t' << kind;
+  std::cout << '\n';
+
+  for (size_t size : payloadSizes) {
+    std::cout << size / KB << " KB";
+    for (const char* kind : kinds) {
+      double bytesPerSec;
+      if (!Benchmark(cx, global, pool, kind, size, &bytesPerSec)) return false;
+      std::cout << '\t' << bytesPerSec / MB << " MB/s";
+    }
+    std::cout << '\n';
+    JS_GC(cx);
+  }
+  return true;
+}
+
+int main(int argc, const char* argv[]) {
+  if (!boilerplate::RunExample(TransferExample)) return 1;
+  return 0;
+}
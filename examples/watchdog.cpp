@@ -0,0 +1,223 @@
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+
+#include <pthread.h>
+#include <time.h>
+
+#include <jsapi.h>
+
+#include "watchdog.h"
+
+// A Watchdog stops scripts that run for too long, so that one runaway script
+// can't keep a thread busy forever.
+//
+// SpiderMonkey can't be stopped from another thread directly. Instead, any
+// thread may call JS_RequestInterruptCallback(), and the context's thread will
+// call its interrupt callbacks at the next safe point, such as the top of a
+// loop or a function call. If a callback returns false, the script is
+// terminated with an uncatchable exception: the outermost JS API call returns
+// false without an exception pending.
+//
+// A ScriptBudget sets the limits for the scripts that run on its thread while
+// it is in scope, and measures the wall clock time and the thread's CPU time
+// that they use. The watchdog thread sleeps until the earliest time at which a
+// registered budget could be used up, and then requests an interrupt. Since a
+// thread can't use more CPU time than wall clock time, the earliest time a CPU
+// budget could run out is now plus the CPU time remaining; the watchdog reads
+// the script thread's CPU clock, through pthread_getcpuclockid(), to find out
+// how much that is. The interrupt callback then checks the limits again on the
+// script's own thread, and only terminates the script if they have really
+// been exceeded, so interrupts requested for other reasons, or for a budget
+// that has since ended, are harmless.
+//
+// Scripts that are not running JS, but are blocked in a native function, can
+// only be stopped once they return to JS.
+//
+// Usage:
+//
+//   Watchdog watchdog;
+//   watchdog.start();
+//   ...
+//   Watchdog::Install(cx);  // once per context, on its thread
+//   ScriptLimits limits;
+//   limits.cpuTime = std::chrono::milliseconds(100);
+//   {
+//     ScriptBudget budget(watchdog, cx, limits);
+//     if (!JS::Evaluate(cx, options, source, &rval) && budget.exceeded())
+//       ... the script was terminated ...
+//   }
+//
+// macOS has no pthread_getcpuclockid(). There, CPU time budgets are measured
+// against the wall clock instead, which is never behind the thread's CPU
+// time, so a script is stopped no later than it would be elsewhere, but may
+// be stopped sooner if its thread doesn't get a whole CPU.
+
+// Don't wake up more often than this to check a CPU budget that is about to
+// run out.
+static constexpr std::chrono::milliseconds MinCheckInterval(1);
+
+// The innermost budget on this thread, for the interrupt callback.
+static thread_local boilerplate::ScriptBudget* currentBudget = nullptr;
+
+static std::chrono::nanoseconds ReadClock(clockid_t clock) {
+  timespec now;
+  if (clock_gettime(clock, &now) != 0) return std::chrono::nanoseconds(0);
+  return std::chrono::seconds(now.tv_sec) +
+         std::chrono::nanoseconds(now.tv_nsec);
+}
+
+boilerplate::Watchdog::Watchdog(void)
+    : m_stopping(false), m_counters{0, 0, std::chrono::nanoseconds(0)} {}
+
+boilerplate::Watchdog::~Watchdog(void) {
+  if (!m_thread.joinable()) return;
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_stopping = true;
+  }
+  m_wakeup.notify_one();
+  m_thread.join();
+}
+
+bool boilerplate::Watchdog::start(void) {
+  m_thread = std::thread(&Watchdog::threadMain, this);
+  return true;
+}
+
+bool boilerplate::Watchdog::Install(JSContext* cx) {
+  static thread_local JSContext* installed = nullptr;
+  if (installed == cx) return true;
+  // There is no way to remove an interrupt callback again, but it does
+  // nothing unless there is a ScriptBudget on the thread.
+  if (!JS_AddInterruptCallback(cx, &ScriptBudget::InterruptCallback))
+    return false;
+  installed = cx;
+  return true;
+}
+
+boilerplate::Watchdog::Counters boilerplate::Watchdog::counters(void) {
+  std::lock_guard<std::mutex> lock(m_lock);
+  return m_counters;
+}
+
+void boilerplate::Watchdog::add(ScriptBudget* budget) {
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_budgets.push_back(budget);
+  }
+  m_wakeup.notify_one();
+}
+
+void boilerplate::Watchdog::remove(ScriptBudget* budget) {
+  std::lock_guard<std::mutex> lock(m_lock);
+  auto entry = std::find(m_budgets.begin(), m_budgets.end(), budget);
+  if (entry != m_budgets.end()) m_budgets.erase(entry);
+
+  m_counters.scripts++;
+  if (budget->exceeded()) m_counters.terminated++;
+  m_counters.cpuTime += budget->cpuTime();
+}
+
+void boilerplate::Watchdog::threadMain(void) {
+  std::unique_lock<std::mutex> lock(m_lock);
+  while (!m_stopping) {
+    Clock::time_point now = Clock::now();
+    Clock::time_point wake = Clock::time_point::max();
+
+    for (ScriptBudget* budget : m_budgets) {
+      if (budget->m_interruptRequested) continue;
+      const ScriptLimits& limits = budget->m_limits;
+
+      Clock::duration remaining = Clock::duration::max();
+      if (limits.wallTime.count() > 0) {
+        remaining = std::min<Clock::duration>(
+            remaining,
+            budget->m_wallStart + limits.wallTime - now);
+      }
+      if (limits.cpuTime.count() > 0) {
+        remaining = std::min<Clock::duration>(
+            remaining, limits.cpuTime - (ReadClock(budget->m_cpuClock) -
+                                         budget->m_cpuStart));
+      }
+
+      if (remaining <= Clock::duration::zero()) {
+        budget->m_interruptRequested = true;
+        JS_RequestInterruptCallback(budget->m_cx);
+        continue;
+      }
+      wake = std::min(wake, now + std::max<Clock::duration>(remaining,
+                                                            MinCheckInterval));
+    }
+
+    if (wake == Clock::time_point::max())
+      m_wakeup.wait(lock);
+    else
+      m_wakeup.wait_until(lock, wake);
+  }
+}
+
+boilerplate::ScriptBudget::ScriptBudget(Watchdog& watchdog, JSContext* cx,
+                                        const ScriptLimits& limits)
+    : m_watchdog(watchdog),
+      m_cx(cx),
+      m_limits(limits),
+      m_outer(currentBudget),
+      m_cpuClock(CLOCK_THREAD_CPUTIME_ID),
+      m_wallStart(Watchdog::Clock::now()),
+      m_exceeded(false),
+      m_interruptRequested(false) {
+  // The watchdog needs a clock ID that it can read from its own thread.
+#ifdef __APPLE__
+  m_cpuClock = CLOCK_MONOTONIC;
+#else
+  if (pthread_getcpuclockid(pthread_self(), &m_cpuClock) != 0)
+    m_cpuClock = CLOCK_MONOTONIC;
+#endif
+  m_cpuStart = ReadClock(m_cpuClock);
+  currentBudget = this;
+
+  if (limits.wallTime.count() > 0 || limits.cpuTime.count() > 0)
+    watchdog.add(this);
+}
+
+boilerplate::ScriptBudget::~ScriptBudget(void) {
+  currentBudget = m_outer;
+  m_watchdog.remove(this);
+}
+
+std::chrono::nanoseconds boilerplate::ScriptBudget::cpuTime(void) const {
+  return ReadClock(m_cpuClock) - m_cpuStart;
+}
+
+std::chrono::nanoseconds boilerplate::ScriptBudget::wallTime(void) const {
+  return Watchdog::Clock::now() - m_wallStart;
+}
+
+// Called on the script's thread. Returns false if the script must stop.
+bool boilerplate::ScriptBudget::check(void) {
+  if (m_exceeded) return false;
+
+  if ((m_limits.wallTime.count() > 0 && wallTime() >= m_limits.wallTime) ||
+      (m_limits.cpuTime.count() > 0 && cpuTime() >= m_limits.cpuTime)) {
+    m_exceeded = true;
+    return false;
+  }
+
+  // Not yet: the thread was probably descheduled for a while, or this is
+  // someone else's interrupt. Let the watchdog look at this budget again.
+  {
+    std::lock_guard<std::mutex> lock(m_watchdog.m_lock);
+    if (!m_interruptRequested) return true;
+    m_interruptRequested = false;
+  }
+  m_watchdog.m_wakeup.notify_one();
+  return true;
+}
+
+bool boilerplate::ScriptBudget::InterruptCallback(JSContext* cx) {
+  for (ScriptBudget* budget = currentBudget; budget; budget = budget->m_outer) {
+    if (budget->m_cx == cx && !budget->check()) return false;
+  }
+  return true;
+}
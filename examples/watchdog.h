@@ -0,0 +1,102 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <time.h>
+
+#include <jsapi.h>
+
+// See 'watchdog.cpp' for documentation.
+
+namespace boilerplate {
+
+// Limits for one script. Zero means no limit.
+struct ScriptLimits {
+  std::chrono::milliseconds wallTime{0};
+  std::chrono::milliseconds cpuTime{0};
+};
+
+class ScriptBudget;
+
+class Watchdog {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Counters {
+    uint64_t scripts;     // number of ScriptBudgets that have ended
+    uint64_t terminated;  // of which, number that exceeded their limits
+    std::chrono::nanoseconds cpuTime;  // total CPU time of those scripts
+  };
+
+  Watchdog(void);
+  ~Watchdog(void);
+
+  Watchdog(const Watchdog&) = delete;
+  Watchdog& operator=(const Watchdog&) = delete;
+
+  bool start(void);
+
+  // Must be called once for each JSContext that will run scripts with a
+  // ScriptBudget, on the context's thread.
+  static bool Install(JSContext* cx);
+
+  Counters counters(void);
+
+ private:
+  friend class ScriptBudget;
+
+  void add(ScriptBudget* budget);
+  void remove(ScriptBudget* budget);
+  void threadMain(void);
+
+  std::thread m_thread;
+  std::mutex m_lock;
+  std::condition_variable m_wakeup;
+  bool m_stopping;
+  std::vector<ScriptBudget*> m_budgets;
+  Counters m_counters;
+};
+
+// Limits the time that scripts run on this thread's context while it is in
+// scope. Budgets may be nested, in which case all of them apply.
+class ScriptBudget {
+ public:
+  ScriptBudget(Watchdog& watchdog, JSContext* cx, const ScriptLimits& limits);
+  ~ScriptBudget(void);
+
+  ScriptBudget(const ScriptBudget&) = delete;
+  ScriptBudget& operator=(const ScriptBudget&) = delete;
+
+  // Whether a script was terminated because it went over the limits. When it
+  // is, the script returns false without a pending exception.
+  bool exceeded(void) const { return m_exceeded; }
+
+  // Time used since the budget was created.
+  std::chrono::nanoseconds cpuTime(void) const;
+  std::chrono::nanoseconds wallTime(void) const;
+
+ private:
+  friend class Watchdog;
+
+  bool check(void);
+  static bool InterruptCallback(JSContext* cx);
+
+  Watchdog& m_watchdog;
+  JSContext* m_cx;
+  ScriptLimits m_limits;
+  ScriptBudget* m_outer;
+  clockid_t m_cpuClock;
+  Watchdog::Clock::time_point m_wallStart;
+  std::chrono::nanoseconds m_cpuStart;
+  bool m_exceeded;
+
+  // Protected by the watchdog's lock.
+  bool m_interruptRequested;
+};
+
+}  // namespace boilerplate
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+
+#include <jsapi.h>
+
+#include <js/GCHashTable.h>
+#include <js/SweepingAPI.h>
+
+// A WeakObjectMap maps native keys (such as IDs from the embedding) to JS
+// objects, without keeping the objects alive. When the GC finds that an object
+// in the map isn't reachable from anywhere else, the entry is removed during
+// sweeping, as part of that GC; there's no separate pass over the map to look
+// for dead entries.
+//
+// This is built on JS::WeakCache, which registers the map with the GC so it
+// gets swept after marking, and JS::GCHashMap, which uses
+// JS::GCPolicy<JS::Heap<JSObject*>>::needsSweep() to decide which entries are
+// dead. The Key type needs a JS::GCPolicy as well; for integer types
+// SpiderMonkey already provides one (JS::IgnoreGCPolicy).
+//
+// The map is registered with the whole runtime rather than with one zone, so
+// it can hold objects from any zone, and it must be destroyed before the
+// JSContext.
+//
+// NOTE: Objects that are still in the nursery are kept alive across minor GCs
+// by the map's post-barriers; they're only dropped by the first major GC after
+// they're tenured and become unreachable.
+
+namespace boilerplate {
+
+template <typename Key, typename HashPolicy = js::DefaultHasher<Key>>
+class WeakObjectMap {
+  using Map = JS::GCHashMap<Key, JS::Heap<JSObject*>, HashPolicy,
+                            js::SystemAllocPolicy>;
+
+  JS::WeakCache<Map> m_map;
+
+ public:
+  explicit WeakObjectMap(JSContext* cx) : m_map(JS_GetRuntime(cx)) {}
+
+  WeakObjectMap(const WeakObjectMap&) = delete;
+  WeakObjectMap& operator=(const WeakObjectMap&) = delete;
+
+  // Returns null if there's no live object for 'key'.
+  JSObject* lookup(const Key& key) const {
+    auto ptr = m_map.lookup(key);
+    return ptr ? ptr->value().get() : nullptr;
+  }
+
+  // Returns false if out of memory.
+  bool put(const Key& key, JSObject* obj) { return m_map.put(key, obj); }
+
+  void remove(const Key& key) { m_map.remove(key); }
+  void clear(void) { m_map.clear(); }
+
+  // May include entries for objects that have died since the last GC.
+  size_t count(void) const { return m_map.count(); }
+};
+
+}  // namespace boilerplate
@@ -0,0 +1,80 @@
+#include <cstdint>
+#include <iostream>
+
+#include <jsapi.h>
+
+#include <js/GCHashTable.h>
+
+#include "boilerplate.h"
+#include "weakobjectmap.h"
+
+// This example shows how to keep a cache of JS objects keyed by native IDs
+// without leaking them, using boilerplate::WeakObjectMap.
+//
+// It simulates an embedding that wraps native objects with JS objects,
+// looking up existing wrappers by ID. Wrappers are created continuously and
+// scripts only keep a few of them around. With a strong map (a rooted
+// GCHashMap) every wrapper ever created stays alive, and the heap keeps
+// growing. With a WeakObjectMap, dead wrappers are dropped during GC, so the
+// number of entries and the heap size stay flat.
+
+static constexpr uint64_t numWrappers = 1000000;
+static constexpr uint64_t reportEvery = 200000;
+
+using StrongMap = JS::GCHashMap<uint64_t, JS::Heap<JSObject*>,
+                                js::DefaultHasher<uint64_t>,
+                                js::SystemAllocPolicy>;
+
+static void Report(JSContext* cx, uint64_t created, size_t entries) {
+  std::cout << "  " << created << " wrappers created, " << entries
+            << " in map, GC heap " << JS_GetGCParameter(cx, JSGC_BYTES) / 1024
+            << " KB\n";
+}
+
+// 'Map' only needs lookup(), put() and count() with the same meaning as in
+// WeakObjectMap. A rooted GCHashMap happens to have those too.
+template <typename Map>
+static bool Churn(JSContext* cx, Map& map) {
+  for (uint64_t id = 1; id <= numWrappers; id++) {
+    // The embedding looks up the wrapper for a native object, and creates
+    // one if there isn't one yet. Here every ID is new.
+    if (!map.lookup(id)) {
+      JSObject* wrapper = JS_NewPlainObject(cx);
+      if (!wrapper || !map.put(id, wrapper)) return false;
+    }
+
+    if (id % reportEvery == 0) {
+      JS_GC(cx);
+      Report(cx, id, map.count());
+    }
+  }
+  return true;
+}
+
+static bool WeakRefsExample(JSContext* cx) {
+  JS::RootedObject global(cx, boilerplate::CreateGlobal(cx));
+  if (!global) return false;
+
+  JSAutoRealm ar(cx, global);
+
+  std::cout << "strong map (rooted GCHashMap):\n";
+  {
+    JS::Rooted<StrongMap> strong(cx);
+    if (!Churn(cx, strong)) return false;
+  }
+
+  JS_GC(cx);
+
+  std::cout << "weak map (WeakObjectMap):\n";
+  {
+    boilerplate::WeakObjectMap<uint64_t> weak(cx);
+    if (!Churn(cx, weak)) return false;
+  }
+
+  return true;
+}
+
+int main(int argc, const char* argv[]) {
+  if (!boilerplate::RunExample(WeakRefsExample)) return 1;
+  return 0;
+}
@@ -306,7 +306,8 @@ def get_opcodes(dir):
             opcode.length = m.group('length')
             opcode.nuses = m.group('nuses')
             opcode.ndefs = m.group('ndefs')
-            opcode.flags = m.group('flags').split('|')
+            opcode.flags = [flag.strip()
+                            for flag in m.group('flags').split('|')]
 
             if not group_head:
                 group_head = opcode
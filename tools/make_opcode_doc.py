@@ -4,11 +4,16 @@
 """ Usage: make_opcode_doc.py PATH_TO_SPIDERMONKEY_SOURCE
 
     This script generates SpiderMonkey bytecode documentation
-    from js/src/vm/Opcodes.h.
+    from js/src/vm/Opcodes.h, and a table of the opcodes for programs
+    that work with bytecode, such as profilers.
 
-    Output is written to docs/Bytecode.md.
+    Output is written to docs/Bytecodes.md and docs/Opcodes.json, both
+    from one pass over Opcodes.h. Opcode values and lengths change between
+    engine versions, so Opcodes.json is only right for the Opcodes.h it was
+    generated from, and is not committed.
 """
 
+import json
 import sys
 import os
 from xml.sax.saxutils import escape
@@ -132,6 +137,39 @@ overall stack-effects of their execution.
                 print_opcode(opcode_, out)
 
 
+def opcode_table(opcodes):
+    """ Returns the opcodes sorted by value, and the names of all their flags
+        without the JOF_ prefix, sorted. """
+    table = sorted(opcodes.values(), key=lambda opcode: opcode.value)
+    flags = set()
+    for opcode in table:
+        flags.update(flag.replace('JOF_', '') for flag in opcode.flags)
+    return table, sorted(flags)
+
+
+def write_json(opcodes, out):
+    table, flags = opcode_table(opcodes)
+    # One opcode per line, so that changes between versions are easy to see.
+    entries = []
+    for opcode in table:
+        entries.append(json.dumps({
+            'name': opcode.name,
+            'displayName': opcode.display_name,
+            'value': opcode.value,
+            'length': int(opcode.length),
+            'nuses': int(opcode.nuses),
+            'ndefs': int(opcode.ndefs),
+            'flags': [flag.replace('JOF_', '') for flag in opcode.flags],
+        }, separators=(',', ':')))
+    print('{{"source":"{source_base}/js/src/vm/Opcodes.h",\n'
+          '"flags":{flags},\n'
+          '"opcodes":[\n{entries}\n]}}'.format(
+              source_base=SOURCE_BASE,
+              flags=json.dumps(flags, separators=(',', ':')),
+              entries=',\n'.join(entries)),
+          file=out)
+
+
 if __name__ == '__main__':
     if len(sys.argv) < 2:
         print("Usage: make_opcode_doc.py PATH_TO_SPIDERMONKEY_SOURCE",
@@ -144,10 +182,12 @@ if __name__ == '__main__':
     import jsopcode
 
     try:
-        index, _ = jsopcode.get_opcodes(dir)
+        index, opcodes = jsopcode.get_opcodes(dir)
     except Exception as e:
         print("Error: {}".format(' '.join(map(str, e.args))), file=sys.stderr)
         sys.exit(1)
 
     with open(os.path.join(thisdir, '..', 'docs', 'Bytecodes.md'), 'w') as out:
         print_doc(index, out)
+    with open(os.path.join(thisdir, '..', 'docs', 'Opcodes.json'), 'w') as out:
+        write_json(opcodes, out)